@@ -2141,6 +2141,276 @@ BIF_RETTYPE send_3(BIF_ALIST_3)
     BIF_ERROR(p, BADARG);
 }
 
+/*
+ * erlang:send_multi/2,3 sends the same message to a list of processes.
+ *
+ * The destinations are grouped by node. Each remote node that has
+ * DFLAG_SEND_MULTI gets one DOP_SEND_MULTI signal with the message
+ * encoded once, instead of one DOP_SEND per destination.
+ *
+ * Destinations on nodes that are not connected are handed to
+ * erlang:dsend_multi/2,3, which connects and calls us again. If the
+ * sender has to be suspended on a busy distribution port, we yield
+ * with the destinations not yet handled. With the nosuspend and
+ * noconnect options such destinations are instead returned to the
+ * caller.
+ */
+
+#define ERTS_SEND_MULTI_SENT		0
+#define ERTS_SEND_MULTI_CONNECT		1 /* Node not connected */
+#define ERTS_SEND_MULTI_BUSY		2 /* Skipped due to nosuspend */
+
+typedef struct {
+    DistEntry *dep;
+    Uint ix;
+    Eterm pid;
+    int state;
+} ErtsSendMultiDest;
+
+static int
+send_multi_cmp(const void *a, const void *b)
+{
+    const ErtsSendMultiDest *x = (const ErtsSendMultiDest *) a;
+    const ErtsSendMultiDest *y = (const ErtsSendMultiDest *) b;
+    if (x->dep != y->dep)
+	return x->dep < y->dep ? -1 : 1;
+    return x->ix < y->ix ? -1 : (x->ix > y->ix ? 1 : 0);
+}
+
+static void
+send_multi_local(Process *p, Eterm to, Eterm msg)
+{
+    Process *rp;
+    ErtsProcLocks rp_locks = 0;
+
+    if (internal_pid_index(to) >= erts_max_processes)
+	return;
+    rp = erts_pid2proc_opt(p, ERTS_PROC_LOCK_MAIN,
+			   to, 0, ERTS_P2P_FLG_SMP_INC_REFC);
+    if (!rp)
+	return;
+#ifdef ERTS_SMP
+    if (p == rp)
+	rp_locks |= ERTS_PROC_LOCK_MAIN;
+#endif
+    erts_send_message(p, rp, &rp_locks, msg, 0);
+    erts_smp_proc_unlock(rp,
+			 p == rp
+			 ? (rp_locks & ~ERTS_PROC_LOCK_MAIN)
+			 : rp_locks);
+    erts_smp_proc_dec_refc(rp);
+}
+
+/*
+ * Build a list of the destinations in dv[0..n-1] that have one of
+ * the states in the state mask (or all of them if mask is 0).
+ */
+static Eterm
+send_multi_list(Process *p, ErtsSendMultiDest *dv, Uint n, int mask,
+		Eterm tail)
+{
+    Uint i, len = 0;
+    Eterm *hp;
+
+    for (i = 0; i < n; i++) {
+	if (!mask || (mask & (1 << dv[i].state)))
+	    len++;
+    }
+    if (len == 0)
+	return tail;
+    hp = HAlloc(p, 2*len);
+    while (n > 0) {
+	n--;
+	if (!mask || (mask & (1 << dv[n].state))) {
+	    tail = CONS(hp, dv[n].pid, tail);
+	    hp += 2;
+	}
+    }
+    return tail;
+}
+
+static BIF_RETTYPE
+send_multi(Process *p, Eterm dests, Eterm msg, Eterm opts,
+	   int connect, int suspend)
+{
+    ErtsSendMultiDest *dv;
+    Eterm l, res, *ctl_heap = NULL;
+    Uint n, i, j, k, npending = 0;
+    Uint ctl_heap_sz = 0;
+    int yield = 0;
+
+    for (n = 0, l = dests; is_list(l); l = CDR(list_val(l)), n++) {
+	if (is_not_pid(CAR(list_val(l))))
+	    BIF_ERROR(p, BADARG);
+    }
+    if (is_not_nil(l))
+	BIF_ERROR(p, BADARG);
+    if (n == 0)
+	BIF_RET(is_value(opts) ? NIL : am_ok);
+
+    if (IS_TRACED(p)) {
+	for (l = dests; is_list(l); l = CDR(list_val(l)))
+	    trace_send(p, CAR(list_val(l)), msg);
+    }
+    if (ERTS_PROC_GET_SAVED_CALLS_BUF(p))
+	save_calls(p, &exp_send);
+
+    dv = erts_alloc(ERTS_ALC_T_TMP, n*sizeof(ErtsSendMultiDest));
+    for (i = 0, l = dests; i < n; i++, l = CDR(list_val(l))) {
+	Eterm to = CAR(list_val(l));
+	dv[i].dep = (is_internal_pid(to)
+		     ? erts_this_dist_entry
+		     : external_pid_dist_entry(to));
+	dv[i].ix = i;
+	dv[i].pid = to;
+	dv[i].state = ERTS_SEND_MULTI_SENT;
+    }
+    qsort((void *) dv, (size_t) n, sizeof(ErtsSendMultiDest), send_multi_cmp);
+
+    for (i = 0; i < n && !yield; i = j) {
+	DistEntry *dep = dv[i].dep;
+	ErtsDSigData dsd;
+	int code;
+
+	for (j = i + 1; j < n && dv[j].dep == dep; j++)
+	    ;
+
+	if (dep == erts_this_dist_entry) {
+	    for (k = i; k < j; k++) {
+		if (is_internal_pid(dv[k].pid))
+		    send_multi_local(p, dv[k].pid, msg);
+		/* else an old incarnation of this node; drop it */
+	    }
+	    BUMP_REDS(p, j - i);
+	    if (ERTS_PROC_IS_EXITING(p)) {
+		erts_free(ERTS_ALC_T_TMP, (void *) dv);
+		if (ctl_heap)
+		    erts_free(ERTS_ALC_T_TMP, (void *) ctl_heap);
+		KILL_CATCHES(p); /* Must exit */
+		BIF_ERROR(p, EXC_ERROR);
+	    }
+	    continue;
+	}
+
+	code = erts_dsig_prepare(&dsd, dep, p, ERTS_DSP_NO_LOCK, !suspend);
+	switch (code) {
+	case ERTS_DSIG_PREP_NOT_ALIVE:
+	case ERTS_DSIG_PREP_NOT_CONNECTED:
+	    for (k = i; k < j; k++)
+		dv[k].state = ERTS_SEND_MULTI_CONNECT;
+	    npending += j - i;
+	    break;
+	case ERTS_DSIG_PREP_WOULD_SUSPEND:
+	    ASSERT(!suspend);
+	    for (k = i; k < j; k++)
+		dv[k].state = ERTS_SEND_MULTI_BUSY;
+	    break;
+	case ERTS_DSIG_PREP_CONNECTED:
+	    if (j - i > 1
+		&& (dep->flags & DFLAG_SEND_MULTI)
+		&& SEQ_TRACE_TOKEN(p) == NIL) {
+		Eterm *hp, to_list = NIL;
+		if (ctl_heap_sz < 2*(j - i)) {
+		    if (ctl_heap)
+			erts_free(ERTS_ALC_T_TMP, (void *) ctl_heap);
+		    ctl_heap_sz = 2*(j - i);
+		    ctl_heap = erts_alloc(ERTS_ALC_T_TMP,
+					  ctl_heap_sz*sizeof(Eterm));
+		}
+		hp = ctl_heap;
+		for (k = j; k > i; k--) {
+		    to_list = CONS(hp, dv[k-1].pid, to_list);
+		    hp += 2;
+		}
+		code = erts_dsig_send_multi(&dsd, to_list, msg);
+		k = j;
+	    }
+	    else {
+		code = ERTS_DSIG_SEND_OK;
+		for (k = i; k < j && code != ERTS_DSIG_SEND_YIELD; k++)
+		    code = erts_dsig_send_msg(&dsd, dv[k].pid, msg);
+	    }
+	    if (code == ERTS_DSIG_SEND_YIELD) {
+		/*
+		 * We have been suspended on a busy distribution port.
+		 * Destinations from dv[k] and on have not been handled.
+		 */
+		ASSERT(suspend);
+		yield = 1;
+		for (; k < n; k++)
+		    dv[k].state = ERTS_SEND_MULTI_CONNECT;
+	    }
+	    break;
+	default:
+	    ASSERT(! "Invalid dsig prepare result");
+	    erts_free(ERTS_ALC_T_TMP, (void *) dv);
+	    if (ctl_heap)
+		erts_free(ERTS_ALC_T_TMP, (void *) ctl_heap);
+	    BIF_ERROR(p, EXC_INTERNAL_ERROR);
+	}
+    }
+
+    if (ctl_heap)
+	erts_free(ERTS_ALC_T_TMP, (void *) ctl_heap);
+
+    if (yield) {
+	Eterm rest = send_multi_list(p, dv, n,
+				     1 << ERTS_SEND_MULTI_CONNECT, NIL);
+	erts_free(ERTS_ALC_T_TMP, (void *) dv);
+	if (is_value(opts))
+	    ERTS_BIF_YIELD3(bif_export[BIF_send_multi_3], p, rest, msg, opts);
+	ERTS_BIF_YIELD2(bif_export[BIF_send_multi_2], p, rest, msg);
+    }
+
+    if (npending && connect) {
+	/* Busy ones (nosuspend) are tried once more after connecting */
+	Eterm pending = send_multi_list(p, dv, n,
+					((1 << ERTS_SEND_MULTI_CONNECT)
+					 | (1 << ERTS_SEND_MULTI_BUSY)), NIL);
+	erts_free(ERTS_ALC_T_TMP, (void *) dv);
+	if (is_value(opts))
+	    BIF_TRAP3(dsend_multi3_trap, p, pending, msg, opts);
+	BIF_TRAP2(dsend_multi2_trap, p, pending, msg);
+    }
+
+    if (is_non_value(opts))
+	res = am_ok;
+    else
+	res = send_multi_list(p, dv, n,
+			      ((1 << ERTS_SEND_MULTI_CONNECT)
+			       | (1 << ERTS_SEND_MULTI_BUSY)), NIL);
+    erts_free(ERTS_ALC_T_TMP, (void *) dv);
+    BIF_RET(res);
+}
+
+BIF_RETTYPE send_multi_2(BIF_ALIST_2)
+{
+    return send_multi(BIF_P, BIF_ARG_1, BIF_ARG_2, THE_NON_VALUE, !0, !0);
+}
+
+BIF_RETTYPE send_multi_3(BIF_ALIST_3)
+{
+    Process *p = BIF_P;
+    Eterm opts = BIF_ARG_3;
+    int connect = !0;
+    int suspend = !0;
+    Eterm l;
+
+    for (l = opts; is_list(l); l = CDR(list_val(l))) {
+	if (CAR(list_val(l)) == am_noconnect) {
+	    connect = 0;
+	} else if (CAR(list_val(l)) == am_nosuspend) {
+	    suspend = 0;
+	} else {
+	    BIF_ERROR(p, BADARG);
+	}
+    }
+    if (is_not_nil(l)) {
+	BIF_ERROR(p, BADARG);
+    }
+    return send_multi(p, BIF_ARG_1, BIF_ARG_2, opts, connect, suspend);
+}
+
 BIF_RETTYPE send_2(BIF_ALIST_2)
 {
     return erl_send(BIF_P, BIF_ARG_1, BIF_ARG_2);
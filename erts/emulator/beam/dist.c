@@ -42,6 +42,7 @@
 #include "external.h"
 #include "erl_binary.h"
 #include "erl_thr_progress.h"
+#include "erl_zlib.h"
 
 /* Turn this on to get printouts of all distribution messages
  * which go on the line
@@ -96,9 +97,11 @@ dist_msg_dbg(ErtsDistExternal *edep, char *what, byte *buf, int sz)
 
 
 #define PASS_THROUGH 'p'        /* This code should go */
+#define DIST_COMPRESSED 'z'	/* Batch of messages compressed with zlib */
 
 int erts_is_alive; /* System must be blocked on change */
 int erts_dist_buf_busy_limit;
+int erts_dist_compress_threshold;
 
 
 /* distribution trap functions */
@@ -111,6 +114,8 @@ Export* dmonitor_node_trap = NULL;
 Export* dgroup_leader_trap = NULL;
 Export* dexit_trap = NULL;
 Export* dmonitor_p_trap = NULL;
+Export* dsend_multi2_trap = NULL;
+Export* dsend_multi3_trap = NULL;
 
 /* local variables */
 
@@ -155,6 +160,59 @@ create_cache(DistEntry *dep)
     }
 }
 
+/*
+ * Compressed distribution links.
+ *
+ * When both nodes have DFLAG_DIST_COMPRESS set, runs of queued output
+ * buffers are packed together as [Len:32, Data]* records and sent as
+ * one packet tagged DIST_COMPRESSED, holding the next piece of a zlib
+ * stream that lives as long as the connection. Each packet ends with a
+ * sync flush, so that the receiver can inflate it on its own. Batches
+ * smaller than erts_dist_compress_threshold are sent as is.
+ */
+
+#define ERTS_DIST_COMPRESS_BATCH_SIZE (64*1024)
+
+typedef struct ErtsDistCompress_ {
+    z_stream out;
+    z_stream in;
+    byte *ibuf;			/* Inflated input */
+    Uint ibuf_size;
+} ErtsDistCompress;
+
+static void
+delete_compress(ErtsDistCompress *dcp)
+{
+    if (dcp) {
+	deflateEnd(&dcp->out);
+	inflateEnd(&dcp->in);
+	if (dcp->ibuf)
+	    erts_free(ERTS_ALC_T_DCOMPR_BUF, (void *) dcp->ibuf);
+	erts_free(ERTS_ALC_T_DIST_COMPRESS, (void *) dcp);
+    }
+}
+
+static void
+create_compress(DistEntry *dep)
+{
+    ErtsDistCompress *dcp;
+
+    ERTS_SMP_LC_ASSERT(
+	is_internal_port(dep->cid)
+	&& erts_lc_is_port_locked(&erts_port[internal_port_index(dep->cid)]));
+    ASSERT(!dep->compress);
+
+    dcp = (ErtsDistCompress *) erts_alloc(ERTS_ALC_T_DIST_COMPRESS,
+					  sizeof(ErtsDistCompress));
+    sys_memzero((void *) dcp, sizeof(ErtsDistCompress));
+    erl_zlib_alloc_init(&dcp->out);
+    erl_zlib_alloc_init(&dcp->in);
+    if (deflateInit(&dcp->out, Z_BEST_SPEED) != Z_OK
+	|| inflateInit(&dcp->in) != Z_OK)
+	erl_exit(ERTS_ABORT_EXIT, "Failed to initialize dist compression\n");
+    dep->compress = dcp;
+}
+
 Uint erts_dist_cache_size(void)
 {
     return (Uint) erts_smp_atomic_read_mb(&no_caches)*sizeof(ErtsAtomCache);
@@ -523,6 +581,8 @@ void init_dist(void)
     dgroup_leader_trap = trap_function(am_dgroup_leader,2);
     dexit_trap = trap_function(am_dexit, 2);
     dmonitor_p_trap = trap_function(am_dmonitor_p, 2);
+    dsend_multi2_trap = trap_function(am_dsend_multi, 2);
+    dsend_multi3_trap = trap_function(am_dsend_multi, 3);
 }
 
 #define ErtsDistOutputBuf2Binary(OB) \
@@ -561,16 +621,180 @@ size_obuf(ErtsDistOutputBuf *obuf)
     return bin->orig_size;
 }
 
+/*
+ * Traffic statistics
+ */
+
+static struct {
+    int op;
+    char *name;
+} dist_stat_ops[] = {
+    {DOP_LINK,			"link"},
+    {DOP_SEND,			"send"},
+    {DOP_EXIT,			"exit"},
+    {DOP_UNLINK,		"unlink"},
+    {DOP_REG_SEND,		"reg_send"},
+    {DOP_GROUP_LEADER,		"group_leader"},
+    {DOP_EXIT2,			"exit2"},
+    {DOP_SEND_TT,		"send_tt"},
+    {DOP_EXIT_TT,		"exit_tt"},
+    {DOP_REG_SEND_TT,		"reg_send_tt"},
+    {DOP_EXIT2_TT,		"exit2_tt"},
+    {DOP_MONITOR_P,		"monitor_p"},
+    {DOP_DEMONITOR_P,		"demonitor_p"},
+    {DOP_MONITOR_P_EXIT,	"monitor_p_exit"},
+    {DOP_SEND_MULTI,		"send_multi"}
+};
+
+#define ERTS_DIST_STAT_NO_OPS \
+  (sizeof(dist_stat_ops)/sizeof(dist_stat_ops[0]))
+
+static ERTS_INLINE Uint
+dist_stat_usecs(void)
+{
+#ifdef HAVE_GETHRTIME
+    return (Uint) (sys_gethrtime() / 1000);
+#else
+    SysTimeval tv;
+    sys_gettimeofday(&tv);
+    return ((Uint) tv.tv_sec)*1000000 + (Uint) tv.tv_usec;
+#endif
+}
+
+static ERTS_INLINE Uint
+dist_stat_slot(Uint type)
+{
+    return type == DOP_SEND_MULTI ? ERTS_DIST_STAT_OPS - 1 : type;
+}
+
+static ERTS_INLINE void
+dist_stat_update(ErtsDistOpStat *statp, Uint type, Uint size, Uint start)
+{
+    type = dist_stat_slot(type);
+    if (type < ERTS_DIST_STAT_OPS) {
+	statp += type;
+	erts_smp_atomic_inc_nob(&statp->msgs);
+	erts_smp_atomic_add_nob(&statp->octets, (erts_aint_t) size);
+	erts_smp_atomic_add_nob(&statp->usecs,
+				(erts_aint_t) (dist_stat_usecs() - start));
+    }
+}
+
+void
+erts_dist_stats_init(ErtsDistStats *dsp)
+{
+    int i;
+    for (i = 0; i < ERTS_DIST_STAT_OPS; i++) {
+	erts_smp_atomic_init_nob(&dsp->send[i].msgs, 0);
+	erts_smp_atomic_init_nob(&dsp->send[i].octets, 0);
+	erts_smp_atomic_init_nob(&dsp->send[i].usecs, 0);
+	erts_smp_atomic_init_nob(&dsp->recv[i].msgs, 0);
+	erts_smp_atomic_init_nob(&dsp->recv[i].octets, 0);
+	erts_smp_atomic_init_nob(&dsp->recv[i].usecs, 0);
+    }
+    dsp->qsize_max = 0;
+    dsp->busy = 0;
+}
+
+static Eterm
+bld_dist_op_stats(Uint **hpp, Uint *szp, Uint (*snap)[3], Eterm *names)
+{
+    Eterm res = NIL;
+    int i;
+    for (i = ERTS_DIST_STAT_NO_OPS - 1; i >= 0; i--) {
+	if (snap[i][0])
+	    res = erts_bld_cons(hpp, szp,
+				erts_bld_tuple(hpp, szp, 4,
+					       names[i],
+					       erts_bld_uint(hpp, szp,
+							     snap[i][0]),
+					       erts_bld_uint(hpp, szp,
+							     snap[i][1]),
+					       erts_bld_uint(hpp, szp,
+							     snap[i][2])),
+				res);
+    }
+    return res;
+}
+
+/*
+ * Returns [{send, OpStats}, {recv, OpStats}, {out_queue_max, Size},
+ * {busy_dist_port, Count}] where OpStats is a list of
+ * {Op, Msgs, Octets, MicroSecs} for each control message type seen.
+ */
+Eterm
+erts_dist_stats_info(Process *c_p, DistEntry *dep)
+{
+    Eterm names[ERTS_DIST_STAT_NO_OPS];
+    Uint send_snap[ERTS_DIST_STAT_NO_OPS][3];
+    Uint recv_snap[ERTS_DIST_STAT_NO_OPS][3];
+    Eterm tags[4];
+    Eterm vals[4];
+    Eterm res;
+    Uint *hp, sz;
+    Uint **hpp, *szp;
+    Uint qsize_max;
+    Uint busy;
+    int i;
+    ERTS_DECL_AM(send);
+    ERTS_DECL_AM(recv);
+    ERTS_DECL_AM(out_queue_max);
+
+    for (i = 0; i < ERTS_DIST_STAT_NO_OPS; i++) {
+	Uint slot = dist_stat_slot(dist_stat_ops[i].op);
+	ErtsDistOpStat *sp = &dep->stats.send[slot];
+	ErtsDistOpStat *rp = &dep->stats.recv[slot];
+	names[i] = am_atom_put(dist_stat_ops[i].name,
+			       sys_strlen(dist_stat_ops[i].name));
+	send_snap[i][0] = (Uint) erts_smp_atomic_read_nob(&sp->msgs);
+	send_snap[i][1] = (Uint) erts_smp_atomic_read_nob(&sp->octets);
+	send_snap[i][2] = (Uint) erts_smp_atomic_read_nob(&sp->usecs);
+	recv_snap[i][0] = (Uint) erts_smp_atomic_read_nob(&rp->msgs);
+	recv_snap[i][1] = (Uint) erts_smp_atomic_read_nob(&rp->octets);
+	recv_snap[i][2] = (Uint) erts_smp_atomic_read_nob(&rp->usecs);
+    }
+
+    erts_smp_mtx_lock(&dep->qlock);
+    qsize_max = (Uint) dep->stats.qsize_max;
+    busy = dep->stats.busy;
+    erts_smp_mtx_unlock(&dep->qlock);
+
+    tags[0] = AM_send;
+    tags[1] = AM_recv;
+    tags[2] = AM_out_queue_max;
+    tags[3] = am_busy_dist_port;
+
+    sz = 0;
+    hpp = NULL;
+    szp = &sz;
+    while (1) {
+	vals[0] = bld_dist_op_stats(hpp, szp, send_snap, names);
+	vals[1] = bld_dist_op_stats(hpp, szp, recv_snap, names);
+	vals[2] = erts_bld_uint(hpp, szp, qsize_max);
+	vals[3] = erts_bld_uint(hpp, szp, busy);
+	res = erts_bld_2tup_list(hpp, szp, 4, tags, vals);
+	if (hpp)
+	    break;
+	hp = HAlloc(c_p, sz);
+	hpp = &hp;
+	szp = NULL;
+    }
+    return res;
+}
+
 static void clear_dist_entry(DistEntry *dep)
 {
     Sint obufsize = 0;
     ErtsAtomCache *cache;
+    ErtsDistCompress *compress;
     ErtsProcList *suspendees;
     ErtsDistOutputBuf *obuf;
 
     erts_smp_de_rwlock(dep);
     cache = dep->cache;
     dep->cache = NULL;
+    compress = dep->compress;
+    dep->compress = NULL;
 
 #ifdef DEBUG
     erts_smp_de_links_lock(dep);
@@ -604,6 +828,7 @@ static void clear_dist_entry(DistEntry *dep)
     erts_resume_processes(suspendees);
 
     delete_cache(cache);
+    delete_compress(compress);
 
     while (obuf) {
 	ErtsDistOutputBuf *fobuf;
@@ -785,6 +1010,29 @@ erts_dsig_send_reg_msg(ErtsDSigData *dsdp, Eterm remote_name, Eterm message)
     return res;
 }
 
+/*
+ * Send one message to several processes on the node. The message is
+ * only encoded once, the receiving node delivers a copy to each of the
+ * processes in the list. Only used when the other node has
+ * DFLAG_SEND_MULTI set, and not for sequential tracing.
+ */
+int
+erts_dsig_send_multi(ErtsDSigData *dsdp, Eterm remotes, Eterm message)
+{
+    Eterm ctl;
+    DeclareTmpHeapNoproc(ctl_heap,4);
+    int res;
+
+    ASSERT(dsdp->dep->flags & DFLAG_SEND_MULTI);
+    ASSERT(SEQ_TRACE_TOKEN(dsdp->proc) == NIL);
+
+    UseTmpHeapNoproc(4);
+    ctl = TUPLE3(&ctl_heap[0], make_small(DOP_SEND_MULTI), am_Cookie, remotes);
+    res = dsig_send(dsdp, ctl, message, 0);
+    UnUseTmpHeapNoproc(4);
+    return res;
+}
+
 /* local has died, deliver the exit signal to remote */
 int
 erts_dsig_send_exit_tt(ErtsDSigData *dsdp, Eterm local, Eterm remote, 
@@ -884,6 +1132,71 @@ erts_dsig_send_group_leader(ErtsDSigData *dsdp, Eterm leader, Eterm remote)
 #  define PURIFY_MSG(msg)
 #endif
 
+/*
+ * Inflate a DIST_COMPRESSED packet and pass each message
+ * in it on to erts_net_message().
+ */
+static int
+net_compressed_message(Port *prt, DistEntry *dep, byte *buf, ErlDrvSizeT len)
+{
+    ErtsDistCompress *dcp = dep->compress;
+    Uint used = 0;
+    byte *p, *endp;
+
+    dcp->in.next_in = buf + 1;
+    dcp->in.avail_in = len - 1;
+    while (1) {
+	int res;
+	if (used == dcp->ibuf_size) {
+	    dcp->ibuf_size = (dcp->ibuf_size
+			      ? 2*dcp->ibuf_size
+			      : ERTS_DIST_COMPRESS_BATCH_SIZE);
+	    dcp->ibuf = (dcp->ibuf
+			 ? erts_realloc(ERTS_ALC_T_DCOMPR_BUF,
+					(void *) dcp->ibuf,
+					dcp->ibuf_size)
+			 : erts_alloc(ERTS_ALC_T_DCOMPR_BUF, dcp->ibuf_size));
+	}
+	dcp->in.next_out = dcp->ibuf + used;
+	dcp->in.avail_out = dcp->ibuf_size - used;
+	res = inflate(&dcp->in, Z_SYNC_FLUSH);
+	used = dcp->in.next_out - dcp->ibuf;
+	if (res != Z_OK && (res != Z_BUF_ERROR || dcp->in.avail_out != 0))
+	    goto data_error;
+	if (dcp->in.avail_in == 0 && dcp->in.avail_out != 0)
+	    break;
+    }
+
+    p = dcp->ibuf;
+    endp = p + used;
+    while (p < endp) {
+	Uint32 mlen;
+	if (endp - p < 4)
+	    goto data_error;
+	mlen = get_int32(p);
+	p += 4;
+	if (mlen == 0 || mlen > endp - p || *p == DIST_COMPRESSED)
+	    goto data_error;
+	/* Connection is gone (and dcp with it) on failure */
+	if (erts_net_message(prt, dep, NULL, 0, p, mlen) < 0)
+	    return -1;
+	p += mlen;
+    }
+
+    if (dcp->ibuf_size > 4*ERTS_DIST_COMPRESS_BATCH_SIZE) {
+	/* Don't hang on to the space used by a huge message */
+	erts_free(ERTS_ALC_T_DCOMPR_BUF, (void *) dcp->ibuf);
+	dcp->ibuf = NULL;
+	dcp->ibuf_size = 0;
+    }
+    return 0;
+
+ data_error:
+    PURIFY_MSG("data error");
+    erts_do_exit_port(prt, dep->cid, am_killed);
+    return -1;
+}
+
 /*
 ** Input from distribution port.
 **  Input follows the distribution protocol v4.5
@@ -923,6 +1236,8 @@ int erts_net_message(Port *prt,
     ErtsLink *lnk;
     Uint tuple_arity;
     int res;
+    Uint start;
+    ErlDrvSizeT stat_len = len;
 #ifdef ERTS_DIST_MSG_DBG
     ErlDrvSizeT orig_len = len;
 #endif
@@ -947,11 +1262,18 @@ int erts_net_message(Port *prt,
 	return 0;
     }
 
+    if (buf[0] == DIST_COMPRESSED && dep->compress) {
+	UnUseTmpHeapNoproc(DIST_CTL_DEFAULT_SIZE);
+	return net_compressed_message(prt, dep, buf, len);
+    }
+
 #ifdef ERTS_RAW_DIST_MSG_DBG
     erts_fprintf(stderr, "<< ");
     bw(buf, len);
 #endif
 
+    start = dist_stat_usecs();
+
     if (dep->flags & DFLAG_DIST_HDR_ATOM_CACHE)
 	t = buf;
     else {
@@ -1243,6 +1565,40 @@ int erts_net_message(Port *prt,
 	}
 	break;
 
+    case DOP_SEND_MULTI: {
+	/* {DOP_SEND_MULTI, Cookie, [To, ...]} -- Message */
+	Eterm l;
+#ifdef ERTS_DIST_MSG_DBG
+	dist_msg_dbg(&ede, "MSG", buf, orig_len);
+#endif
+	if (tuple_arity != 3) {
+	    goto invalid_message;
+	}
+	for (l = tuple[3]; is_list(l); l = CDR(list_val(l))) {
+	    if (is_not_pid(CAR(list_val(l)))) {
+		goto invalid_message;
+	    }
+	}
+	if (is_not_nil(l)) {
+	    goto invalid_message;
+	}
+	for (l = tuple[3]; is_list(l); l = CDR(list_val(l))) {
+	    to = CAR(list_val(l));
+	    rp = erts_pid2proc_opt(NULL, 0, to, 0, ERTS_P2P_FLG_SMP_INC_REFC);
+	    if (rp) {
+		ErtsProcLocks locks = 0;
+		ErtsDistExternal *ede_copy;
+
+		ede_copy = erts_make_dist_ext_copy(&ede, 0);
+		erts_queue_dist_message(rp, &locks, ede_copy, NIL);
+		if (locks)
+		    erts_smp_proc_unlock(rp, locks);
+		erts_smp_proc_dec_refc(rp);
+	    }
+	}
+	break;
+    }
+
     case DOP_SEND_TT:
 	if (tuple_arity != 4) {
 	    goto invalid_message;
@@ -1482,6 +1838,8 @@ int erts_net_message(Port *prt,
 	goto invalid_message;
     }
 
+    dist_stat_update(dep->stats.recv, (Uint) type, stat_len, start);
+
     erts_cleanup_offheap(&off_heap);
 #ifndef HYBRID /* FIND ME! */
     if (ctl != ctl_default) {
@@ -1524,6 +1882,7 @@ dsig_send(ErtsDSigData *dsdp, Eterm ctl, Eterm msg, int force_busy)
     DistEntry *dep = dsdp->dep;
     Uint32 flags = dep->flags;
     Process *c_p = dsdp->proc;
+    Uint start;
 
     if (!c_p || dsdp->no_suspend)
 	force_busy = 1;
@@ -1550,6 +1909,8 @@ dsig_send(ErtsDSigData *dsdp, Eterm ctl, Eterm msg, int force_busy)
 	erts_fprintf(stderr, "    MSG: %T\n", msg);
 #endif
 
+    start = dist_stat_usecs();
+
     data_size = pass_through_size;
     erts_reset_atom_cache_map(acmp);
     data_size += erts_encode_dist_ext_size(ctl, flags, acmp);
@@ -1578,6 +1939,9 @@ dsig_send(ErtsDSigData *dsdp, Eterm ctl, Eterm msg, int force_busy)
 
     data_size = obuf->ext_endp - obuf->extp;
 
+    dist_stat_update(dep->stats.send, unsigned_val(tuple_val(ctl)[1]),
+		     data_size, start);
+
     /*
      * Signal encoded; now verify that the connection still exists,
      * and if so enqueue the signal and schedule it for send.
@@ -1596,9 +1960,12 @@ dsig_send(ErtsDSigData *dsdp, Eterm ctl, Eterm msg, int force_busy)
 	ErtsProcList *plp = NULL;
 	erts_smp_mtx_lock(&dep->qlock);
 	dep->qsize += size_obuf(obuf);
+	if (dep->qsize > dep->stats.qsize_max)
+	    dep->stats.qsize_max = dep->qsize;
 	if (dep->qsize >= erts_dist_buf_busy_limit)
 	    dep->qflgs |= ERTS_DE_QFLG_BUSY;
 	if (!force_busy && (dep->qflgs & ERTS_DE_QFLG_BUSY)) {
+	    dep->stats.busy++;
 	    erts_smp_mtx_unlock(&dep->qlock);
 
 	    plp = erts_proclist_create(c_p);
@@ -1759,6 +2126,124 @@ dist_port_commandv(Port *prt, ErtsDistOutputBuf *obuf)
    ? ((Sint) 1) \
    : ((((Sint) (SZ)) >> 10) & ((Sint) ERTS_PORT_REDS_MASK__)))
 
+static ErtsDistOutputBuf *
+dist_deflate(ErtsDistCompress *dcp, ErtsDistOutputBuf *cob, Uint *cob_sizep,
+	     byte *data, Uint size, int flush)
+{
+    dcp->out.next_in = data;
+    dcp->out.avail_in = size;
+    while (1) {
+	int res;
+	if (dcp->out.avail_out == 0) {
+	    /* Rare; the buffer was sized with deflateBound() */
+	    Uint used = dcp->out.next_out - &cob->data[0];
+	    ErtsDistOutputBuf *ncob = alloc_dist_obuf(2 * *cob_sizep);
+	    sys_memcpy((void *) &ncob->data[0], (void *) &cob->data[0], used);
+	    free_dist_obuf(cob);
+	    cob = ncob;
+	    dcp->out.next_out = &cob->data[used];
+	    dcp->out.avail_out = 2 * *cob_sizep - used;
+	    *cob_sizep *= 2;
+	}
+	res = deflate(&dcp->out, flush);
+	if (res != Z_OK && res != Z_BUF_ERROR)
+	    erl_exit(ERTS_ABORT_EXIT,
+		     "Distribution compression failed: %d\n", res);
+	if (dcp->out.avail_in == 0 && dcp->out.avail_out != 0)
+	    return cob;
+    }
+}
+
+/*
+ * Finalize buffers in 'oq' and move them over to 'foq'. Batches of
+ * buffers that are large enough are replaced by one compressed buffer.
+ * Stops when 'reds' passes 'reds_limit'; what is left stays in 'oq'.
+ */
+static Sint
+dist_compress_queue(DistEntry *dep, Uint32 flags,
+		    ErtsDistOutputQueue *oq, ErtsDistOutputQueue *foq,
+		    Sint reds, int reds_limit)
+{
+    ErtsDistCompress *dcp = dep->compress;
+    Sint qsize_diff = 0;
+
+    while (oq->first && reds <= reds_limit) {
+	ErtsDistOutputBuf *ob, *batch, *last, *cob;
+	Uint size = 0, cob_size;
+	int n = 0;
+
+	batch = ob = oq->first;
+	do {
+	    ob->extp = erts_encode_ext_dist_header_finalize(ob->extp,
+							    dep->cache);
+	    if (!(flags & DFLAG_DIST_HDR_ATOM_CACHE))
+		*--ob->extp = PASS_THROUGH; /* Old node; 'pass through'
+					       needed */
+	    ASSERT(&ob->data[0] <= ob->extp && ob->extp < ob->ext_endp);
+	    /* Charge for the deflate up front */
+	    reds += (ERTS_PORT_REDS_DIST_CMD_FINALIZE
+		     + ERTS_PORT_REDS_DIST_CMD_DATA(ob->ext_endp - ob->extp));
+	    size += ob->ext_endp - ob->extp;
+	    n++;
+	    last = ob;
+	    ob = ob->next;
+	} while (ob
+		 && size < ERTS_DIST_COMPRESS_BATCH_SIZE
+		 && reds <= reds_limit);
+
+	oq->first = ob;
+	if (!ob)
+	    oq->last = NULL;
+	last->next = NULL;
+
+	if (size < (Uint) erts_dist_compress_threshold) {
+	    /* Not worth compressing; pass them on as they are */
+	    cob = batch;
+	}
+	else {
+	    cob_size = 1 + deflateBound(&dcp->out, size + 4*n) + 16;
+	    cob = alloc_dist_obuf(cob_size);
+	    cob->data[0] = DIST_COMPRESSED;
+	    dcp->out.next_out = &cob->data[1];
+	    dcp->out.avail_out = cob_size - 1;
+	    ob = batch;
+	    while (ob) {
+		ErtsDistOutputBuf *fob;
+		byte hdr[4];
+		Uint sz = ob->ext_endp - ob->extp;
+		put_int32(sz, hdr);
+		cob = dist_deflate(dcp, cob, &cob_size, hdr, 4, Z_NO_FLUSH);
+		cob = dist_deflate(dcp, cob, &cob_size, ob->extp, sz, Z_NO_FLUSH);
+		fob = ob;
+		ob = ob->next;
+		qsize_diff -= size_obuf(fob);
+		free_dist_obuf(fob);
+	    }
+	    cob = dist_deflate(dcp, cob, &cob_size, NULL, 0, Z_SYNC_FLUSH);
+	    cob->extp = &cob->data[0];
+	    cob->ext_endp = dcp->out.next_out;
+	    cob->next = NULL;
+	    last = cob;
+	    qsize_diff += size_obuf(cob);
+	}
+
+	if (foq->last)
+	    foq->last->next = cob;
+	else
+	    foq->first = cob;
+	foq->last = last;
+    }
+
+    if (qsize_diff) {
+	erts_smp_mtx_lock(&dep->qlock);
+	dep->qsize += qsize_diff;
+	ASSERT(dep->qsize >= 0);
+	erts_smp_mtx_unlock(&dep->qlock);
+    }
+
+    return reds;
+}
+
 int
 erts_dist_command(Port *prt, int reds_limit)
 {
@@ -1817,6 +2302,17 @@ erts_dist_command(Port *prt, int reds_limit)
 
     prt_busy = (int) (prt->status & ERTS_PORT_SFLG_PORT_BUSY);
 
+    /*
+     * On compressed links everything is finalized here, busy port
+     * or not; a busy port is when the queue is big and compression
+     * pays the most.
+     */
+    if (oq.first && dep->compress) {
+	reds = dist_compress_queue(dep, flags, &oq, &foq, reds, reds_limit);
+	if (!oq.first)
+	    oq.last = NULL;
+    }
+
     if (!prt_busy && foq.first) {
 	int preempt = 0;
 	do {
@@ -1845,6 +2341,12 @@ erts_dist_command(Port *prt, int reds_limit)
 	    goto preempted;
     }
 
+    if (oq.first && dep->compress) {
+	/* dist_compress_queue() ran out of reductions; don't let
+	   the rest through uncompressed below */
+	goto preempted;
+    }
+
     if (prt_busy) {
 	if (oq.first) {
 	    ErtsDistOutputBuf *ob;
@@ -2303,6 +2805,8 @@ BIF_RETTYPE setnode_2(BIF_ALIST_2)
 	dmonitor_node_trap->address == NULL ||
 	dgroup_leader_trap->address == NULL ||
 	dmonitor_p_trap->address == NULL ||
+	dsend_multi2_trap->address == NULL ||
+	dsend_multi3_trap->address == NULL ||
 	dexit_trap->address == NULL) {
 	goto error;
     }
@@ -2387,9 +2891,9 @@ BIF_RETTYPE setnode_3(BIF_ALIST_3)
     tp = tuple_val(BIF_ARG_3);
     if (*tp++ != make_arityval(4))
 	goto badarg;
-    if (!is_small(*tp))
+    /* Flags in the top bits are not small on 32-bit machines */
+    if (!term_to_Uint(*tp++, &flags) || flags > (Uint) 0xffffffff)
 	goto badarg;
-    flags = unsigned_val(*tp++);
     if (!is_small(*tp) || (version = unsigned_val(*tp)) == 0)
 	goto badarg;
     ic = *(++tp);
@@ -2478,11 +2982,15 @@ BIF_RETTYPE setnode_3(BIF_ALIST_3)
     erts_smp_mtx_unlock(&dep->qlock);
 #endif
 
+    erts_dist_stats_init(&dep->stats);
     erts_set_dist_entry_connected(dep, BIF_ARG_2, flags);
 
     if (flags & DFLAG_DIST_HDR_ATOM_CACHE)
 	create_cache(dep);
 
+    if (flags & DFLAG_DIST_COMPRESS)
+	create_compress(dep);
+
     erts_smp_de_rwunlock(dep);
     dep = NULL; /* inc of refc transferred to port (dist_entry field) */
 
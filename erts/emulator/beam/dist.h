@@ -40,6 +40,14 @@
 #define DFLAG_SMALL_ATOM_TAGS     0x4000
 #define DFLAGS_INTERNAL_TAGS      0x8000
 
+/*
+ * Flags of our own. They are taken from the top of the flag word,
+ * which the standard handshake keeps reserved and never sets, so that
+ * they are not confused with flags added to later releases.
+ */
+#define DFLAG_DIST_COMPRESS       0x40000000
+#define DFLAG_SEND_MULTI          0x80000000
+
 /* All flags that should be enabled when term_to_binary/1 is used. */
 #define TERM_TO_BINARY_DFLAGS (DFLAG_EXTENDED_REFERENCES	\
 			       | DFLAG_NEW_FUN_TAGS		\
@@ -66,6 +74,9 @@
 #define DOP_DEMONITOR_P		20
 #define DOP_MONITOR_P_EXIT	21
 
+/* Only sent with DFLAG_SEND_MULTI, numbered apart from the standard ones */
+#define DOP_SEND_MULTI		100
+
 /* distribution trap functions */
 extern Export* dsend2_trap;
 extern Export* dsend3_trap;
@@ -75,6 +86,8 @@ extern Export* dmonitor_node_trap;
 extern Export* dgroup_leader_trap;
 extern Export* dexit_trap;
 extern Export* dmonitor_p_trap;
+extern Export* dsend_multi2_trap;
+extern Export* dsend_multi3_trap;
 
 typedef enum {
     ERTS_DSP_NO_LOCK,
@@ -101,6 +114,8 @@ typedef struct {
 
 #define ERTS_DE_BUSY_LIMIT (1024*1024)
 extern int erts_dist_buf_busy_limit;
+#define ERTS_DIST_COMPRESS_THRESHOLD 1024
+extern int erts_dist_compress_threshold;
 extern int erts_is_alive;
 
 /*
@@ -275,6 +290,7 @@ extern int erts_dsig_send_msg(ErtsDSigData *, Eterm, Eterm);
 extern int erts_dsig_send_exit_tt(ErtsDSigData *, Eterm, Eterm, Eterm, Eterm);
 extern int erts_dsig_send_unlink(ErtsDSigData *, Eterm, Eterm);
 extern int erts_dsig_send_reg_msg(ErtsDSigData *, Eterm, Eterm);
+extern int erts_dsig_send_multi(ErtsDSigData *, Eterm, Eterm);
 extern int erts_dsig_send_group_leader(ErtsDSigData *, Eterm, Eterm);
 extern int erts_dsig_send_exit(ErtsDSigData *, Eterm, Eterm, Eterm);
 extern int erts_dsig_send_exit2(ErtsDSigData *, Eterm, Eterm, Eterm);
@@ -288,5 +304,8 @@ extern void erts_kill_dist_connection(DistEntry *dep, Uint32);
 
 extern Uint erts_dist_cache_size(void);
 
+extern void erts_dist_stats_init(ErtsDistStats *);
+extern Eterm erts_dist_stats_info(Process *, DistEntry *);
+
 
 #endif
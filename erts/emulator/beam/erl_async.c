@@ -36,6 +36,7 @@
 #endif
 
 typedef struct _erl_async {
+    struct _erl_async* next;
     DE_Handle*         hndl;   /* The DE_Handle is needed when port is gone */
     Eterm              port;
     long               async_id;
@@ -43,6 +44,7 @@ typedef struct _erl_async {
     ErlDrvPDL          pdl;
     void (*async_invoke)(void*);
     void (*async_free)(void*);
+    Uint64             queued; /* Time of enqueue (us) */
 #if ERTS_USE_ASYNC_READY_Q
     Uint               sched_id;
     union {
@@ -93,10 +95,57 @@ typedef union {
 
 #endif /* ERTS_USE_ASYNC_READY_Q */
 
+/*
+ * Each async thread owns a queue, and jobs are put in queues by key as
+ * before. A thread that runs out of work in its own queue takes jobs
+ * from other queues. Jobs of a port that are put in the same queue are
+ * still executed in order and one at a time: a job is not taken as long
+ * as another job of the same port from that queue is executing. A slow
+ * job thus only holds up later jobs of its own port, not those of all
+ * ports sharing the queue.
+ */
+
+/* How far into a queue we look for a job that may be started */
+#define ERTS_ASYNC_MAX_SCAN 64
+
+typedef struct _erl_async_running {
+    struct _erl_async_running *next;
+    Eterm port;
+} ErtsAsyncRunning;
+
 typedef struct {
-    ErtsThrQ_t thr_q;
+    Uint length;
+    Uint max_length;
+    Uint jobs;		/* Jobs started */
+    Uint stolen;	/* Jobs started by another queue's thread */
+    Uint wait_time;	/* Microseconds from enqueue to start, in total */
+    Uint max_wait_time;
+    Uint run_time;	/* Microseconds executing, in total */
+    Uint max_run_time;
+} ErtsAsyncStat;
+
+typedef struct _erl_async_q ErtsAsyncQ;
+
+struct _erl_async_q {
+    erts_mtx_t mtx;
+    ErtsAsync *first;
+    ErtsAsync *last;
+    ErtsAsyncRunning *running;	/* Ports with a job from here executing */
+    int busy;			/* Owner is executing a job */
+    ErtsAsyncStat stat;
+
+    /* Protected by the idle mutex; idle may be read without it */
+    ErtsAsyncQ *idle_next;
+    ErtsAsyncQ *idle_prev;
+    erts_atomic32_t idle;
+    int steal_hint;
+
+    /* Owner only */
+    ErtsAsyncRunning run;
+    erts_tse_t *tse;
     erts_tid_t thr_id;
-} ErtsAsyncQ;
+    int ix;
+};
 
 typedef union {
     ErtsAsyncQ aq;
@@ -110,11 +159,21 @@ typedef struct {
     erts_atomic_t id;
 } ErtsAsyncInit;
 
+typedef struct {
+    erts_mtx_t mtx;
+    ErtsAsyncQ *first;		/* Threads waiting for work */
+    erts_atomic32_t no;		/* Length of the list above */
+} ErtsAsyncIdle;
+
 typedef struct {
     union {
 	ErtsAsyncInit data;
 	char align__[ERTS_ALC_CACHE_LINE_ALIGN_SIZE(sizeof(ErtsAsyncInit))];
     } init;
+    union {
+	ErtsAsyncIdle data;
+	char align__[ERTS_ALC_CACHE_LINE_ALIGN_SIZE(sizeof(ErtsAsyncIdle))];
+    } idle;
     ErtsAlgndAsyncQ *queue;
 #if ERTS_USE_ASYNC_READY_Q
     ErtsAlgndAsyncReadyQ *ready_queue;
@@ -154,6 +213,16 @@ async_ready_q(Uint sched_id)
 
 #endif
 
+static ERTS_INLINE Uint64
+async_time(void)
+{
+#ifdef HAVE_GETHRTIME
+    return (Uint64) sys_gethrtime() / 1000;
+#else
+    return 0;
+#endif
+}
+
 void
 erts_init_async(void)
 {
@@ -184,6 +253,10 @@ erts_init_async(void)
 	erts_cnd_init(&async->init.data.cnd);
 	erts_atomic_init_nob(&async->init.data.id, 0);
 
+	erts_mtx_init(&async->idle.data.mtx, "async_idle_mtx");
+	async->idle.data.first = NULL;
+	erts_atomic32_init_nob(&async->idle.data.no, 0);
+
 	async->queue = (ErtsAlgndAsyncQ *) ptr;
 	ptr += sizeof(ErtsAlgndAsyncQ)*erts_async_max_threads;
 
@@ -208,6 +281,20 @@ erts_init_async(void)
 
 #endif
 
+	for (i = 0; i < erts_async_max_threads; i++) {
+	    ErtsAsyncQ *aq = async_q(i);
+	    erts_mtx_init(&aq->mtx, "async_q_mtx");
+	    aq->first = aq->last = NULL;
+	    aq->running = NULL;
+	    aq->busy = 0;
+	    sys_memzero((void *) &aq->stat, sizeof(ErtsAsyncStat));
+	    aq->idle_next = aq->idle_prev = NULL;
+	    erts_atomic32_init_nob(&aq->idle, 0);
+	    aq->steal_hint = -1;
+	    aq->tse = NULL;
+	    aq->ix = i;
+	}
+
 	/* Create async threads... */
 
 	thr_opts.detached = 0;
@@ -242,8 +329,60 @@ erts_get_async_ready_queue(Uint sched_id)
 
 #endif
 
+/* Call with the idle mutex locked */
+static ERTS_INLINE void
+async_unset_idle(ErtsAsyncQ *aq)
+{
+    ASSERT(erts_atomic32_read_nob(&aq->idle));
+    if (aq->idle_prev)
+	aq->idle_prev->idle_next = aq->idle_next;
+    else
+	async->idle.data.first = aq->idle_next;
+    if (aq->idle_next)
+	aq->idle_next->idle_prev = aq->idle_prev;
+    aq->idle_next = aq->idle_prev = NULL;
+    erts_atomic32_set_nob(&aq->idle, 0);
+    erts_atomic32_dec_nob(&async->idle.data.no);
+}
+
+/*
+ * There is work in q. Wake its owner if it waits for work; if not and
+ * help is wanted, wake some other waiting thread.
+ *
+ * Called after the work has been put in q under q->mtx. An owner that
+ * sets its idle flag looks in q under q->mtx afterwards, so either it
+ * finds the work or we see the flag here, and the idle mutex is only
+ * needed when there is someone to wake. The count of waiting threads
+ * is only a hint; help that is missed is not needed for progress
+ * since the owner runs the job anyway.
+ */
+static void async_wake(ErtsAsyncQ *q, int help)
+{
+    ErtsAsyncQ *wake = NULL;
+
+    if (!erts_atomic32_read_nob(&q->idle)
+	&& (!help || !erts_atomic32_read_nob(&async->idle.data.no)))
+	return;
+
+    erts_mtx_lock(&async->idle.data.mtx);
+    if (erts_atomic32_read_nob(&q->idle))
+	wake = q;
+    else if (help)
+	wake = async->idle.data.first;
+    if (wake) {
+	async_unset_idle(wake);
+	wake->steal_hint = q->ix;
+    }
+    erts_mtx_unlock(&async->idle.data.mtx);
+
+    if (wake)
+	erts_tse_set(wake->tse);
+}
+
 static ERTS_INLINE void async_add(ErtsAsync *a, ErtsAsyncQ* q)
 {
+    int busy;
+
     if (is_internal_port(a->port)) {
 #if ERTS_USE_ASYNC_READY_Q
 	ErtsAsyncReadyQ *arq = async_ready_q(a->sched_id);
@@ -258,86 +397,186 @@ static ERTS_INLINE void async_add(ErtsAsync *a, ErtsAsyncQ* q)
     erts_fprintf(stderr, "-> %ld\n", a->async_id);
 #endif
 
-    erts_thr_q_enqueue(&q->thr_q, a);
+    a->next = NULL;
+    a->queued = async_time();
+
+    erts_mtx_lock(&q->mtx);
+    if (q->last)
+	q->last->next = a;
+    else
+	q->first = a;
+    q->last = a;
+    if (++q->stat.length > q->stat.max_length)
+	q->stat.max_length = q->stat.length;
+    busy = q->busy;
+    erts_mtx_unlock(&q->mtx);
+
+    async_wake(q, busy && is_not_nil(a->port));
 }
 
-static ERTS_INLINE ErtsAsync *async_get(ErtsThrQ_t *q,
-					erts_tse_t *tse,
-					ErtsThrQPrepEnQ_t **prep_enq)
+/*
+ * Take the first job in q that may be started now, i.e., whose port
+ * has no other job from q executing. Jobs that terminate a thread are
+ * only taken by the owner, and not until all jobs before them are
+ * gone.
+ */
+static ErtsAsync *async_take(ErtsAsyncQ *q, ErtsAsyncQ *aq)
 {
-#if ERTS_USE_ASYNC_READY_Q
-    int saved_fin_deq = 0;
-    ErtsThrQFinDeQ_t fin_deq;
-#endif
-
-    while (1) {
-	ErtsAsync *a = (ErtsAsync *) erts_thr_q_dequeue(q);
-	if (a) {
+    ErtsAsync *a, *prev = NULL;
+    int n = 0;
 
-#if ERTS_USE_ASYNC_READY_Q
-	    *prep_enq = a->q.prep_enq;
-	    erts_thr_q_get_finalize_dequeue_data(q, &a->q.fin_deq);
-	    if (saved_fin_deq)
-		erts_thr_q_append_finalize_dequeue_data(&a->q.fin_deq, &fin_deq);
-#endif
+    erts_mtx_lock(&q->mtx);
+    for (a = q->first; a; prev = a, a = a->next) {
+	ErtsAsyncRunning *r;
 
-	    return a;
+	if (is_nil(a->port)) {
+	    if (q == aq && !prev && !q->running)
+		break;
+	    a = NULL;
+	    break;
+	}
+	for (r = q->running; r; r = r->next) {
+	    if (r->port == a->port)
+		break;
 	}
+	if (!r)
+	    break;
+	if (++n >= ERTS_ASYNC_MAX_SCAN) {
+	    a = NULL;
+	    break;
+	}
+    }
+    if (a) {
+	Uint64 wait = async_time() - a->queued;
+
+	if (prev)
+	    prev->next = a->next;
+	else
+	    q->first = a->next;
+	if (q->last == a)
+	    q->last = prev;
+
+	aq->run.port = a->port;
+	aq->run.next = q->running;
+	q->running = &aq->run;
+
+	q->stat.length--;
+	q->stat.jobs++;
+	if (q != aq)
+	    q->stat.stolen++;
+	q->stat.wait_time += (Uint) wait;
+	if (wait > q->stat.max_wait_time)
+	    q->stat.max_wait_time = (Uint) wait;
+    }
+    erts_mtx_unlock(&q->mtx);
+    return a;
+}
 
-	if (ERTS_THR_Q_DIRTY != erts_thr_q_clean(q)) {
-	    ErtsThrQFinDeQ_t tmp_fin_deq;
+static void async_done(ErtsAsyncQ *q, ErtsAsyncQ *aq, Uint64 start)
+{
+    ErtsAsyncRunning **rp;
+    Uint64 run = start ? async_time() - start : 0;
+    int held, busy;
+
+    erts_mtx_lock(&q->mtx);
+    for (rp = &q->running; *rp != &aq->run; rp = &(*rp)->next)
+	ASSERT(*rp);
+    *rp = aq->run.next;
+    q->stat.run_time += (Uint) run;
+    if (run > q->stat.max_run_time)
+	q->stat.max_run_time = (Uint) run;
+    held = q != aq && q->first;
+    busy = q->busy;
+    erts_mtx_unlock(&q->mtx);
 
-	    erts_tse_reset(tse);
+    /*
+     * A job we took from another queue may have held back later jobs
+     * of the same port there, or the job ending its owner. The owner
+     * may have gone to sleep over them, so tell it they can be taken.
+     */
+    if (held)
+	async_wake(q, busy);
+}
 
-#if ERTS_USE_ASYNC_READY_Q
-	chk_fin_deq:
-	    if (erts_thr_q_get_finalize_dequeue_data(q, &tmp_fin_deq)) {
-		if (!saved_fin_deq) {
-		    erts_thr_q_finalize_dequeue_state_init(&fin_deq);
-		    saved_fin_deq = 1;
-		}
-		erts_thr_q_append_finalize_dequeue_data(&fin_deq,
-							&tmp_fin_deq);
-	    }
-#endif
+static ERTS_INLINE void async_set_busy(ErtsAsyncQ *aq, int busy)
+{
+    erts_mtx_lock(&aq->mtx);
+    aq->busy = busy;
+    erts_mtx_unlock(&aq->mtx);
+}
 
-	    switch (erts_thr_q_inspect(q, 1)) {
-	    case ERTS_THR_Q_DIRTY:
-		break;
-	    case ERTS_THR_Q_NEED_THR_PRGR:
-#ifdef ERTS_SMP
-	    {
-		ErtsThrPrgrVal prgr = erts_thr_q_need_thr_progress(q);
-		erts_thr_progress_wakeup(NULL, prgr);
-		/*
-		 * We do no dequeue finalizing in hope that a new async
-		 * job will arrive before we are woken due to thread
-		 * progress...
-		 */
-		erts_tse_wait(tse);
-		break;
+/* Look for a job in other queues, starting where help was asked for */
+static ErtsAsync *async_steal(ErtsAsyncQ *aq, ErtsAsyncQ **qp)
+{
+    int i, ix = aq->steal_hint;
+
+    if (ix < 0)
+	ix = aq->ix;
+    for (i = 0; i < erts_async_max_threads; i++) {
+	ErtsAsyncQ *q = async_q((ix + i) % erts_async_max_threads);
+	if (q != aq && q->first) {
+	    ErtsAsync *a = async_take(q, aq);
+	    if (a) {
+		*qp = q;
+		return a;
 	    }
-#endif
-	    case ERTS_THR_Q_CLEAN:
+	}
+    }
+    return NULL;
+}
 
-#if ERTS_USE_ASYNC_READY_Q
-		if (saved_fin_deq) {
-		    if (erts_thr_q_finalize_dequeue(&fin_deq))
-			goto chk_fin_deq;
-		    else
-			saved_fin_deq = 0;
-		}
-#endif
+static ErtsAsync *async_get(ErtsAsyncQ *aq,
+			    erts_tse_t *tse,
+			    ErtsAsyncQ **qp,
+			    ErtsThrQPrepEnQ_t **prep_enq)
+{
+    while (1) {
+	ErtsAsync *a;
+	int idle = 0;
 
-		erts_tse_wait(tse);
-		break;
+	*qp = aq;
+	a = async_take(aq, aq);
+	if (!a) {
+	    /*
+	     * Announce that we are waiting before the last look, so
+	     * that a job added after it will wake us.
+	     */
+	    erts_tse_reset(tse);
+	    erts_mtx_lock(&async->idle.data.mtx);
+	    if (!erts_atomic32_read_nob(&aq->idle)) {
+		erts_atomic32_set_nob(&aq->idle, 1);
+		erts_atomic32_inc_nob(&async->idle.data.no);
+		aq->idle_prev = NULL;
+		aq->idle_next = async->idle.data.first;
+		if (aq->idle_next)
+		    aq->idle_next->idle_prev = aq;
+		async->idle.data.first = aq;
+	    }
+	    erts_mtx_unlock(&async->idle.data.mtx);
+	    idle = 1;
 
-	    default:
-		ASSERT(0);
-		break;
+	    a = async_take(aq, aq);
+	    if (!a)
+		a = async_steal(aq, qp);
+	}
+
+	if (a) {
+	    if (idle) {
+		erts_mtx_lock(&async->idle.data.mtx);
+		if (erts_atomic32_read_nob(&aq->idle))
+		    async_unset_idle(aq);
+		erts_mtx_unlock(&async->idle.data.mtx);
 	    }
+	    aq->steal_hint = -1;
 
+#if ERTS_USE_ASYNC_READY_Q
+	    *prep_enq = a->q.prep_enq;
+	    erts_thr_q_finalize_dequeue_state_init(&a->q.fin_deq);
+#endif
+	    return a;
 	}
+
+	erts_tse_wait(tse);
     }
 }
 
@@ -396,6 +635,7 @@ static ERTS_INLINE void async_reply(ErtsAsync *a, ErtsThrQPrepEnQ_t *prep_enq)
 #endif /* ERTS_USE_ASYNC_READY_Q */
 }
 
+#ifdef ERTS_SMP
 
 static void
 async_wakeup(void *vtse)
@@ -403,9 +643,10 @@ async_wakeup(void *vtse)
     erts_tse_set((erts_tse_t *) vtse);
 }
 
+#endif
+
 static erts_tse_t *async_thread_init(ErtsAsyncQ *aq)
 {
-    ErtsThrQInit_t qinit = ERTS_THR_Q_INIT_DEFAULT;
     erts_tse_t *tse = erts_tse_fetch();
 #ifdef ERTS_SMP
     ErtsThrPrgrCallbacks callbacks;
@@ -418,15 +659,7 @@ static erts_tse_t *async_thread_init(ErtsAsyncQ *aq)
     erts_thr_progress_register_unmanaged_thread(&callbacks);
 #endif
 
-    qinit.live.queue = ERTS_THR_Q_LIVE_LONG;
-    qinit.live.objects = ERTS_THR_Q_LIVE_SHORT;
-    qinit.arg = (void *) tse;
-    qinit.notify = async_wakeup;
-#if ERTS_USE_ASYNC_READY_Q
-    qinit.auto_finalize_dequeue = 0;
-#endif
-
-    erts_thr_q_initialize(&aq->thr_q, &qinit);
+    aq->tse = tse;
 
     /* Inform main thread that we are done initializing... */
     erts_mtx_lock(&async->init.data.mtx);
@@ -443,17 +676,28 @@ static void *async_main(void* arg)
     erts_tse_t *tse = async_thread_init(aq);
 
     while (1) {
-	ErtsThrQPrepEnQ_t *prep_enq;
-	ErtsAsync *a = async_get(&aq->thr_q, tse, &prep_enq);
-	if (is_nil(a->port))
+	ErtsThrQPrepEnQ_t *prep_enq = NULL;
+	ErtsAsyncQ *q;
+	ErtsAsync *a = async_get(aq, tse, &q, &prep_enq);
+	Uint64 start;
+
+	if (is_nil(a->port)) {
+	    async_done(q, aq, 0);
 	    break; /* Time to die */
+	}
 
 #if ERTS_ASYNC_PRINT_JOB
 	erts_fprintf(stderr, "<- %ld\n", a->async_id);
 #endif
 
+	async_set_busy(aq, 1);
+	start = async_time();
+
 	a->async_invoke(a->async_data);
 
+	async_done(q, aq, start);
+	async_set_busy(aq, 0);
+
 	async_reply(a, prep_enq);
     }
 
@@ -467,21 +711,102 @@ erts_exit_flush_async(void)
 {
 #ifdef USE_THREADS
     int i;
-    ErtsAsync a;
-    a.port = NIL;
     /*
      * Terminate threads in order to flush queues. We do not
      * bother to clean everything up since we are about to
      * terminate the runtime system and a cleanup would only
      * delay the termination.
      */
-    for (i = 0; i < erts_async_max_threads; i++)
-	async_add(&a, async_q(i));
+    for (i = 0; i < erts_async_max_threads; i++) {
+	ErtsAsync *a = erts_alloc(ERTS_ALC_T_ASYNC, sizeof(ErtsAsync));
+	a->port = NIL;
+	async_add(a, async_q(i));
+    }
     for (i = 0; i < erts_async_max_threads; i++)
 	erts_thr_join(async->queue[i].aq.thr_id, NULL);
 #endif
 }
 
+/*
+ * Statistics for erlang:system_info(async_queues); a list with one
+ * element per queue.
+ */
+Eterm
+erts_async_queues_info(Process *c_p)
+{
+#ifdef USE_THREADS
+    Eterm atoms[8];
+    Uint values[8];
+    ErtsAsyncStat *stat;
+    Eterm res, *hp;
+#ifdef DEBUG
+    Eterm *hp_end;
+#endif
+    Uint sz;
+    int i;
+
+    if (erts_async_max_threads <= 0)
+	return NIL;
+
+    stat = erts_alloc(ERTS_ALC_T_TMP,
+		      sizeof(ErtsAsyncStat)*erts_async_max_threads);
+    for (i = 0; i < erts_async_max_threads; i++) {
+	ErtsAsyncQ *q = async_q(i);
+	erts_mtx_lock(&q->mtx);
+	stat[i] = q->stat;
+	erts_mtx_unlock(&q->mtx);
+    }
+
+    atoms[0] = am_length;
+    atoms[1] = am_max_length;
+    atoms[2] = am_jobs;
+    atoms[3] = am_stolen;
+    atoms[4] = am_wait_time;
+    atoms[5] = am_max_wait_time;
+    atoms[6] = am_run_time;
+    atoms[7] = am_max_run_time;
+
+#define ERTS_ASYNC_STAT_VALUES(S)		\
+    do {					\
+	values[0] = (S)->length;		\
+	values[1] = (S)->max_length;		\
+	values[2] = (S)->jobs;			\
+	values[3] = (S)->stolen;		\
+	values[4] = (S)->wait_time;		\
+	values[5] = (S)->max_wait_time;		\
+	values[6] = (S)->run_time;		\
+	values[7] = (S)->max_run_time;		\
+    } while (0)
+
+    sz = 0;
+    for (i = 0; i < erts_async_max_threads; i++) {
+	ERTS_ASYNC_STAT_VALUES(&stat[i]);
+	erts_bld_atom_uint_2tup_list(NULL, &sz, 8, atoms, values);
+	sz += 2;
+    }
+
+    hp = HAlloc(c_p, sz);
+#ifdef DEBUG
+    hp_end = hp + sz;
+#endif
+    res = NIL;
+    for (i = erts_async_max_threads - 1; i >= 0; i--) {
+	Eterm info;
+	ERTS_ASYNC_STAT_VALUES(&stat[i]);
+	info = erts_bld_atom_uint_2tup_list(&hp, NULL, 8, atoms, values);
+	res = erts_bld_cons(&hp, NULL, info, res);
+    }
+    ASSERT(hp == hp_end);
+
+#undef ERTS_ASYNC_STAT_VALUES
+
+    erts_free(ERTS_ALC_T_TMP, (void *) stat);
+    return res;
+#else
+    return NIL;
+#endif
+}
+
 #if defined(USE_THREADS) && ERTS_USE_ASYNC_READY_Q
 
 int erts_check_async_ready(void *varq)
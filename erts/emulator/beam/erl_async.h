@@ -61,6 +61,7 @@ void *erts_get_async_ready_queue(Uint sched_id);
 
 void erts_init_async(void);
 void erts_exit_flush_async(void);
+Eterm erts_async_queues_info(struct process *c_p);
 
 
 #endif /* ERL_ASYNC_H__ */
@@ -1808,6 +1808,17 @@ info_1_tuple(Process* BIF_P,	/* Pointer to current process. */
 	}
     } else if (ERTS_IS_ATOM_STR("internal_cpu_topology", sel) && arity == 2) {
 	return erts_get_cpu_topology_term(BIF_P, *tp);
+    } else if (ERTS_IS_ATOM_STR("dist_stats", sel) && arity == 2) {
+	Eterm res = am_undefined;
+	DistEntry *dep;
+	if (is_not_atom(*tp))
+	    goto badarg;
+	dep = erts_sysname_to_connected_dist_entry(*tp);
+	if (dep) {
+	    res = erts_dist_stats_info(BIF_P, dep);
+	    erts_deref_dist_entry(dep);
+	}
+	return res;
     } else if (ERTS_IS_ATOM_STR("cpu_topology", sel) && arity == 2) {
 	Eterm res = erts_get_cpu_topology_term(BIF_P, *tp);
 	if (res == THE_NON_VALUE)
@@ -2272,6 +2283,9 @@ BIF_RETTYPE system_info_1(BIF_ALIST_1)
 #endif
 	BIF_RET(make_small(n));
     }
+    else if (BIF_ARG_1 == am_async_queues) {
+	BIF_RET(erts_async_queues_info(BIF_P));
+    }
     else if (BIF_ARG_1 == am_alloc_util_allocators) {
 	BIF_RET(erts_alloc_util_allocators((void *) BIF_P));
     }
@@ -127,6 +127,24 @@ do_port_command(Process *BIF_P, Eterm arg1, Eterm arg2, Eterm arg3,
     BIF_RETTYPE res;
     Port *p;
 
+#ifdef ERTS_SMP
+    if (erts_port_parallelism_in_use
+	&& !(flags & ERTS_PORT_COMMAND_FLAG_FORCE)
+	&& !IS_TRACED_FL(BIF_P, F_TRACE_SCHED_PROCS)
+	&& !erts_system_profile_flags.runnable_procs) {
+	int cres;
+	erts_smp_proc_unlock(BIF_P, ERTS_PROC_LOCK_MAIN);
+	cres = erts_port_cmdq_command(BIF_P->id, arg1, arg2);
+	erts_smp_proc_lock(BIF_P, ERTS_PROC_LOCK_MAIN);
+	if (cres != ERTS_PORT_CMDQ_NOT_USED) {
+	    ERTS_SMP_BIF_CHK_PENDING_EXIT(BIF_P, ERTS_PROC_LOCK_MAIN);
+	    if (cres == ERTS_PORT_CMDQ_BADARG)
+		BIF_ERROR(BIF_P, BADARG);
+	    BIF_RET(am_true);
+	}
+    }
+#endif
+
     /* Trace sched out before lock check wait */    
     if (IS_TRACED_FL(BIF_P, F_TRACE_SCHED_PROCS)) {
 	trace_virtual_sched(BIF_P, am_out);
@@ -320,6 +338,7 @@ port_call(Process* c_p, Eterm arg1, Eterm arg2, Eterm arg3)
     if (!term_to_Uint(arg2, &op)) {
 	goto error;
     }
+    erts_port_flush_cmdq(p);
     p->caller = c_p->id;
     
     /* Lock taken, virtual schedule of port */
@@ -500,6 +519,7 @@ BIF_RETTYPE port_close_1(BIF_ALIST_1)
 	erts_smp_proc_lock(BIF_P, ERTS_PROC_LOCK_MAIN);
 	BIF_ERROR(BIF_P, BADARG);
     }
+    erts_port_flush_cmdq(p);
     erts_do_exit_port(p, p->connected, am_normal);
     /* if !ERTS_SMP: since we terminate port with reason normal 
        we SHOULD never get an exit signal ourselves
@@ -523,6 +543,7 @@ BIF_RETTYPE port_connect_2(BIF_ALIST_2)
     if (!prt) {
 	goto error;
     }
+    erts_port_flush_cmdq(prt);
 
     rp = erts_pid2proc(BIF_P, ERTS_PROC_LOCK_MAIN,
 		       pid, ERTS_PROC_LOCK_LINK);
@@ -616,6 +637,7 @@ open_port(Process* p, Eterm name, Eterm settings, int *err_nump)
     SysDriverOpts opts;
     int binary_io;
     int soft_eof;
+    int parallelism;
     Sint linebuf;
     Eterm edir = NIL;
     byte dir[MAXPATHLEN];
@@ -630,10 +652,12 @@ open_port(Process* p, Eterm name, Eterm settings, int *err_nump)
     opts.envir = NULL;
     opts.exit_status = 0;
     opts.overlapped_io = 0; 
+    opts.out_buffer = 0;
     opts.spawn_type = ERTS_SPAWN_ANY; 
     opts.argv = NULL;
     binary_io = 0;
     soft_eof = 0;
+    parallelism = erts_port_parallelism;
     linebuf = 0;
 
     *err_nump = 0;
@@ -711,6 +735,21 @@ open_port(Process* p, Eterm name, Eterm settings, int *err_nump)
 		    }
 		} else if (option == am_cd) {
 		    edir = *tp;
+		} else if (option == am_output_buffer) {
+		    if (is_not_small(*tp) || signed_val(*tp) < 0) {
+			goto badarg;
+		    }
+		    opts.out_buffer = signed_val(*tp);
+		    if (opts.out_buffer > (1 << 24)) {
+			opts.out_buffer = 1 << 24;
+		    }
+		} else if (option == am_parallelism) {
+		    if (*tp == am_true)
+			parallelism = 1;
+		    else if (*tp == am_false)
+			parallelism = 0;
+		    else
+			goto badarg;
 		} else {
 		    goto badarg;
 		}
@@ -927,6 +966,15 @@ open_port(Process* p, Eterm name, Eterm settings, int *err_nump)
 	erts_port_status_bor_set(&erts_port[port_num],
 				 ERTS_PORT_SFLG_SOFT_EOF);
     }
+#ifdef ERTS_SMP
+    if (parallelism) {
+	erts_port_parallelism_in_use = 1;
+	erts_port_status_bor_set(&erts_port[port_num],
+				 ERTS_PORT_SFLG_PARALLELISM);
+    }
+#else
+    (void) parallelism;	/* No other scheduler to wait for */
+#endif
     if (linebuf && erts_port[port_num].linebuf == NULL){
 	erts_port[port_num].linebuf = allocate_linebuf(linebuf); 
 	erts_port_status_bor_set(&erts_port[port_num],
@@ -1359,9 +1407,18 @@ BIF_RETTYPE decode_packet_3(BIF_ALIST_3)
     case am_http_bin: type = TCP_PB_HTTP_BIN; break;
     case am_httph_bin: type = TCP_PB_HTTPH_BIN; break;
     case am_ssl_tls: type = TCP_PB_SSL_TLS; break;
+    case am_varint: type = TCP_PB_VARINT; break;
     default:
+        if (is_tuple_arity(BIF_ARG_1, 2)
+            && tuple_val(BIF_ARG_1)[2] == am_little) {
+            switch (tuple_val(BIF_ARG_1)[1]) {
+            case make_small(2): type = TCP_PB_2_LITTLE; goto type_done;
+            case make_small(4): type = TCP_PB_4_LITTLE; goto type_done;
+            }
+        }
         BIF_ERROR(BIF_P, BADARG);
     }
+type_done:
 
     options = BIF_ARG_3;
     while (!is_nil(options)) {
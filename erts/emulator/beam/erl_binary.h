@@ -197,6 +197,10 @@ ERTS_GLB_INLINE void erts_bin_free(Binary *bp);
 ERTS_GLB_INLINE Binary *erts_create_magic_binary(Uint size,
 						 void (*destructor)(Binary *));
 
+#ifdef ERTS_HAVE_MMAP_BINARY
+void erts_sys_munmap_binary(Binary *bp);
+#endif
+
 #if ERTS_GLB_INLINE_INCL_FUNC_DEF
 
 #include <stddef.h> /* offsetof */
@@ -267,7 +271,7 @@ erts_bin_realloc_fnf(Binary *bp, Uint size)
 {
     Binary *nbp;
     Uint bsize = ERTS_SIZEOF_Binary(size) + CHICKEN_PAD;
-    ASSERT((bp->flags & BIN_FLAG_MAGIC) == 0);
+    ASSERT((bp->flags & (BIN_FLAG_MAGIC|BIN_FLAG_MMAP)) == 0);
     if (bp->flags & BIN_FLAG_DRV)
 	nbp = erts_realloc_fnf(ERTS_ALC_T_DRV_BINARY, (void *) bp, bsize);
     else
@@ -281,7 +285,7 @@ erts_bin_realloc(Binary *bp, Uint size)
 {
     Binary *nbp;
     Uint bsize = ERTS_SIZEOF_Binary(size) + CHICKEN_PAD;
-    ASSERT((bp->flags & BIN_FLAG_MAGIC) == 0);
+    ASSERT((bp->flags & (BIN_FLAG_MAGIC|BIN_FLAG_MMAP)) == 0);
     if (bp->flags & BIN_FLAG_DRV)
 	nbp = erts_realloc_fnf(ERTS_ALC_T_DRV_BINARY, (void *) bp, bsize);
     else
@@ -299,6 +303,12 @@ erts_bin_realloc(Binary *bp, Uint size)
 ERTS_GLB_INLINE void
 erts_bin_free(Binary *bp)
 {
+#ifdef ERTS_HAVE_MMAP_BINARY
+    if (bp->flags & BIN_FLAG_MMAP) {
+	erts_sys_munmap_binary(bp);
+	return;
+    }
+#endif
     if (bp->flags & BIN_FLAG_MAGIC)
 	ERTS_MAGIC_BIN_DESTRUCTOR(bp)(bp);
     if (bp->flags & BIN_FLAG_DRV)
@@ -86,6 +86,7 @@ static erts_tid_t main_thread;
 #endif
 
 int erts_use_sender_punish;
+int erts_port_parallelism;
 
 /*
  * Configurable parameters.
@@ -513,6 +514,7 @@ void erts_usage(void)
     erts_fprintf(stderr, "            u|ns|ts|ps|s|nnts|nnps|tnnps|db\n");
     erts_fprintf(stderr, "-scl bool   enable/disable compaction of scheduler load,\n");
     erts_fprintf(stderr, "            see the erl(1) documentation for more info.\n");
+    erts_fprintf(stderr, "-spp bool   set default port parallelism, see open_port/2\n");
     erts_fprintf(stderr, "-sct cput   set cpu topology,\n");
     erts_fprintf(stderr, "            see the erl(1) documentation for more info.\n");
     erts_fprintf(stderr, "-swt val    set scheduler wakeup threshold, valid values are:\n");
@@ -540,6 +542,7 @@ void erts_usage(void)
     erts_fprintf(stderr, "            see error_logger documentation for details\n");
     erts_fprintf(stderr, "-zdbbl size set the distribution buffer busy limit in kilobytes\n");
     erts_fprintf(stderr, "            valid range is [1-%d]\n", INT_MAX/1024);
+    erts_fprintf(stderr, "-zdct size set the compressed distribution batch threshold in bytes\n");
     erts_fprintf(stderr, "\n");
     erts_fprintf(stderr, "Note that if the emulator is started with erlexec (typically\n");
     erts_fprintf(stderr, "from the erl script), these flags should be specified with +.\n");
@@ -623,6 +626,7 @@ early_init(int *argc, char **argv) /*
     erts_initialized = 0;
 
     erts_use_sender_punish = 1;
+    erts_port_parallelism = 0;
 
     erts_pre_early_init_cpu_topology(&max_reader_groups,
 				     &ncpu,
@@ -864,6 +868,7 @@ early_init(int *argc, char **argv) /*
     erts_ets_realloc_always_moves = 0;
     erts_ets_always_compress = 0;
     erts_dist_buf_busy_limit = ERTS_DE_BUSY_LIMIT;
+    erts_dist_compress_threshold = ERTS_DIST_COMPRESS_THRESHOLD;
 
     return ncpu;
 }
@@ -1256,6 +1261,19 @@ erl_start(int argc, char **argv)
 	    }
 	    else if (sys_strcmp("nsp", sub_param) == 0)
 		erts_use_sender_punish = 0;
+	    else if (has_prefix("pp", sub_param)) {
+		arg = get_arg(sub_param+2, argv[i+1], &i);
+		if (sys_strcmp("true", arg) == 0)
+		    erts_port_parallelism = 1;
+		else if (sys_strcmp("false", arg) == 0)
+		    erts_port_parallelism = 0;
+		else {
+		    erts_fprintf(stderr,
+				 "bad port parallelism value '%s'\n",
+				 arg);
+		    erts_usage();
+		}
+	    }
 	    else if (sys_strcmp("wt", sub_param) == 0) {
 		arg = get_arg(sub_param+2, argv[i+1], &i);
 		if (erts_sched_set_wakeup_limit(arg) != 0) {
@@ -1424,6 +1442,16 @@ erl_start(int argc, char **argv)
 		} else {
 		    erts_dist_buf_busy_limit = new_limit*1024;
 		}
+	    } else if (has_prefix("dct", sub_param)) {
+		arg = get_arg(sub_param+3, argv[i+1], &i);
+		new_limit = atoi(arg);
+		if (new_limit < 0) {
+		    erts_fprintf(stderr, "Invalid dct threshold: %d\n",
+				 new_limit);
+		    erts_usage();
+		} else {
+		    erts_dist_compress_threshold = new_limit;
+		}
 	    } else {
 		erts_fprintf(stderr, "bad -z option %s\n", argv[i]);
 		erts_usage();
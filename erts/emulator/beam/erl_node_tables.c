@@ -123,6 +123,8 @@ dist_table_alloc(void *dep_tmpl)
     erts_port_task_handle_init(&dep->dist_cmd);
     dep->send				= NULL;
     dep->cache				= NULL;
+    dep->compress			= NULL;
+    erts_dist_stats_init(&dep->stats);
 
     /* Link in */
 
@@ -171,6 +173,7 @@ dist_table_free(void *vdep)
     erts_no_of_not_connected_dist_entries--;
 
     ASSERT(!dep->cache);
+    ASSERT(!dep->compress);
     erts_smp_rwmtx_destroy(&dep->rwmtx);
     erts_smp_mtx_destroy(&dep->lnk_mtx);
     erts_smp_mtx_destroy(&dep->qlock);
@@ -772,6 +775,8 @@ void erts_init_node_tables(void)
     erts_port_task_handle_init(&erts_this_dist_entry->dist_cmd);
     erts_this_dist_entry->send				= NULL;
     erts_this_dist_entry->cache				= NULL;
+    erts_this_dist_entry->compress			= NULL;
+    erts_dist_stats_init(&erts_this_dist_entry->stats);
 
     (void) hash_put(&erts_dist_table, (void *) erts_this_dist_entry);
 
@@ -89,6 +89,27 @@ typedef struct {
     struct ErtsProcList_ *last;
 } ErtsDistSuspended;
 
+/*
+ * Traffic statistics kept per dist entry and per control message
+ * type. The opcodes (DOP_* in dist.h) are used as index, and all of
+ * them but DOP_SEND_MULTI, which is counted in the last slot, are
+ * less than ERTS_DIST_STAT_OPS.
+ */
+#define ERTS_DIST_STAT_OPS 23
+
+typedef struct {
+    erts_smp_atomic_t msgs;	/* Number of messages */
+    erts_smp_atomic_t octets;	/* Size of external format */
+    erts_smp_atomic_t usecs;	/* Encode (send) or decode (recv) time */
+} ErtsDistOpStat;
+
+typedef struct {
+    ErtsDistOpStat send[ERTS_DIST_STAT_OPS];
+    ErtsDistOpStat recv[ERTS_DIST_STAT_OPS];
+    Sint qsize_max;		/* Out queue high water mark; qlock */
+    Uint busy;			/* Senders suspended on busy dist; qlock */
+} ErtsDistStats;
+
 /*
  * Lock order:
  *   1. dist_entry->rwmtx
@@ -144,6 +165,9 @@ typedef struct dist_entry_ {
     Uint (*send)(struct port *prt, ErtsDistOutputBuf *obuf);
 
     struct cache* cache;	/* The atom cache */
+    struct ErtsDistCompress_ *compress; /* zlib streams, if compressed */
+
+    ErtsDistStats stats;	/* Reset on connect */
 } DistEntry;
 
 typedef struct erl_node_ {
@@ -46,6 +46,7 @@
 #define ERTS_PORT_REDS_INPUT		200
 #define ERTS_PORT_REDS_OUTPUT		200
 #define ERTS_PORT_REDS_EVENT		200
+#define ERTS_PORT_REDS_CMDQ		200
 #define ERTS_PORT_REDS_TERMINATE	100
 
 
@@ -848,6 +849,13 @@ erts_port_task_execute(ErtsRunQueue *runq, Port **curr_port_pp)
 	case ERTS_PORT_TASK_DIST_CMD:
 	    reds += erts_dist_command(pp, CONTEXT_REDS-reds);
 	    break;
+#ifdef ERTS_SMP
+	case ERTS_PORT_TASK_CMDQ:
+	    /* Cleared first so that commands pushed from now on get a task */
+	    erts_smp_atomic32_set_mb(&pp->cmdq_scheduled, 0);
+	    reds += ERTS_PORT_REDS_CMDQ*erts_port_run_cmdq(pp);
+	    break;
+#endif
 	default:
 	    erl_exit(ERTS_ABORT_EXIT,
 		     "Invalid port task type: %d\n",
@@ -1007,6 +1015,7 @@ handle_remaining_tasks(ErtsRunQueue *runq, Port *pp)
 		erts_stale_drv_select(pp->id, ptp->event, 0, 1);
 		break;
 	    case ERTS_PORT_TASK_DIST_CMD:
+	    case ERTS_PORT_TASK_CMDQ:
 		break;
 	    default:
 		erl_exit(ERTS_ABORT_EXIT,
@@ -149,6 +149,10 @@ struct port {
     ErtsXPortsList *xports;
     erts_smp_atomic_t run_queue;
     erts_smp_spinlock_t state_lck;  /* protects: id, status, snapshot */
+    erts_smp_atomic_t cmdq;         /* Queued commands, see io.c */
+    erts_smp_atomic_t cmdq_size;    /* Bytes in cmdq */
+    erts_smp_atomic32_t cmdq_scheduled;
+    ErtsPortTaskHandle cmdq_task;
 #endif
     Eterm id;                   /* The Port id of this port */
     Eterm connected;            /* A connected process */
@@ -454,6 +458,7 @@ typedef union {
 #define BIN_FLAG_USR1       2 /* Reserved for use by different modules too mark */
 #define BIN_FLAG_USR2       4 /*  certain binaries as special (used by ets) */
 #define BIN_FLAG_DRV        8
+#define BIN_FLAG_MMAP      16 /* Contents are a file mapping */
 
 /*
  * This structure represents one type of a binary in a process.
@@ -806,6 +811,8 @@ do {									\
 /* Port uses port specific locking (opposed to driver specific locking) */
 #define ERTS_PORT_SFLG_PORT_SPECIFIC_LOCK ((Uint32) (1 << 13))
 #define ERTS_PORT_SFLG_INVALID		((Uint32) (1 << 14))
+/* Commands may be queued instead of waiting for the port lock */
+#define ERTS_PORT_SFLG_PARALLELISM	((Uint32) (1 << 15))
 #ifdef DEBUG
 /* Only debug: make sure all flags aren't cleared unintentionally */
 #define ERTS_PORT_SFLG_PORT_DEBUG	((Uint32) (1 << 31))
@@ -1101,6 +1108,8 @@ extern Eterm erts_error_logger_warnings;
 extern int erts_initialized;
 extern int erts_compat_rel;
 extern int erts_use_sender_punish;
+extern int erts_port_parallelism;
+extern int erts_port_parallelism_in_use;
 void erts_short_init(void);
 void erl_start(int, char**);
 void erts_usage(void);
@@ -1172,6 +1181,13 @@ void init_io(void);
 void cleanup_io(void);
 void erts_do_exit_port(Port *, Eterm, Eterm);
 void erts_port_command(Process *, Eterm, Port *, Eterm);
+#ifdef ERTS_SMP
+#define ERTS_PORT_CMDQ_NOT_USED	0
+#define ERTS_PORT_CMDQ_DONE	1
+#define ERTS_PORT_CMDQ_BADARG	2
+int erts_port_cmdq_command(Eterm caller_id, Eterm id, Eterm list);
+Sint erts_port_run_cmdq(Port *);
+#endif
 Eterm erts_port_control(Process*, Port*, Uint, Eterm);
 int erts_write_to_port(Eterm caller_id, Port *p, Eterm list);
 void print_port_info(int, void *, int);
@@ -1200,9 +1216,21 @@ ERTS_GLB_INLINE void erts_smp_port_state_unlock(Port*);
 ERTS_GLB_INLINE int erts_smp_port_trylock(Port *prt);
 ERTS_GLB_INLINE void erts_smp_port_lock(Port *prt);
 ERTS_GLB_INLINE void erts_smp_port_unlock(Port *prt);
+ERTS_GLB_INLINE void erts_port_flush_cmdq(Port *prt);
 
 #if ERTS_GLB_INLINE_INCL_FUNC_DEF
 
+/* Run commands queued by others before doing anything on their behalf */
+ERTS_GLB_INLINE void
+erts_port_flush_cmdq(Port *prt)
+{
+#ifdef ERTS_SMP
+    ERTS_SMP_LC_ASSERT(erts_lc_is_port_locked(prt));
+    if (erts_smp_atomic_read_nob(&prt->cmdq))
+	(void) erts_port_run_cmdq(prt);
+#endif
+}
+
 ERTS_GLB_INLINE void
 erts_smp_port_state_lock(Port* prt)
 {
@@ -287,6 +287,7 @@ erts_test_next_port(int set, Uint next)
 static void port_cleanup(Port *prt);
 
 #ifdef ERTS_SMP
+static void free_cmdq(Port *prt);
 
 static void
 sched_port_cleanup(void *vprt)
@@ -337,6 +338,8 @@ port_cleanup(Port *prt)
 
     prt->lock = NULL;
 
+    free_cmdq(prt);
+
     ASSERT(prt->status & ERTS_PORT_SFLG_PORT_DEBUG);
     ASSERT(!(prt->status & ERTS_PORT_SFLG_FREE));
     prt->status = ERTS_PORT_SFLG_FREE;
@@ -456,6 +459,12 @@ setup_port(Port* prt, Eterm pid, erts_driver_t *driver,
     sys_memset(&prt->tm, 0, sizeof(ErlTimer));
 #endif
     erts_port_task_handle_init(&prt->timeout_task);
+#ifdef ERTS_SMP
+    ASSERT(!erts_smp_atomic_read_nob(&prt->cmdq));
+    ASSERT(!erts_smp_atomic_read_nob(&prt->cmdq_size));
+    erts_smp_atomic32_set_nob(&prt->cmdq_scheduled, 0);
+    erts_port_task_handle_init(&prt->cmdq_task);
+#endif
     prt->suspended  = NULL;
     sys_strcpy(prt->name, name);
     prt->nlinks = NULL;
@@ -1103,6 +1112,8 @@ int erts_write_to_port(Eterm caller_id, Port *p, Eterm list)
     ERTS_SMP_LC_ASSERT(erts_lc_is_port_locked(p));
     ERTS_SMP_CHK_NO_PROC_LOCKS;
 
+    erts_port_flush_cmdq(p);
+
     p->caller = caller_id;
     if (drv->outputv != NULL) {
 	Uint vsize;
@@ -1241,6 +1252,223 @@ int erts_write_to_port(Eterm caller_id, Port *p, Eterm list)
     }
 }
 
+/* Set once a port with the parallelism flag has been opened */
+int erts_port_parallelism_in_use = 0;
+
+#ifdef ERTS_SMP
+
+/*
+ * Command queue of ports with the parallelism flag set. A process
+ * that finds such a port locked copies its data into a binary and
+ * pushes it on a lock free stack instead of waiting for the lock.
+ * Whoever holds the lock next runs the queued commands before its
+ * own; if nobody comes along, a port task does. The commands of one
+ * process are thereby run in the order they were given.
+ *
+ * Queued data is not seen by the driver's busy handling, so a process
+ * finding ERTS_PORT_CMDQ_LIMIT bytes queued waits for the lock as
+ * usual, and is suspended there if the driver says the port is busy.
+ */
+
+#define ERTS_PORT_CMDQ_LIMIT (64*1024)
+
+typedef struct ErtsPortCmd_ ErtsPortCmd;
+struct ErtsPortCmd_ {
+    ErtsPortCmd *next;
+    Eterm caller;
+    ErlDrvBinary *bin;
+    Uint size;
+};
+
+static void
+write_cmd_to_port(Port *p, ErtsPortCmd *cmd)
+{
+    erts_driver_t *drv = p->drv_ptr;
+    int fpe_was_unmasked;
+
+    p->caller = cmd->caller;
+    fpe_was_unmasked = erts_block_fpe();
+    if (drv->outputv != NULL) {
+	SysIOVec iv[2];
+	ErlDrvBinary* bv[2];
+	ErlIOVec ev;
+	/* Element 0 is for driver usage to add header block */
+	iv[0].iov_base = NULL;
+	iv[0].iov_len = 0;
+	bv[0] = NULL;
+	iv[1].iov_base = cmd->bin->orig_bytes;
+	iv[1].iov_len = cmd->size;
+	bv[1] = cmd->bin;
+	ev.vsize = cmd->size ? 2 : 1;
+	ev.size = cmd->size;
+	ev.iov = iv;
+	ev.binv = bv;
+	(*drv->outputv)((ErlDrvData)p->drv_data, &ev);
+    } else {
+	(*drv->output)((ErlDrvData)p->drv_data, cmd->bin->orig_bytes,
+		       cmd->size);
+    }
+    erts_unblock_fpe(fpe_was_unmasked);
+    p->bytes_out += cmd->size;
+    erts_smp_atomic_add_nob(&erts_bytes_out, cmd->size);
+    if (p->xports)
+	erts_smp_xports_unlock(p);
+    ASSERT(!p->xports);
+    p->caller = NIL;
+}
+
+static ERTS_INLINE ErtsPortCmd *
+take_cmdq(Port *prt)
+{
+    ErtsPortCmd *cmd, *next, *fifo = NULL;
+    erts_aint_t size = 0;
+
+    cmd = (ErtsPortCmd *) erts_smp_atomic_xchg_mb(&prt->cmdq,
+						  (erts_aint_t) NULL);
+    for (; cmd; cmd = next) {
+	next = cmd->next;
+	cmd->next = fifo;
+	fifo = cmd;
+	size += (erts_aint_t) cmd->size;
+    }
+    if (size)
+	erts_smp_atomic_add_nob(&prt->cmdq_size, -size);
+    return fifo;
+}
+
+static ERTS_INLINE void
+free_cmd(ErtsPortCmd *cmd)
+{
+    driver_free_binary(cmd->bin);
+    erts_free(ERTS_ALC_T_PORT_CMD, (void *) cmd);
+}
+
+static void
+free_cmdq(Port *prt)
+{
+    ErtsPortCmd *cmd, *next;
+    for (cmd = take_cmdq(prt); cmd; cmd = next) {
+	next = cmd->next;
+	free_cmd(cmd);
+    }
+}
+
+/* Called with the port locked; returns the number of commands run */
+Sint
+erts_port_run_cmdq(Port *prt)
+{
+    ErtsPortCmd *cmd, *next;
+    Sint n = 0;
+
+    ERTS_SMP_LC_ASSERT(erts_lc_is_port_locked(prt));
+
+    for (cmd = take_cmdq(prt); cmd; cmd = next) {
+	next = cmd->next;
+	if (!(prt->status & (ERTS_PORT_SFLGS_DEAD|ERTS_PORT_SFLG_CLOSING))) {
+	    write_cmd_to_port(prt, cmd);
+	    n++;
+	}
+	free_cmd(cmd);
+    }
+    return n;
+}
+
+/*
+ * port_command/2,3 on a port with the parallelism flag. Runs the
+ * command at once if the port lock is free, and queues it if not.
+ * Returns ERTS_PORT_CMDQ_NOT_USED when the ordinary path has to be
+ * taken, e.g. since the port is busy or too much is queued and the
+ * caller may have to be suspended. No process locks may be held.
+ */
+int
+erts_port_cmdq_command(Eterm caller_id, Eterm id, Eterm list)
+{
+    Port *prt;
+    ErtsPortCmd *cmd;
+    erts_aint_t head, old;
+    Uint size;
+    int res;
+
+    ERTS_SMP_CHK_NO_PROC_LOCKS;
+
+    if (is_not_internal_port(id))
+	return ERTS_PORT_CMDQ_NOT_USED;
+
+    prt = &erts_port[internal_port_index(id)];
+
+    erts_smp_port_state_lock(prt);
+    if (INVALID_PORT(prt, id)
+	|| (prt->status & (ERTS_PORT_SFLG_PORT_BUSY
+			   | ERTS_PORT_SFLG_DISTRIBUTION))
+	|| !(prt->status & ERTS_PORT_SFLG_PARALLELISM)
+	|| (prt->trace_flags & F_TRACE_SCHED_PORTS)
+	|| erts_system_profile_flags.runnable_ports) {
+	erts_smp_port_state_unlock(prt);
+	return ERTS_PORT_CMDQ_NOT_USED;
+    }
+    erts_smp_atomic_inc_nob(&prt->refc);
+    erts_smp_port_state_unlock(prt);
+
+    if (erts_smp_mtx_trylock(prt->lock) != EBUSY) {
+	if (INVALID_PORT(prt, id)) {
+	    erts_smp_port_unlock(prt);
+	    return ERTS_PORT_CMDQ_NOT_USED;
+	}
+	res = (erts_write_to_port(caller_id, prt, list) == 0
+	       ? ERTS_PORT_CMDQ_DONE
+	       : ERTS_PORT_CMDQ_BADARG);
+	erts_port_release(prt);
+	return res;
+    }
+
+    res = ERTS_PORT_CMDQ_DONE;
+    if (erts_iolist_size(list, &size)) {
+	res = ERTS_PORT_CMDQ_BADARG;
+	goto done;
+    }
+    if (erts_smp_atomic_add_read_nob(&prt->cmdq_size, (erts_aint_t) size)
+	> ERTS_PORT_CMDQ_LIMIT) {
+	erts_smp_atomic_add_nob(&prt->cmdq_size, -((erts_aint_t) size));
+	res = ERTS_PORT_CMDQ_NOT_USED;
+	goto done;
+    }
+    cmd = erts_alloc(ERTS_ALC_T_PORT_CMD, sizeof(ErtsPortCmd));
+    cmd->caller = caller_id;
+    cmd->size = size;
+    cmd->bin = driver_alloc_binary(size);
+    if (!cmd->bin)
+	erts_alloc_enomem(ERTS_ALC_T_DRV_BINARY, ERTS_SIZEOF_Binary(size));
+    (void) io_list_to_buf(list, cmd->bin->orig_bytes, size);
+
+    head = erts_smp_atomic_read_nob(&prt->cmdq);
+    while (1) {
+	cmd->next = (ErtsPortCmd *) head;
+	old = erts_smp_atomic_cmpxchg_mb(&prt->cmdq, (erts_aint_t) cmd, head);
+	if (old == head)
+	    break;
+	head = old;
+    }
+
+    if (!erts_smp_atomic32_xchg_mb(&prt->cmdq_scheduled, 1)) {
+	(void) erts_port_task_schedule(id,
+				       &prt->cmdq_task,
+				       ERTS_PORT_TASK_CMDQ,
+				       (ErlDrvEvent) -1,
+				       NULL);
+    }
+
+ done: {
+	/* Like erts_smp_port_unlock() without the unlock */
+	erts_aint_t refc = erts_smp_atomic_dec_read_nob(&prt->refc);
+	ASSERT(refc >= 0);
+	if (refc == 0)
+	    erts_port_cleanup(prt);
+    }
+    return res;
+}
+
+#endif /* ERTS_SMP */
+
 /* initialize the port array */
 void init_io(void)
 {
@@ -1302,6 +1530,10 @@ void init_io(void)
 	erts_port[i].lock = NULL;
 	erts_port[i].xports = NULL;
 	erts_smp_spinlock_init_x(&erts_port[i].state_lck, "port_state", make_small(i));
+	erts_smp_atomic_init_nob(&erts_port[i].cmdq, (erts_aint_t) NULL);
+	erts_smp_atomic_init_nob(&erts_port[i].cmdq_size, 0);
+	erts_smp_atomic32_init_nob(&erts_port[i].cmdq_scheduled, 0);
+	erts_port_task_handle_init(&erts_port[i].cmdq_task);
 #endif
 	erts_port[i].tracer_proc = NIL;
 	erts_port[i].trace_flags = 0;
@@ -2111,6 +2343,7 @@ void erts_port_command(Process *proc,
     erts_smp_proc_unlock(proc, ERTS_PROC_LOCK_MAIN);
     ERTS_SMP_CHK_NO_PROC_LOCKS;
     ASSERT(!INVALID_PORT(port, port->id));
+    erts_port_flush_cmdq(port);
 
     if (is_tuple_arity(command, 2)) {
 	tp = tuple_val(command);
@@ -2182,6 +2415,8 @@ erts_port_control(Process* p, Port* prt, Uint command, Eterm iolist)
 	return THE_NON_VALUE;
     }
 
+    erts_port_flush_cmdq(prt);
+
     /*
      * Convert the iolist to a buffer, pointed to by to_port,
      * and with its length in to_len.
@@ -3488,6 +3723,18 @@ ErlDrvBinary* driver_realloc_binary(ErlDrvBinary* bin, ErlDrvSizeT size)
     }
 
     oldbin = ErlDrvBinary2Binary(bin);
+#ifdef ERTS_HAVE_MMAP_BINARY
+    if (oldbin->flags & BIN_FLAG_MMAP) {
+	/* A file mapping cannot be resized; copy what is kept */
+	ErlDrvBinary *nbin = driver_alloc_binary(size);
+	if (nbin) {
+	    sys_memcpy(nbin->orig_bytes, bin->orig_bytes,
+		       size < bin->orig_size ? size : bin->orig_size);
+	    driver_free_binary(bin);
+	}
+	return nbin;
+    }
+#endif
     newbin = (Binary *) erts_bin_realloc_fnf(oldbin, size);
     if (!newbin)
 	return NULL;
@@ -47,6 +47,9 @@
                              (((unsigned char*) (s))[1] << 8) | \
                              (((unsigned char*) (s))[0]))
 
+#define get_little_int16(s) ((((unsigned char*) (s))[1] << 8) | \
+                             (((unsigned char*) (s))[0]))
+
 #if !defined(__WIN32__) && !defined(HAVE_STRNCASECMP)
 #define STRNCASECMP my_strncasecmp
 
@@ -288,6 +291,39 @@ int packet_get_length(enum PacketParseType htype,
         plen = get_int32(ptr);
         goto remain;
 
+    case TCP_PB_2_LITTLE:
+        /* TCP_PB_2_LITTLE: [L0,L1 | Data] */
+        hlen = 2;
+        if (n < hlen) goto more;
+        plen = get_little_int16(ptr);
+        goto remain;
+
+    case TCP_PB_4_LITTLE:
+        /* TCP_PB_4_LITTLE: [L0,L1,L2,L3 | Data] */
+        hlen = 4;
+        if (n < hlen) goto more;
+        plen = get_little_int32(ptr);
+        goto remain;
+
+    case TCP_PB_VARINT: {
+        /* TCP_PB_VARINT: [V0,...Vn | Data]
+        ** base 128 length, least significant group first and the
+        ** MSB (bit) set on all bytes but the last (protobuf varint)
+        */
+        unsigned char c;
+        plen = 0;
+        hlen = 0;
+        do {
+            if (hlen == n) goto more;
+            c = ptr[hlen];
+            if (hlen == PACKET_VARINT_MAX-1 && c > 0x0f)
+                goto error; /* does not fit in 32 bits */
+            plen |= ((Uint32) (c & 0x7f)) << (7*hlen);
+            hlen++;
+        } while (c & 0x80);
+        goto remain;
+    }
+
     case TCP_PB_RM:
         /* TCP_PB_RM:    [L3,L2,L1,L0 | Data] 
         ** where MSB (bit) is used to signal end of record
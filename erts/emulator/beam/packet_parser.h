@@ -43,9 +43,14 @@ enum PacketParseType {
     TCP_PB_HTTPH    = 11,
     TCP_PB_SSL_TLS  = 12,
     TCP_PB_HTTP_BIN = 13,
-    TCP_PB_HTTPH_BIN = 14
+    TCP_PB_HTTPH_BIN = 14,
+    TCP_PB_VARINT   = 15,
+    TCP_PB_2_LITTLE = 16,
+    TCP_PB_4_LITTLE = 17
 };
 
+#define PACKET_VARINT_MAX 5 /* Max bytes in a TCP_PB_VARINT header */
+
 typedef struct http_atom {
     struct http_atom* next;   /* next in bucket */
     unsigned long h;          /* stored hash value */
@@ -111,6 +116,12 @@ void packet_get_body(enum PacketParseType htype,
                      const char** bufp, /* In: Packet header, Out: Packet body */
                      int* lenp);        /* In: Packet length, Out: Body length */
 
+/* Writes a TCP_PB_VARINT header for a body of len bytes.
+ * Returns the header length.
+ */
+ERTS_GLB_INLINE
+int packet_put_varint(unsigned len, char* buf);
+
 /* Returns 1 = Packet parsed and handled by callbacks.
 **         0 = No parsing support for this packet type
 **        -1 = Error
@@ -149,6 +160,15 @@ void packet_get_body(enum PacketParseType htype, const char** bufp, int* lenp)
     case TCP_PB_1:  *bufp += 1; *lenp -= 1; break;
     case TCP_PB_2:  *bufp += 2; *lenp -= 2; break;
     case TCP_PB_4:  *bufp += 4; *lenp -= 4; break;
+    case TCP_PB_2_LITTLE: *bufp += 2; *lenp -= 2; break;
+    case TCP_PB_4_LITTLE: *bufp += 4; *lenp -= 4; break;
+    case TCP_PB_VARINT: {
+        int hlen = 1;
+        while ((*bufp)[hlen-1] & 0x80)
+            hlen++;
+        *bufp += hlen; *lenp -= hlen;
+        break;
+    }
     case TCP_PB_FCGI:
 	*lenp -= ((struct fcgi_head*)*bufp)->paddingLength;
         break;
@@ -157,6 +177,19 @@ void packet_get_body(enum PacketParseType htype, const char** bufp, int* lenp)
     }
 }
 
+ERTS_GLB_INLINE
+int packet_put_varint(unsigned len, char* buf)
+{
+    int hlen = 0;
+
+    while (len >= 0x80) {
+        buf[hlen++] = (char) ((len & 0x7f) | 0x80);
+        len >>= 7;
+    }
+    buf[hlen++] = (char) len;
+    return hlen;
+}
+
 ERTS_GLB_INLINE
 int packet_parse(enum PacketParseType htype, const char* buf, int len,
 		 int* statep, PacketCallbacks* pcb, void* arg)
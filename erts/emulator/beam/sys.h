@@ -581,6 +581,8 @@ typedef struct _SysDriverOpts {
     int hide_window;		/* Hide this windows (Windows). */
     int exit_status;		/* Report exit status of subprocess. */
     int overlapped_io;          /* Only has effect on windows NT et al */
+    int out_buffer;		/* Bytes of output to gather before writing */
+				/* (fd and spawn drivers on Unix). */
     char *envir;		/* Environment of the port process, */
 				/* in Windows format. */
     char **argv;                /* Argument vector in Unix'ish format. */
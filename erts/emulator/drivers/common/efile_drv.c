@@ -56,6 +56,8 @@
 #define FILE_FDATASYNC          30
 #define FILE_FADVISE            31
 #define FILE_SENDFILE           32
+#define FILE_READ_FILE_MMAP     33
+#define FILE_READDIR_INFO       34
 
 /* Return codes */
 
@@ -71,6 +73,7 @@
 #define FILE_RESP_FNAME      9
 #define FILE_RESP_ALL_DATA  10
 #define FILE_RESP_LFNAME    11
+#define FILE_RESP_LFINFO    12
 
 /* Options */
 
@@ -81,10 +84,15 @@
 
 #define IPREAD_S32BU_P32BU 0
 
+/* FILE_PREADV flags */
+
+#define FILE_PREADV_BATCH 1
+
 /* Limits */
 
 #define FILE_SEGMENT_READ  (256*1024)
 #define FILE_SEGMENT_WRITE (256*1024)
+#define FILE_MMAP_MIN      (64*1024)	/* Smaller files are just read */
 
 /* Internal */
 
@@ -112,6 +120,7 @@
 #include "erl_threads.h"
 #include "zlib.h"
 #include "gzio.h"
+#include "erl_uring.h"
 #include <ctype.h>
 #include <sys/types.h>
 
@@ -177,6 +186,7 @@ static ErlDrvSysInfo sys_info;
 #  define FILENAME_BYTELEN(Str) filename_len_16bit(Str)
 #  define FILENAME_COPY(To,From) filename_cpy_16bit((To),(From)) 
 #  define FILENAME_CHARSIZE 2
+#  define FILENAME_PUTC(P,C) ((P)[0] = (C), (P)[1] = '\0')
 
    static int filename_len_16bit(char *str) 
    {
@@ -201,6 +211,7 @@ static ErlDrvSysInfo sys_info;
 #  define FILENAME_BYTELEN(Str) strlen(Str)
 #  define FILENAME_COPY(To,From) strcpy(To,From) 
 #  define FILENAME_CHARSIZE 1
+#  define FILENAME_PUTC(P,C) ((P)[0] = (C))
 #endif
 
 #if     (MAXPATHLEN+1)*FILENAME_CHARSIZE+1 > BUFSIZ
@@ -249,6 +260,9 @@ static void file_timeout(ErlDrvData);
 static void file_outputv(ErlDrvData, ErlIOVec*);
 static void file_async_ready(ErlDrvData, ErlDrvThreadData);
 static void file_flush(ErlDrvData);
+#if ERTS_HAVE_IO_URING
+static void file_ready_input(ErlDrvData data, ErlDrvEvent event);
+#endif
 
 #ifdef HAVE_SENDFILE
 static void file_ready_output(ErlDrvData data, ErlDrvEvent event);
@@ -288,6 +302,14 @@ typedef struct {
     ErlDrvPDL       q_mtx;    /* Mutex for the driver queue, known by the emulator. Also used for
 				 mutual exclusion when accessing field(s) below. */
     size_t          write_buffered;
+#if ERTS_HAVE_IO_URING
+    ErtsURing      *ring;     /* Set up on first use, see ring_execute() */
+    struct t_data  *ring_d;   /* Command on the ring */
+    unsigned        ring_wait; /* Completions still to come for ring_d */
+    SysIOVec       *ring_iov; /* What is left to write of a FILE_WRITE */
+    int             ring_iovcnt;
+    unsigned        async_jobs; /* Commands out on async threads */
+#endif
 } file_descriptor;
 
 
@@ -298,7 +320,11 @@ struct erl_drv_entry efile_driver_entry = {
     file_start,
     file_stop,
     file_output,
+#if ERTS_HAVE_IO_URING
+    file_ready_input,
+#else
     NULL,
+#endif
 #ifdef HAVE_SENDFILE
     file_ready_output,
 #else
@@ -330,6 +356,9 @@ struct erl_drv_entry efile_driver_entry = {
 
 
 static int thread_short_circuit;
+#if ERTS_HAVE_IO_URING
+static int use_ring;
+#endif
 
 #define DRIVER_ASYNC(level, desc, f_invoke, data, f_free) \
 if (thread_short_circuit >= (level)) { \
@@ -356,12 +385,24 @@ struct t_pwritev {
     struct t_pbuf_spec specs[1];
 };
 
+/* With FILE_PREADV_BATCH the n reads are the coalesced runs, all into
+ * one binary, and run[i] tells which run the data for eiov.iov[1+i]
+ * is in. Otherwise the reads are the requested ranges themselves. */
 struct t_preadv {
-    ErlIOVec eiov;
-    unsigned n;
-    unsigned cnt;
+    ErlIOVec  eiov;
+    unsigned  n;
+    unsigned  cnt;
+    size_t    size;
+    SysIOVec *iov;		/* Read buffers, iov[0..n-1] */
+    unsigned *run;		/* NULL unless batched */
+    Sint64   *offsets;		/* File positions, offsets[0..n-1] */
+};
+
+/* A requested range while coalescing */
+struct t_preadv_range {
+    Sint64   offset;
     size_t   size;
-    Sint64   offsets[1];
+    unsigned ix;
 };
 
 #define READDIR_BUFSIZE (8*1024)*READDIR_CHUNKS
@@ -376,6 +417,38 @@ struct t_readdir_buf {
      char buf[READDIR_BUFSIZE];
 };
 
+/* Size of the file information in FILE_RESP_INFO and FILE_RESP_LFINFO */
+#define FILE_INFO_SIZE (17*4)
+
+/* Largest entry of a FILE_RESP_LFINFO chunk */
+#define READDIR_INFO_ENTRY_MAX (2 + MAXPATHLEN*FILENAME_CHARSIZE + FILE_INFO_SIZE)
+
+#define READDIR_INFO_BUFSIZE (64*1024)
+#if READDIR_INFO_BUFSIZE < (1 + READDIR_INFO_ENTRY_MAX)
+#  undef READDIR_INFO_BUFSIZE
+#  define READDIR_INFO_BUFSIZE (1 + READDIR_INFO_ENTRY_MAX)
+#endif
+
+struct t_readdir_info_dir {
+    EFILE_DIR_HANDLE handle;
+    size_t           len;	/* Bytes of path naming this directory */
+};
+
+/*
+ * State of a FILE_READDIR_INFO walk. path is the directory being read;
+ * the directories above it are still open in dirs[0..level-1].
+ */
+struct t_readdir_info {
+    char  *buf;			/* Chunk being filled */
+    size_t n;			/* Bytes used in buf */
+    char  *path;
+    size_t rel;			/* Where names below the top start in path */
+    int    depth;		/* Levels to descend, < 0 for no limit */
+    int    level;		/* Index in dirs, < 0 when done */
+    int    max_levels;
+    struct t_readdir_info_dir dirs[1];
+};
+
 struct t_data
 {
     struct t_data *next;
@@ -410,6 +483,9 @@ struct t_data
 	    size_t        size;
 	    size_t        free_size;
 	    size_t        reply_size;
+#if ERTS_HAVE_IO_URING
+	    SysIOVec     *ring_iov;
+#endif
 	} writev;
 	struct t_pwritev pwritev;
 	struct t_preadv  preadv;
@@ -431,13 +507,15 @@ struct t_data
 	} read_line;
 	struct {
 	    ErlDrvBinary *binp;
-	    int           size;
-	    int           offset;
+	    ErlDrvSizeT   size;
+	    ErlDrvSizeT   offset;
+	    int           mmap; /* in, bool */
 	} read_file;
 	struct {
 	    struct t_readdir_buf *first_buf;
 	    struct t_readdir_buf *last_buf;
 	} read_dir;
+	struct t_readdir_info *readdir_info;
 	struct {
 	    Sint64 offset;
 	    Sint64 length;
@@ -679,6 +757,9 @@ file_init(void)
 			    ? atoi(buf)
 			    : 0);
     driver_system_info(&sys_info, sizeof(ErlDrvSysInfo));
+#if ERTS_HAVE_IO_URING
+    use_ring = erts_use_io_uring;
+#endif
 
     return 0;
 }
@@ -719,6 +800,14 @@ file_start(ErlDrvPort port, char* command)
     desc->write_error = 0;
     MUTEX_INIT(desc->q_mtx, port); /* Refc is one, referenced by emulator now */
     desc->write_buffered = 0;
+#if ERTS_HAVE_IO_URING
+    desc->ring = NULL;
+    desc->ring_d = NULL;
+    desc->ring_wait = 0;
+    desc->ring_iov = NULL;
+    desc->ring_iovcnt = 0;
+    desc->async_jobs = 0;
+#endif
     return (ErlDrvData) desc;
 }
 
@@ -745,6 +834,10 @@ static void invoke_close(void *data)
 /*********************************************************************
  * Driver entry point -> stop
  */
+#if ERTS_HAVE_IO_URING
+static void ring_exit(file_descriptor *desc);
+#endif
+
 static void 
 file_stop(ErlDrvData e)
 {
@@ -752,6 +845,12 @@ file_stop(ErlDrvData e)
 
     TRACE_C('p');
 
+#if ERTS_HAVE_IO_URING
+    if (desc->ring) {
+	ring_exit(desc);
+    }
+#endif
+
 #ifdef HAVE_SENDFILE
     if (desc->sendfile_state == sending && !USE_THRDS_FOR_SENDFILE) {
 	driver_select(desc->port,(ErlDrvEvent)(long)desc->d->c.sendfile.out_fd,
@@ -769,6 +868,11 @@ file_stop(ErlDrvData e)
     if (desc->read_binp) {
 	driver_free_binary(desc->read_binp);
     }
+    if (desc->timer_state == timer_again) {
+	/* A job waiting to be continued, e.g. a directory walk with
+	 * directories still open */
+	desc->free(desc->d);
+    }
     EF_FREE(desc);
 }
 
@@ -966,6 +1070,35 @@ static int reply_eof(file_descriptor *desc) {
     driver_output2(desc->port, &c, 1, NULL, 0);
     return 0;
 }
+
+/* Encodes file information as in FILE_RESP_INFO, FILE_INFO_SIZE bytes */
+static void put_info(char *p, Efile_info *info) {
+    put_int32(info->size_high,         p + ( 0 * 4));
+    put_int32(info->size_low,          p + ( 1 * 4));
+    put_int32(info->type,              p + ( 2 * 4));
+
+    /* Note 64 bit indexing here */
+    put_int64(info->accessTime,        p + ( 3 * 4));
+    put_int64(info->modifyTime,        p + ( 5 * 4));
+    put_int64(info->cTime,             p + ( 7 * 4));
+
+    put_int32(info->mode,              p + ( 9 * 4));
+    put_int32(info->links,             p + (10 * 4));
+    put_int32(info->major_device,      p + (11 * 4));
+    put_int32(info->minor_device,      p + (12 * 4));
+    put_int32(info->inode,             p + (13 * 4));
+    put_int32(info->uid,               p + (14 * 4));
+    put_int32(info->gid,               p + (15 * 4));
+    put_int32(info->access,            p + (16 * 4));
+}
+
+static void reply_readdir_info(file_descriptor *desc, struct t_data *d) {
+    struct t_readdir_info *w = d->c.readdir_info;
+
+    if (w->n > 1) {
+	driver_output2(desc->port, w->buf, 1, w->buf + 1, w->n - 1);
+    }
+}
  
 static void invoke_name(void *data, int (*f)(Efile_error *, char *))
 {
@@ -1195,9 +1328,21 @@ static void invoke_read_file(void *data)
 	    goto done;
 	}
 	d->fd = fd;
-	d->c.read_file.size = (int) size;
-	if (size < 0 || size != d->c.read_file.size ||
-	    ! (d->c.read_file.binp = 
+	d->c.read_file.size = (ErlDrvSizeT) size;
+	if (size < 0 || size != (Sint64) d->c.read_file.size) {
+	    d->result_ok = 0;
+	    d->errInfo.posix_errno = ENOMEM;
+	    goto close;
+	}
+#ifdef ERTS_HAVE_MMAP_BINARY
+	if (d->c.read_file.mmap && size >= FILE_MMAP_MIN
+	    && (d->c.read_file.binp =
+		erts_sys_mmap_drv_binary(fd, d->c.read_file.size))) {
+	    d->c.read_file.offset = d->c.read_file.size;
+	    goto close;
+	}
+#endif
+	if (! (d->c.read_file.binp =
 	       driver_alloc_binary(d->c.read_file.size))) {
 	    d->result_ok = 0;
 	    d->errInfo.posix_errno = ENOMEM;
@@ -1247,7 +1392,7 @@ static void invoke_preadv(void *data)
     unsigned char   *p = (unsigned char *)ev->iov[0].iov_base + 4+4+8*c->cnt;
 
     while (c->cnt < c->n) {
-	size_t read_size = ev->iov[1 + c->cnt].iov_len - c->size;
+	size_t read_size = c->iov[c->cnt].iov_len - c->size;
 	size_t bytes_read = 0;
 	int chop = d->again 
 	    && bytes_read_so_far + read_size >= 2*FILE_SEGMENT_READ;
@@ -1260,7 +1405,7 @@ static void invoke_preadv(void *data)
 	      = efile_pread(&d->errInfo, 
 			    (int) d->fd,
 			    c->offsets[c->cnt] + c->size,
-			    ev->iov[1 + c->cnt].iov_base + c->size,
+			    (char *) c->iov[c->cnt].iov_base + c->size,
 			    read_size,
 			    &bytes_read))) {
 	    bytes_read_so_far += bytes_read;
@@ -1269,9 +1414,11 @@ static void invoke_preadv(void *data)
 		return;
 	    }
 	    ASSERT(bytes_read <= read_size);
-	    ev->iov[1 + c->cnt].iov_len = bytes_read + c->size;
-	    ev->size += bytes_read + c->size;
-	    put_int64(bytes_read + c->size, p); p += 8;
+	    c->iov[c->cnt].iov_len = bytes_read + c->size;
+	    if (! c->run) {
+		ev->size += bytes_read + c->size;
+		put_int64(bytes_read + c->size, p); p += 8;
+	    }
 	    c->size = 0;
 	    c->cnt++;
 	    if (d->again 
@@ -1290,6 +1437,91 @@ static void invoke_preadv(void *data)
     d->again = 0;
 }
 
+/*
+ * Batched: cut the result for each requested range out of the run it
+ * was read in, shortened to what was read of the run.
+ */
+static void preadv_split(struct t_preadv *c) {
+    ErlIOVec      *ev = &c->eiov;
+    unsigned char *p = (unsigned char *)ev->iov[0].iov_base + 4+4;
+    int            i;
+
+    for (i = 1; i < ev->vsize; i++) {
+	SysIOVec *r = &c->iov[c->run[i-1]];
+	size_t    pos = (char *) ev->iov[i].iov_base - (char *) r->iov_base;
+	size_t    len = r->iov_len > pos ? r->iov_len - pos : 0;
+	if (len < ev->iov[i].iov_len) {
+	    ev->iov[i].iov_len = len;
+	}
+	ev->size += ev->iov[i].iov_len;
+	put_int64(ev->iov[i].iov_len, p); p += 8;
+    }
+}
+
+static int preadv_range_cmp(const void *a, const void *b) {
+    Sint64 x = ((struct t_preadv_range *) a)->offset;
+    Sint64 y = ((struct t_preadv_range *) b)->offset;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Batched: sort the requested ranges and merge the ones that overlap or
+ * are adjacent into runs, each read with one pread() into its own part
+ * of one binary that all results are then cut from. Returns 0 if the
+ * binary could not be allocated.
+ */
+static int preadv_coalesce(struct t_preadv *c,
+			   struct t_preadv_range *ranges) {
+    ErlIOVec     *ev = &c->eiov;
+    unsigned      n = ev->vsize - 1;
+    unsigned      i, r = 0;
+    Uint64        end = 0;
+    size_t        total = 0;
+    ErlDrvBinary *bin;
+
+    qsort(ranges, n, sizeof(*ranges), preadv_range_cmp);
+    for (i = 0; i < n; i++) {
+	struct t_preadv_range *x = &ranges[i];
+	Uint64 x_end = (Uint64) x->offset + x->size;
+	if (r == 0 || (Uint64) x->offset > end) {
+	    c->offsets[r] = x->offset;
+	    c->iov[r].iov_len = x->size;
+	    end = x_end;
+	    r++;
+	} else if (x_end > end) {
+	    c->iov[r-1].iov_len += x_end - end;
+	    end = x_end;
+	}
+	c->run[x->ix - 1] = r - 1;
+	ev->iov[x->ix].iov_len = x->size;
+    }
+    for (i = 0; i < r; i++) {
+	if (total + c->iov[i].iov_len < total) {
+	    return 0;
+	}
+	total += c->iov[i].iov_len;
+    }
+    if (! (bin = driver_alloc_binary(total))) {
+	return 0;
+    }
+    for (i = 0, total = 0; i < r; i++) {
+	c->iov[i].iov_base = bin->orig_bytes + total;
+	total += c->iov[i].iov_len;
+    }
+    for (i = 0; i < n; i++) {
+	struct t_preadv_range *x = &ranges[i];
+	unsigned k = c->run[x->ix - 1];
+	ev->iov[x->ix].iov_base = (char *) c->iov[k].iov_base
+	    + (x->offset - c->offsets[k]);
+	ev->binv[x->ix] = bin;
+	if (i > 0) {
+	    driver_binary_inc_refc(bin);
+	}
+    }
+    c->n = r;
+    return !0;
+}
+
 static void free_preadv(void *data) {
     struct t_data *d = data;
     int            i;
@@ -1344,6 +1576,7 @@ static void invoke_ipread(void *data)
     ev->vsize = 2;
     ev->iov[1].iov_len = size;
     ev->iov[1].iov_base = ev->binv[1]->orig_bytes;
+    c->iov = &ev->iov[1];
     /* Read data block */
     d->invoke = invoke_preadv;
     invoke_preadv(data);
@@ -1718,6 +1951,84 @@ static void invoke_readdir(void *data)
     d->result_ok = (d->errInfo.posix_errno == 0);
 }
 
+/*
+ * Fills one FILE_RESP_LFINFO chunk with directory entries and their file
+ * information. Format of each entry, names are relative to the listed
+ * directory:
+ * ---------------------------------------------
+ * | Len     | Name      | File information    |
+ * | 2 bytes | Len bytes | FILE_INFO_SIZE bytes |
+ * ---------------------------------------------
+ * Directories are entered depth first, after their own entry, as long
+ * as the depth limit allows. The walk continues in a new invocation
+ * (d->again) once the chunk has been sent.
+ */
+static void invoke_readdir_info(void *data)
+{
+    struct t_data *d = (struct t_data *) data;
+    struct t_readdir_info *w = d->c.readdir_info;
+    size_t n = 1;
+
+    d->errInfo.posix_errno = 0;
+    d->result_ok = 1;
+
+    while (w->level >= 0
+	   && READDIR_INFO_BUFSIZE - n >= READDIR_INFO_ENTRY_MAX) {
+	struct t_readdir_info_dir *dir = &w->dirs[w->level];
+	char *p = w->buf + n + 2;
+	size_t prefix = 0, name_bs;
+	Efile_info info;
+
+	if (dir->len >= w->rel) {
+	    prefix = dir->len - w->rel;
+	    memcpy(p, w->path + w->rel, prefix);
+	    FILENAME_PUTC(p + prefix, '/');
+	    prefix += FILENAME_CHARSIZE;
+	}
+	name_bs = READDIR_INFO_BUFSIZE - n - 2 - prefix - FILE_INFO_SIZE;
+	if (! efile_readdir_info(&d->errInfo, w->path, &dir->handle,
+				 p + prefix, &name_bs, &info)) {
+	    /* The directory has been closed */
+	    dir->handle = NULL;
+	    if (d->errInfo.posix_errno != 0) {
+		if (w->level == 0) {
+		    d->result_ok = 0;
+		    w->level = -1;
+		    break;
+		}
+		/* Unreadable directories below the top are left out */
+		d->errInfo.posix_errno = 0;
+	    }
+	    if (--w->level >= 0) {
+		FILENAME_PUTC(w->path + w->dirs[w->level].len, '\0');
+	    }
+	    continue;
+	}
+
+	put_int16((Uint16) (prefix + name_bs), w->buf + n);
+	put_info(p + prefix + name_bs, &info);
+	n += 2 + prefix + name_bs + FILE_INFO_SIZE;
+
+	if (info.type == FT_DIRECTORY
+	    && (w->depth < 0 || w->level < w->depth)
+	    && w->level + 1 < w->max_levels
+	    && (dir->len + FILENAME_CHARSIZE + name_bs
+		< MAXPATHLEN*FILENAME_CHARSIZE)) {
+	    struct t_readdir_info_dir *sub = dir + 1;
+
+	    FILENAME_PUTC(w->path + dir->len, '/');
+	    memcpy(w->path + dir->len + FILENAME_CHARSIZE, p + prefix, name_bs);
+	    sub->len = dir->len + FILENAME_CHARSIZE + name_bs;
+	    FILENAME_PUTC(w->path + sub->len, '\0');
+	    sub->handle = NULL;
+	    w->level++;
+	}
+    }
+
+    w->n = n;
+    d->again = d->result_ok && w->level >= 0;
+}
+
 static void invoke_open(void *data)
 {
     struct t_data *d = (struct t_data *) data;
@@ -1829,6 +2140,21 @@ static void file_stop_select(ErlDrvEvent event, void* _)
 #endif /* HAVE_SENDFILE */
 
 
+static void free_readdir_info(void *data)
+{
+    struct t_data *d = (struct t_data *) data;
+    struct t_readdir_info *w = d->c.readdir_info;
+    int i;
+
+    for (i = 0; i <= w->level; i++) {
+	if (w->dirs[i].handle) {
+	    efile_closedir(w->dirs[i].handle);
+	}
+    }
+    EF_FREE(w);
+    EF_FREE(d);
+}
+
 static void free_readdir(void *data)
 {
     struct t_data *d = (struct t_data *) data;
@@ -1871,6 +2197,10 @@ static int try_again(file_descriptor *desc, struct t_data *d) {
 	driver_deq(d->c.pwritev.port, d->c.pwritev.free_size);
 	MUTEX_UNLOCK(d->c.writev.q_mtx);
 	break;
+    case FILE_READDIR_INFO:
+	/* Pass on what is done so far */
+	reply_readdir_info(desc, d);
+	break;
     }
     if (desc->timer_state != timer_idle) {
 	driver_cancel_timer(desc->port);
@@ -1885,6 +2215,330 @@ static int try_again(file_descriptor *desc, struct t_data *d) {
 
 
 
+#if ERTS_HAVE_IO_URING
+
+/*
+ * Reads, writes, positioned reads and syncs of plain files are handed
+ * to the kernel through an io_uring owned by the port instead of going
+ * through an async thread. Page cache hits usually complete while being
+ * submitted and are replied to at once; the rest are picked up when the
+ * ring fd becomes readable. Commands still run one at a time, exactly
+ * as on the async thread path.
+ */
+
+#define FILE_RING_ENTRIES 32
+#define FILE_RING_MAXIOV  1024		/* UIO_MAXIOV */
+#define FILE_RING_MAXRW   0x7ffff000	/* Largest single read() on Linux */
+
+static void ring_reap(file_descriptor *desc, int stopping);
+
+static int ring_setup(file_descriptor *desc) {
+    ErtsURing *ring;
+    int err;
+
+    if (! (ring = EF_ALLOC(sizeof(ErtsURing)))) {
+	return 0;
+    }
+    if ( (err = erts_uring_init(ring, FILE_RING_ENTRIES, 0)) != 0) {
+	EF_FREE(ring);
+	if (err != EMFILE && err != ENFILE && err != ENOMEM) {
+	    use_ring = 0; /* Not available here, do not try again */
+	}
+	return 0;
+    }
+    desc->ring = ring;
+    driver_select(desc->port, (ErlDrvEvent)(long) ring->fd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+    return !0;
+}
+
+static void ring_submit_write(file_descriptor *desc, struct t_data *d) {
+    struct io_uring_sqe *sqe = erts_uring_get_sqe(desc->ring);
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = (int) d->fd;
+    sqe->off = (__u64) -1; /* At the file position */
+    sqe->addr = (__u64) (UWord) desc->ring_iov;
+    sqe->len = (desc->ring_iovcnt < FILE_RING_MAXIOV
+		? desc->ring_iovcnt : FILE_RING_MAXIOV);
+}
+
+/* Same bookkeeping as efile_writev() after a partial write */
+static int ring_advance_write(file_descriptor *desc, size_t w) {
+    while (desc->ring_iovcnt > 0 && w >= desc->ring_iov[0].iov_len) {
+	w -= desc->ring_iov[0].iov_len;
+	desc->ring_iov++;
+	desc->ring_iovcnt--;
+    }
+    if (desc->ring_iovcnt > 0) {
+	desc->ring_iov[0].iov_base = (char *) desc->ring_iov[0].iov_base + w;
+	desc->ring_iov[0].iov_len -= w;
+    }
+    return desc->ring_iovcnt > 0;
+}
+
+static int ring_execute(file_descriptor *desc, struct t_data *d) {
+    struct io_uring_sqe *sqe;
+    SysIOVec *iov0;
+    SysIOVec *iov = NULL;
+    int iovlen, iovcnt = 0;
+    size_t p;
+    unsigned i;
+
+    if (! use_ring
+	|| thread_short_circuit >= d->level
+	|| (d->flags & EFILE_COMPRESSED)) {
+	return 0;
+    }
+    switch (d->command) {
+    case FILE_READ:
+    case FILE_FSYNC:
+    case FILE_FDATASYNC:
+	break;
+    case FILE_PREADV:
+	if (d->c.preadv.n > FILE_RING_ENTRIES) {
+	    return 0;
+	}
+	break;
+    case FILE_WRITE:
+	/* Copy the io vector, see invoke_writev() */
+	MUTEX_LOCK(d->c.writev.q_mtx);
+	iov0 = driver_peekq(d->c.writev.port, &iovlen);
+	for (p = 0, iovcnt = 0;
+	     p < d->c.writev.size && iovcnt < iovlen;
+	     p += iov0[iovcnt++].iov_len)
+	    ;
+	if (iovcnt == 0 || p < d->c.writev.size) {
+	    /* Nothing to write or port terminated, let the thread
+	     * path sort it out */
+	    MUTEX_UNLOCK(d->c.writev.q_mtx);
+	    return 0;
+	}
+	iov = EF_SAFE_ALLOC(sizeof(SysIOVec)*iovcnt);
+	memcpy(iov, iov0, iovcnt*sizeof(SysIOVec));
+	MUTEX_UNLOCK(d->c.writev.q_mtx);
+	iov[iovcnt-1].iov_len -= p - d->c.writev.size;
+	break;
+    default:
+	return 0;
+    }
+    if (! desc->ring && ! ring_setup(desc)) {
+	EF_FREE(iov);
+	return 0;
+    }
+
+    d->again = 0;
+    d->result_ok = !0;
+    desc->ring_wait = 1;
+    switch (d->command) {
+    case FILE_READ:
+	sqe = erts_uring_get_sqe(desc->ring);
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = (int) d->fd;
+	sqe->off = (__u64) -1;
+	sqe->addr = (__u64) (UWord) (d->c.read.binp->orig_bytes 
+				     + d->c.read.bin_offset);
+	sqe->len = (d->c.read.bin_size < FILE_RING_MAXRW
+		    ? d->c.read.bin_size : FILE_RING_MAXRW);
+	break;
+    case FILE_PREADV: {
+	struct t_preadv *c = &d->c.preadv;
+	desc->ring_wait = c->n;
+	for (i = 0; i < c->n; i++) {
+	    sqe = erts_uring_get_sqe(desc->ring);
+	    sqe->opcode = IORING_OP_READ;
+	    sqe->fd = (int) d->fd;
+	    sqe->off = (__u64) c->offsets[i];
+	    sqe->addr = (__u64) (UWord) c->iov[i].iov_base;
+	    sqe->len = (c->iov[i].iov_len < FILE_RING_MAXRW
+			? c->iov[i].iov_len : FILE_RING_MAXRW);
+	    sqe->user_data = i;
+	}
+    } break;
+    case FILE_WRITE:
+	desc->ring_iov = iov;
+	desc->ring_iovcnt = iovcnt;
+	ring_submit_write(desc, d);
+	break;
+    default: /* FILE_FSYNC, FILE_FDATASYNC */
+	sqe = erts_uring_get_sqe(desc->ring);
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = (int) d->fd;
+	if (d->command == FILE_FDATASYNC) {
+	    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	}
+	break;
+    }
+    desc->ring_d = d;
+    if (erts_uring_enter(desc->ring, 0, -1) != 0) {
+	/* Could not submit; nothing reached the kernel */
+	erts_uring_discard(desc->ring);
+	desc->ring_d = NULL;
+	desc->ring_wait = 0;
+	desc->ring_iov = NULL;
+	EF_FREE(iov);
+	return 0;
+    }
+    if (iov) {
+	/* ring_advance_write() moves ring_iov; remember what to free */
+	d->c.writev.ring_iov = iov;
+    }
+    ring_reap(desc, 0);
+    return !0;
+}
+
+/* Returns !0 if the command needs to be submitted again */
+static int ring_complete(file_descriptor *desc, struct t_data *d,
+			 Uint64 ix, int res) {
+    if (res < 0) {
+	if (d->result_ok) {
+	    d->result_ok = 0;
+	    d->errInfo.posix_errno = d->errInfo.os_errno = -res;
+	}
+	return 0;
+    }
+    switch (d->command) {
+    case FILE_READ:
+	d->c.read.bin_offset += res;
+	d->c.read.bin_size = 0;
+	break;
+    case FILE_PREADV: {
+	struct t_preadv *c = &d->c.preadv;
+	c->iov[ix].iov_len = res;
+	if (! c->run) {
+	    c->eiov.size += res;
+	    put_int64((Uint64) res,
+		      (char *) c->eiov.iov[0].iov_base + 4+4+8*ix);
+	}
+	c->cnt++;
+    } break;
+    case FILE_WRITE:
+	if (ring_advance_write(desc, (size_t) res)) {
+	    ring_submit_write(desc, d);
+	    return !0;
+	}
+	d->c.writev.free_size = d->c.writev.size;
+	d->c.writev.size = 0;
+	break;
+    }
+    return 0;
+}
+
+/*
+ * Handle the completions that are there. When stopping, a finished
+ * command is only freed, and a partial write is not gone on with
+ * since there is nobody left to tell.
+ */
+static void ring_reap(file_descriptor *desc, int stopping) {
+    struct io_uring_cqe *cqe;
+    struct t_data *d;
+    while ( (d = desc->ring_d) != NULL) {
+	Uint64 ix;
+	int res;
+	if (! (cqe = erts_uring_peek_cqe(desc->ring))) {
+	    return;
+	}
+	ix = cqe->user_data;
+	res = cqe->res;
+	erts_uring_cqe_seen(desc->ring);
+	if (ring_complete(desc, d, ix, res)) {
+	    if (! stopping && erts_uring_enter(desc->ring, 0, -1) == 0) {
+		continue;
+	    }
+	    erts_uring_discard(desc->ring);
+	    d->result_ok = 0;
+	    d->errInfo.posix_errno = d->errInfo.os_errno = EIO;
+	}
+	if (--desc->ring_wait > 0) {
+	    continue;
+	}
+	desc->ring_d = NULL;
+	if (d->command == FILE_WRITE) {
+	    EF_FREE(d->c.writev.ring_iov);
+	    desc->ring_iov = NULL;
+	    desc->ring_iovcnt = 0;
+	}
+	if (stopping) {
+	    (*d->free)(d);
+	} else {
+	    file_async_ready((ErlDrvData) desc, (ErlDrvThreadData) d);
+	}
+    }
+}
+
+static void file_ready_input(ErlDrvData data, ErlDrvEvent event) {
+    ring_reap((file_descriptor *) data, 0);
+}
+
+/*
+ * A command still on the ring of a stopped port can not be freed while
+ * the kernel may be using its buffers, and the port must not wait for
+ * it on a scheduler. An async thread gets the ring and the command,
+ * waits for the rest of the completions and frees them both.
+ */
+struct t_ring_orphan {
+    ErtsURing     *ring;
+    struct t_data *d;
+    unsigned       wait;	/* Completions still to come for d */
+};
+
+static void invoke_ring_orphan(void *data) {
+    struct t_ring_orphan *o = (struct t_ring_orphan *) data;
+    while (o->wait > 0) {
+	if (! erts_uring_peek_cqe(o->ring)) {
+	    if (erts_uring_enter(o->ring, 1, -1) != 0 && errno != EINTR) {
+		return;
+	    }
+	    continue;
+	}
+	erts_uring_cqe_seen(o->ring);
+	o->wait--;
+    }
+}
+
+static void free_ring_orphan(void *data) {
+    struct t_ring_orphan *o = (struct t_ring_orphan *) data;
+    /* If we could not wait it out, leak the command rather than free
+     * buffers the kernel may still write to */
+    if (o->wait == 0) {
+	if (o->d->command == FILE_WRITE) {
+	    EF_FREE(o->d->c.writev.ring_iov);
+	}
+	(*o->d->free)(o->d);
+    }
+    erts_uring_exit(o->ring);
+    EF_FREE(o->ring);
+    EF_FREE(o);
+}
+
+static void ring_exit(file_descriptor *desc) {
+    struct t_ring_orphan *o;
+    ring_reap(desc, !0);
+    driver_select(desc->port, (ErlDrvEvent)(long) desc->ring->fd,
+		  ERL_DRV_READ|ERL_DRV_USE_NO_CALLBACK, 0);
+    if (! desc->ring_d) {
+	erts_uring_exit(desc->ring);
+	EF_FREE(desc->ring);
+    } else {
+	o = EF_SAFE_ALLOC(sizeof(struct t_ring_orphan));
+	o->ring = desc->ring;
+	o->d = desc->ring_d;
+	o->wait = desc->ring_wait;
+	desc->ring_d = NULL;
+	if (sys_info.async_threads > 0) {
+	    /* The port is gone when it is done, so only free is called */
+	    driver_async(desc->port, KEY(desc),
+			 invoke_ring_orphan, (void *) o, free_ring_orphan);
+	} else {
+	    /* Without async threads every command blocks like this */
+	    invoke_ring_orphan((void *) o);
+	    free_ring_orphan((void *) o);
+	}
+    }
+    desc->ring = NULL;
+}
+
+#endif /* ERTS_HAVE_IO_URING */
+
 static void cq_execute(file_descriptor *desc) {
     struct t_data *d;
     register void *void_ptr; /* Soft cast variable */
@@ -1893,11 +2547,22 @@ static void cq_execute(file_descriptor *desc) {
 #ifdef HAVE_SENDFILE
     if (desc->sendfile_state == sending)
 	return;
+#endif
+#if ERTS_HAVE_IO_URING
+    if (desc->ring_d)
+	return;
 #endif
     if (! (d = cq_deq(desc)))
 	return;
     TRACE_F(("x%i", (int) d->command));
     d->again = sys_info.async_threads == 0;
+#if ERTS_HAVE_IO_URING
+    /* Commands already queued for the async thread must finish first,
+     * the ring would not wait for them */
+    if (desc->async_jobs == 0 && ring_execute(desc, d))
+	return;
+    desc->async_jobs++;
+#endif
     DRIVER_ASYNC(d->level, desc, d->invoke, void_ptr=d, d->free);
 }
 
@@ -2021,6 +2686,12 @@ file_async_ready(ErlDrvData e, ErlDrvThreadData data)
     if (try_again(desc, d)) {
 	return;
     }
+#if ERTS_HAVE_IO_URING
+    /* Ring commands only run when no async jobs are out */
+    if (desc->async_jobs > 0) {
+	desc->async_jobs--;
+    }
+#endif
 
     switch (d->command)
     {
@@ -2159,29 +2830,9 @@ file_async_ready(ErlDrvData e, ErlDrvThreadData data)
         {
 	    if (d->result_ok) {
 		resbuf[0] = FILE_RESP_INFO;
-
-		put_int32(d->info.size_high,         &resbuf[1 + ( 0 * 4)]);
-		put_int32(d->info.size_low,          &resbuf[1 + ( 1 * 4)]);
-		put_int32(d->info.type,              &resbuf[1 + ( 2 * 4)]);
-
-		/* Note 64 bit indexing in resbuf here */
-		put_int64(d->info.accessTime,        &resbuf[1 + ( 3 * 4)]);
-		put_int64(d->info.modifyTime,        &resbuf[1 + ( 5 * 4)]);
-		put_int64(d->info.cTime,             &resbuf[1 + ( 7 * 4)]);
-
-		put_int32(d->info.mode,              &resbuf[1 + ( 9 * 4)]);
-		put_int32(d->info.links,             &resbuf[1 + (10 * 4)]);
-		put_int32(d->info.major_device,      &resbuf[1 + (11 * 4)]);
-		put_int32(d->info.minor_device,      &resbuf[1 + (12 * 4)]);
-		put_int32(d->info.inode,             &resbuf[1 + (13 * 4)]);
-		put_int32(d->info.uid,               &resbuf[1 + (14 * 4)]);
-		put_int32(d->info.gid,               &resbuf[1 + (15 * 4)]);
-		put_int32(d->info.access,            &resbuf[1 + (16 * 4)]);
-
-#define RESULT_SIZE (1 + (17 * 4))
+		put_info(&resbuf[1], &d->info);
 		TRACE_C('R');
-		driver_output2(desc->port, resbuf, RESULT_SIZE, NULL, 0);
-#undef RESULT_SIZE
+		driver_output2(desc->port, resbuf, 1 + FILE_INFO_SIZE, NULL, 0);
 	    } else
 		reply_error(desc, &d->errInfo);
 	}
@@ -2211,6 +2862,18 @@ file_async_ready(ErlDrvData e, ErlDrvThreadData data)
 	}
 	free_readdir(data);
 	break;
+      case FILE_READDIR_INFO:
+	if (!d->result_ok) {
+	    reply_error(desc, &d->errInfo);
+	} else {
+	    char op = FILE_RESP_LFINFO;
+
+	    TRACE_C('R');
+	    reply_readdir_info(desc, d);
+	    driver_output2(desc->port, &op, 1, NULL, 0);
+	}
+	free_readdir_info(data);
+	break;
 	/* See file_stop */
       case FILE_CLOSE:
 	  if (d->reply) {
@@ -2231,6 +2894,9 @@ file_async_ready(ErlDrvData e, ErlDrvThreadData data)
 	  if (!d->result_ok) {
 	      reply_error(desc, &d->errInfo);
 	  } else {
+	      if (d->c.preadv.run) {
+		  preadv_split(&d->c.preadv);
+	      }
 	      reply_ev(desc, FILE_RESP_LDATA, &d->c.preadv.eiov);
 	  }
 	  free_preadv(data);
@@ -2460,6 +3126,47 @@ file_output(ErlDrvData e, char* buf, ErlDrvSizeT count)
 	    driver_output2(desc->port, resbuf, 1, NULL, 0);
 	    return;
 	}
+    case FILE_READDIR_INFO:
+	{
+	    struct t_readdir_info *w;
+	    int depth = (int) get_int32((uchar*)buf);
+	    int max_levels;
+	    size_t len;
+
+	    name = buf+4;
+	    len = FILENAME_BYTELEN(name);
+	    if (len >= MAXPATHLEN*FILENAME_CHARSIZE) {
+		reply_posix_error(desc, ENAMETOOLONG);
+		return;
+	    }
+	    /* Every level adds at least two characters to the path */
+	    max_levels = MAXPATHLEN/2 + 1;
+	    if (depth >= 0 && depth < max_levels) {
+		max_levels = depth + 1;
+	    }
+	    d = EF_SAFE_ALLOC(sizeof(struct t_data));
+	    w = EF_SAFE_ALLOC(sizeof(struct t_readdir_info)
+			      + (max_levels - 1)*sizeof(struct t_readdir_info_dir)
+			      + (MAXPATHLEN+1)*FILENAME_CHARSIZE
+			      + READDIR_INFO_BUFSIZE);
+	    w->path = (char *) &w->dirs[max_levels];
+	    w->buf = w->path + (MAXPATHLEN+1)*FILENAME_CHARSIZE;
+	    w->buf[0] = FILE_RESP_LFINFO;
+	    w->n = 1;
+	    FILENAME_COPY(w->path, name);
+	    w->rel = len + FILENAME_CHARSIZE;
+	    w->depth = depth;
+	    w->level = 0;
+	    w->max_levels = max_levels;
+	    w->dirs[0].handle = NULL;
+	    w->dirs[0].len = len;
+	    d->c.readdir_info = w;
+	    d->command = command;
+	    d->invoke = invoke_readdir_info;
+	    d->free = free_readdir_info;
+	    d->level = 2;
+	    goto done;
+	}
     case FILE_OPEN:
 	{
 	    d = EF_SAFE_ALLOC(sizeof(struct t_data) - 1 + FILENAME_BYTELEN(buf+4) + 
@@ -3123,9 +3830,12 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 
     case FILE_PREADV: {
 	register void * void_ptr;
-	Uint32 i, n;
+	Uint32 i, n, flags;
 	struct t_data *d;
+	struct t_preadv *c;
+	struct t_preadv_range *ranges = NULL;
 	ErlIOVec *res_ev;
+	int batch;
 	if (lseek_flush_read(desc, &err) < 0) {
 	    reply_posix_error(desc, err);
 	    goto done;
@@ -3135,7 +3845,7 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 	    goto done;
 	}
 	if (ev->size < 1+8
-	    || !EV_GET_UINT32(ev, &n, &p, &q)
+	    || !EV_GET_UINT32(ev, &flags, &p, &q)
 	    || !EV_GET_UINT32(ev, &n, &p, &q)) {
 	    /* Buffer too short to contain even the number of pos/size specs */
 	    reply_posix_error(desc, EINVAL);
@@ -3146,13 +3856,23 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 	    reply_posix_error(desc, EINVAL);
 	    goto done;
 	}
+	batch = (flags & FILE_PREADV_BATCH) && n > 1;
 	/* Create the thread data structure with the contained ErlIOVec 
 	 * and corresponding binaries for the response 
 	 */
 	d = EF_ALLOC(sizeof(*d)
 		     + (n * sizeof(*d->c.preadv.offsets))
 		     + ((1+n) * (sizeof(*res_ev->iov)
-				 + sizeof(*res_ev->binv))));
+				 + sizeof(*res_ev->binv)))
+		     + (batch ? n * (sizeof(*d->c.preadv.iov)
+				     + sizeof(*d->c.preadv.run)) : 0));
+	if (batch && d) {
+	    ranges = EF_ALLOC(n * sizeof(*ranges));
+	    if (! ranges) {
+		EF_FREE(d);
+		d = NULL;
+	    }
+	}
 	if (! d) {
 	    reply_posix_error(desc, ENOMEM);
 	    goto done;
@@ -3161,19 +3881,30 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 	d->reply = !0;
 	d->fd = desc->fd;
 	d->flags = desc->flags;
-	d->c.preadv.n = n;
-	d->c.preadv.cnt = 0;
-	d->c.preadv.size = 0;
-	res_ev = &d->c.preadv.eiov;
+	c = &d->c.preadv;
+	c->n = n;
+	c->cnt = 0;
+	c->size = 0;
+	res_ev = &c->eiov;
 	/* XXX possible alignment problems here for weird machines */
-	res_ev->vsize = 1+d->c.preadv.n;
-	res_ev->iov = void_ptr = &d->c.preadv.offsets[d->c.preadv.n];
-	res_ev->binv = void_ptr = &res_ev->iov[res_ev->vsize];
+	c->offsets = void_ptr = d + 1;
+	res_ev->vsize = 1+n;
+	res_ev->iov = void_ptr = c->offsets + n;
+	c->iov = res_ev->iov + 1;
+	c->run = NULL;
+	if (batch) {
+	    c->iov = res_ev->iov + res_ev->vsize;
+	    res_ev->binv = void_ptr = c->iov + n;
+	    c->run = void_ptr = res_ev->binv + res_ev->vsize;
+	} else {
+	    res_ev->binv = void_ptr = res_ev->iov + res_ev->vsize;
+	}
 	/* Read in the pos/size specs and allocate binaries for the results */
 	for (i = 1; i < 1+n; i++) {
+	    Sint64 offset;
 	    Uint32 sizeH, sizeL;
 	    size_t size;
-	    if (   !EV_GET_UINT64(ev, &d->c.preadv.offsets[i-1], &p, &q)
+	    if (   !EV_GET_UINT64(ev, &offset, &p, &q)
 		|| !EV_GET_UINT32(ev, &sizeH, &p, &q)
 		|| !EV_GET_UINT32(ev, &sizeL, &p, &q)) {
 		reply_posix_error(desc, EINVAL);
@@ -3188,17 +3919,36 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 #else
 	    size = ((size_t)sizeH<<32) | sizeL;
 #endif
-	    if (! (res_ev->binv[i] = driver_alloc_binary(size))) {
+	    if (batch) {
+		if (offset < 0) {
+		    /* pread() would fail, and we add to offsets below */
+		    reply_posix_error(desc, EINVAL);
+		    break;
+		}
+		ranges[i-1].offset = offset;
+		ranges[i-1].size = size;
+		ranges[i-1].ix = i;
+	    } else if (! (res_ev->binv[i] = driver_alloc_binary(size))) {
 		reply_posix_error(desc, ENOMEM);
 		break;
 	    } else {
+		c->offsets[i-1] = offset;
 		res_ev->iov[i].iov_len  = size;
 		res_ev->iov[i].iov_base = res_ev->binv[i]->orig_bytes;
 	    }
 	}
+	if (batch && i == 1+n) {
+	    if (! preadv_coalesce(c, ranges)) {
+		reply_posix_error(desc, ENOMEM);
+		i = 1;
+	    }
+	}
+	EF_FREE(ranges);
 	if (i < 1+n) {
-	    for (i--; i > 0; i--) {
-		driver_free_binary(res_ev->binv[i]);
+	    if (! batch) {
+		for (i--; i > 0; i--) {
+		    driver_free_binary(res_ev->binv[i]);
+		}
 	    }
 	    EF_FREE(d);
 	    goto done;
@@ -3257,7 +4007,8 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 	}
     } goto done;
 
-    case FILE_READ_FILE: {
+    case FILE_READ_FILE:
+    case FILE_READ_FILE_MMAP: {
 	struct t_data *d;
 	char *filename;
 	if (ev->size < 1+1) {
@@ -3276,11 +4027,12 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 	    reply_posix_error(desc, ENOMEM);
 	    goto done;
 	}
-	d->command = command;
+	d->command = FILE_READ_FILE;
 	d->reply = !0;
 	/* Copy name */
 	FILENAME_COPY(d->b, filename);
 	d->c.read_file.binp = NULL;
+	d->c.read_file.mmap = command == FILE_READ_FILE_MMAP;
 	d->invoke = invoke_read_file;
 	d->free = free_read_file;
 	d->level = 2;
@@ -3331,7 +4083,7 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 	 * and corresponding binaries for the response 
 	 */
 	vsize = 2;
-	d = EF_ALLOC(sizeof(*d) + 
+	d = EF_ALLOC(sizeof(*d) + sizeof(*d->c.preadv.offsets) +
 		     vsize*(sizeof(*res_ev->iov) + sizeof(*res_ev->binv)));
 	if (! d) {
 	    reply_posix_error(desc, ENOMEM);
@@ -3341,11 +4093,13 @@ file_outputv(ErlDrvData e, ErlIOVec *ev) {
 	d->reply = !0;
 	d->fd = desc->fd;
 	d->flags = desc->flags;
+	d->c.preadv.offsets = void_ptr = d + 1;
 	d->c.preadv.offsets[0] = hdr_offset;
 	d->c.preadv.size = max_size;
+	d->c.preadv.run = NULL;
 	res_ev = &d->c.preadv.eiov;
 	/* XXX possible alignment problems here for weird machines */
-	res_ev->iov = void_ptr = d + 1;
+	res_ev->iov = void_ptr = d->c.preadv.offsets + 1;
 	res_ev->binv = void_ptr = res_ev->iov + vsize;
 	res_ev->size = 0;
 	res_ev->vsize = 0;
@@ -151,6 +151,10 @@ int efile_getdcwd(Efile_error* errInfo, int drive,
 int efile_readdir(Efile_error* errInfo, char* name, 
 		  EFILE_DIR_HANDLE* dir_handle,
 		  char* buffer, size_t *size);
+int efile_readdir_info(Efile_error* errInfo, char* name,
+		       EFILE_DIR_HANDLE* dir_handle,
+		       char* buffer, size_t *size, Efile_info* pInfo);
+void efile_closedir(EFILE_DIR_HANDLE dir_handle);
 int efile_openfile(Efile_error* errInfo, char* name, int flags,
 		   int* pfd, Sint64* pSize);
 void efile_closefile(int fd);
@@ -312,6 +312,23 @@ static unsigned long one_value = 1;
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 
+#ifdef HAVE_SPLICE
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_LINUX_TLS_H
+#include <linux/tls.h>
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TLS_GET_RECORD_TYPE
+#define TLS_GET_RECORD_TYPE 2
+#endif
+#endif
+
 #if (!defined(VXWORKS))
 #include <sys/param.h>
 #ifdef HAVE_ARPA_NAMESER_H
@@ -546,6 +563,16 @@ static int my_strncasecmp(const char *s1, const char *s2, size_t n)
 			     (((unsigned char*) (s))[1] << 8) | \
 			     (((unsigned char*) (s))[0]))
 
+#define put_little_int16(i, s) do {((char*)(s))[1] = (char)((i) >> 8) & 0xff; \
+                                   ((char*)(s))[0] = (char)(i)        & 0xff;} \
+                               while (0)
+
+#define put_little_int32(i, s) do {((char*)(s))[3] = (char)((i) >> 24) & 0xff; \
+                                   ((char*)(s))[2] = (char)((i) >> 16) & 0xff; \
+                                   ((char*)(s))[1] = (char)((i) >> 8)  & 0xff; \
+                                   ((char*)(s))[0] = (char)(i)         & 0xff;} \
+                               while (0)
+
 
 #ifdef VALGRIND
 #  include <valgrind/memcheck.h>   
@@ -632,11 +659,15 @@ static int my_strncasecmp(const char *s1, const char *s2, size_t n)
 #define TCP_REQ_RECV           42
 #define TCP_REQ_UNRECV         43
 #define TCP_REQ_SHUTDOWN       44
+#define TCP_REQ_TLS_OFFLOAD    45 /* Hand the record layer to the kernel */
+#define TCP_REQ_SPLICE         46 /* Move data from another socket in-kernel */
+#define TCP_REQ_TAKE_INPUT     47 /* Hand out undelivered buffered input */
 /* UDP and SCTP requests */
 #define PACKET_REQ_RECV        60 /* Common for UDP and SCTP         */
 /* #define SCTP_REQ_LISTEN       61 MERGED Different from TCP; not for UDP */
 #define SCTP_REQ_BINDX	       62 /* Multi-home SCTP bind            */
 #define SCTP_REQ_PEELOFF       63
+#define UDP_REQ_SENDMULTI      64 /* Send a number of datagrams       */
 
 /* INET_REQ_SUBSCRIBE sub-requests */
 #define INET_SUBS_EMPTY_OUT_Q  1
@@ -646,6 +677,17 @@ static int my_strncasecmp(const char *s1, const char *s2, size_t n)
 #define TCP_ADDF_CLOSE_SENT    2 /* Close sent (active mode only) */
 #define TCP_ADDF_DELAYED_CLOSE_RECV 4 /* If receive fails, report {error,closed} (passive mode) */
 #define TCP_ADDF_DELAYED_CLOSE_SEND 8 /* If send fails, report {error,closed} (passive mode) */
+#define TCP_ADDF_ADAPTIVE_BUFFER 16 /* Size input buffer from reads, deliver sub-binaries */
+#define TCP_ADDF_TLS_TX         32 /* Kernel encrypts outgoing TLS records */
+#define TCP_ADDF_TLS_RX         64 /* Kernel decrypts incoming TLS records */
+
+/* TCP_REQ_TLS_OFFLOAD direction and cipher codes */
+#define TCP_TLS_TX              1
+#define TCP_TLS_RX              2
+#define TCP_TLS_AES_128_GCM     1
+#define TCP_TLS_AES_256_GCM     2
+#define TCP_TLS_MAX_RECORD      16384 /* max plaintext of one record */
+#define TCP_TLS_RECORD_DATA     23    /* application_data */
 
 /* *_REQ_* replies */
 #define INET_REP_ERROR       0
@@ -686,6 +728,13 @@ static int my_strncasecmp(const char *s1, const char *s2, size_t n)
 #define INET_LOPT_UDP_READ_PACKETS 33  /* Number of packets to read */
 #define INET_OPT_RAW               34  /* Raw socket options */
 #define INET_LOPT_TCP_SEND_TIMEOUT_CLOSE 35  /* auto-close on send timeout or not */
+#define INET_LOPT_TCP_MULTI_ACCEPT 36  /* connections to accept per event */
+#define INET_OPT_REUSEPORT         37  /* enable/disable local port sharing */
+#define INET_LOPT_UDP_RECV_BATCH   38  /* datagrams per batched message */
+#define INET_LOPT_TCP_ADAPTIVE_BUFFER 39  /* learn input buffer size */
+#define INET_LOPT_TCP_LATENCY_STATS 40  /* keep latency histograms */
+#define INET_LOPT_TCP_DELAY_SEND_BYTES 41  /* write delayed output at size */
+#define INET_LOPT_TCP_DELAY_SEND_TIME  42  /* hold delayed output this long */
 /* SCTP options: a separate range, from 100: */
 #define SCTP_OPT_RTOINFO		100
 #define SCTP_OPT_ASSOCINFO		101
@@ -731,6 +780,9 @@ static int my_strncasecmp(const char *s1, const char *s2, size_t n)
 #define INET_STAT_SEND_PND   8
 #define INET_STAT_RECV_OCT   9      /* received octets */ 
 #define INET_STAT_SEND_OCT   10     /* sent octets */
+#define INET_STAT_SEND_DWELL 11     /* histogram: time in output queue */
+#define INET_STAT_RECV_LAT   12     /* histogram: arrival to delivery */
+#define INET_STAT_BUSY_TIME  13     /* histogram: time above high watermark */
 
 /* INET_IFOPT_FLAGS enumeration */
 #define INET_IFF_UP            0x0001
@@ -799,6 +851,8 @@ static int my_strncasecmp(const char *s1, const char *s2, size_t n)
 
 #define INET_DEF_BUFFER     1460        /* default buffer size */
 #define INET_MIN_BUFFER     1           /* internal min buffer */
+#define INET_MAX_ADAPT_BUFFER (256*1024) /* max learned buffer size */
+#define INET_SUBBIN_MIN     64          /* smaller packets are copied */
 
 #define INET_HIGH_WATERMARK (1024*8) /* 8k pending high => busy  */
 #define INET_LOW_WATERMARK  (1024*4) /* 4k pending => allow more */
@@ -809,6 +863,9 @@ static int my_strncasecmp(const char *s1, const char *s2, size_t n)
 
 /* INET_LOPT_UDP_PACKETS */
 #define INET_PACKET_POLL     5   /* maximum number of packets to poll */
+#define INET_PACKET_BATCH 1024   /* maximum number of packets in a batch */
+#define INET_PACKET_BATCH_BYTES (256*1024) /* max receive area of a batch */
+#define INET_PACKET_MAX_SIZE (64*1024)     /* no datagram is larger */
 
 /* Max interface name */
 #define INET_IFNAMSIZ          16
@@ -885,6 +942,13 @@ typedef struct inet_async_multi_op_ {
     struct inet_async_multi_op_ *next;
 } inet_async_multi_op;
 
+/* A connection accepted ahead of an accept request (multi_accept) */
+typedef struct tcp_accepted_ {
+    SOCKET s;
+    inet_address remote;
+    struct tcp_accepted_ *next;
+} tcp_accepted;
+
 
 typedef struct subs_list_ {
   ErlDrvTermData subscriber;
@@ -960,8 +1024,30 @@ typedef struct {
     int is_ignored;             /* if a fd is ignored by the inet_drv.
 				   This flag should be set to true when
 				   the fd is used outside of inet_drv. */
+#ifdef HAVE_SPLICE
+    struct inet_lent* lent;     /* the ignored socket may be spliced from */
+#endif
 } inet_descriptor;
 
+#ifdef HAVE_SPLICE
+/*
+** Sockets lent out by ignoring them.  A splice may only read from a
+** socket found here, so a port can not be made to read some other
+** file; it then works on a dup() of it, so the lender closing its
+** descriptor can not pull the socket from under the splice.
+*/
+typedef struct inet_lent {
+    struct inet_lent* next;
+    int fd;			/* the lender's socket */
+    int spliced;		/* a splice reads from it */
+    int closed;			/* the lender has closed it */
+    int refc;			/* lender and splice */
+} inet_lent;
+
+static ErlDrvMutex* lent_mtx;
+static inet_lent* lent_first;
+#endif
+
 
 
 #define TCP_MAX_PACKET_SIZE 0x4000000  /* 64 M */
@@ -1106,6 +1192,32 @@ static struct erl_drv_entry sctp_inet_driver_entry =
 };
 #endif
 
+/*
+** Latency histograms (latency_stats option).  Bucket 0 counts samples
+** of 0 microseconds, bucket i samples of [2^(i-1), 2^i) microseconds,
+** the last bucket everything longer.
+*/
+#define INET_LAT_BUCKETS 24
+#define INET_LAT_MARKS   64
+
+typedef struct {
+    ErlDrvUInt64 end;           /* queue position after the last byte */
+    ErlDrvUInt64 t;             /* when it was queued */
+} tcp_lat_mark;
+
+typedef struct {
+    Uint32 send_dwell[INET_LAT_BUCKETS];
+    Uint32 recv_lat[INET_LAT_BUCKETS];
+    Uint32 busy_time[INET_LAT_BUCKETS];
+    ErlDrvUInt64 q_in;          /* bytes ever put in the output queue */
+    ErlDrvUInt64 q_out;         /* bytes ever written from it */
+    tcp_lat_mark marks[INET_LAT_MARKS]; /* ring of queued sends */
+    int m_first;
+    int m_len;
+    ErlDrvUInt64 busy_since;    /* when the port went busy, 0 = not busy */
+    ErlDrvUInt64 rx_t;          /* arrival of the oldest undelivered data */
+} tcp_latency;
+
 typedef struct {
     inet_descriptor inet;       /* common data structure (DON'T MOVE) */
     int   high;                 /* high watermark */
@@ -1123,8 +1235,40 @@ typedef struct {
     inet_async_multi_op *multi_first;/* NULL == no multi-accept-queue, op is in ordinary queue */
     inet_async_multi_op *multi_last;
     MultiTimerData *mtd;        /* Timer structures for multiple accept */
+    int   multi_accept;         /* max connections to accept ahead */
+    int   n_accepted;           /* connections in accepted queue */
+    tcp_accepted *acc_first;    /* connections accepted ahead, oldest first */
+    tcp_accepted *acc_last;
+    int   i_adapt;              /* learned input buffer size */
+    int   sp_fd;                /* our dup() of the socket spliced from, or -1 */
+#ifdef HAVE_SPLICE
+    struct inet_lent* sp_lent;  /* where sp_fd came from */
+#endif
+    int   sp_pipe[2];           /* in-kernel buffer between the sockets */
+    ErlDrvSizeT sp_queued;      /* bytes waiting in sp_pipe */
+    ErlDrvUInt64 sp_left;       /* bytes still to move, 0 = until eof */
+    ErlDrvUInt64 sp_done;       /* bytes written to the socket so far */
+    int   sp_bounded;           /* sp_left is a limit */
+    int   sp_id;                /* async id of the splice request */
+    ErlDrvTermData sp_caller;   /* who gets the reply */
+    tcp_latency* lat;           /* latency histograms, or NULL */
+    int   delay_bytes;          /* delay_send: write once this much queued */
+    int   delay_time;           /* delay_send: max ms to hold output */
+    int   delay_timer;          /* the port timer is holding output */
+    int   tls_rx_vsn;           /* record version given at rx offload */
 } tcp_descriptor;
 
+static int tcp_latency_stats(tcp_descriptor* desc, int on);
+static void tcp_lat_queued(tcp_descriptor* desc, ErlDrvSizeT n);
+static void tcp_lat_written(tcp_descriptor* desc, ErlDrvSizeT n);
+static void tcp_lat_clear_output(tcp_descriptor* desc);
+static void tcp_lat_busy(tcp_descriptor* desc, int on);
+static int tcp_lat_recv(tcp_descriptor* desc, char* buf, int len);
+static void tcp_lat_delivered(tcp_descriptor* desc);
+static int tcp_delay_send(tcp_descriptor* desc);
+static void tcp_delay_flush(tcp_descriptor* desc);
+static void tcp_delay_cancel(tcp_descriptor* desc);
+
 /* send function */
 static int tcp_send(tcp_descriptor* desc, char* ptr, ErlDrvSizeT len);
 static int tcp_sendv(tcp_descriptor* desc, ErlIOVec* ev);
@@ -1132,11 +1276,30 @@ static int tcp_recv(tcp_descriptor* desc, int request_len);
 static int tcp_deliver(tcp_descriptor* desc, int len);
 
 static int tcp_inet_output(tcp_descriptor* desc, HANDLE event);
+static int tcp_splice_run(tcp_descriptor* desc);
+static void tcp_splice_done(tcp_descriptor* desc, ErlDrvTermData reason);
 static int tcp_inet_input(tcp_descriptor* desc, HANDLE event);
 
+/* Receive buffers for the recv_batch option, allocated in one chunk */
+typedef struct {
+    int n;                  /* number of datagram slots */
+    int bufsz;              /* size of each slot */
+    inet_address* addr;     /* source addresses */
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr* msg;
+    struct iovec* iov;
+#endif
+    ErlDrvTermData* spec;   /* for the batched message */
+    char* data;             /* n slots of bufsz bytes */
+    unsigned int* alen;     /* address lengths */
+    int* len;               /* datagram lengths */
+} packet_batch;
+
 typedef struct {
     inet_descriptor inet;   /* common data structure (DON'T MOVE) */
     int read_packets;       /* Number of packets to read per invocation */
+    int recv_batch;         /* Max datagrams per batched active message */
+    packet_batch* batch;    /* Receive buffers for recv_batch */
     int i_bufsz;            /* current input buffer size */
     ErlDrvBinary* i_buf;    /* current binary buffer */
     char* i_ptr;            /* current pos in buf */
@@ -1164,6 +1327,7 @@ static ErlDrvTermData am_closed;
 static ErlDrvTermData am_tcp_closed;
 static ErlDrvTermData am_tcp_error;
 static ErlDrvTermData am_udp_error;
+static ErlDrvTermData am_udp_batch;
 static ErlDrvTermData am_empty_out_q;
 static ErlDrvTermData am_ssl_tls;
 #ifdef HAVE_SCTP
@@ -1277,6 +1441,12 @@ static void *realloc_wrapper(void *current, ErlDrvSizeT size){
   ((vec)[(i)+1] = (ErlDrvTermData)(val)), \
   ((i)+LOAD_UINT_CNT))
 
+#define LOAD_UINT64_CNT 2
+#define LOAD_UINT64(vec, i, ptr) \
+  (((vec)[(i)] = ERL_DRV_UINT64), \
+  ((vec)[(i)+1] = (ErlDrvTermData)(ptr)), \
+  ((i)+LOAD_UINT64_CNT))
+
 #define LOAD_PORT_CNT 2
 #define LOAD_PORT(vec, i, port) \
   (((vec)[(i)] = ERL_DRV_PORT), \
@@ -1478,7 +1648,20 @@ static ErlDrvBinary* alloc_buffer(ErlDrvSizeT minsz)
 
     if (bs && bs->buf.pos > 0) {
 	long size;
-	ErlDrvBinary* buf = bs->buf.stk[--bs->buf.pos];
+	int i = bs->buf.pos - 1;
+	ErlDrvBinary* buf;
+
+	/* Adaptive TCP buffers put buffers of different sizes on the
+	 * stack, take the most recently released one that is large
+	 * enough. If none is, the top one is dropped.
+	 */
+	while (i > 0 && bs->buf.stk[i]->orig_size < minsz)
+	    i--;
+	if (bs->buf.stk[i]->orig_size < minsz)
+	    i = bs->buf.pos - 1;
+	buf = bs->buf.stk[i];
+	for (bs->buf.pos--; i < bs->buf.pos; i++)
+	    bs->buf.stk[i] = bs->buf.stk[i+1];
 	size = buf->orig_size;
 	bs->buf.mem_size -= size;
 	ASSERT(0 <= bs->buf.mem_size
@@ -1785,6 +1968,55 @@ static int remove_multi_op(tcp_descriptor *desc, int *id_p, int *req_p,
     return 0;
 }
 
+/*
+** Queue of connections accepted ahead of accept requests. It is only
+** used in INET_STATE_LISTENING, i.e when nobody is waiting in accept.
+*/
+static void enq_accepted(tcp_descriptor *desc, SOCKET s,
+			 inet_address *remote)
+{
+    tcp_accepted *ap = ALLOC(sizeof(tcp_accepted));
+
+    ap->s = s;
+    ap->remote = *remote;
+    ap->next = NULL;
+    if (desc->acc_first == NULL) {
+	desc->acc_first = ap;
+    } else {
+	desc->acc_last->next = ap;
+    }
+    desc->acc_last = ap;
+    desc->n_accepted++;
+}
+
+static SOCKET deq_accepted(tcp_descriptor *desc, inet_address *remote)
+{
+    tcp_accepted *ap = desc->acc_first;
+    SOCKET s;
+
+    if (ap == NULL) {
+	return INVALID_SOCKET;
+    }
+    if ((desc->acc_first = ap->next) == NULL) {
+	desc->acc_last = NULL;
+    }
+    desc->n_accepted--;
+    s = ap->s;
+    *remote = ap->remote;
+    FREE(ap);
+    return s;
+}
+
+static void clear_accepted(tcp_descriptor *desc)
+{
+    inet_address remote;
+    SOCKET s;
+
+    while ((s = deq_accepted(desc, &remote)) != INVALID_SOCKET) {
+	sock_close(s);
+    }
+}
+
 /* setup a new async id + caller (format async_id into buf) */
 
 static int enq_async_w_tmo(inet_descriptor* desc, char* buf, int req, unsigned timeout,
@@ -2113,9 +2345,8 @@ static ErlDrvTermData am_scheme;
 static int http_load_string(tcp_descriptor* desc, ErlDrvTermData* spec, int i,
 			    const char* str, int len)
 {
-    if (desc->inet.htype >= TCP_PB_HTTP_BIN) {
-	ASSERT(desc->inet.htype == TCP_PB_HTTP_BIN ||
-	       desc->inet.htype == TCP_PB_HTTPH_BIN);
+    if (desc->inet.htype == TCP_PB_HTTP_BIN ||
+	desc->inet.htype == TCP_PB_HTTPH_BIN) {
 	i = LOAD_BUF2BINARY(spec, i, str, len);
     } else {
 	i = LOAD_STRING(spec, i, str, len);
@@ -2401,7 +2632,7 @@ int ssl_tls_inetdrv(void* arg, unsigned type, unsigned major, unsigned minor,
 {
     tcp_descriptor* desc = (tcp_descriptor*) arg;
     int i = 0;
-    ErlDrvTermData spec[28];
+    ErlDrvTermData spec[30];
     ErlDrvTermData caller = ERL_DRV_NIL;
     ErlDrvBinary* bin;
     int ret;
@@ -2442,11 +2673,11 @@ int ssl_tls_inetdrv(void* arg, unsigned type, unsigned major, unsigned minor,
     if (desc->inet.active == INET_PASSIVE) {
         i = LOAD_TUPLE(spec, i, 2);
         i = LOAD_TUPLE(spec, i, 4);
-        ASSERT(i <= 28);
+        ASSERT(i <= 30);
         ret = driver_send_term(desc->inet.port, caller, spec, i);
     }
     else {
-        ASSERT(i <= 28);
+        ASSERT(i <= 30);
         ret = driver_output_term(desc->inet.port, spec, i);
     }
 done:
@@ -3605,6 +3836,11 @@ static int inet_init()
     if (0 != erl_drv_tsd_key_create("inet_buffer_stack_key", &buffer_stack_key))
 	goto error;
 
+#ifdef HAVE_SPLICE
+    if ((lent_mtx = erl_drv_mutex_create("inet_lent_mtx")) == NULL)
+	goto error;
+#endif
+
     ASSERT(sizeof(struct in_addr) == 4);
 #   if defined(HAVE_IN6) && defined(AF_INET6)
     ASSERT(sizeof(struct in6_addr) == 16);
@@ -3621,6 +3857,7 @@ static int inet_init()
     INIT_ATOM(tcp_closed);
     INIT_ATOM(tcp_error);
     INIT_ATOM(udp_error);
+    INIT_ATOM(udp_batch);
     INIT_ATOM(empty_out_q);
     INIT_ATOM(ssl_tls);
 
@@ -3834,9 +4071,60 @@ static int inet_get_address(int family, char* dst, inet_address* src, unsigned i
     return -1;
 }
 
+#ifdef HAVE_SPLICE
+static void inet_lend(inet_descriptor* desc)
+{
+    inet_lent* l;
+
+    if ((l = ALLOC(sizeof(inet_lent))) == NULL)
+	return; /* can not be spliced from then */
+    l->fd = (int) desc->s;
+    l->spliced = 0;
+    l->closed = 0;
+    l->refc = 1;
+    erl_drv_mutex_lock(lent_mtx);
+    l->next = lent_first;
+    lent_first = l;
+    erl_drv_mutex_unlock(lent_mtx);
+    desc->lent = l;
+}
+
+static void inet_lent_release(inet_lent* l)
+{
+    if (--l->refc == 0)
+	FREE(l);
+}
+
+/* Take the socket back.  If it is closing, a splice reading from it
+** is woken by the shutdown and ends with {error,closed}. */
+static void inet_unlend(inet_descriptor* desc, int closing)
+{
+    inet_lent* l = desc->lent;
+    inet_lent** lp;
+
+    if (l == NULL)
+	return;
+    erl_drv_mutex_lock(lent_mtx);
+    for (lp = &lent_first; *lp != l; lp = &(*lp)->next)
+	ASSERT(*lp);
+    *lp = l->next;
+    if (closing) {
+	l->closed = 1;
+	if (l->spliced)
+	    sock_shutdown(l->fd, SHUT_RD);
+    }
+    inet_lent_release(l);
+    erl_drv_mutex_unlock(lent_mtx);
+    desc->lent = NULL;
+}
+#endif
+
 static void desc_close(inet_descriptor* desc)
 {
     if (desc->s != INVALID_SOCKET) {
+#ifdef HAVE_SPLICE
+	inet_unlend(desc, 1);
+#endif
 #ifdef __WIN32__
 	winsock_event_select(desc, FD_READ|FD_WRITE|FD_CLOSE, 0);
 	sock_close(desc->s);
@@ -5545,6 +5833,14 @@ static int inet_set_opts(inet_descriptor* desc, char* ptr, int len)
 		tdesc->send_timeout_close = ival;
 	    }
 	    continue;
+
+	case INET_LOPT_TCP_MULTI_ACCEPT:
+	    if (desc->stype == SOCK_STREAM) {
+		tcp_descriptor* tdesc = (tcp_descriptor*) desc;
+		if (ival < 0) return -1;
+		tdesc->multi_accept = ival;
+	    }
+	    continue;
 	    
 
 	case INET_LOPT_TCP_DELAY_SEND:
@@ -5552,8 +5848,43 @@ static int inet_set_opts(inet_descriptor* desc, char* ptr, int len)
 		tcp_descriptor* tdesc = (tcp_descriptor*) desc;
 		if (ival)
 		    tdesc->tcp_add_flags |= TCP_ADDF_DELAY_SEND;
-		else
+		else {
 		    tdesc->tcp_add_flags &= ~TCP_ADDF_DELAY_SEND;
+		    tcp_delay_flush(tdesc);
+		}
+	    }
+	    continue;
+
+	case INET_LOPT_TCP_DELAY_SEND_BYTES:
+	    if (desc->stype == SOCK_STREAM) {
+		if (ival < 0) return -1;
+		((tcp_descriptor*)desc)->delay_bytes = ival;
+	    }
+	    continue;
+
+	case INET_LOPT_TCP_DELAY_SEND_TIME:
+	    if (desc->stype == SOCK_STREAM) {
+		tcp_descriptor* tdesc = (tcp_descriptor*) desc;
+		if (ival < 0) return -1;
+		tdesc->delay_time = ival;
+		if (tdesc->delay_timer)
+		    tcp_delay_flush(tdesc);
+	    }
+	    continue;
+
+	case INET_LOPT_TCP_ADAPTIVE_BUFFER:
+	    if (desc->stype == SOCK_STREAM) {
+		tcp_descriptor* tdesc = (tcp_descriptor*) desc;
+		if (ival)
+		    tdesc->tcp_add_flags |= TCP_ADDF_ADAPTIVE_BUFFER;
+		else
+		    tdesc->tcp_add_flags &= ~TCP_ADDF_ADAPTIVE_BUFFER;
+	    }
+	    continue;
+	case INET_LOPT_TCP_LATENCY_STATS:
+	    if (desc->stype == SOCK_STREAM) {
+		if (tcp_latency_stats((tcp_descriptor*) desc, ival) < 0)
+		    return -1;
 	    }
 	    continue;
 
@@ -5565,6 +5896,18 @@ static int inet_set_opts(inet_descriptor* desc, char* ptr, int len)
 	    }
 	    continue;
 
+	case INET_LOPT_UDP_RECV_BATCH:
+	    if (desc->stype == SOCK_DGRAM) {
+		udp_descriptor* udesc = (udp_descriptor*) desc;
+		if (ival < 0 || ival > INET_PACKET_BATCH) return -1;
+		udesc->recv_batch = ival;
+		if (ival == 0 && udesc->batch != NULL) {
+		    FREE(udesc->batch);
+		    udesc->batch = NULL;
+		}
+	    }
+	    continue;
+
 	case INET_OPT_REUSEADDR: 
 #ifdef __WIN32__
 	    continue;  /* Bjorn says */
@@ -5573,6 +5916,16 @@ static int inet_set_opts(inet_descriptor* desc, char* ptr, int len)
 	    DEBUGF(("inet_set_opts(%ld): s=%d, SO_REUSEADDR=%d\r\n",
 		    (long)desc->port, desc->s,ival));
 	    break;
+#endif
+	case INET_OPT_REUSEPORT:
+#ifdef SO_REUSEPORT
+	    type = SO_REUSEPORT;
+	    propagate = 1; /* We do want to know if this fails */
+	    DEBUGF(("inet_set_opts(%ld): s=%d, SO_REUSEPORT=%d\r\n",
+		    (long)desc->port, desc->s,ival));
+	    break;
+#else
+	    return -1;
 #endif
 	case INET_OPT_KEEPALIVE: type = SO_KEEPALIVE;
 	    DEBUGF(("inet_set_opts(%ld): s=%d, SO_KEEPALIVE=%d\r\n",
@@ -6437,6 +6790,16 @@ static ErlDrvSSizeT inet_fill_opts(inet_descriptor* desc,
 	    }
 	    continue;
 
+	case INET_LOPT_TCP_MULTI_ACCEPT:
+	    if (desc->stype == SOCK_STREAM) {
+		*ptr++ = opt;
+		ival = ((tcp_descriptor*)desc)->multi_accept;
+		put_int32(ival, ptr);
+	    } else {
+		TRUNCATE_TO(0,ptr);
+	    }
+	    continue;
+
 	case INET_LOPT_TCP_DELAY_SEND:
 	    if (desc->stype == SOCK_STREAM) {
 		*ptr++ = opt;
@@ -6447,6 +6810,44 @@ static ErlDrvSSizeT inet_fill_opts(inet_descriptor* desc,
 	    }
 	    continue;
 
+	case INET_LOPT_TCP_DELAY_SEND_BYTES:
+	    if (desc->stype == SOCK_STREAM) {
+		*ptr++ = opt;
+		put_int32(((tcp_descriptor*)desc)->delay_bytes, ptr);
+	    } else {
+		TRUNCATE_TO(0,ptr);
+	    }
+	    continue;
+
+	case INET_LOPT_TCP_DELAY_SEND_TIME:
+	    if (desc->stype == SOCK_STREAM) {
+		*ptr++ = opt;
+		put_int32(((tcp_descriptor*)desc)->delay_time, ptr);
+	    } else {
+		TRUNCATE_TO(0,ptr);
+	    }
+	    continue;
+
+	case INET_LOPT_TCP_ADAPTIVE_BUFFER:
+	    if (desc->stype == SOCK_STREAM) {
+		*ptr++ = opt;
+		ival = !!(((tcp_descriptor*)desc)->tcp_add_flags &
+			  TCP_ADDF_ADAPTIVE_BUFFER);
+		put_int32(ival, ptr);
+	    } else {
+		TRUNCATE_TO(0,ptr);
+	    }
+	    continue;
+	case INET_LOPT_TCP_LATENCY_STATS:
+	    if (desc->stype == SOCK_STREAM) {
+		*ptr++ = opt;
+		ival = (((tcp_descriptor*)desc)->lat != NULL);
+		put_int32(ival, ptr);
+	    } else {
+		TRUNCATE_TO(0,ptr);
+	    }
+	    continue;
+
 	case INET_LOPT_UDP_READ_PACKETS:
 	    if (desc->stype == SOCK_DGRAM) {
 		*ptr++ = opt;
@@ -6457,6 +6858,16 @@ static ErlDrvSSizeT inet_fill_opts(inet_descriptor* desc,
 	    }
 	    continue;
 
+	case INET_LOPT_UDP_RECV_BATCH:
+	    if (desc->stype == SOCK_DGRAM) {
+		*ptr++ = opt;
+		ival = ((udp_descriptor*)desc)->recv_batch;
+		put_int32(ival, ptr);
+	    } else {
+		TRUNCATE_TO(0,ptr);
+	    }
+	    continue;
+
 	case INET_OPT_PRIORITY:
 #ifdef SO_PRIORITY
 	    type = SO_PRIORITY;
@@ -6479,6 +6890,15 @@ static ErlDrvSSizeT inet_fill_opts(inet_descriptor* desc,
 	case INET_OPT_REUSEADDR: 
 	    type = SO_REUSEADDR; 
 	    break;
+	case INET_OPT_REUSEPORT:
+#ifdef SO_REUSEPORT
+	    type = SO_REUSEPORT;
+	    break;
+#else
+	    *ptr++ = opt;
+	    put_int32(0, ptr);
+	    continue;
+#endif
 	case INET_OPT_KEEPALIVE: 
 	    type = SO_KEEPALIVE; 
 	    break;
@@ -7358,6 +7778,23 @@ static ErlDrvSSizeT inet_fill_stat(inet_descriptor* desc,
 	    put_int32(desc->send_oct[0], dst+4); /* write low 32bit */
 	    dst += 8;
 	    continue;
+	case INET_STAT_SEND_DWELL:
+	case INET_STAT_RECV_LAT:
+	case INET_STAT_BUSY_TIME: {
+	    tcp_latency* lat = (desc->stype == SOCK_STREAM) ?
+		((tcp_descriptor*)desc)->lat : NULL;
+	    Uint32* h = NULL;
+	    int i;
+	    if (lat != NULL)
+		h = (op == INET_STAT_SEND_DWELL) ? lat->send_dwell :
+		    (op == INET_STAT_RECV_LAT) ? lat->recv_lat :
+		    lat->busy_time;
+	    for (i = 0; i < INET_LAT_BUCKETS; i++) {
+		put_int32((h != NULL) ? h[i] : 0, dst);
+		dst += 4;
+	    }
+	    continue;
+	}
 	default: return -1; /* invalid argument */
 	}
 	put_int32(val, dst);  /* write 32bit value */
@@ -7480,6 +7917,9 @@ static ErlDrvData inet_start(ErlDrvPort port, int size, int protocol)
     sys_memzero((char *)&desc->remote,sizeof(desc->remote));
 
     desc->is_ignored = 0;
+#ifdef HAVE_SPLICE
+    desc->lent = NULL;
+#endif
 
     return (ErlDrvData)desc;
 }
@@ -7506,6 +7946,9 @@ static ErlDrvSSizeT inet_ctl(inet_descriptor* desc, int cmd, char* buf,
 	      switch(buf[i]) {
 	      case INET_STAT_SEND_OCT: dstlen += 9; break;
 	      case INET_STAT_RECV_OCT: dstlen += 9; break;
+	      case INET_STAT_SEND_DWELL:
+	      case INET_STAT_RECV_LAT:
+	      case INET_STAT_BUSY_TIME: dstlen += 1+4*INET_LAT_BUCKETS; break;
 	      default: dstlen += 5; break;
 	      }
 	  }
@@ -7780,8 +8223,18 @@ static ErlDrvSSizeT inet_ctl(inet_descriptor* desc, int cmd, char* buf,
       if (*buf == 1 && !desc->is_ignored) {
 	  sock_select(desc, (FD_READ|FD_WRITE|FD_CLOSE|ERL_DRV_USE_NO_CALLBACK), 0);
 	  desc->is_ignored = INET_IGNORE_READ;
+#ifdef HAVE_SPLICE
+	  inet_lend(desc);
+#endif
       } else if (*buf == 0 && desc->is_ignored) {
-	  int flags = (FD_READ|FD_CLOSE|((desc->is_ignored & INET_IGNORE_WRITE)?FD_WRITE:0));
+	  /* A passive socket only reads for a pending recv, otherwise a
+	     close seen now would be lost to the next recv */
+	  int flags = (((desc->active || desc->opt != NULL) ? FD_READ : 0) |
+		       FD_CLOSE |
+		       ((desc->is_ignored & INET_IGNORE_WRITE)?FD_WRITE:0));
+#ifdef HAVE_SPLICE
+	  inet_unlend(desc, 0);
+#endif
 	  desc->is_ignored = INET_IGNORE_NONE;
 	  sock_select(desc, flags, 1);
       } else
@@ -7923,6 +8376,19 @@ static int tcp_expand_buffer(tcp_descriptor* desc, int len)
 	desc->i_bufsz = ulen;  /* set "virtual" size */
 	return 0;
     }
+    else if (driver_binary_get_refc(desc->i_buf) > 1) {
+	/* packets delivered as sub-binaries, move the rest */
+	offs2 = desc->i_ptr - desc->i_ptr_start;
+	if ((bin = alloc_buffer(len)) == NULL)
+	    return -1;
+	sys_memcpy(bin->orig_bytes, desc->i_ptr_start, offs2);
+	driver_free_binary(desc->i_buf);
+	desc->i_buf = bin;
+	desc->i_ptr_start = bin->orig_bytes;
+	desc->i_ptr       = desc->i_ptr_start + offs2;
+	desc->i_bufsz     = len;
+	return 0;
+    }
 
     DEBUGF(("tcp_expand_buffer(%ld): s=%d, from %ld to %d\r\n",
 	    (long)desc->inet.port, desc->inet.s, desc->i_buf->orig_size, ulen));
@@ -7958,7 +8424,7 @@ static int tcp_push_buffer(tcp_descriptor* desc, char* buf, int len)
 	int sz_before = desc->i_ptr_start - start;
 	int sz_filled = desc->i_ptr - desc->i_ptr_start;
 	
-	if (len <= sz_before) {
+	if (len <= sz_before && driver_binary_get_refc(desc->i_buf) == 1) {
 	    sys_memcpy(desc->i_ptr_start - len, buf, len);
 	    desc->i_ptr_start -= len;
 	}
@@ -7996,16 +8462,249 @@ static void tcp_clear_output(tcp_descriptor* desc)
     ErlDrvSizeT qsz = driver_sizeq(ix);
 
     driver_deq(ix, qsz);
+    if (desc->lat != NULL)
+	tcp_lat_clear_output(desc);
     send_empty_out_q_msgs(INETP(desc));
 }
 
 
+/* Size of a new input buffer */
+static int tcp_input_size(tcp_descriptor* desc)
+{
+    if ((desc->tcp_add_flags & TCP_ADDF_ADAPTIVE_BUFFER) &&
+	(desc->i_adapt > desc->inet.bufsz))
+	return desc->i_adapt;
+    return desc->inet.bufsz;
+}
+
+/*
+** Latency histograms (latency_stats).  Send dwell is measured per send
+** from the time its data was queued to the write that drains its last
+** byte; sends written at once count as 0.  Receive latency runs from
+** the arrival of the oldest undelivered data (kernel timestamp where
+** the platform gives one, else the read) to delivery of the packet.
+** Busy time runs from crossing the high watermark to dropping under
+** the low one.
+*/
+static ErlDrvUInt64 tcp_lat_now(void)
+{
+#ifdef __WIN32__
+    ErlDrvNowData now;
+    driver_get_now(&now);
+    return ((ErlDrvUInt64) now.megasecs * 1000000 + now.secs) * 1000000
+	+ now.microsecs;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (ErlDrvUInt64) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+static void tcp_lat_sample(Uint32* h, ErlDrvUInt64 t0, ErlDrvUInt64 t1)
+{
+    ErlDrvUInt64 us = (t1 > t0) ? (t1 - t0) : 0;
+    int i = 0;
+
+    while ((us != 0) && (i < INET_LAT_BUCKETS-1)) {
+	us >>= 1;
+	i++;
+    }
+    h[i]++;
+}
+
+static int tcp_latency_stats(tcp_descriptor* desc, int on)
+{
+    if (on && (desc->lat == NULL)) {
+	if ((desc->lat = ALLOC(sizeof(tcp_latency))) == NULL)
+	    return -1;
+	sys_memzero(desc->lat, sizeof(tcp_latency));
+	/* Data already queued is not tracked */
+	desc->lat->q_out = -(ErlDrvUInt64) driver_sizeq(desc->inet.port);
+	if (IS_BUSY(INETP(desc)))
+	    desc->lat->busy_since = tcp_lat_now();
+#if defined(SO_TIMESTAMP) && !defined(__WIN32__)
+	on = 1;
+	sock_setopt(desc->inet.s, SOL_SOCKET, SO_TIMESTAMP,
+		    (char*) &on, sizeof(on));
+#endif
+    } else if (!on && (desc->lat != NULL)) {
+	FREE(desc->lat);
+	desc->lat = NULL;
+#if defined(SO_TIMESTAMP) && !defined(__WIN32__)
+	sock_setopt(desc->inet.s, SOL_SOCKET, SO_TIMESTAMP,
+		    (char*) &on, sizeof(on));
+#endif
+    }
+    return 0;
+}
+
+/* n bytes of a send went to the output queue (n == 0: all written) */
+static void tcp_lat_queued(tcp_descriptor* desc, ErlDrvSizeT n)
+{
+    tcp_latency* lat = desc->lat;
+    ErlDrvUInt64 now = tcp_lat_now();
+
+    if (n == 0) {
+	tcp_lat_sample(lat->send_dwell, now, now);
+	return;
+    }
+    lat->q_in += n;
+    if (lat->m_len == INET_LAT_MARKS) /* full, stretch the newest */
+	lat->marks[(lat->m_first+lat->m_len-1) % INET_LAT_MARKS].end =
+	    lat->q_in;
+    else {
+	tcp_lat_mark* m =
+	    &lat->marks[(lat->m_first+lat->m_len) % INET_LAT_MARKS];
+	m->end = lat->q_in;
+	m->t = now;
+	lat->m_len++;
+    }
+}
+
+/* n bytes were written from the output queue */
+static void tcp_lat_written(tcp_descriptor* desc, ErlDrvSizeT n)
+{
+    tcp_latency* lat = desc->lat;
+    ErlDrvUInt64 now = 0;
+
+    lat->q_out += n;
+    while ((lat->m_len > 0) &&
+	   ((Sint64)(lat->q_out - lat->marks[lat->m_first].end) >= 0)) {
+	if (now == 0)
+	    now = tcp_lat_now();
+	tcp_lat_sample(lat->send_dwell, lat->marks[lat->m_first].t, now);
+	lat->m_first = (lat->m_first + 1) % INET_LAT_MARKS;
+	lat->m_len--;
+    }
+}
+
+/* the output queue was thrown away */
+static void tcp_lat_clear_output(tcp_descriptor* desc)
+{
+    desc->lat->q_in = desc->lat->q_out = 0;
+    desc->lat->m_len = 0;
+}
+
+static void tcp_lat_busy(tcp_descriptor* desc, int on)
+{
+    if (on)
+	desc->lat->busy_since = tcp_lat_now();
+    else if (desc->lat->busy_since != 0) {
+	tcp_lat_sample(desc->lat->busy_time, desc->lat->busy_since,
+		       tcp_lat_now());
+	desc->lat->busy_since = 0;
+    }
+}
+
+/* sock_recv that also notes when the data arrived */
+static int tcp_lat_recv(tcp_descriptor* desc, char* buf, int len)
+{
+    ErlDrvUInt64 t = 0;
+    int n;
+#if defined(SO_TIMESTAMP) && !defined(__WIN32__)
+    struct msghdr mhdr;
+    struct iovec iov;
+    union {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(sizeof(struct timeval))];
+    } ctl;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    sys_memzero(&mhdr, sizeof(mhdr));
+    mhdr.msg_iov = &iov;
+    mhdr.msg_iovlen = 1;
+    mhdr.msg_control = ctl.buf;
+    mhdr.msg_controllen = sizeof(ctl.buf);
+    n = recvmsg(desc->inet.s, &mhdr, 0);
+    if (n > 0) {
+	struct cmsghdr* cmsg;
+	for (cmsg = CMSG_FIRSTHDR(&mhdr); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&mhdr, cmsg)) {
+	    if ((cmsg->cmsg_level == SOL_SOCKET) &&
+		(cmsg->cmsg_type == SO_TIMESTAMP)) {
+		struct timeval tv;
+		memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+		t = (ErlDrvUInt64) tv.tv_sec * 1000000 + tv.tv_usec;
+	    }
+	}
+    }
+#else
+    n = sock_recv(desc->inet.s, buf, len, 0);
+#endif
+    if ((n > 0) && (desc->lat->rx_t == 0))
+	desc->lat->rx_t = (t != 0) ? t : tcp_lat_now();
+    return n;
+}
+
+/* a packet was delivered */
+static void tcp_lat_delivered(tcp_descriptor* desc)
+{
+    tcp_latency* lat = desc->lat;
+
+    if (lat->rx_t != 0) {
+	tcp_lat_sample(lat->recv_lat, lat->rx_t, tcp_lat_now());
+	if ((desc->i_buf == NULL) || (desc->i_ptr_start == desc->i_ptr))
+	    lat->rx_t = 0;
+    }
+}
+
+/*
+** Learn the input buffer size from what is read (adaptive_buffer).
+** A read that fills the space given doubles the size, shorter reads
+** let it decay towards the amount read. Never below the buffer option.
+*/
+static void tcp_adapt_input(tcp_descriptor* desc, int n, int nread)
+{
+    int min = desc->inet.bufsz;
+    int max = (min > INET_MAX_ADAPT_BUFFER) ? min : INET_MAX_ADAPT_BUFFER;
+    int sz = (desc->i_adapt > min) ? desc->i_adapt : min;
+
+    if (n >= nread)
+	sz = (sz > max/2) ? max : 2*sz;
+    else if (n < sz)
+	sz -= (sz - n) >> 3;
+    desc->i_adapt = (sz > min) ? sz : min;
+}
+
+/*
+** With adaptive_buffer, binary packets are delivered as sub-binaries
+** of the input buffer once more than one packet is read into it.
+*/
+static int tcp_share_input(tcp_descriptor* desc, int len)
+{
+    return (desc->tcp_add_flags & TCP_ADDF_ADAPTIVE_BUFFER)
+	&& (desc->inet.mode == INET_MODE_BINARY)
+	&& (len > INET_SUBBIN_MIN)
+	&& ((desc->i_ptr_start + len != desc->i_ptr)
+	    || (driver_binary_get_refc(desc->i_buf) > 1));
+}
+
 /* Move data so that ptr_start point at buf->orig_bytes */
 static void tcp_restart_input(tcp_descriptor* desc)
 {
     if (desc->i_ptr_start != desc->i_buf->orig_bytes) {
 	int n = desc->i_ptr - desc->i_ptr_start;
 
+	if (driver_binary_get_refc(desc->i_buf) > 1) {
+	    /* packets delivered as sub-binaries, move the rest */
+	    ErlDrvBinary* bin;
+	    int sz = desc->i_bufsz - (desc->i_ptr_start -
+				      desc->i_buf->orig_bytes);
+
+	    if (sz < tcp_input_size(desc))
+		sz = tcp_input_size(desc);
+	    DEBUGF(("tcp_restart_input: copy %d bytes\r\n", n));
+	    if ((bin = alloc_buffer(sz)) == NULL)
+		return; /* read on after the shared part */
+	    sys_memcpy(bin->orig_bytes, desc->i_ptr_start, n);
+	    driver_free_binary(desc->i_buf);
+	    desc->i_buf = bin;
+	    desc->i_bufsz = sz;
+	    desc->i_ptr_start = bin->orig_bytes;
+	    desc->i_ptr = desc->i_ptr_start + n;
+	    return;
+	}
 	DEBUGF(("tcp_restart_input: move %d bytes\r\n", n));
 	sys_memmove(desc->i_buf->orig_bytes, desc->i_ptr_start, n);
 	desc->i_ptr_start = desc->i_buf->orig_bytes;
@@ -8045,6 +8744,19 @@ static ErlDrvData tcp_inet_start(ErlDrvPort port, char* args)
     desc->http_state = 0;
     desc->mtd = NULL;
     desc->multi_first = desc->multi_last = NULL;
+    desc->multi_accept = 0;
+    desc->n_accepted = 0;
+    desc->acc_first = desc->acc_last = NULL;
+    desc->i_adapt = 0;
+    desc->sp_fd = -1;
+#ifdef HAVE_SPLICE
+    desc->sp_lent = NULL;
+#endif
+    desc->lat = NULL;
+    desc->delay_bytes = 0;
+    desc->delay_time = 0;
+    desc->delay_timer = 0;
+    desc->tls_rx_vsn = 0;
     DEBUGF(("tcp_inet_start(%ld) }\r\n", (long)port));
     return (ErlDrvData) desc;
 }
@@ -8100,6 +8812,214 @@ static tcp_descriptor* tcp_inet_copy(tcp_descriptor* desc,SOCKET s,
     return copy_desc;
 }
 
+/*
+** Splice: move bytes from another port's socket (one that port has
+** been told to ignore, see inet_lend) to ours through a pipe, so the
+** data never leaves the kernel.  Our output queue is empty when a
+** splice starts; whatever is sent while it runs is queued behind it
+** and the high/low watermarks apply to those senders as usual.
+*/
+#define TCP_SPLICE_CHUNK  (64*1024)
+#define TCP_SPLICE_ROUNDS 16       /* chunks per event before yielding */
+
+#ifdef HAVE_SPLICE
+/* Take a dup() of fd into sp_fd, if some live port has lent it out */
+static int tcp_splice_borrow(tcp_descriptor* desc, int fd)
+{
+    inet_lent* l;
+    int err = 0;
+
+    erl_drv_mutex_lock(lent_mtx);
+    for (l = lent_first; l != NULL; l = l->next) {
+	if (l->fd == fd)
+	    break;
+    }
+    if (l == NULL)
+	err = EBADF;
+    else if (l->spliced)
+	err = EALREADY;
+    else if ((desc->sp_fd = dup(fd)) < 0)
+	err = errno;
+    else {
+	l->spliced = 1;
+	l->refc++;
+	desc->sp_lent = l;
+    }
+    erl_drv_mutex_unlock(lent_mtx);
+    return err;
+}
+
+/* Give back what tcp_splice_borrow took; true if the lender closed */
+static int tcp_splice_return(tcp_descriptor* desc)
+{
+    inet_lent* l = desc->sp_lent;
+    int closed;
+
+    /* stop_select closes our dup(), right away if it is not selected */
+    driver_select(desc->inet.port, (ErlDrvEvent)(long)desc->sp_fd,
+		  ERL_DRV_READ|ERL_DRV_USE, 0);
+    desc->sp_fd = -1;
+    desc->sp_lent = NULL;
+    erl_drv_mutex_lock(lent_mtx);
+    l->spliced = 0;
+    closed = l->closed;
+    inet_lent_release(l);
+    erl_drv_mutex_unlock(lent_mtx);
+    return closed;
+}
+#endif
+
+static int tcp_splice_start(tcp_descriptor* desc, char* buf, ErlDrvSizeT len)
+{
+#ifdef HAVE_SPLICE
+    int fd, err;
+
+    if (len != 4+8)
+	return EINVAL;
+    if (desc->sp_fd >= 0)
+	return EALREADY;
+    if (driver_sizeq(desc->inet.port) > 0)
+	return EBUSY;
+    fd = get_int32(buf);
+    if ((fd < 0) || (fd == desc->inet.s))
+	return EINVAL;
+    if ((err = tcp_splice_borrow(desc, fd)) != 0)
+	return err;
+    if (pipe(desc->sp_pipe) < 0) {
+	err = errno;
+	tcp_splice_return(desc);
+	return err;
+    }
+    desc->sp_queued = 0;
+    desc->sp_left = ((ErlDrvUInt64) get_int32(buf+4) << 32) |
+	(ErlDrvUInt64) get_int32(buf+8);
+    desc->sp_bounded = (desc->sp_left != 0);
+    desc->sp_done = 0;
+    desc->sp_id = NEW_ASYNC_ID();
+    desc->sp_caller = driver_caller(desc->inet.port);
+    tcp_splice_run(desc);
+    return 0;
+#else
+    return ENOTSUP;
+#endif
+}
+
+/* send message:
+**     {inet_async, Port, Ref, {ok, Bytes}}  or  {inet_async, Port, Ref, {error, Reason}}
+*/
+static void tcp_splice_done(tcp_descriptor* desc, ErlDrvTermData reason)
+{
+    if (desc->sp_fd < 0)
+	return;
+#ifdef HAVE_SPLICE
+    close(desc->sp_pipe[0]);
+    close(desc->sp_pipe[1]);
+    /* The end of the source is only a normal end if its port lives */
+    if (tcp_splice_return(desc) && reason == 0)
+	reason = am_closed;
+#endif
+    desc->sp_fd = -1;
+    if (reason == 0) {
+	ErlDrvTermData spec[2*LOAD_ATOM_CNT + LOAD_PORT_CNT + LOAD_INT_CNT +
+			    LOAD_UINT64_CNT + 2*LOAD_TUPLE_CNT];
+	int i = 0;
+	i = LOAD_ATOM(spec, i, am_inet_async);
+	i = LOAD_PORT(spec, i, desc->inet.dport);
+	i = LOAD_INT(spec, i, desc->sp_id);
+	i = LOAD_ATOM(spec, i, am_ok);
+	i = LOAD_UINT64(spec, i, &desc->sp_done);
+	i = LOAD_TUPLE(spec, i, 2);
+	i = LOAD_TUPLE(spec, i, 4);
+	ASSERT(i == sizeof(spec)/sizeof(*spec));
+	driver_send_term(desc->inet.port, desc->sp_caller, spec, i);
+    } else
+	send_async_error(desc->inet.port, desc->inet.dport, desc->sp_id,
+			 desc->sp_caller, reason);
+
+    /* Now let out what was sent meanwhile */
+    if (IS_CONNECTED(INETP(desc)) && !INETP(desc)->is_ignored) {
+	if (driver_sizeq(desc->inet.port) > 0)
+	    sock_select(INETP(desc), (FD_WRITE|FD_CLOSE), 1);
+	else {
+	    sock_select(INETP(desc), FD_WRITE, 0);
+	    send_empty_out_q_msgs(INETP(desc));
+	}
+    }
+}
+
+/* Pump the splice until one side would block, it is done, or we have
+** had our share of the scheduler.  Exactly one of "source readable"
+** and "socket writable" is selected when we return with work left.
+*/
+static int tcp_splice_run(tcp_descriptor* desc)
+{
+#ifdef HAVE_SPLICE
+    ErlDrvPort ix = desc->inet.port;
+    int rounds = 0;
+
+    while (desc->sp_fd >= 0) {
+	ssize_t n;
+
+	if (desc->sp_queued > 0) {
+	    n = splice(desc->sp_pipe[0], NULL, desc->inet.s, NULL,
+		       desc->sp_queued,
+		       SPLICE_F_MOVE|SPLICE_F_NONBLOCK|SPLICE_F_MORE);
+	    if (n < 0) {
+		if (errno == EINTR)
+		    continue;
+		if (errno != ERRNO_BLOCK) {
+		    tcp_splice_done(desc, error_atom(errno));
+		    return -1;
+		}
+		driver_select(ix, (ErlDrvEvent)(long)desc->sp_fd,
+			      ERL_DRV_READ, 0);
+		sock_select(INETP(desc), (FD_WRITE|FD_CLOSE), 1);
+		return 0;
+	    }
+	    desc->sp_queued -= n;
+	    desc->sp_done += n;
+	    inet_output_count(INETP(desc), n);
+	    continue;
+	}
+	if (desc->sp_bounded && desc->sp_left == 0) {
+	    tcp_splice_done(desc, 0);
+	    return 0;
+	}
+	if (++rounds > TCP_SPLICE_ROUNDS) {
+	    /* Come back when the poll set says we may write */
+	    driver_select(ix, (ErlDrvEvent)(long)desc->sp_fd,
+			  ERL_DRV_READ, 0);
+	    sock_select(INETP(desc), (FD_WRITE|FD_CLOSE), 1);
+	    return 0;
+	}
+	n = splice(desc->sp_fd, NULL, desc->sp_pipe[1], NULL,
+		   (desc->sp_bounded && desc->sp_left < TCP_SPLICE_CHUNK) ?
+		   (size_t) desc->sp_left : TCP_SPLICE_CHUNK,
+		   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    if (errno != ERRNO_BLOCK) {
+		tcp_splice_done(desc, error_atom(errno));
+		return -1;
+	    }
+	    sock_select(INETP(desc), FD_WRITE, 0);
+	    driver_select(ix, (ErlDrvEvent)(long)desc->sp_fd,
+			  ERL_DRV_READ|ERL_DRV_USE, 1);
+	    return 0;
+	}
+	if (n == 0) { /* source closed, or its port did */
+	    tcp_splice_done(desc, 0);
+	    return 0;
+	}
+	desc->sp_queued = n;
+	if (desc->sp_bounded)
+	    desc->sp_left -= n;
+    }
+#endif
+    return 0;
+}
+
 /*
 ** Check Special cases:
 ** 1. we are a listener doing nb accept -> report error on accept !
@@ -8107,6 +9027,9 @@ static tcp_descriptor* tcp_inet_copy(tcp_descriptor* desc,SOCKET s,
 */
 static void tcp_close_check(tcp_descriptor* desc)
 {
+    clear_accepted(desc);
+    tcp_splice_done(desc, am_closed);
+    tcp_delay_cancel(desc);
     /* XXX:PaN - multiple clients to handle! */
     if (desc->inet.state == INET_STATE_ACCEPTING) {
 	inet_async_op *this_op = desc->inet.opt;
@@ -8153,6 +9076,9 @@ static void tcp_inet_stop(ErlDrvData e)
 	release_buffer(desc->i_buf);
     desc->i_buf = NULL; /* net_mess2 may call this function recursively when 
 			   faulty messages arrive on dist ports*/
+    if (desc->lat != NULL)
+	FREE(desc->lat);
+    desc->lat = NULL;
     DEBUGF(("tcp_inet_stop(%ld) }\r\n", (long)desc->inet.port));
     inet_stop(INETP(desc));
 }
@@ -8161,6 +9087,104 @@ static void tcp_inet_stop(ErlDrvData e)
     
 
 /* TCP requests from Erlang */
+/*
+** Install kernel TLS record protection on a connected socket.
+** buf = [Dir:8, Version:16, Cipher:8, Seq:64, Salt:4/binary,
+**        IV:8/binary, Key/binary]
+** The handshake has been done by the caller; from here on the
+** kernel seals everything we write (TX) and opens what we read (RX)
+** so the data path stays plain send/recv/sendfile.  Anything already
+** queued in the driver was meant to go out (or came in) under the
+** old protection, so the switch is refused until the queues are empty.
+*/
+static int tcp_tls_offload(tcp_descriptor* desc, char* buf, ErlDrvSizeT len)
+{
+#if defined(HAVE_LINUX_TLS_H) && defined(TLS_CIPHER_AES_GCM_128)
+    union {
+	struct tls12_crypto_info_aes_gcm_128 g128;
+#ifdef TLS_CIPHER_AES_GCM_256
+	struct tls12_crypto_info_aes_gcm_256 g256;
+#endif
+    } ci;
+    unsigned char* iv;
+    unsigned char* key;
+    unsigned char* salt;
+    unsigned char* seq;
+    char* buf0 = buf;
+    int dir, flag, keylen;
+    socklen_t ci_len;
+
+    if (len < 1+2+1+8+4+8)
+	return EINVAL;
+    dir = get_int8(buf);
+    if (dir == TCP_TLS_TX) {
+	flag = TCP_ADDF_TLS_TX;
+	if (driver_sizeq(desc->inet.port) != 0)
+	    return EBUSY;
+    } else if (dir == TCP_TLS_RX) {
+	flag = TCP_ADDF_TLS_RX;
+	if ((desc->i_buf != NULL) && (desc->i_ptr > desc->i_ptr_start))
+	    return EBUSY;
+    } else
+	return EINVAL;
+    if (desc->tcp_add_flags & flag)
+	return EALREADY;
+
+    sys_memzero(&ci, sizeof(ci));
+    switch (get_int8(buf+3)) {
+    case TCP_TLS_AES_128_GCM:
+	keylen = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+	ci.g128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+	iv = ci.g128.iv; key = ci.g128.key;
+	salt = ci.g128.salt; seq = ci.g128.rec_seq;
+	ci_len = sizeof(ci.g128);
+	break;
+#ifdef TLS_CIPHER_AES_GCM_256
+    case TCP_TLS_AES_256_GCM:
+	keylen = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+	ci.g256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+	iv = ci.g256.iv; key = ci.g256.key;
+	salt = ci.g256.salt; seq = ci.g256.rec_seq;
+	ci_len = sizeof(ci.g256);
+	break;
+#endif
+    default:
+	return ENOTSUP;
+    }
+    if (len != 1+2+1+8+4+8+keylen)
+	return EINVAL;
+    ci.g128.info.version = get_int16(buf+1);
+    buf += 4;
+    sys_memcpy(seq, buf, 8);   buf += 8;
+    sys_memcpy(salt, buf, 4);  buf += 4;
+    sys_memcpy(iv, buf, 8);    buf += 8;
+    sys_memcpy(key, buf, keylen);
+
+    /* The upper layer protocol can only be attached once */
+    if (!(desc->tcp_add_flags & (TCP_ADDF_TLS_TX|TCP_ADDF_TLS_RX))) {
+	if (setsockopt(desc->inet.s, IPPROTO_TCP, TCP_ULP, "tls", 3) < 0) {
+	    int err = sock_errno();
+	    /* ENOENT: the tls module is not loaded in this kernel */
+	    return (err == ENOENT) ? ENOTSUP : err;
+	}
+    }
+    if (setsockopt(desc->inet.s, SOL_TLS,
+		   (dir == TCP_TLS_TX) ? TLS_TX : TLS_RX,
+		   (void*) &ci, ci_len) < 0) {
+	int err = sock_errno();
+	sys_memzero(&ci, sizeof(ci));
+	return err;
+    }
+    sys_memzero(&ci, sizeof(ci));
+    desc->tcp_add_flags |= flag;
+    if (dir == TCP_TLS_RX)
+	desc->tls_rx_vsn = get_int16(buf0+1);
+    return 0;
+#else
+    return ENOTSUP;
+#endif
+}
+
 static ErlDrvSSizeT tcp_inet_ctl(ErlDrvData e, unsigned int cmd,
 				 char* buf, ErlDrvSizeT len,
 				 char** rbuf, ErlDrvSizeT rsize)
@@ -8352,8 +9376,10 @@ static ErlDrvSSizeT tcp_inet_ctl(ErlDrvData e, unsigned int cmd,
 	    enq_multi_op(desc, tbuf, INET_REQ_ACCEPT, caller, mtd, &monitor);
 	    return ctl_reply(INET_REP_OK, tbuf, 2, rbuf, rsize);
  	} else {
-	    n = sizeof(desc->inet.remote);
-	    s = sock_accept(desc->inet.s, (struct sockaddr*) &remote, &n);
+	    if ((s = deq_accepted(desc, &remote)) == INVALID_SOCKET) {
+		n = sizeof(desc->inet.remote);
+		s = sock_accept(desc->inet.s, (struct sockaddr*) &remote, &n);
+	    }
 	    if (s == INVALID_SOCKET) {
 		if (sock_errno() == ERRNO_BLOCK) {
 		    ErlDrvMonitor monitor;
@@ -8436,8 +9462,10 @@ static ErlDrvSSizeT tcp_inet_ctl(ErlDrvData e, unsigned int cmd,
 	    if (timeout == 0)
 		async_error_am(INETP(desc), am_timeout);
 	    else {
-		if (timeout != INET_INFINITY)
+		if (timeout != INET_INFINITY) {
+		    tcp_delay_flush(desc);  /* we need the timer */
 		    driver_set_timer(desc->inet.port, timeout);
+		}
 		if (!INETP(desc)->is_ignored)
 		    sock_select(INETP(desc),(FD_READ|FD_CLOSE),1);
 	    }
@@ -8470,6 +9498,54 @@ static ErlDrvSSizeT tcp_inet_ctl(ErlDrvData e, unsigned int cmd,
 	    return ctl_error(sock_errno(), rbuf, rsize);
 	}
     }
+    case TCP_REQ_SPLICE: {
+	char tbuf[2];
+	int err;
+	DEBUGF(("tcp_inet_ctl(%ld): SPLICE\r\n", (long)desc->inet.port)); 
+	if (!IS_CONNECTED(INETP(desc)))
+	    return ctl_error(ENOTCONN, rbuf, rsize);
+	if (INETP(desc)->is_ignored)
+	    return ctl_error(EINVAL, rbuf, rsize);
+	if ((err = tcp_splice_start(desc, buf, len)) != 0)
+	    return ctl_error(err, rbuf, rsize);
+	put_int16(desc->sp_id, tbuf);
+	return ctl_reply(INET_REP_OK, tbuf, 2, rbuf, rsize);
+    }
+    case TCP_REQ_TAKE_INPUT: {
+	/* buf = Max:64 (0 = all); what the socket has read ahead of
+	   the packet parsing, so that a splice can send it first */
+	ErlDrvUInt64 max;
+	ErlDrvSSizeT r;
+	int n = 0;
+	DEBUGF(("tcp_inet_ctl(%ld): TAKE_INPUT\r\n", (long)desc->inet.port)); 
+	if (len != 8)
+	    return ctl_error(EINVAL, rbuf, rsize);
+	max = ((ErlDrvUInt64) get_int32(buf) << 32) |
+	    (ErlDrvUInt64) get_int32(buf+4);
+	if (desc->i_buf != NULL) {
+	    n = desc->i_ptr - desc->i_ptr_start;
+	    if ((max != 0) && ((ErlDrvUInt64) n > max))
+		n = (int) max;
+	}
+	if (n == 0)
+	    return ctl_reply(INET_REP_OK, NULL, 0, rbuf, rsize);
+	r = ctl_reply(INET_REP_OK, desc->i_ptr_start, n, rbuf, rsize);
+	desc->i_ptr_start += n;
+	if (desc->i_ptr_start == desc->i_ptr)
+	    tcp_clear_input(desc);
+	else
+	    desc->i_remain = 0;
+	return r;
+    }
+    case TCP_REQ_TLS_OFFLOAD: {
+	int err;
+	DEBUGF(("tcp_inet_ctl(%ld): TLS_OFFLOAD\r\n", (long)desc->inet.port)); 
+	if (!IS_CONNECTED(INETP(desc)))
+	    return ctl_error(ENOTCONN, rbuf, rsize);
+	if ((err = tcp_tls_offload(desc, buf, len)) != 0)
+	    return ctl_error(err, rbuf, rsize);
+	return ctl_reply(INET_REP_OK, NULL, 0, rbuf, rsize);
+    }
     default:
 	DEBUGF(("tcp_inet_ctl(%ld): %u\r\n", (long)desc->inet.port, cmd)); 
 	return inet_ctl(INETP(desc), cmd, buf, len, rbuf, rsize);
@@ -8498,12 +9574,18 @@ static void tcp_inet_timeout(ErlDrvData e)
     if ((state & INET_F_MULTI_CLIENT)) { /* Multi-client always means multi-timers */
 	fire_multi_timers(&(desc->mtd), desc->inet.port, e);
     } else if ((state & INET_STATE_CONNECTED) == INET_STATE_CONNECTED) {
-	if (desc->busy_on_send) {
+	if (desc->delay_timer) {
+	    /* delay_send_time is up */
+	    tcp_delay_flush(desc);
+	}
+	else if (desc->busy_on_send) {
 	    ASSERT(IS_BUSY(INETP(desc)));
 	    desc->inet.caller = desc->inet.busy_caller;
 	    desc->inet.state &= ~INET_F_BUSY;
 	    desc->busy_on_send = 0;
 	    set_busy_port(desc->inet.port, 0);
+	    if (desc->lat != NULL)
+	        tcp_lat_busy(desc, 0);
 	    inet_reply_error_am(INETP(desc), am_timeout);
 	    if (desc->send_timeout_close) {
 		erl_inet_close(INETP(desc));
@@ -8602,6 +9684,7 @@ static void tcp_inet_commandv(ErlDrvData e, ErlIOVec* ev)
 static void tcp_inet_flush(ErlDrvData e)
 {
     tcp_descriptor* desc = (tcp_descriptor*)e;
+    tcp_delay_flush(desc);
     if (!(desc->inet.event_mask & FD_WRITE)) {
 	/* Discard send queue to avoid hanging port (OTP-7615) */
 	tcp_clear_output(desc);
@@ -8654,6 +9737,8 @@ static int tcp_recv_closed(tcp_descriptor* desc)
 #endif
     DEBUGF(("tcp_recv_closed(%ld): s=%d, in %s, line %d\r\n",
 	    port, desc->inet.s, __FILE__, __LINE__));
+    /* Held output still goes out if only the read side closes */
+    tcp_delay_flush(desc);
     if (IS_BUSY(INETP(desc))) {
 	/* A send is blocked */
 	desc->inet.caller = desc->inet.busy_caller;
@@ -8665,6 +9750,8 @@ static int tcp_recv_closed(tcp_descriptor* desc)
 	}
 	desc->inet.state &= ~INET_F_BUSY;
 	set_busy_port(desc->inet.port, 0);
+	if (desc->lat != NULL)
+	    tcp_lat_busy(desc, 0);
 	inet_reply_error_am(INETP(desc), am_closed);
 	DEBUGF(("tcp_recv_closed(%ld): busy reply 'closed'\r\n", port));
     }
@@ -8701,6 +9788,7 @@ static int tcp_recv_closed(tcp_descriptor* desc)
 static int tcp_recv_error(tcp_descriptor* desc, int err)
 {
     if (err != ERRNO_BLOCK) {
+	tcp_delay_cancel(desc);
 	if (IS_BUSY(INETP(desc))) {
 	    /* A send is blocked */
 	    desc->inet.caller = desc->inet.busy_caller;
@@ -8711,6 +9799,8 @@ static int tcp_recv_error(tcp_descriptor* desc, int err)
 	    }
 	    desc->inet.state &= ~INET_F_BUSY;
 	    set_busy_port(desc->inet.port, 0);
+	    if (desc->lat != NULL)
+	        tcp_lat_busy(desc, 0);
 	    inet_reply_error_am(INETP(desc), am_closed);
 	}
 	if (!desc->inet.active) {
@@ -8835,7 +9925,8 @@ static int tcp_deliver(tcp_descriptor* desc, int len)
 	inet_input_count(INETP(desc), len);
 
 	/* deliver binary? */
-	if (len*4 >= desc->i_buf->orig_size*3) { /* >=75% */
+	if ((len*4 >= desc->i_buf->orig_size*3) || /* >=75% */
+	    tcp_share_input(desc, len)) {
 	    code = tcp_reply_binary_data(desc, desc->i_buf,
 					 (desc->i_ptr_start -
 					  desc->i_buf->orig_bytes),
@@ -8847,6 +9938,11 @@ static int tcp_deliver(tcp_descriptor* desc, int len)
 	    if (desc->i_ptr_start + len == desc->i_ptr) { /* no */
 		tcp_clear_input(desc);
 	    }
+	    else if (desc->tcp_add_flags & TCP_ADDF_ADAPTIVE_BUFFER) {
+		/* go on sharing, tcp_restart_input moves the trail */
+		desc->i_ptr_start += len;
+		desc->i_remain = 0;
+	    }
 	    else { /* move trail to beginning of a new buffer */
 		ErlDrvBinary* bin = alloc_buffer(desc->i_bufsz);
 		char* ptr_end = desc->i_ptr_start + len;
@@ -8875,9 +9971,11 @@ static int tcp_deliver(tcp_descriptor* desc, int len)
 
 	count++;
 	len = 0;
+	if (desc->lat != NULL)
+	    tcp_lat_delivered(desc);
 
 	if (!desc->inet.active) {
-	    if (!desc->busy_on_send) {
+	    if (!desc->busy_on_send && !desc->delay_timer) {
 		driver_cancel_timer(desc->inet.port);
 	    }
 	    sock_select(INETP(desc),(FD_READ|FD_CLOSE),0);
@@ -8898,15 +9996,118 @@ static int tcp_deliver(tcp_descriptor* desc, int len)
     return count;
 }
 
+/*
+** recv on a socket with kernel TLS rx: the record type comes as a
+** control message and one call never mixes types. Anything but
+** application data (handshake messages such as NewSessionTicket and
+** KeyUpdate, alerts) would fail a plain recv with EIO.
+*/
+static int tcp_tls_recv(tcp_descriptor* desc, char* buf, int len,
+			int* type, int* eor)
+{
+#ifdef HAVE_LINUX_TLS_H
+    struct msghdr mhdr;
+    struct iovec iov;
+    union {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(sizeof(unsigned char))];
+    } ctl;
+    int n;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    sys_memzero(&mhdr, sizeof(mhdr));
+    mhdr.msg_iov = &iov;
+    mhdr.msg_iovlen = 1;
+    mhdr.msg_control = ctl.buf;
+    mhdr.msg_controllen = sizeof(ctl.buf);
+    n = sock_recvmsg(desc->inet.s, &mhdr, 0);
+    *type = TCP_TLS_RECORD_DATA;
+    if (n > 0) {
+	struct cmsghdr* cmsg;
+	for (cmsg = CMSG_FIRSTHDR(&mhdr); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&mhdr, cmsg)) {
+	    if ((cmsg->cmsg_level == SOL_TLS) &&
+		(cmsg->cmsg_type == TLS_GET_RECORD_TYPE))
+		*type = *(unsigned char*) CMSG_DATA(cmsg);
+	}
+	*eor = (mhdr.msg_flags & MSG_EOR) != 0;
+    }
+    return n;
+#else
+    *type = TCP_TLS_RECORD_DATA;
+    *eor = 0;
+    return sock_recv(desc->inet.s, buf, len, 0);
+#endif
+}
+
+/*
+** A record that is not application data was read to desc->i_ptr
+** (len bytes, done if it is all of it). Fetch the rest, which the
+** kernel has already decrypted, and deliver it on its own as
+** {ssl_tls,S,Type,{Major,Minor},Bin} without touching the buffered
+** stream data.
+*/
+static int tcp_tls_record(tcp_descriptor* desc, int type, int len, int done)
+{
+    char* rec;
+    int code;
+
+    if ((rec = ALLOC(TCP_TLS_MAX_RECORD+1)) == NULL)
+	return tcp_recv_error(desc, ENOMEM);
+    sys_memcpy(rec, desc->i_ptr, len);
+    while (!done) {
+	int rtype, eor;
+	/* one byte of slack makes a completing read always short */
+	int want = TCP_TLS_MAX_RECORD+1 - len;
+	int n;
+
+	if (want <= 0) {
+	    FREE(rec);
+	    return tcp_recv_error(desc, EMSGSIZE);
+	}
+	n = tcp_tls_recv(desc, rec+len, want, &rtype, &eor);
+	if (IS_SOCKET_ERROR(n) || (n == 0) || (rtype != type)) {
+	    int err = IS_SOCKET_ERROR(n) ? sock_errno() : EIO;
+	    FREE(rec);
+	    if (n == 0)
+		return tcp_recv_closed(desc);
+	    return tcp_recv_error(desc, (err == ERRNO_BLOCK) ? EIO : err);
+	}
+	len += n;
+	done = (n < want) || eor;
+    }
+    code = ssl_tls_inetdrv(desc, type,
+			   (desc->tls_rx_vsn >> 8) & 0xff,
+			   desc->tls_rx_vsn & 0xff, rec, len, NULL, 0);
+    FREE(rec);
+    if (code < 0)
+	return code;
+    if (desc->inet.active == INET_ONCE)
+	desc->inet.active = INET_PASSIVE;
+    if (!desc->inet.active) {
+	/* the pending recv got its answer */
+	if (!desc->busy_on_send && !desc->delay_timer)
+	    driver_cancel_timer(desc->inet.port);
+	sock_select(INETP(desc),(FD_READ|FD_CLOSE),0);
+    }
+    if (desc->i_ptr == desc->i_ptr_start)
+	tcp_clear_input(desc);
+    else
+	desc->i_remain = 0;  /* recomputed from the buffer on next read */
+    return 1;
+}
 
 static int tcp_recv(tcp_descriptor* desc, int request_len)
 {
     int n;
     int len;
     int nread;
+    int rtype = TCP_TLS_RECORD_DATA;
+    int eor = 0;
 
     if (desc->i_buf == NULL) {  /* allocte a read buffer */
-	int sz = (request_len > 0) ? request_len : desc->inet.bufsz;
+	int sz = (request_len > 0) ? request_len : tcp_input_size(desc);
 
 	if ((desc->i_buf = alloc_buffer(sz)) == NULL)
 	    return -1;
@@ -8945,7 +10146,12 @@ static int tcp_recv(tcp_descriptor* desc, int request_len)
     DEBUGF(("tcp_recv(%ld): s=%d about to read %d bytes...\r\n",  
 	    (long)desc->inet.port, desc->inet.s, nread));
 
-    n = sock_recv(desc->inet.s, desc->i_ptr, nread, 0);
+    if (desc->tcp_add_flags & TCP_ADDF_TLS_RX)
+	n = tcp_tls_recv(desc, desc->i_ptr, nread, &rtype, &eor);
+    else if (desc->lat != NULL)
+	n = tcp_lat_recv(desc, desc->i_ptr, nread);
+    else
+	n = sock_recv(desc->inet.s, desc->i_ptr, nread, 0);
 
     if (IS_SOCKET_ERROR(n)) {
 	int err = sock_errno();
@@ -8968,7 +10174,12 @@ static int tcp_recv(tcp_descriptor* desc, int request_len)
     }
 
     DEBUGF((" => got %d bytes\r\n", n));
+    if (rtype != TCP_TLS_RECORD_DATA)
+	return tcp_tls_record(desc, rtype, n, (n < nread) || eor);
     desc->i_ptr += n;
+    if ((desc->tcp_add_flags & TCP_ADDF_ADAPTIVE_BUFFER) &&
+	(desc->i_remain == 0))
+	tcp_adapt_input(desc, n, nread);
     if (desc->i_remain > 0) {
 	desc->i_remain -= n;
 	if (desc->i_remain == 0)
@@ -9176,6 +10387,25 @@ static void tcp_inet_event(ErlDrvData e, ErlDrvEvent event)
 #endif /* WIN32 */
 
 
+/* The last waiting acceptor has got its connection: accept up to
+** multi_accept more from the backlog, for later accept requests to
+** pick up without waiting for the next poll.
+*/
+static void tcp_accept_ahead(tcp_descriptor* desc)
+{
+    SOCKET s;
+    unsigned int len;
+    inet_address remote;
+
+    while (desc->n_accepted < desc->multi_accept) {
+	len = sizeof(desc->inet.remote);
+	s = sock_accept(desc->inet.s, (struct sockaddr*) &remote, &len);
+	if (s == INVALID_SOCKET)
+	    break;
+	enq_accepted(desc, s, &remote);
+    }
+}
+
 /* socket has input:
 ** 1. INET_STATE_ACCEPTING  => non block accept ?
 ** 2. INET_STATE_CONNECTED => read input
@@ -9245,6 +10475,7 @@ static int tcp_inet_input(tcp_descriptor* desc, HANDLE event)
 #endif
 	    accept_desc->inet.state = INET_STATE_CONNECTED;
 	    ret =  async_ok_port(INETP(desc), accept_desc->inet.dport);
+	    tcp_accept_ahead(desc);
 	    goto done;
 	}
     } else if (desc->inet.state == INET_STATE_MULTI_ACCEPTING) {
@@ -9315,6 +10546,7 @@ static int tcp_inet_input(tcp_descriptor* desc, HANDLE event)
 					  id, caller, accept_desc->inet.dport);
 	    }
 	}
+	tcp_accept_ahead(desc);
     }
     else if (IS_CONNECTED(INETP(desc))) {
 	ret = tcp_recv(desc, 0);
@@ -9333,6 +10565,7 @@ static int tcp_inet_input(tcp_descriptor* desc, HANDLE event)
 
 static int tcp_send_error(tcp_descriptor* desc, int err)
 {
+    tcp_delay_cancel(desc);
     /*
      * If the port is busy, we must do some clean-up before proceeding.
      */
@@ -9344,6 +10577,8 @@ static int tcp_send_error(tcp_descriptor* desc, int err)
 	}
 	desc->inet.state &= ~INET_F_BUSY;
 	set_busy_port(desc->inet.port, 0);
+	if (desc->lat != NULL)
+	    tcp_lat_busy(desc, 0);
     }
 
     /*
@@ -9394,7 +10629,7 @@ static int tcp_send_error(tcp_descriptor* desc, int err)
 static int tcp_sendv(tcp_descriptor* desc, ErlIOVec* ev)
 {
     ErlDrvSizeT sz;
-    char buf[4];
+    char buf[PACKET_VARINT_MAX];
     ErlDrvSizeT h_len;
     ssize_t n;
     ErlDrvPort ix = desc->inet.port;
@@ -9413,6 +10648,17 @@ static int tcp_sendv(tcp_descriptor* desc, ErlIOVec* ev)
          put_int32(len, buf);
          h_len = 4;
          break;
+     case TCP_PB_2_LITTLE:
+         put_little_int16(len, buf);
+         h_len = 2;
+         break;
+     case TCP_PB_4_LITTLE:
+         put_little_int32(len, buf);
+         h_len = 4;
+         break;
+     case TCP_PB_VARINT:
+         h_len = packet_put_varint(len, buf);
+         break;
      default:
          if (len == 0)
              return 0;
@@ -9430,18 +10676,26 @@ static int tcp_sendv(tcp_descriptor* desc, ErlIOVec* ev)
 
     if ((sz = driver_sizeq(ix)) > 0) {
 	driver_enqv(ix, ev, 0);
+	if (desc->lat != NULL)
+	    tcp_lat_queued(desc, ev->size);
 	if (sz+ev->size >= desc->high) {
 	    DEBUGF(("tcp_sendv(%ld): s=%d, sender forced busy\r\n",
 		    (long)desc->inet.port, desc->inet.s));
 	    desc->inet.state |= INET_F_BUSY;  /* mark for low-watermark */
 	    desc->inet.busy_caller = desc->inet.caller;
 	    set_busy_port(desc->inet.port, 1);
+	    if (desc->lat != NULL)
+		tcp_lat_busy(desc, 1);
+	    tcp_delay_flush(desc);
 	    if (desc->send_timeout != INET_INFINITY) {
 		desc->busy_on_send = 1;
 		driver_set_timer(desc->inet.port, desc->send_timeout);
 	    }
 	    return 1;
 	}
+	else if ((desc->tcp_add_flags & TCP_ADDF_DELAY_SEND) &&
+		 !INETP(desc)->is_ignored && (desc->sp_fd < 0))
+	    return tcp_delay_send(desc);
     }
     else {
 	int vsize = (ev->vsize > MAX_VSIZE) ? MAX_VSIZE : ev->vsize;
@@ -9452,7 +10706,8 @@ static int tcp_sendv(tcp_descriptor* desc, ErlIOVec* ev)
 	if (INETP(desc)->is_ignored) {
 	    INETP(desc)->is_ignored |= INET_IGNORE_WRITE;
 	    n = 0;
-	} else if (desc->tcp_add_flags & TCP_ADDF_DELAY_SEND) {
+	} else if ((desc->tcp_add_flags & TCP_ADDF_DELAY_SEND) ||
+		   (desc->sp_fd >= 0)) {
 	    n = 0;
 	} else if (IS_SOCKET_ERROR(sock_sendv(desc->inet.s, ev->iov,
 					      vsize, &n, 0))) {
@@ -9470,6 +10725,8 @@ static int tcp_sendv(tcp_descriptor* desc, ErlIOVec* ev)
 	}
 	else if (n == ev->size) {
 	    ASSERT(NO_SUBSCRIBERS(&INETP(desc)->empty_out_q_subs));
+	    if (desc->lat != NULL)
+		tcp_lat_queued(desc, 0);
 	    return 0;
 	}
 	else {
@@ -9482,6 +10739,11 @@ static int tcp_sendv(tcp_descriptor* desc, ErlIOVec* ev)
 	DEBUGF(("tcp_sendv(%ld): s=%d, Send failed, queuing\r\n", 
 		(long)desc->inet.port, desc->inet.s));
 	driver_enqv(ix, ev, n); 
+	if (desc->lat != NULL)
+	    tcp_lat_queued(desc, ev->size - n);
+	if ((desc->tcp_add_flags & TCP_ADDF_DELAY_SEND) &&
+	    !INETP(desc)->is_ignored && (desc->sp_fd < 0))
+	    return tcp_delay_send(desc);
 	if (!INETP(desc)->is_ignored)
 	    sock_select(INETP(desc),(FD_WRITE|FD_CLOSE), 1);
     }
@@ -9494,7 +10756,7 @@ static int tcp_sendv(tcp_descriptor* desc, ErlIOVec* ev)
 static int tcp_send(tcp_descriptor* desc, char* ptr, ErlDrvSizeT len)
 {
     int sz;
-    char buf[4];
+    char buf[PACKET_VARINT_MAX];
     int h_len;
     int n;
     ErlDrvPort ix = desc->inet.port;
@@ -9513,6 +10775,17 @@ static int tcp_send(tcp_descriptor* desc, char* ptr, ErlDrvSizeT len)
 	put_int32(len, buf);
 	h_len = 4; 
 	break;
+    case TCP_PB_2_LITTLE:
+	put_little_int16(len, buf);
+	h_len = 2;
+	break;
+    case TCP_PB_4_LITTLE:
+	put_little_int32(len, buf);
+	h_len = 4;
+	break;
+    case TCP_PB_VARINT:
+	h_len = packet_put_varint(len, buf);
+	break;
     default:
 	if (len == 0)
 	    return 0;
@@ -9527,18 +10800,26 @@ static int tcp_send(tcp_descriptor* desc, char* ptr, ErlDrvSizeT len)
 	if (h_len > 0)
 	    driver_enq(ix, buf, h_len);
 	driver_enq(ix, ptr, len);
+	if (desc->lat != NULL)
+	    tcp_lat_queued(desc, h_len+len);
 	if (sz+h_len+len >= desc->high) {
 	    DEBUGF(("tcp_send(%ld): s=%d, sender forced busy\r\n",
 		    (long)desc->inet.port, desc->inet.s));
 	    desc->inet.state |= INET_F_BUSY;  /* mark for low-watermark */
 	    desc->inet.busy_caller = desc->inet.caller;
 	    set_busy_port(desc->inet.port, 1);
+	    if (desc->lat != NULL)
+		tcp_lat_busy(desc, 1);
+	    tcp_delay_flush(desc);
 	    if (desc->send_timeout != INET_INFINITY) {
 		desc->busy_on_send = 1;
 		driver_set_timer(desc->inet.port, desc->send_timeout);
 	    }
 	    return 1;
 	}
+	else if ((desc->tcp_add_flags & TCP_ADDF_DELAY_SEND) &&
+		 !INETP(desc)->is_ignored && (desc->sp_fd < 0))
+	    return tcp_delay_send(desc);
     }
     else {
 	iov[0].iov_base = buf;
@@ -9554,6 +10835,8 @@ static int tcp_send(tcp_descriptor* desc, char* ptr, ErlDrvSizeT len)
 	} else if (desc->tcp_add_flags & TCP_ADDF_DELAY_SEND) {
 	    sock_send(desc->inet.s, buf, 0, 0);
 	    n = 0;
+	} else if (desc->sp_fd >= 0) {
+	    n = 0;
 	} else 	if (IS_SOCKET_ERROR(sock_sendv(desc->inet.s,iov,2,&n,0))) {
 	    if ((sock_errno() != ERRNO_BLOCK) && (sock_errno() != EINTR)) {
 		int err = sock_errno();
@@ -9568,12 +10851,16 @@ static int tcp_send(tcp_descriptor* desc, char* ptr, ErlDrvSizeT len)
 	}
 	else if (n == len+h_len) {
 	    ASSERT(NO_SUBSCRIBERS(&INETP(desc)->empty_out_q_subs));
+	    if (desc->lat != NULL)
+		tcp_lat_queued(desc, 0);
 	    return 0;
 	}
 
 	DEBUGF(("tcp_send(%ld): s=%d, Send failed, queuing", 
 		(long)desc->inet.port, desc->inet.s));
 
+	if (desc->lat != NULL)
+	    tcp_lat_queued(desc, h_len+len-n);
 	if (n < h_len) {
 	    driver_enq(ix, buf+n, h_len-n);
 	    driver_enq(ix, ptr, len);
@@ -9582,20 +10869,86 @@ static int tcp_send(tcp_descriptor* desc, char* ptr, ErlDrvSizeT len)
 	    n -= h_len;
 	    driver_enq(ix, ptr+n, len-n);
 	}
+	if ((desc->tcp_add_flags & TCP_ADDF_DELAY_SEND) &&
+	    !INETP(desc)->is_ignored && (desc->sp_fd < 0))
+	    return tcp_delay_send(desc);
 	if (!INETP(desc)->is_ignored)
 	    sock_select(INETP(desc),(FD_WRITE|FD_CLOSE), 1);
     }
     return 0;
 }
 
+/*
+** delay_send: the output just queued is not written until the next
+** poll, so that what a process sends in one go leaves in a single
+** writev. delay_send_time holds it longer, on the port timer, and
+** delay_send_bytes writes everything at once when that much is
+** queued. The timer is only borrowed while no one else needs it;
+** a recv or send timeout flushes first.
+*/
+static int tcp_delay_send(tcp_descriptor* desc)
+{
+    if (desc->inet.event_mask & FD_WRITE)
+	return 0;    /* already on its way out */
+    if ((desc->delay_bytes > 0) &&
+	(driver_sizeq(desc->inet.port) >= desc->delay_bytes)) {
+	if (desc->delay_timer) {
+	    desc->delay_timer = 0;
+	    driver_cancel_timer(desc->inet.port);
+	}
+	sock_select(INETP(desc),(FD_WRITE|FD_CLOSE), 1);
+	return tcp_inet_output(desc, (HANDLE) desc->inet.event);
+    }
+    if ((desc->delay_time > 0) && (desc->inet.opt == NULL) &&
+	!desc->busy_on_send) {
+	if (!desc->delay_timer) {
+	    desc->delay_timer = 1;
+	    driver_set_timer(desc->inet.port, desc->delay_time);
+	}
+	return 0;
+    }
+    tcp_delay_flush(desc);
+    return 0;
+}
+
+/*
+** Stop holding output, it goes at the next poll.
+*/
+static void tcp_delay_flush(tcp_descriptor* desc)
+{
+    tcp_delay_cancel(desc);
+    if (IS_CONNECTED(INETP(desc)) && !INETP(desc)->is_ignored &&
+	(desc->sp_fd < 0) && (driver_sizeq(desc->inet.port) > 0))
+	sock_select(INETP(desc),(FD_WRITE|FD_CLOSE), 1);
+}
+
+/*
+** Give the timer back, the socket is closing.
+*/
+static void tcp_delay_cancel(tcp_descriptor* desc)
+{
+    if (desc->delay_timer) {
+	desc->delay_timer = 0;
+	driver_cancel_timer(desc->inet.port);
+    }
+}
+
 static void tcp_inet_drv_output(ErlDrvData data, ErlDrvEvent event)
 {
-    (void)tcp_inet_output((tcp_descriptor*)data, (HANDLE)event);
+    tcp_descriptor* desc = (tcp_descriptor*)data;
+    if ((desc->sp_fd >= 0) && IS_CONNECTED(INETP(desc)))
+	(void)tcp_splice_run(desc);
+    else
+	(void)tcp_inet_output(desc, (HANDLE)event);
 }
 
 static void tcp_inet_drv_input(ErlDrvData data, ErlDrvEvent event)
 {
-    (void)tcp_inet_input((tcp_descriptor*)data, (HANDLE)event);
+    tcp_descriptor* desc = (tcp_descriptor*)data;
+    if ((desc->sp_fd >= 0) && ((long)event == (long)desc->sp_fd))
+	(void)tcp_splice_run(desc);
+    else
+	(void)tcp_inet_input(desc, (HANDLE)event);
 }
 
 /* socket ready for ouput:
@@ -9682,11 +11035,15 @@ static int tcp_inet_output(tcp_descriptor* desc, HANDLE event)
 #endif
 		goto done;
 	    }
+	    if (desc->lat != NULL)
+		tcp_lat_written(desc, n);
 	    if (driver_deq(ix, n) <= desc->low) {
 		if (IS_BUSY(INETP(desc))) {
 		    desc->inet.caller = desc->inet.busy_caller;
 		    desc->inet.state &= ~INET_F_BUSY;
 		    set_busy_port(desc->inet.port, 0);
+		    if (desc->lat != NULL)
+		        tcp_lat_busy(desc, 0);
 		    /* if we have a timer then cancel and send ok to client */
 		    if (desc->busy_on_send) {
 			driver_cancel_timer(desc->inet.port);
@@ -9822,6 +11179,8 @@ static ErlDrvData packet_inet_start(ErlDrvPort port, char* args, int protocol)
 	return ERL_DRV_ERROR_ERRNO;
 
     desc->read_packets = INET_PACKET_POLL;
+    desc->recv_batch = 0;
+    desc->batch = NULL;
     desc->i_bufsz = 0;
     desc->i_buf = NULL;
     desc->i_ptr = NULL;
@@ -9853,6 +11212,10 @@ static void packet_inet_stop(ErlDrvData e)
 	release_buffer(udesc->i_buf);
 	udesc->i_buf = NULL;
     }
+    if (udesc->batch != NULL) {
+	FREE(udesc->batch);
+	udesc->batch = NULL;
+    }
 
     ASSERT(NO_SUBSCRIBERS(&(descr->empty_out_q_subs)));
     inet_stop(descr);
@@ -9870,6 +11233,110 @@ static int packet_error(udp_descriptor* udesc, int err)
 /*
 ** Various functions accessible via "port_control" on the Erlang side:
 */
+/* Next datagram of a UDP_REQ_SENDMULTI request:
+** Len(4) P1 P0 Address Data(Len)
+*/
+static char* packet_multi_next(inet_descriptor* desc, char* ptr,
+			       ErlDrvSizeT* rem, inet_address* addr,
+			       unsigned int* alen, char** data, int* dlen)
+{
+    ErlDrvSizeT sz;
+    char* qtr;
+
+    if (*rem < 4)
+	return NULL;
+    *dlen = get_int32(ptr);
+    ptr += 4;
+    sz = *rem - 4;
+    if ((qtr = inet_set_address(desc->sfamily, addr, ptr, &sz)) == NULL)
+	return NULL;
+    *alen = sz;
+    *rem -= 4 + (qtr - ptr);
+    if (*rem < *dlen)
+	return NULL;
+    *data = qtr;
+    *rem -= *dlen;
+    return qtr + *dlen;
+}
+
+/* Send all datagrams in buf (sendmmsg where available), return 0 or
+** an error code. The datagrams before a failing one have been sent.
+*/
+static int packet_sendmulti(udp_descriptor* udesc, char* buf, ErlDrvSizeT len)
+{
+    inet_descriptor* desc = INETP(udesc);
+    int connected = (desc->state & INET_F_ACTIVE);
+    inet_address other;
+    unsigned int alen;
+    ErlDrvSizeT rem;
+    char* ptr;
+    char* data;
+    int dlen;
+    int n = 0;
+    int k;
+
+    for (ptr = buf, rem = len; rem > 0; n++) {
+	ptr = packet_multi_next(desc, ptr, &rem, &other, &alen, &data, &dlen);
+	if (ptr == NULL)
+	    return EINVAL;
+    }
+    if (n == 0)
+	return 0;
+#ifdef HAVE_SENDMMSG
+    {
+	struct mmsghdr* msg;
+	struct iovec* iov;
+	inet_address* addr;
+	int err = 0;
+
+	msg = ALLOC(n*(sizeof(struct mmsghdr) + sizeof(struct iovec)
+		       + sizeof(inet_address)));
+	if (msg == NULL)
+	    return ENOMEM;
+	iov = (struct iovec*) (msg + n);
+	addr = (inet_address*) (iov + n);
+	for (ptr = buf, rem = len, k = 0; k < n; k++) {
+	    ptr = packet_multi_next(desc, ptr, &rem, &addr[k], &alen,
+				    &data, &dlen);
+	    iov[k].iov_base = data;
+	    iov[k].iov_len = dlen;
+	    msg[k].msg_hdr.msg_name = connected ? NULL : &addr[k];
+	    msg[k].msg_hdr.msg_namelen = connected ? 0 : alen;
+	    msg[k].msg_hdr.msg_iov = &iov[k];
+	    msg[k].msg_hdr.msg_iovlen = 1;
+	    msg[k].msg_hdr.msg_control = NULL;
+	    msg[k].msg_hdr.msg_controllen = 0;
+	    msg[k].msg_hdr.msg_flags = 0;
+	}
+	for (k = 0; k < n; ) {
+	    int sent = sendmmsg(desc->s, msg + k, n - k, 0);
+	    if (IS_SOCKET_ERROR(sent)) {
+		err = sock_errno();
+		break;
+	    }
+	    for (sent += k; k < sent; k++)
+		inet_output_count(desc, iov[k].iov_len);
+	}
+	FREE(msg);
+	return err;
+    }
+#else
+    for (ptr = buf, rem = len, k = 0; k < n; k++) {
+	int code;
+
+	ptr = packet_multi_next(desc, ptr, &rem, &other, &alen, &data, &dlen);
+	if (connected)
+	    code = sock_send(desc->s, data, dlen, 0);
+	else
+	    code = sock_sendto(desc->s, data, dlen, 0, &other.sa, alen);
+	if (IS_SOCKET_ERROR(code))
+	    return sock_errno();
+	inet_output_count(desc, dlen);
+    }
+    return 0;
+#endif
+}
+
 static ErlDrvSSizeT packet_inet_ctl(ErlDrvData e, unsigned int cmd, char* buf,
 				    ErlDrvSizeT len, char** rbuf, ErlDrvSizeT rsize)
 {
@@ -10224,6 +11691,20 @@ static ErlDrvSSizeT packet_inet_ctl(ErlDrvData e, unsigned int cmd, char* buf,
 	    }
 	    return ctl_reply(INET_REP_OK, tbuf, 2, rbuf, rsize);
 	}
+
+    case UDP_REQ_SENDMULTI: {
+	int err;
+
+	DEBUGF(("packet_inet_ctl(%ld): SENDMULTI\r\n", (long)desc->port));
+	/* INPUT: [Len(4), P1, P0, Address, Data(Len)]* */
+	if (!IS_OPEN(desc))
+	    return ctl_xerror(EXBADPORT, rbuf, rsize);
+	if (!IS_BOUND(desc) || desc->sprotocol != IPPROTO_UDP)
+	    return ctl_error(EINVAL, rbuf, rsize);
+	if ((err = packet_sendmulti(udesc, buf, len)) != 0)
+	    return ctl_error(err, rbuf, rsize);
+	return ctl_reply(INET_REP_OK, NULL, 0, rbuf, rsize);
+    }
 	
     default:
 	/* Delegate the request to the INET layer. In particular,
@@ -10380,6 +11861,181 @@ static void packet_inet_drv_input(ErlDrvData e, ErlDrvEvent event)
     (void)  packet_inet_input((udp_descriptor*)e, (HANDLE)event);
 }
 
+#define LOAD_BATCH_ENTRY_CNT						\
+    (8*LOAD_INT_CNT + LOAD_TUPLE_CNT + LOAD_INT_CNT +			\
+     LOAD_BINARY_CNT + LOAD_STRING_CONS_CNT + LOAD_TUPLE_CNT)
+#define LOAD_BATCH_CNT(n)						\
+    (LOAD_ATOM_CNT + LOAD_PORT_CNT + (n)*LOAD_BATCH_ENTRY_CNT +		\
+     LOAD_NIL_CNT + LOAD_LIST_CNT + LOAD_TUPLE_CNT)
+
+/*
+** The slots are allocated on the first batch and kept. A slot is never
+** larger than a datagram can be, and the slots take at most
+** INET_PACKET_BATCH_BYTES, so a large buffer gives fewer slots.
+*/
+static packet_batch* packet_batch_alloc(udp_descriptor* udesc)
+{
+    packet_batch* b = udesc->batch;
+    int n = udesc->recv_batch;
+    int bufsz = INETP(udesc)->bufsz;
+    char* ptr;
+
+    if (bufsz > INET_PACKET_MAX_SIZE)
+	bufsz = INET_PACKET_MAX_SIZE;
+    if (n > INET_PACKET_BATCH_BYTES / bufsz)
+	n = INET_PACKET_BATCH_BYTES / bufsz;
+    if (n < 1)
+	n = 1;
+    if (b != NULL && b->n == n && b->bufsz == bufsz)
+	return b;
+    if (b != NULL)
+	FREE(b);
+    b = ALLOC(sizeof(packet_batch) + n*sizeof(inet_address)
+#ifdef HAVE_RECVMMSG
+	      + n*(sizeof(struct mmsghdr) + sizeof(struct iovec))
+#endif
+	      + LOAD_BATCH_CNT(n)*sizeof(ErlDrvTermData)
+	      + n*(bufsz + sizeof(unsigned int) + sizeof(int)));
+    udesc->batch = b;
+    if (b == NULL)
+	return NULL;
+    b->n = n;
+    b->bufsz = bufsz;
+    ptr = (char*) (b + 1);
+    b->addr = (inet_address*) ptr;
+    ptr += n*sizeof(inet_address);
+#ifdef HAVE_RECVMMSG
+    b->msg = (struct mmsghdr*) ptr;
+    ptr += n*sizeof(struct mmsghdr);
+    b->iov = (struct iovec*) ptr;
+    ptr += n*sizeof(struct iovec);
+#endif
+    b->spec = (ErlDrvTermData*) ptr;
+    ptr += LOAD_BATCH_CNT(n)*sizeof(ErlDrvTermData);
+    b->alen = (unsigned int*) ptr;
+    ptr += n*sizeof(unsigned int);
+    b->len = (int*) ptr;
+    ptr += n*sizeof(int);
+    b->data = ptr;
+    return b;
+}
+
+/*
+** Read up to recv_batch datagrams (with one recvmmsg call where
+** available) and deliver them to an active socket as one message:
+**        {udp_batch, S, [{IP, Port, [H1,...Hsz | Data]}, ...]}
+*/
+static int packet_batch_input(udp_descriptor* udesc)
+{
+    inet_descriptor* desc = INETP(udesc);
+    packet_batch* b;
+    ErlDrvBinary* bin = NULL;
+    ErlDrvTermData* spec;
+    char abuf[sizeof(inet_address)];
+    int connected = (desc->state & INET_F_ACTIVE);
+    int k, n, i, code;
+    int total;
+
+    if ((b = packet_batch_alloc(udesc)) == NULL)
+	return packet_error(udesc, ENOMEM);
+
+#ifdef HAVE_RECVMMSG
+    for (k = 0; k < b->n; k++) {
+	b->iov[k].iov_base = b->data + k*b->bufsz;
+	b->iov[k].iov_len = b->bufsz;
+	b->msg[k].msg_hdr.msg_name = connected ? NULL : &b->addr[k];
+	b->msg[k].msg_hdr.msg_namelen = connected ? 0 : sizeof(inet_address);
+	b->msg[k].msg_hdr.msg_iov = &b->iov[k];
+	b->msg[k].msg_hdr.msg_iovlen = 1;
+	b->msg[k].msg_hdr.msg_control = NULL;
+	b->msg[k].msg_hdr.msg_controllen = 0;
+	b->msg[k].msg_hdr.msg_flags = 0;
+    }
+    n = recvmmsg(desc->s, b->msg, b->n, 0, NULL);
+    if (IS_SOCKET_ERROR(n))
+	n = 0;
+    for (k = 0; k < n; k++) {
+	b->len[k] = b->msg[k].msg_len;
+	b->alen[k] = b->msg[k].msg_hdr.msg_namelen;
+    }
+#else
+    for (n = 0; n < b->n; n++) {
+	char* ptr = b->data + n*b->bufsz;
+	int m;
+
+	if (connected) {
+	    m = sock_recv(desc->s, ptr, b->bufsz, 0);
+	} else {
+	    b->alen[n] = sizeof(inet_address);
+	    m = sock_recvfrom(desc->s, ptr, b->bufsz, 0,
+			      &b->addr[n].sa, &b->alen[n]);
+	}
+	if (IS_SOCKET_ERROR(m))
+	    break;
+	b->len[n] = m;
+    }
+#endif
+    if (n == 0) {
+	int err = sock_errno();
+	if (err != ERRNO_BLOCK)
+	    packet_error_message(udesc, err);
+	return 0;
+    }
+
+    total = 0;
+    for (k = 0; k < n; k++) {
+	total += b->len[k];
+	inet_input_count(desc, b->len[k]);
+	scanbit8(desc, b->data + k*b->bufsz, b->len[k]);
+    }
+    if (desc->mode == INET_MODE_BINARY) {
+	if ((bin = alloc_buffer(total)) == NULL)
+	    return packet_error(udesc, ENOMEM);
+    }
+
+    spec = b->spec;
+    i = LOAD_ATOM(spec, 0, am_udp_batch);
+    i = LOAD_PORT(spec, i, desc->dport);
+    total = 0;
+    for (k = 0; k < n; k++) {
+	char* ptr = b->data + k*b->bufsz;
+	unsigned int hsz = desc->hsz;
+	unsigned int alen = connected ? sizeof(inet_address) : b->alen[k];
+	int len = b->len[k];
+
+	if (inet_get_address(desc->sfamily, abuf,
+			     connected ? &desc->remote : &b->addr[k],
+			     &alen) < 0)
+	    sys_memzero(abuf, sizeof(abuf));
+	i = load_ip_address(spec, i, desc->sfamily, abuf+3);
+	i = load_ip_port(spec, i, abuf+1);
+	if (bin == NULL || hsz > len)
+	    i = LOAD_STRING(spec, i, ptr, len);
+	else {
+	    sys_memcpy(bin->orig_bytes + total, ptr, len);
+	    i = LOAD_BINARY(spec, i, bin, total + hsz, len - hsz);
+	    if (hsz > 0)
+		i = LOAD_STRING_CONS(spec, i, bin->orig_bytes + total, hsz);
+	    total += len;
+	}
+	i = LOAD_TUPLE(spec, i, 3);
+    }
+    i = LOAD_NIL(spec, i);
+    i = LOAD_LIST(spec, i, n+1);
+    i = LOAD_TUPLE(spec, i, 3);
+    ASSERT(i <= LOAD_BATCH_CNT(b->n));
+    code = driver_output_term(desc->port, spec, i);
+    if (bin != NULL)
+	free_buffer(bin);
+    if (code < 0)
+	return 0;
+    if (desc->active == INET_ONCE) {
+	desc->active = INET_PASSIVE;
+	sock_select(desc, FD_READ, 0);
+    }
+    return 1;
+}
+
 /*
 ** THIS IS A BACK-END FOR "recv*" REQUEST, which actually receives the
 **	data requested, and delivers them to the caller:
@@ -10399,6 +12055,15 @@ static int packet_inet_input(udp_descriptor* udesc, HANDLE event)
     int short_recv = 0;
 #endif
 
+    if (udesc->recv_batch > 0 && desc->active
+	&& desc->deliver == INET_DELIVER_TERM
+#ifdef HAVE_SCTP
+	&& !IS_SCTP(desc)
+#endif
+	) {
+	return packet_batch_input(udesc);
+    }
+
     while(packet_count--) {
 	unsigned int len = sizeof(other);
 
@@ -0,0 +1,654 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2013. All Rights Reserved.
+ *
+ * The contents of this file are subject to the Erlang Public License,
+ * Version 1.1, (the "License"); you may not use this file except in
+ * compliance with the License. You should have received a copy of the
+ * Erlang Public License along with this software. If not, it can be
+ * retrieved online at http://www.erlang.org/.
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * %CopyrightEnd%
+ */
+/*
+ * In-VM native name lookups.
+ *
+ * Speaks the same request/reply protocol as the inet_gethost port
+ * program (erts/etc/common/inet_gethost.c) so that inet_gethost_native
+ * can use either, but resolves the names in a small pool of driver
+ * threads instead of forked worker processes behind a pipe.
+ *
+ * The threads only run getaddrinfo()/getnameinfo(), which may block
+ * for as long as the system resolver likes; that is why they are not
+ * taken from the async thread pool, where a slow name server would
+ * hold up file operations. Finished lookups are put on a done queue
+ * and the emulator is woken through a pipe selected with
+ * driver_select(), so replies are delivered from erl_check_io like
+ * any other port input.
+ *
+ * Request:  Serial:32 Op:8 Proto:8 Data
+ * Reply:    Serial:32 Unit:8 ...  (see build_reply below)
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "erl_driver.h"
+
+#if defined(USE_THREADS) && !defined(__WIN32__) \
+    && defined(HAVE_GETADDRINFO) && defined(HAVE_GETNAMEINFO)
+#  define GH_SUPPORTED 1
+#endif
+
+#ifdef GH_SUPPORTED
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/types.h>
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <netdb.h>
+#endif
+
+#define OP_GETHOSTBYNAME 	1
+#define OP_GETHOSTBYADDR 	2
+#define OP_CANCEL_REQUEST 	3
+#define OP_CONTROL 		4
+
+#define PROTO_IPV4 	1
+#define PROTO_IPV6 	2
+
+#define UNIT_ERROR 	0
+
+#define GH_DEFAULT_POOLSIZE 	4
+#define GH_MAX_POOLSIZE 	256
+
+#define get_int32(s) ((((unsigned char*) (s))[0] << 24) | \
+                      (((unsigned char*) (s))[1] << 16) | \
+                      (((unsigned char*) (s))[2] << 8)  | \
+                      (((unsigned char*) (s))[3]))
+
+#define put_int32(i, s) do {((char*)(s))[0] = (char)((i) >> 24) & 0xff; \
+                            ((char*)(s))[1] = (char)((i) >> 16) & 0xff; \
+                            ((char*)(s))[2] = (char)((i) >> 8)  & 0xff; \
+                            ((char*)(s))[3] = (char)(i)         & 0xff;} \
+                        while (0)
+
+static int gh_init(void);
+static ErlDrvData gh_start(ErlDrvPort, char*);
+static void gh_stop(ErlDrvData);
+static void gh_command(ErlDrvData, char*, ErlDrvSizeT);
+static void gh_ready_input(ErlDrvData, ErlDrvEvent);
+static void gh_stop_select(ErlDrvEvent, void*);
+
+struct erl_drv_entry inet_gethost_driver_entry = {
+    gh_init,
+    gh_start,
+    gh_stop,
+    gh_command,
+    gh_ready_input,
+    NULL,
+    "inet_gethost_drv",
+    NULL,
+    NULL, /* handle */
+    NULL, /* control */
+    NULL, /* timeout */
+    NULL, /* outputv */
+    NULL, /* ready_async */
+    NULL, /* flush */
+    NULL, /* call */
+    NULL, /* event */
+    ERL_DRV_EXTENDED_MARKER,
+    ERL_DRV_EXTENDED_MAJOR_VERSION,
+    ERL_DRV_EXTENDED_MINOR_VERSION,
+    0,
+    NULL,
+    NULL,
+    gh_stop_select
+};
+
+#ifdef GH_SUPPORTED
+
+typedef struct gh_request {
+    struct gh_request* next;
+    unsigned serial;
+    int op;
+    int proto;
+    ErlDrvBinary* reply;	/* Filled in by the thread that did it */
+    ErlDrvSizeT len;		/* Length of data, then of reply */
+    char data[1];		/* Name (0 terminated) or address */
+} GhRequest;
+
+typedef struct gh_descriptor {
+    ErlDrvPort port;
+    ErlDrvMutex* mtx;
+    ErlDrvCond* cnd;
+    GhRequest* todo;		/* Waiting for a thread */
+    GhRequest* todo_last;
+    GhRequest* done;		/* Waiting for gh_ready_input */
+    GhRequest* done_last;
+    int stopping;
+    int exited;			/* Threads that have left gh_worker */
+    int signalled;		/* A wakeup byte is in the pipe */
+    int wake[2];		/* [0] selected by us, [1] written by threads */
+    int nthreads;
+    ErlDrvTid* tids;
+    struct gh_descriptor* next_dead;
+} GhDescriptor;
+
+/*
+** Stopped ports whose threads are still inside a lookup. Only touched
+** from gh_start/gh_stop, which the driver lock serializes.
+*/
+static GhDescriptor* gh_graveyard = NULL;
+
+static ErlDrvBinary* build_error_reply(unsigned serial, char* errstring,
+				       ErlDrvSizeT* lenp);
+static ErlDrvBinary* build_reply(unsigned serial, int addrlen,
+				 struct addrinfo* res0, ErlDrvSizeT* lenp);
+static void gh_lookup(GhRequest* req);
+static void* gh_worker(void* arg);
+static void gh_free_list(GhRequest* req);
+static void gh_free_desc(GhDescriptor* desc);
+static void gh_reap(void);
+
+#endif /* GH_SUPPORTED */
+
+static int gh_init(void)
+{
+    return 0;
+}
+
+#ifdef GH_SUPPORTED
+
+static ErlDrvData gh_start(ErlDrvPort port, char* command)
+{
+    GhDescriptor* desc;
+    char* p;
+    long n = GH_DEFAULT_POOLSIZE;
+    int i;
+
+    gh_reap();
+
+    /* command is "inet_gethost_drv [PoolSize]" */
+    if ((p = strchr(command, ' ')) != NULL) {
+	n = strtol(p, NULL, 10);
+	if (n <= 0)
+	    n = GH_DEFAULT_POOLSIZE;
+	else if (n > GH_MAX_POOLSIZE)
+	    n = GH_MAX_POOLSIZE;
+    }
+
+    desc = (GhDescriptor*) driver_alloc(sizeof(GhDescriptor));
+    if (desc == NULL)
+	return ERL_DRV_ERROR_ERRNO;
+    memset(desc, 0, sizeof(GhDescriptor));
+    desc->port = port;
+    desc->wake[0] = desc->wake[1] = -1;
+
+    if (pipe(desc->wake) < 0) {
+	driver_free(desc);
+	return ERL_DRV_ERROR_ERRNO;
+    }
+    fcntl(desc->wake[0], F_SETFL, fcntl(desc->wake[0], F_GETFL) | O_NONBLOCK);
+    fcntl(desc->wake[1], F_SETFL, fcntl(desc->wake[1], F_GETFL) | O_NONBLOCK);
+
+    desc->mtx = erl_drv_mutex_create("inet_gethost_drv");
+    desc->cnd = erl_drv_cond_create("inet_gethost_drv");
+    desc->tids = (ErlDrvTid*) driver_alloc(n * sizeof(ErlDrvTid));
+    if (desc->mtx == NULL || desc->cnd == NULL || desc->tids == NULL)
+	goto error;
+
+    for (i = 0; i < n; i++) {
+	if (erl_drv_thread_create("inet_gethost_drv", &desc->tids[i],
+				  gh_worker, desc, NULL) != 0)
+	    break;
+	desc->nthreads++;
+    }
+    if (desc->nthreads == 0)
+	goto error;
+    driver_select(port, (ErlDrvEvent)(long) desc->wake[0],
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+    return (ErlDrvData) desc;
+
+ error:
+    gh_free_desc(desc);
+    return ERL_DRV_ERROR_GENERAL;
+}
+
+/*
+** Queued lookups are dropped. A thread cannot be taken out of
+** getaddrinfo() though, so if some are still running the descriptor
+** is left in the graveyard and joined by a later start or stop
+** once they have finished, instead of blocking the scheduler here.
+*/
+static void gh_stop(ErlDrvData data)
+{
+    GhDescriptor* desc = (GhDescriptor*) data;
+
+    driver_select(desc->port, (ErlDrvEvent)(long) desc->wake[0],
+		  ERL_DRV_USE, 0);
+    desc->wake[0] = -1;
+
+    erl_drv_mutex_lock(desc->mtx);
+    desc->stopping = 1;
+    erl_drv_cond_broadcast(desc->cnd);
+    gh_free_list(desc->todo);
+    desc->todo = desc->todo_last = NULL;
+    erl_drv_mutex_unlock(desc->mtx);
+
+    desc->next_dead = gh_graveyard;
+    gh_graveyard = desc;
+    gh_reap();
+}
+
+static void gh_reap(void)
+{
+    GhDescriptor** pp = &gh_graveyard;
+    GhDescriptor* desc;
+    int done;
+
+    while ((desc = *pp) != NULL) {
+	erl_drv_mutex_lock(desc->mtx);
+	done = (desc->exited == desc->nthreads);
+	erl_drv_mutex_unlock(desc->mtx);
+	if (done) {
+	    *pp = desc->next_dead;
+	    gh_free_desc(desc);
+	} else {
+	    pp = &desc->next_dead;
+	}
+    }
+}
+
+/*
+** All threads must have left gh_worker (or never been started).
+*/
+static void gh_free_desc(GhDescriptor* desc)
+{
+    int i;
+
+    for (i = 0; i < desc->nthreads; i++)
+	erl_drv_thread_join(desc->tids[i], NULL);
+    gh_free_list(desc->todo);
+    gh_free_list(desc->done);
+    if (desc->wake[0] >= 0)
+	close(desc->wake[0]);
+    if (desc->wake[1] >= 0)
+	close(desc->wake[1]);
+    if (desc->tids != NULL)
+	driver_free(desc->tids);
+    if (desc->cnd != NULL)
+	erl_drv_cond_destroy(desc->cnd);
+    if (desc->mtx != NULL)
+	erl_drv_mutex_destroy(desc->mtx);
+    driver_free(desc);
+}
+
+static void gh_command(ErlDrvData data, char* buf, ErlDrvSizeT len)
+{
+    GhDescriptor* desc = (GhDescriptor*) data;
+    GhRequest* req;
+    GhRequest** pp;
+    unsigned serial;
+    int op;
+
+    if (len < 5)
+	return;
+    serial = get_int32(buf);
+    op = (unsigned char) buf[4];
+
+    switch (op) {
+    case OP_GETHOSTBYNAME:
+    case OP_GETHOSTBYADDR:
+	if (len < 6)
+	    return;
+	req = (GhRequest*) driver_alloc(sizeof(GhRequest) + len - 6);
+	if (req == NULL)
+	    return;
+	req->next = NULL;
+	req->serial = serial;
+	req->op = op;
+	req->proto = (unsigned char) buf[5];
+	req->reply = NULL;
+	req->len = len - 6;
+	memcpy(req->data, buf + 6, len - 6);
+	req->data[len - 6] = '\0';
+
+	erl_drv_mutex_lock(desc->mtx);
+	if (desc->todo_last == NULL)
+	    desc->todo = req;
+	else
+	    desc->todo_last->next = req;
+	desc->todo_last = req;
+	erl_drv_cond_signal(desc->cnd);
+	erl_drv_mutex_unlock(desc->mtx);
+	break;
+
+    case OP_CANCEL_REQUEST:
+	/* Only possible while it still waits for a thread */
+	erl_drv_mutex_lock(desc->mtx);
+	req = NULL;
+	for (pp = &desc->todo; *pp != NULL; pp = &(*pp)->next) {
+	    if ((*pp)->serial == serial) {
+		req = *pp;
+		*pp = req->next;
+		if (desc->todo_last == req) {
+		    GhRequest* last = desc->todo;
+		    while (last != NULL && last->next != NULL)
+			last = last->next;
+		    desc->todo_last = last;
+		}
+		break;
+	    }
+	}
+	erl_drv_mutex_unlock(desc->mtx);
+	if (req != NULL)
+	    driver_free(req);
+	break;
+
+    case OP_CONTROL:
+	/* Debug level; there is nothing to print here */
+    default:
+	break;
+    }
+}
+
+static void gh_ready_input(ErlDrvData data, ErlDrvEvent event)
+{
+    GhDescriptor* desc = (GhDescriptor*) data;
+    GhRequest* req;
+    GhRequest* next;
+    char buf[64];
+
+    while (read(desc->wake[0], buf, sizeof(buf)) > 0)
+	;
+    erl_drv_mutex_lock(desc->mtx);
+    req = desc->done;
+    desc->done = desc->done_last = NULL;
+    desc->signalled = 0;
+    erl_drv_mutex_unlock(desc->mtx);
+
+    for (; req != NULL; req = next) {
+	next = req->next;
+	if (req->reply != NULL) {
+	    driver_output_binary(desc->port, NULL, 0,
+				 req->reply, 0, req->len);
+	    driver_free_binary(req->reply);
+	}
+	driver_free(req);
+    }
+}
+
+static void gh_stop_select(ErlDrvEvent event, void* reserved)
+{
+    close((int)(long) event);
+}
+
+static void* gh_worker(void* arg)
+{
+    GhDescriptor* desc = (GhDescriptor*) arg;
+    GhRequest* req;
+
+    erl_drv_mutex_lock(desc->mtx);
+    for (;;) {
+	while (desc->todo == NULL && !desc->stopping)
+	    erl_drv_cond_wait(desc->cnd, desc->mtx);
+	if (desc->stopping)
+	    break;
+	req = desc->todo;
+	if ((desc->todo = req->next) == NULL)
+	    desc->todo_last = NULL;
+	req->next = NULL;
+	erl_drv_mutex_unlock(desc->mtx);
+
+	gh_lookup(req);
+
+	erl_drv_mutex_lock(desc->mtx);
+	if (desc->done_last == NULL)
+	    desc->done = req;
+	else
+	    desc->done_last->next = req;
+	desc->done_last = req;
+	if (!desc->signalled && !desc->stopping) {
+	    desc->signalled = 1;
+	    while (write(desc->wake[1], "", 1) < 0 && errno == EINTR)
+		;
+	}
+    }
+    desc->exited++;
+    erl_drv_mutex_unlock(desc->mtx);
+    return NULL;
+}
+
+static void gh_free_list(GhRequest* req)
+{
+    GhRequest* next;
+
+    for (; req != NULL; req = next) {
+	next = req->next;
+	if (req->reply != NULL)
+	    driver_free_binary(req->reply);
+	driver_free(req);
+    }
+}
+
+/*
+** Error strings are the ones inet_gethost uses, the Erlang side
+** turns them into atoms.
+*/
+static char* gai_error_string(int code)
+{
+    switch (code) {
+    case EAI_AGAIN:
+	return "try_again";
+    case EAI_FAIL:
+    case EAI_NONAME:
+#if defined(EAI_NODATA) && EAI_NODATA != EAI_NONAME
+    case EAI_NODATA:
+#endif
+	return "notfound";
+    default:
+	return "netdb_internal";
+    }
+}
+
+/*
+** Called in a pool thread, may block for a long time.
+*/
+static void gh_lookup(GhRequest* req)
+{
+    struct addrinfo* ai = NULL;
+    struct addrinfo hints;
+    struct addrinfo res;
+    char name[NI_MAXHOST];
+    int addrlen;
+    int code;
+
+    switch (req->proto) {
+    case PROTO_IPV4:
+	addrlen = 4;
+	break;
+#if defined(HAVE_IN6) && defined(AF_INET6)
+    case PROTO_IPV6:
+	addrlen = 16;
+	break;
+#endif
+    default:
+	req->reply = build_error_reply(req->serial, "enotsup", &req->len);
+	return;
+    }
+
+    switch (req->op) {
+    case OP_GETHOSTBYNAME:
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_flags = AI_CANONNAME;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_family = (addrlen == 4) ? AF_INET : AF_INET6;
+	if ((code = getaddrinfo(req->data, NULL, &hints, &ai)) != 0) {
+	    req->reply = build_error_reply(req->serial,
+					   gai_error_string(code), &req->len);
+	} else {
+	    req->reply = build_reply(req->serial, addrlen, ai, &req->len);
+	    freeaddrinfo(ai);
+	}
+	break;
+
+    case OP_GETHOSTBYADDR: {
+	struct sockaddr_in sin;
+#if defined(HAVE_IN6) && defined(AF_INET6)
+	struct sockaddr_in6 sin6;
+#endif
+	struct sockaddr* sa;
+	socklen_t salen;
+
+	if (req->len != addrlen) {
+	    req->reply = build_error_reply(req->serial, "netdb_internal",
+					   &req->len);
+	    return;
+	}
+	if (addrlen == 4) {
+	    memset(&sin, 0, sizeof(sin));
+	    sin.sin_family = AF_INET;
+	    memcpy(&sin.sin_addr, req->data, 4);
+	    sa = (struct sockaddr*) &sin;
+	    salen = sizeof(sin);
+	}
+#if defined(HAVE_IN6) && defined(AF_INET6)
+	else {
+	    memset(&sin6, 0, sizeof(sin6));
+	    sin6.sin6_family = AF_INET6;
+	    memcpy(&sin6.sin6_addr, req->data, 16);
+	    sa = (struct sockaddr*) &sin6;
+	    salen = sizeof(sin6);
+	}
+#endif
+	if ((code = getnameinfo(sa, salen, name, sizeof(name),
+				NULL, 0, NI_NAMEREQD)) != 0) {
+	    req->reply = build_error_reply(req->serial,
+					   gai_error_string(code), &req->len);
+	} else {
+	    memset(&res, 0, sizeof(res));
+	    res.ai_canonname = name;
+	    res.ai_addr = sa;
+	    req->reply = build_reply(req->serial, addrlen, &res, &req->len);
+	}
+	break;
+    }
+
+    default:
+	req->reply = build_error_reply(req->serial, "enotsup", &req->len);
+	break;
+    }
+}
+
+static ErlDrvBinary* build_error_reply(unsigned serial, char* errstring,
+				       ErlDrvSizeT* lenp)
+{
+    ErlDrvSizeT need = 4 /* Serial */ + 1 /* Unit */ + strlen(errstring) + 1;
+    ErlDrvBinary* bin;
+
+    if ((bin = driver_alloc_binary(need)) == NULL)
+	return NULL;
+    put_int32(serial, bin->orig_bytes);
+    bin->orig_bytes[4] = UNIT_ERROR;
+    strcpy(bin->orig_bytes + 5, errstring);
+    *lenp = need;
+    return bin;
+}
+
+/*
+** Serial:32 Unit:8 Naddr:32 Addr*Naddr Nnames:32 (Name 0)*Nnames
+*/
+static ErlDrvBinary* build_reply(unsigned serial, int addrlen,
+				 struct addrinfo* res0, ErlDrvSizeT* lenp)
+{
+    struct addrinfo* res;
+    ErlDrvBinary* bin;
+    ErlDrvSizeT need;
+    int num_addresses = 0;
+    int num_strings = 0;
+    char* ptr;
+
+    need = 4 /* Serial */ + 1 /* Unit */ + 4 /* Naddr */ + 4 /* Nnames */;
+    for (res = res0; res != NULL; res = res->ai_next) {
+	if (res->ai_addr != NULL) {
+	    num_addresses++;
+	    need += addrlen;
+	}
+	if (res->ai_canonname != NULL) {
+	    num_strings++;
+	    need += strlen(res->ai_canonname) + 1;
+	}
+    }
+
+    if ((bin = driver_alloc_binary(need)) == NULL)
+	return NULL;
+    ptr = bin->orig_bytes;
+    put_int32(serial, ptr);
+    ptr += 4;
+    *ptr++ = (char) addrlen;
+    put_int32(num_addresses, ptr);
+    ptr += 4;
+    for (res = res0; res != NULL; res = res->ai_next) {
+	if (res->ai_addr == NULL)
+	    continue;
+	if (addrlen == 4)
+	    memcpy(ptr, &((struct sockaddr_in*) res->ai_addr)->sin_addr, 4);
+#if defined(HAVE_IN6) && defined(AF_INET6)
+	else
+	    memcpy(ptr, &((struct sockaddr_in6*) res->ai_addr)->sin6_addr, 16);
+#endif
+	ptr += addrlen;
+    }
+    put_int32(num_strings, ptr);
+    ptr += 4;
+    for (res = res0; res != NULL; res = res->ai_next) {
+	if (res->ai_canonname == NULL)
+	    continue;
+	strcpy(ptr, res->ai_canonname);
+	ptr += strlen(res->ai_canonname) + 1;
+    }
+    *lenp = need;
+    return bin;
+}
+
+#else /* !GH_SUPPORTED */
+
+/*
+** No threads or no getaddrinfo(); inet_gethost_native falls back
+** to the port program when the open fails.
+*/
+static ErlDrvData gh_start(ErlDrvPort port, char* command)
+{
+    return ERL_DRV_ERROR_GENERAL;
+}
+
+static void gh_stop(ErlDrvData data)
+{
+}
+
+static void gh_command(ErlDrvData data, char* buf, ErlDrvSizeT len)
+{
+}
+
+static void gh_ready_input(ErlDrvData data, ErlDrvEvent event)
+{
+}
+
+static void gh_stop_select(ErlDrvEvent event, void* reserved)
+{
+}
+
+#endif /* GH_SUPPORTED */
@@ -84,8 +84,7 @@
 
 #include "sys.h"
 #include "erl_driver.h"
-#include "zlib.h"
-#include "gzio.h"
+#include "erl_zlib.h"
 
 #ifndef NULL
 #define NULL ((void*)0)
@@ -93,12 +92,22 @@
 
 #define BFILE_BLOCK  1024
 
+/* Largest segment added when a file grows */
+#define RAM_FILE_SEG_MAX   (1 << 20)
+
+/* Bytes of input plus output handled by compress and uncompress
+   before they give up the scheduler thread */
+#define RAM_FILE_Z_SLICE   (1 << 18)
+#define RAM_FILE_Z_CHUNK   (1 << 16)
+
 typedef unsigned char uchar;
 
 static ErlDrvData rfile_start(ErlDrvPort, char*);
 static int rfile_init(void);
 static void rfile_stop(ErlDrvData);
 static void rfile_command(ErlDrvData, char*, ErlDrvSizeT);
+static void rfile_timeout(ErlDrvData);
+static void rfile_ready_async(ErlDrvData, ErlDrvThreadData);
 
 
 struct erl_drv_entry ram_file_driver_entry = {
@@ -112,9 +121,9 @@ struct erl_drv_entry ram_file_driver_entry = {
     NULL,
     NULL, /* handle */
     NULL, /* control */
-    NULL, /* timeout */
+    rfile_timeout,
     NULL, /* outputv */
-    NULL, /* ready_async */
+    rfile_ready_async,
     NULL, /* flush */
     NULL, /* call */
     NULL, /* event */
@@ -127,21 +136,51 @@ struct erl_drv_entry ram_file_driver_entry = {
     NULL,
 };
 
-/* A File is represented as a array of bytes, this array is
-   reallocated when needed. A possibly better implementation
-   whould be to have a vector of blocks. This may be implemented
-   when we have the commandv/driver_outputv
+/* A File is represented as a vector of segments, each a binary,
+   lying back to back. Growing the file adds a segment and never
+   moves what is already written; new segments are as large as the
+   file so far, up to RAM_FILE_SEG_MAX. The bytes between the end of
+   the file and the end of the last segment are always zero.
 */
+typedef struct {
+    ErlDrvBinary* bin;  /* segment data */
+    ErlDrvSSizeT start; /* file position of first byte */
+} RamFileSeg;
+
+typedef struct {
+    RamFileSeg* seg;    /* segment vector */
+    int n;              /* segments in use */
+    int alloc;          /* slots allocated in seg */
+    int last;           /* segment of the latest lookup */
+    ErlDrvSSizeT size;  /* bytes in all segments */
+} RamFileData;
+
+/* A compress or uncompress in progress. The file's segments are
+   moved to the job and given back to the file when it is done. */
+typedef struct {
+    int op;             /* RAM_FILE_COMPRESS or RAM_FILE_UNCOMPRESS */
+    int async;          /* running in the async pool */
+    int zinit;          /* z has been initialized */
+    z_stream z;
+    RamFileData in;
+    ErlDrvSSizeT in_len;
+    ErlDrvSSizeT pos;   /* input passed to zlib so far */
+    RamFileData out;
+    ErlDrvSSizeT out_len;
+    int error;          /* errno value if failed */
+} RamFileZJob;
+
 typedef struct ram_file {
     ErlDrvPort port;	/* the associcated port */
     int flags;          /* flags read/write */
-    ErlDrvBinary* bin;  /* binary to hold binary file */
-    char* buf;          /* buffer start (in binary) */
-    ErlDrvSSizeT size;   /* buffer size (allocated) */
+    RamFileData data;   /* file contents */
     ErlDrvSSizeT cur;    /* current position in buffer */
     ErlDrvSSizeT end;            /* end position in buffer */
+    RamFileZJob* zjob;  /* compress or uncompress in progress */
 } RamFile;
 
+static ErlDrvSysInfo sys_info;
+
 #ifdef LOADABLE
 static int rfile_finish(DriverEntry* drv)
 {
@@ -165,6 +204,7 @@ DriverEntry* driver_init(void *handle)
 
 static int rfile_init(void)
 {
+    driver_system_info(&sys_info, sizeof(ErlDrvSysInfo));
     return 0;
 }
 
@@ -178,17 +218,22 @@ static ErlDrvData rfile_start(ErlDrvPort port, char* buf)
     }
     f->port = port;
     f->flags = 0;
-    f->bin = NULL;
-    f->buf = NULL;
-    f->size = f->cur = f->end = 0;
+    sys_memzero(&f->data, sizeof(RamFileData));
+    f->cur = f->end = 0;
+    f->zjob = NULL;
     return (ErlDrvData)f;
 }
 
+static void ram_file_data_free(RamFileData *d);
+static void ram_file_z_free(void *data);
+
 static void rfile_stop(ErlDrvData e)
 {
     RamFile* f = (RamFile*)e;
-    if (f->bin != NULL) 
-	driver_free_binary(f->bin);
+    /* A job in the async pool is freed when it returns */
+    if (f->zjob != NULL && !f->zjob->async)
+	ram_file_z_free(f->zjob);
+    ram_file_data_free(&f->data);
     driver_free(f);
 }
 
@@ -245,16 +290,117 @@ static int numeric_reply(RamFile *f, ErlDrvSSizeT result)
     return 0;
 }
 
-/* install bin as the new binary reset all pointer */
+static void ram_file_data_free(RamFileData *d)
+{
+    int i;
+    for (i = 0; i < d->n; i++)
+	driver_free_binary(d->seg[i].bin);
+    if (d->seg != NULL)
+	driver_free(d->seg);
+    sys_memzero(d, sizeof(RamFileData));
+}
+
+/* Append bin as a new segment, taking over the reference */
+static int ram_file_add_seg(RamFileData *d, ErlDrvBinary *bin)
+{
+    if (d->n == d->alloc) {
+	int alloc = d->alloc ? 2*d->alloc : 8;
+	RamFileSeg* seg;
+	if ((seg = driver_realloc(d->seg, alloc*sizeof(RamFileSeg))) == NULL)
+	    return -1;
+	d->seg = seg;
+	d->alloc = alloc;
+    }
+    d->seg[d->n].bin = bin;
+    d->seg[d->n].start = d->size;
+    d->n++;
+    d->size += bin->orig_size;
+    return 0;
+}
 
-static void ram_file_set(RamFile *f, ErlDrvBinary *bin,
-			 ErlDrvSSizeT bsize, ErlDrvSSizeT len)
+static ErlDrvBinary* ram_file_new_seg(RamFileData *d, ErlDrvSSizeT bsize)
 {
-    f->size = bsize;
-    f->buf = bin->orig_bytes;
+    ErlDrvBinary* bin;
+
+    if ((bin = driver_alloc_binary(bsize)) == NULL)
+	return NULL;
+    if (ram_file_add_seg(d, bin) < 0) {
+	driver_free_binary(bin);
+	return NULL;
+    }
+    return bin;
+}
+
+/* Size of the next segment when growing with no size in mind */
+static ErlDrvSSizeT ram_file_grow_size(RamFileData *d)
+{
+    if (d->size < 16*BFILE_BLOCK)
+	return 16*BFILE_BLOCK;
+    return d->size < RAM_FILE_SEG_MAX ? d->size : RAM_FILE_SEG_MAX;
+}
+
+/* Index of the segment holding pos, which must be below d->size */
+static int ram_file_seg_ix(RamFileData *d, ErlDrvSSizeT pos)
+{
+    RamFileSeg* s = &d->seg[d->last];
+    int lo, hi;
+
+    ASSERT(0 <= pos && pos < d->size);
+    if (s->start <= pos && pos < s->start + s->bin->orig_size)
+	return d->last;
+    lo = 0;
+    hi = d->n - 1;
+    while (lo < hi) {
+	int mid = (lo + hi + 1) / 2;
+	if (d->seg[mid].start <= pos)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    return d->last = lo;
+}
+
+/* Copy between the file and buf, or zero the file if buf is NULL.
+   The range must be within d->size. */
+static void ram_file_copy(RamFileData *d, ErlDrvSSizeT pos, char *buf,
+			  ErlDrvSSizeT len, int to_file)
+{
+    while (len > 0) {
+	RamFileSeg* s = &d->seg[ram_file_seg_ix(d, pos)];
+	char* p = s->bin->orig_bytes + (pos - s->start);
+	ErlDrvSSizeT n = s->start + s->bin->orig_size - pos;
+
+	if (n > len)
+	    n = len;
+	if (buf == NULL)
+	    sys_memzero(p, n);
+	else {
+	    if (to_file)
+		sys_memcpy(p, buf, n);
+	    else
+		sys_memcpy(buf, p, n);
+	    buf += n;
+	}
+	pos += n;
+	len -= n;
+    }
+}
+
+/* Replace the contents with the first len bytes of bin */
+
+static int ram_file_set(RamFile *f, ErlDrvBinary *bin, ErlDrvSSizeT len)
+{
+    ram_file_data_free(&f->data);
+    if (ram_file_add_seg(&f->data, bin) < 0) {
+	driver_free_binary(bin);
+	f->cur = f->end = 0;
+	return -1;
+    }
+    if (bin->orig_size > len)
+	sys_memzero(bin->orig_bytes + len, bin->orig_size - len);
     f->cur = 0;
     f->end = len;
-    f->bin = bin;
+    return 0;
 }
 
 static int ram_file_init(RamFile *f, char *buf, ErlDrvSSizeT count, int *error)
@@ -271,17 +417,15 @@ static int ram_file_init(RamFile *f, char *buf, ErlDrvSSizeT count, int *error)
 	bsize = INT_MAX;
     }
 
-    if (f->bin == NULL)
-	bin = driver_alloc_binary(bsize);
-    else 
-	bin = driver_realloc_binary(f->bin, bsize);
-    if (bin == NULL) {
+    if ((bin = driver_alloc_binary(bsize)) == NULL) {
 	*error = ENOMEM;
 	return -1;
     }
-    sys_memzero(bin->orig_bytes, bsize);
     sys_memcpy(bin->orig_bytes, buf, count);
-    ram_file_set(f, bin, bsize, count);
+    if (ram_file_set(f, bin, count) < 0) {
+	*error = ENOMEM;
+	return -1;
+    }
     return count;
 }
 
@@ -294,26 +438,46 @@ static ErlDrvSSizeT ram_file_expand(RamFile *f, ErlDrvSSizeT size, int *error)
 	*error = EINVAL;
 	return -1;
     }
-    if ((bsize = (size+BFILE_BLOCK+(BFILE_BLOCK>>1)) & ~(BFILE_BLOCK-1))
-	< 0) {
-	bsize = INT_MAX;
-    }
-    
-    if (bsize <= f->size)
-	return f->size;
-    else {
-	if ((bin = driver_realloc_binary(f->bin, bsize)) == NULL) {
+    while (f->data.size < size) {
+	if (f->data.n > 0)
+	    bsize = ram_file_grow_size(&f->data);
+	else if ((bsize = (size+BFILE_BLOCK+(BFILE_BLOCK>>1))
+		  & ~(BFILE_BLOCK-1)) < 0) {
+	    bsize = INT_MAX;
+	}
+	if ((bin = ram_file_new_seg(&f->data, bsize)) == NULL) {
 	    *error = ENOMEM;
 	    return -1;
 	}
-	sys_memzero(bin->orig_bytes+f->size, bsize - f->size);
-	f->size = bsize;
-	f->buf = bin->orig_bytes;
-	f->bin = bin;
-	return bsize;
+	sys_memzero(bin->orig_bytes, bsize);
     }
+    return f->data.size;
 }
 
+/* Make the file one segment, as the uuencode and uudecode code
+   wants it, and return a pointer to it */
+
+static char* ram_file_flatten(RamFile *f)
+{
+    ErlDrvSSizeT bsize;
+    ErlDrvBinary* bin;
+
+    if (f->data.n == 1 && f->data.size > f->end)
+	return f->data.seg[0].bin->orig_bytes;
+    bsize = (f->end+BFILE_BLOCK+(BFILE_BLOCK>>1)) & ~(BFILE_BLOCK-1);
+    if (bsize < 0 || (bin = driver_alloc_binary(bsize)) == NULL)
+	return NULL;
+    ram_file_copy(&f->data, 0, bin->orig_bytes, f->end, 0);
+    ram_file_data_free(&f->data);
+    if (ram_file_add_seg(&f->data, bin) < 0) {
+	/* Cannot happen with an empty vector unless memory is out */
+	driver_free_binary(bin);
+	f->cur = f->end = 0;
+	return NULL;
+    }
+    sys_memzero(bin->orig_bytes + f->end, bsize - f->end);
+    return bin->orig_bytes;
+}
 
 static ErlDrvSSizeT ram_file_write(RamFile *f, char *buf, ErlDrvSSizeT len,
 			  ErlDrvSSizeT *location, int *error)
@@ -329,10 +493,10 @@ static ErlDrvSSizeT ram_file_write(RamFile *f, char *buf, ErlDrvSSizeT len,
 	*error = EINVAL;
 	return -1;
     }
-    if (cur+len > f->size && ram_file_expand(f, cur+len, error) < 0) {
+    if (cur+len > f->data.size && ram_file_expand(f, cur+len, error) < 0) {
 	return -1;
     }
-    if (len) sys_memcpy(f->buf+cur, buf, len);
+    if (len) ram_file_copy(&f->data, cur, buf, len, 1);
     cur += len;
     if (cur > f->end) f->end = cur;
     if (! location) f->cur = cur;
@@ -363,12 +527,36 @@ static ErlDrvSSizeT ram_file_read(RamFile *f, ErlDrvSSizeT len, ErlDrvBinary **b
 	*error = ENOMEM;
 	return -1;
     }
-    if (len) sys_memcpy(bin->orig_bytes, f->buf+cur, len);
+    if (len) ram_file_copy(&f->data, cur, bin->orig_bytes, len, 0);
     *bp = bin;
     if (! location) f->cur = cur + len;
     return len;
 }
 
+static int ram_file_truncate(RamFile *f, int *error)
+{
+    RamFileData* d = &f->data;
+
+    if (f->cur > f->end) {
+	if (ram_file_expand(f, f->cur, error) < 0)
+	    return -1;
+    } else {
+	/* Give back the segments wholly past the new end */
+	while (d->n > 0 && d->seg[d->n-1].start >= f->cur) {
+	    d->n--;
+	    d->size = d->seg[d->n].start;
+	    driver_free_binary(d->seg[d->n].bin);
+	}
+	d->last = 0;
+	if (f->end > d->size)
+	    f->end = d->size;
+	if (f->end > f->cur)
+	    ram_file_copy(d, f->cur, NULL, f->end - f->cur, 1);
+    }
+    f->end = f->cur;
+    return 0;
+}
+
 static ErlDrvSSizeT ram_file_seek(RamFile *f, ErlDrvSSizeT offset, int whence,
 				 int *error)
 {
@@ -415,10 +603,11 @@ static int ram_file_uuencode(RamFile *f)
     uchar* outp;
     ErlDrvSSizeT count = 0;
 
+    if ((inp = (uchar*)ram_file_flatten(f)) == NULL)
+	return error_reply(f, ENOMEM);
     if ((bin = driver_alloc_binary(usize)) == NULL)
 	return error_reply(f, ENOMEM);
     outp = (uchar*)bin->orig_bytes;
-    inp = (uchar*)f->buf;
 
     while(len > 0) {
         int c1, c2, c3;
@@ -455,8 +644,8 @@ static int ram_file_uuencode(RamFile *f)
     *outp++ = '\n';
     count += 2;
     ASSERT(count == usize);
-    driver_free_binary(f->bin);
-    ram_file_set(f, bin, usize, count);
+    if (ram_file_set(f, bin, count) < 0)
+	return error_reply(f, ENOMEM);
     return numeric_reply(f, count);
 }
 
@@ -473,10 +662,11 @@ static int ram_file_uudecode(RamFile *f)
     int count = 0;
     int n;
 
+    if ((inp = (uchar*)ram_file_flatten(f)) == NULL)
+	return error_reply(f, ENOMEM);
     if ((bin = driver_alloc_binary(usize)) == NULL)
 	return error_reply(f, ENOMEM);
     outp = (uchar*)bin->orig_bytes;
-    inp  = (uchar*)f->buf;
 
     while(len > 0) {
 	if ((n = uu_decode(*inp++)) < 0)
@@ -516,8 +706,8 @@ static int ram_file_uudecode(RamFile *f)
 	    goto error;
         len--;
     }
-    driver_free_binary(f->bin);
-    ram_file_set(f, bin, usize, count);
+    if (ram_file_set(f, bin, count) < 0)
+	return error_reply(f, ENOMEM);
     return numeric_reply(f, count);
 
  error:
@@ -526,36 +716,187 @@ static int ram_file_uudecode(RamFile *f)
 }
 
 
-static int ram_file_compress(RamFile *f)
+/*
+ * Compress and uncompress work through the segments a slice at a time,
+ * writing new segments. What is not done in the first slice is handed
+ * to the async pool, or continued from a zero timeout when there are no
+ * async threads. The port is busy until the job is done.
+ */
+
+static void ram_file_z_free(void *data)
+{
+    RamFileZJob* j = (RamFileZJob*) data;
+
+    if (j->zinit) {
+	if (j->op == RAM_FILE_COMPRESS)
+	    deflateEnd(&j->z);
+	else
+	    inflateEnd(&j->z);
+    }
+    ram_file_data_free(&j->in);
+    ram_file_data_free(&j->out);
+    driver_free(j);
+}
+
+/* Returns 1 when the job is done, or 0 after about budget bytes of
+   input and output if budget >= 0 */
+static int ram_file_z_step(RamFileZJob *j, ErlDrvSSizeT budget)
 {
-    ErlDrvSSizeT size = f->end;
+    z_stream* z = &j->z;
+    uLong done = z->total_in + z->total_out;
     ErlDrvBinary* bin;
+    int res;
+
+    for (;;) {
+	if (budget >= 0
+	    && (ErlDrvSSizeT) (z->total_in + z->total_out - done) >= budget)
+	    return 0;
+	if (z->avail_in == 0 && j->pos < j->in_len) {
+	    RamFileSeg* s = &j->in.seg[ram_file_seg_ix(&j->in, j->pos)];
+	    ErlDrvSSizeT n = s->start + s->bin->orig_size - j->pos;
+	    if (n > j->in_len - j->pos)
+		n = j->in_len - j->pos;
+	    if (n > RAM_FILE_Z_CHUNK)
+		n = RAM_FILE_Z_CHUNK;
+	    z->next_in = (Bytef*) s->bin->orig_bytes + (j->pos - s->start);
+	    z->avail_in = (uInt) n;
+	    j->pos += n;
+	}
+	if (z->avail_out == 0) {
+	    ErlDrvSSizeT bsize = ram_file_grow_size(&j->out);
+	    if ((bin = ram_file_new_seg(&j->out, bsize)) == NULL) {
+		j->error = ENOMEM;
+		break;
+	    }
+	    z->next_out = (Bytef*) bin->orig_bytes;
+	    z->avail_out = (uInt) bsize;
+	}
+	if (j->op == RAM_FILE_COMPRESS)
+	    res = deflate(z, j->pos == j->in_len ? Z_FINISH : Z_NO_FLUSH);
+	else
+	    res = inflate(z, Z_NO_FLUSH);
+	if (res == Z_STREAM_END) {
+	    j->out_len = j->out.size - z->avail_out;
+	    break;
+	}
+	if (res == Z_MEM_ERROR) {
+	    j->error = ENOMEM;
+	    break;
+	}
+	if ((res != Z_OK && res != Z_BUF_ERROR)
+	    || (res == Z_BUF_ERROR && z->avail_in == 0
+		&& j->pos == j->in_len && z->avail_out != 0)) {
+	    j->error = EINVAL; /* Broken or truncated input */
+	    break;
+	}
+    }
 
-    if ((bin = erts_gzdeflate_buffer(f->buf, size)) == NULL) {
-	return error_reply(f, EINVAL);
+    if (j->op == RAM_FILE_COMPRESS)
+	deflateEnd(z);
+    else
+	inflateEnd(z);
+    j->zinit = 0;
+    if (!j->error) {
+	if (j->out_len > INT_MAX)
+	    j->error = EFBIG; /* Positions are 32 bits in the protocol */
+	else if (j->out.size > j->out_len)
+	    ram_file_copy(&j->out, j->out_len, NULL,
+			  j->out.size - j->out_len, 1);
     }
-    driver_free_binary(f->bin);
-    size = bin->orig_size;
-    ram_file_set(f, bin, size, size);
-    return numeric_reply(f, size);
+    return 1;
+}
+
+static void ram_file_z_invoke(void *data)
+{
+    ram_file_z_step((RamFileZJob*) data, -1);
 }
 
-/* Tricky since we dont know the expanded size !!! */
-/* First attempt is to double the size of input */
-/* loop until we don't get Z_BUF_ERROR */
+static void ram_file_z_done(RamFile *f, RamFileZJob *j)
+{
+    f->zjob = NULL;
+    if (j->error) {
+	/* Leave the file as it was */
+	f->data = j->in;
+	sys_memzero(&j->in, sizeof(RamFileData));
+	error_reply(f, j->error);
+    } else {
+	f->data = j->out;
+	sys_memzero(&j->out, sizeof(RamFileData));
+	f->cur = 0;
+	f->end = j->out_len;
+	numeric_reply(f, f->end);
+    }
+    ram_file_z_free(j);
+}
 
-static int ram_file_uncompress(RamFile *f)
+static int ram_file_z_start(RamFile *f, int op)
 {
-    ErlDrvSSizeT size = f->end;
-    ErlDrvBinary* bin;
+    RamFileZJob* j;
+    uchar magic[2];
+    int res;
+
+    if (op == RAM_FILE_UNCOMPRESS) {
+	if (f->end >= 2)
+	    ram_file_copy(&f->data, 0, (char*) magic, 2, 0);
+	if (f->end < 2 || magic[0] != 0x1f || magic[1] != 0x8b) {
+	    /* No GZIP header -- leave the data as it is */
+	    f->cur = 0;
+	    return numeric_reply(f, f->end);
+	}
+    }
 
-    if ((bin = erts_gzinflate_buffer(f->buf, size)) == NULL) {
-	return error_reply(f, EINVAL);
+    if ((j = driver_alloc(sizeof(RamFileZJob))) == NULL)
+	return error_reply(f, ENOMEM);
+    sys_memzero(j, sizeof(RamFileZJob));
+    j->op = op;
+    erl_zlib_alloc_init(&j->z);
+    if (op == RAM_FILE_COMPRESS)  /* GZIP format */
+	res = deflateInit2(&j->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			   MAX_WBITS+16, 8, Z_DEFAULT_STRATEGY);
+    else
+	res = inflateInit2(&j->z, MAX_WBITS+16);
+    if (res != Z_OK) {
+	driver_free(j);
+	return error_reply(f, res == Z_MEM_ERROR ? ENOMEM : EINVAL);
     }
-    driver_free_binary(f->bin);
-    size = bin->orig_size;
-    ram_file_set(f, bin, size, size);
-    return numeric_reply(f, size);
+    j->zinit = 1;
+    j->in = f->data;
+    j->in_len = f->end;
+    sys_memzero(&f->data, sizeof(RamFileData));
+    f->zjob = j;
+
+    if (ram_file_z_step(j, RAM_FILE_Z_SLICE)) {
+	ram_file_z_done(f, j);
+	return 0;
+    }
+    set_busy_port(f->port, 1);
+    if (sys_info.async_threads > 0) {
+	j->async = 1;
+	driver_async(f->port, NULL, ram_file_z_invoke, j, ram_file_z_free);
+    } else
+	driver_set_timer(f->port, 0);
+    return 0;
+}
+
+static void rfile_timeout(ErlDrvData e)
+{
+    RamFile* f = (RamFile*)e;
+
+    if (f->zjob == NULL)
+	return;
+    if (ram_file_z_step(f->zjob, RAM_FILE_Z_SLICE)) {
+	set_busy_port(f->port, 0);
+	ram_file_z_done(f, f->zjob);
+    } else
+	driver_set_timer(f->port, 0);
+}
+
+static void rfile_ready_async(ErlDrvData e, ErlDrvThreadData data)
+{
+    RamFile* f = (RamFile*)e;
+
+    set_busy_port(f->port, 0);
+    ram_file_z_done(f, (RamFileZJob*) data);
 }
 
 
@@ -569,6 +910,12 @@ static void rfile_command(ErlDrvData e, char* buf, ErlDrvSizeT count)
     ErlDrvSSizeT origin;		/* Origin of seek. */
     ErlDrvSSizeT n;
 
+    if (f->zjob != NULL) {
+	/* Can only be a command that did not wait for the busy port */
+	error_reply(f, EBUSY);
+	return;
+    }
+
     count--;
     switch(*(uchar*)buf++) {
     case RAM_FILE_OPEN:  /* args is initial data */
@@ -654,10 +1001,10 @@ static void rfile_command(ErlDrvData e, char* buf, ErlDrvSizeT count)
 	    error_reply(f, EACCES);
 	    break;
 	}
-	if (f->end > f->cur)
-	    sys_memzero(f->buf + f->cur, f->end - f->cur);
-	f->end = f->cur;
-	reply(f, 1, 0);
+	if (ram_file_truncate(f, &error) < 0)
+	    error_reply(f, error);
+	else
+	    reply(f, 1, 0);
 	break;
 
     case RAM_FILE_GET:        /* return a copy of the file */
@@ -666,7 +1013,7 @@ static void rfile_command(ErlDrvData e, char* buf, ErlDrvSizeT count)
 	    error_reply(f, ENOMEM);
 	    break;
 	}
-	sys_memcpy(bin->orig_bytes, f->buf, n);
+	ram_file_copy(&f->data, 0, bin->orig_bytes, n, 0);
 	
 	header[0] = RAM_FILE_RESP_DATA;
 	put_int32(n, header+1);
@@ -677,8 +1024,15 @@ static void rfile_command(ErlDrvData e, char* buf, ErlDrvSizeT count)
 
     case RAM_FILE_GET_CLOSE:  /* return the file and close driver */
 	n = f->end;  /* length */
-	bin = f->bin;
-	f->bin = NULL;  /* NUKE IT */
+	if (f->data.n == 1) {
+	    bin = f->data.seg[0].bin;
+	    driver_binary_inc_refc(bin);
+	} else if ((bin = driver_alloc_binary(n)) == NULL) {
+	    error_reply(f, ENOMEM);
+	    break;
+	} else
+	    ram_file_copy(&f->data, 0, bin->orig_bytes, n, 0);
+	ram_file_data_free(&f->data);  /* NUKE IT */
 	header[0] = RAM_FILE_RESP_DATA;
 	put_int32(n, header+1);
 	driver_output_binary(f->port, header, sizeof(header),
@@ -698,12 +1052,12 @@ static void rfile_command(ErlDrvData e, char* buf, ErlDrvSizeT count)
 	    numeric_reply(f, n); /* 0 is not used */
 	break;
 	
-    case RAM_FILE_COMPRESS:   /* inline compress the file */
-	ram_file_compress(f);
+    case RAM_FILE_COMPRESS:   /* compress the file */
+	ram_file_z_start(f, RAM_FILE_COMPRESS);
 	break;
 
-    case RAM_FILE_UNCOMPRESS: /* inline uncompress file */
-	ram_file_uncompress(f);
+    case RAM_FILE_UNCOMPRESS: /* uncompress file */
+	ram_file_z_start(f, RAM_FILE_UNCOMPRESS);
 	break;
 
     case RAM_FILE_UUENCODE:   /* uuencode file */
@@ -61,6 +61,16 @@
 
 #define DEFAULT_BUFSZ   4000
 
+/* Bytes of input (and for inflate, output) handled per DEFLATE or
+ * INFLATE call before the caller is told to come back for more */
+#define ZLIB_CHUNK      (64*1024)
+
+/* Finished deflate streams kept for reuse */
+#define ZLIB_POOL_MAX   8
+
+/* Not a zlib code; the work was cut short, call again */
+#define ZLIB_CONTINUE   100
+
 static int zlib_init(void);
 static ErlDrvData zlib_start(ErlDrvPort port, char* buf);
 static void zlib_stop(ErlDrvData e);
@@ -100,14 +110,22 @@ typedef enum {
 } ZLibState;
 
 
-typedef struct {
+typedef struct zlib_stream {
     z_stream s;
+    struct zlib_stream* next;   /* link in the deflate pool */
+    int params[5];              /* deflateInit2() arguments */
+} ZLibStream;
+
+typedef struct {
+    ZLibStream* zs;     /* NULL unless state != ST_NONE */
     ZLibState state;
     ErlDrvBinary* bin;
     int binsz;
     int binsz_need;
     uLong crc;
     int inflate_eos_seen;
+    int inflate_more_output; /* inflate stopped with output pending */
+    int deflate_eos_seen;
     int want_crc;       /* 1 if crc is calculated on clear text */
     ErlDrvPort port;    /* the associcated port */
 } ZLibData;
@@ -115,6 +133,10 @@ typedef struct {
 static int zlib_inflate(ZLibData* d, int flush);
 static int zlib_deflate(ZLibData* d, int flush);
 
+static ErlDrvMutex* zlib_pool_mtx;
+static ZLibStream* zlib_pool;
+static int zlib_pool_size;
+
 #if defined(__WIN32__)
 static int i32(char* buf)
 #else
@@ -137,6 +159,9 @@ static char* zlib_reason(int code, int* err)
     case Z_STREAM_END:
 	*err = 0;
 	return "stream_end"; 
+    case ZLIB_CONTINUE:
+	*err = 0;
+	return "continue";
     case Z_ERRNO:
 	*err = 1;
 	return erl_errno_id(errno);
@@ -210,8 +235,8 @@ static int zlib_output_init(ZLibData* d)
     if ((d->bin = driver_alloc_binary(d->binsz_need)) == NULL)
 	return -1;
     d->binsz = d->binsz_need;
-    d->s.next_out = (unsigned char*)d->bin->orig_bytes;
-    d->s.avail_out = d->binsz;
+    d->zs->s.next_out = (unsigned char*)d->bin->orig_bytes;
+    d->zs->s.avail_out = d->binsz;
     return 0;
 }
 
@@ -222,7 +247,7 @@ static int zlib_output_init(ZLibData* d)
 static int zlib_output(ZLibData* d)
 {
     if (d->bin != NULL) {
-	int len = d->binsz - d->s.avail_out;
+	int len = d->binsz - d->zs->s.avail_out;
 	if (len > 0) {
 	    if (driver_output_binary(d->port, NULL, 0, d->bin, 0, len) < 0) 
 		return -1;
@@ -234,29 +259,48 @@ static int zlib_output(ZLibData* d)
     return zlib_output_init(d);
 }
 
+/*
+ * Inflate what is queued, giving up with ZLIB_CONTINUE once about
+ * ZLIB_CHUNK bytes have gone in or come out so that a big stream does
+ * not hold the scheduler; output not yet sent stays in d->bin.
+ */
 static int zlib_inflate(ZLibData* d, int flush)
 {
     int res = Z_OK;
+    int budget = ZLIB_CHUNK;
 
     if ((d->bin == NULL) && (zlib_output_init(d) < 0)) {
 	errno = ENOMEM;
 	return Z_ERRNO;
     }
 
-    while ((driver_sizeq(d->port) > 0) && (res != Z_STREAM_END)) {
-	int vlen;
-	SysIOVec* iov = driver_peekq(d->port, &vlen);
+    while (((driver_sizeq(d->port) > 0) || d->inflate_more_output) &&
+	   (res != Z_STREAM_END)) {
+	int vlen = 0;
+	SysIOVec* iov = NULL;
 	int len;
-	int possibly_more_output = 0;
+	int possibly_more_output = d->inflate_more_output;
+
+	if (budget <= 0)
+	    return ZLIB_CONTINUE;
 
-	d->s.next_in = iov[0].iov_base;
-	d->s.avail_in = iov[0].iov_len;
-	while((possibly_more_output || (d->s.avail_in > 0)) && (res != Z_STREAM_END)) {
-	    res = inflate(&d->s, Z_NO_FLUSH);
+	if (driver_sizeq(d->port) > 0) {
+	    iov = driver_peekq(d->port, &vlen);
+	    d->zs->s.next_in = iov[0].iov_base;
+	    d->zs->s.avail_in = iov[0].iov_len;
+	} else {
+	    d->zs->s.next_in = NULL;
+	    d->zs->s.avail_in = 0;
+	}
+	while((possibly_more_output || (d->zs->s.avail_in > 0)) &&
+	      (res != Z_STREAM_END) && (budget > 0)) {
+	    res = inflate(&d->zs->s, Z_NO_FLUSH);
 	    if (res == Z_NEED_DICT) {
 		/* Essential to eat the header bytes that zlib has looked at */
-		len = iov[0].iov_len - d->s.avail_in;
-		driver_deq(d->port, len);
+		if (iov != NULL) {
+		    len = iov[0].iov_len - d->zs->s.avail_in;
+		    driver_deq(d->port, len);
+		}
 		return res;
 	    }
 	    if (res == Z_BUF_ERROR) {
@@ -266,23 +310,28 @@ static int zlib_inflate(ZLibData* d, int flush)
 	    else if (res < 0) {
 		return res;
 	    }
-	    if (d->s.avail_out != 0) {
+	    if (d->zs->s.avail_out != 0) {
 		possibly_more_output = 0;
 	    } else {
 		if (d->want_crc)
 		    d->crc = crc32(d->crc, (unsigned char*)d->bin->orig_bytes,
-				   d->binsz - d->s.avail_out);
+				   d->binsz - d->zs->s.avail_out);
+		budget -= d->binsz;
 		zlib_output(d);
 		possibly_more_output = 1;
 	    }
 	}
-	len = iov[0].iov_len - d->s.avail_in;
-	driver_deq(d->port, len);
+	d->inflate_more_output = possibly_more_output && (res != Z_STREAM_END);
+	if (iov != NULL) {
+	    len = iov[0].iov_len - d->zs->s.avail_in;
+	    budget -= len;
+	    driver_deq(d->port, len);
+	}
     }
 
     if (d->want_crc) {
        d->crc = crc32(d->crc, (unsigned char*) d->bin->orig_bytes,
-		      d->binsz - d->s.avail_out);
+		      d->binsz - d->zs->s.avail_out);
     }
     zlib_output(d);
     if (res == Z_STREAM_END) {       
@@ -291,9 +340,14 @@ static int zlib_inflate(ZLibData* d, int flush)
     return res;
 }
 
+/*
+ * Deflate at most ZLIB_CHUNK bytes of what is queued; the flush is
+ * only done by the call that finds the queue empty.
+ */
 static int zlib_deflate(ZLibData* d, int flush)
 {
     int res = Z_OK;
+    int budget = ZLIB_CHUNK;
 
     if ((d->bin == NULL) && (zlib_output_init(d) < 0)) {
 	errno = ENOMEM;
@@ -302,53 +356,62 @@ static int zlib_deflate(ZLibData* d, int flush)
 
     while ((driver_sizeq(d->port) > 0) && (res != Z_STREAM_END)) {
 	int vlen;
-	SysIOVec* iov = driver_peekq(d->port, &vlen);
+	SysIOVec* iov;
 	int len;
 
-	d->s.next_in = iov[0].iov_base;
-	d->s.avail_in = iov[0].iov_len;
+	if (budget <= 0)
+	    return ZLIB_CONTINUE;
 
-	while((d->s.avail_in > 0) && (res != Z_STREAM_END)) {
-	    if ((res = deflate(&d->s, Z_NO_FLUSH)) < 0) {
+	iov = driver_peekq(d->port, &vlen);
+	len = (iov[0].iov_len > budget) ? budget : iov[0].iov_len;
+	d->zs->s.next_in = iov[0].iov_base;
+	d->zs->s.avail_in = len;
+
+	while((d->zs->s.avail_in > 0) && (res != Z_STREAM_END)) {
+	    if ((res = deflate(&d->zs->s, Z_NO_FLUSH)) < 0) {
 		return res;
 	    }
-	    if (d->s.avail_out == 0) {
+	    if (d->zs->s.avail_out == 0) {
 		zlib_output(d);
 	    }
 	}
-	len = iov[0].iov_len - d->s.avail_in;
+	len -= d->zs->s.avail_in;
 	if (d->want_crc) {
 	    d->crc = crc32(d->crc, iov[0].iov_base, len);
 	}
+	budget -= len;
 	driver_deq(d->port, len);
     }
 
     if (flush != Z_NO_FLUSH) {
-	if ((res = deflate(&d->s, flush)) < 0) {
+	if ((res = deflate(&d->zs->s, flush)) < 0) {
 	    return res;
 	}
 	if (flush == Z_FINISH) {
-	    while (d->s.avail_out < d->binsz) {
+	    while (d->zs->s.avail_out < d->binsz) {
 		zlib_output(d);
 		if (res == Z_STREAM_END) {
 		    break;
 		}
-		if ((res = deflate(&d->s, flush)) < 0) {
+		if ((res = deflate(&d->zs->s, flush)) < 0) {
 		    return res;
 		}
 	    }
 	} else {
-	    while (d->s.avail_out == 0) {
+	    while (d->zs->s.avail_out == 0) {
 	       zlib_output(d);
-	       if ((res = deflate(&d->s, flush)) < 0) {
+	       if ((res = deflate(&d->zs->s, flush)) < 0) {
 		  return res;
 	       }
 	    }
-	    if (d->s.avail_out < d->binsz) {
+	    if (d->zs->s.avail_out < d->binsz) {
 	       zlib_output(d);
 	    }
 	}
     }
+    if (res == Z_STREAM_END) {
+	d->deflate_eos_seen = 1;
+    }
     return res;
 }
 
@@ -364,8 +427,132 @@ static void zlib_free(void* data, void* addr)
     driver_free(addr);
 }
 
+static ZLibStream* zlib_stream_alloc(void)
+{
+    ZLibStream* zs;
+
+    if ((zs = (ZLibStream*) driver_alloc(sizeof(ZLibStream))) == NULL)
+	return NULL;
+    memset(zs, 0, sizeof(ZLibStream));
+    zs->s.zalloc = zlib_alloc;
+    zs->s.zfree  = zlib_free;
+    zs->s.data_type = Z_BINARY;
+    return zs;
+}
+
+/*
+ * Deflate state is a few hundred kilobytes that deflateInit2 has to
+ * allocate and clear, so streams that ran to the end are reset and
+ * kept in a small pool, to be picked up by the next init with the
+ * same parameters.
+ */
+static ZLibStream* zlib_pool_get(int* params)
+{
+    ZLibStream** zpp;
+    ZLibStream* zs = NULL;
+
+    erl_drv_mutex_lock(zlib_pool_mtx);
+    for (zpp = &zlib_pool; *zpp != NULL; zpp = &(*zpp)->next) {
+	if (memcmp((*zpp)->params, params, sizeof((*zpp)->params)) == 0) {
+	    zs = *zpp;
+	    *zpp = zs->next;
+	    zlib_pool_size--;
+	    break;
+	}
+    }
+    erl_drv_mutex_unlock(zlib_pool_mtx);
+    return zs;
+}
+
+/* Returns 0 if the stream could not be kept; it is then still live */
+static int zlib_pool_put(ZLibStream* zs)
+{
+    int kept = 0;
+
+    if (zlib_pool_size >= ZLIB_POOL_MAX || deflateReset(&zs->s) != Z_OK)
+	return 0;
+    erl_drv_mutex_lock(zlib_pool_mtx);
+    if (zlib_pool_size < ZLIB_POOL_MAX) {
+	zs->next = zlib_pool;
+	zlib_pool = zs;
+	zlib_pool_size++;
+	kept = 1;
+    }
+    erl_drv_mutex_unlock(zlib_pool_mtx);
+    return kept;
+}
+
+static int zlib_deflate_init(ZLibData* d, int level, int method, int wbits,
+			     int memlevel, int strategy)
+{
+    int params[5];
+    int res;
+
+    params[0] = level;
+    params[1] = method;
+    params[2] = wbits;
+    params[3] = memlevel;
+    params[4] = strategy;
+    if ((d->zs = zlib_pool_get(params)) != NULL)
+	return Z_OK;
+    if ((d->zs = zlib_stream_alloc()) == NULL)
+	return Z_MEM_ERROR;
+    res = deflateInit2(&d->zs->s, level, method, wbits, memlevel, strategy);
+    if (res == Z_OK) {
+	memcpy(d->zs->params, params, sizeof(params));
+    } else {
+	driver_free(d->zs);
+	d->zs = NULL;
+    }
+    return res;
+}
+
+static int zlib_inflate_init(ZLibData* d, int wbits)
+{
+    int res;
+
+    if ((d->zs = zlib_stream_alloc()) == NULL)
+	return Z_MEM_ERROR;
+    res = inflateInit2(&d->zs->s, wbits);
+    if (res != Z_OK) {
+	driver_free(d->zs);
+	d->zs = NULL;
+    }
+    return res;
+}
+
+/* Drop the stream and any output buffer pointing into it */
+static int zlib_end(ZLibData* d)
+{
+    int res;
+
+    if (d->state == ST_DEFLATE) {
+	if (d->deflate_eos_seen && zlib_pool_put(d->zs))
+	    res = Z_OK;
+	else {
+	    res = deflateEnd(&d->zs->s);
+	    driver_free(d->zs);
+	}
+    } else {
+	res = inflateEnd(&d->zs->s);
+	driver_free(d->zs);
+    }
+    d->zs = NULL;
+    d->state = ST_NONE;
+    if (d->bin != NULL) {
+	driver_free_binary(d->bin);
+	d->bin = NULL;
+	d->binsz = 0;
+    }
+    return res;
+}
+
 static int zlib_init()
 {
+    zlib_pool = NULL;
+    zlib_pool_size = 0;
+    if ((zlib_pool_mtx = erl_drv_mutex_create("zlib_drv_pool")) == NULL)
+	return -1;
     return 0;
 }
 
@@ -376,13 +563,7 @@ static ErlDrvData zlib_start(ErlDrvPort port, char* buf)
     if ((d = (ZLibData*) driver_alloc(sizeof(ZLibData))) == NULL)
         return ERL_DRV_ERROR_GENERAL;
 
-    memset(&d->s, 0, sizeof(z_stream));
-
-    d->s.zalloc = zlib_alloc;
-    d->s.zfree  = zlib_free;
-    d->s.opaque = d;
-    d->s.data_type = Z_BINARY;
-
+    d->zs        = NULL;
     d->port      = port;
     d->state     = ST_NONE;
     d->bin       = NULL;
@@ -390,6 +571,8 @@ static ErlDrvData zlib_start(ErlDrvPort port, char* buf)
     d->binsz_need = DEFAULT_BUFSZ;
     d->crc       = crc32(0L, Z_NULL, 0);
     d->inflate_eos_seen = 0;
+    d->inflate_more_output = 0;
+    d->deflate_eos_seen = 0;
     d->want_crc  = 0;
     return (ErlDrvData)d;
 }
@@ -399,10 +582,8 @@ static void zlib_stop(ErlDrvData e)
 {
     ZLibData* d = (ZLibData*)e;
 
-    if (d->state == ST_DEFLATE)
-	deflateEnd(&d->s);
-    else if (d->state == ST_INFLATE)
-	inflateEnd(&d->s);
+    if (d->state != ST_NONE)
+	zlib_end(d);
 
     if (d->bin != NULL)
 	driver_free_binary(d->bin);
@@ -420,9 +601,12 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
     case DEFLATE_INIT:
 	if (len != 4) goto badarg;
 	if (d->state != ST_NONE) goto badarg;
-	res = deflateInit(&d->s, i32(buf));
+	/* deflateInit() uses the default memLevel 8 */
+	res = zlib_deflate_init(d, i32(buf), Z_DEFLATED, MAX_WBITS, 8,
+				Z_DEFAULT_STRATEGY);
 	if (res == Z_OK) {
 	    d->state = ST_DEFLATE;
+	    d->deflate_eos_seen = 0;
 	    d->want_crc = 0;
 	    d->crc = crc32(0L, Z_NULL, 0);
 	}
@@ -434,10 +618,11 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	if (len != 20) goto badarg;
 	if (d->state != ST_NONE) goto badarg;
 	wbits = i32(buf+8);
-	res = deflateInit2(&d->s, i32(buf), i32(buf+4), wbits, 
-			   i32(buf+12), i32(buf+16));
+	res = zlib_deflate_init(d, i32(buf), i32(buf+4), wbits, 
+				i32(buf+12), i32(buf+16));
 	if (res == Z_OK) {
 	    d->state = ST_DEFLATE;
+	    d->deflate_eos_seen = 0;
 	    d->want_crc = (wbits < 0);
 	    d->crc = crc32(0L, Z_NULL, 0);
 	}
@@ -446,9 +631,9 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	
     case DEFLATE_SETDICT:
 	if (d->state != ST_DEFLATE) goto badarg;
-	res = deflateSetDictionary(&d->s, (unsigned char*)buf, len);
+	res = deflateSetDictionary(&d->zs->s, (unsigned char*)buf, len);
 	if (res == Z_OK) {
-	    return zlib_value(d->s.adler, rbuf, rlen);
+	    return zlib_value(d->zs->s.adler, rbuf, rlen);
 	} else {
 	    return zlib_return(res, rbuf, rlen);
 	}
@@ -457,21 +642,25 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	if (len != 0) goto badarg;
 	if (d->state != ST_DEFLATE) goto badarg;
 	driver_deq(d->port, driver_sizeq(d->port));
-	res = deflateReset(&d->s);
+	res = deflateReset(&d->zs->s);
+	d->deflate_eos_seen = 0;
 	return zlib_return(res, rbuf, rlen);	
 	
     case DEFLATE_END:
 	if (len != 0) goto badarg;
 	if (d->state != ST_DEFLATE) goto badarg;
 	driver_deq(d->port, driver_sizeq(d->port));
-	res = deflateEnd(&d->s);
-	d->state = ST_NONE;
+	res = zlib_end(d);
 	return zlib_return(res, rbuf, rlen);
 
     case DEFLATE_PARAMS:
 	if (len != 8) goto badarg;
 	if (d->state != ST_DEFLATE) goto badarg;
-	res = deflateParams(&d->s, i32(buf), i32(buf+4));
+	res = deflateParams(&d->zs->s, i32(buf), i32(buf+4));
+	if (res == Z_OK) {
+	    d->zs->params[0] = i32(buf);
+	    d->zs->params[4] = i32(buf+4);
+	}
 	return zlib_return(res, rbuf, rlen);
 
     case DEFLATE:
@@ -483,10 +672,11 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
     case INFLATE_INIT:
 	if (len != 0) goto badarg;
 	if (d->state != ST_NONE) goto badarg;
-	res = inflateInit(&d->s);
+	res = zlib_inflate_init(d, MAX_WBITS);
 	if (res == Z_OK) {
 	    d->state = ST_INFLATE;
 	    d->inflate_eos_seen = 0;
+	    d->inflate_more_output = 0;
 	    d->want_crc = 0;
 	    d->crc = crc32(0L, Z_NULL, 0);
 	}
@@ -498,10 +688,11 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	if (len != 4) goto badarg;	
 	if (d->state != ST_NONE) goto badarg;
 	wbits = i32(buf);
-	res = inflateInit2(&d->s, wbits);
+	res = zlib_inflate_init(d, wbits);
 	if (res == Z_OK) {
 	    d->state = ST_INFLATE;
 	    d->inflate_eos_seen = 0;
+	    d->inflate_more_output = 0;
 	    d->want_crc = (wbits < 0);
 	    d->crc = crc32(0L, Z_NULL, 0);
 	}
@@ -510,7 +701,7 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	
     case INFLATE_SETDICT:
 	if (d->state != ST_INFLATE) goto badarg;
-	res = inflateSetDictionary(&d->s, (unsigned char*)buf, len);
+	res = inflateSetDictionary(&d->zs->s, (unsigned char*)buf, len);
 	return zlib_return(res, rbuf, rlen);
 
     case INFLATE_SYNC:
@@ -522,9 +713,9 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	    int vlen;
 	    SysIOVec* iov = driver_peekq(d->port, &vlen);
 
-	    d->s.next_in = iov[0].iov_base;
-	    d->s.avail_in = iov[0].iov_len;
-	    res = inflateSync(&d->s);
+	    d->zs->s.next_in = iov[0].iov_base;
+	    d->zs->s.avail_in = iov[0].iov_len;
+	    res = inflateSync(&d->zs->s);
 	}
 	return zlib_return(res, rbuf, rlen);
 
@@ -532,19 +723,19 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	if (d->state != ST_INFLATE) goto badarg;
 	if (len != 0) goto badarg;
 	driver_deq(d->port, driver_sizeq(d->port));
-	res = inflateReset(&d->s);
+	res = inflateReset(&d->zs->s);
 	d->inflate_eos_seen = 0;
+	d->inflate_more_output = 0;
 	return zlib_return(res, rbuf, rlen);
 
     case INFLATE_END:
 	if (d->state != ST_INFLATE) goto badarg;
 	if (len != 0) goto badarg;
 	driver_deq(d->port, driver_sizeq(d->port));
-	res = inflateEnd(&d->s);
+	res = zlib_end(d);
 	if (res == Z_OK && d->inflate_eos_seen == 0) {
 	    res = Z_DATA_ERROR;
 	}
-	d->state = ST_NONE;
 	return zlib_return(res, rbuf, rlen);
 
     case INFLATE:
@@ -552,7 +743,7 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	if (len != 4) goto badarg;
 	res = zlib_inflate(d, i32(buf));
 	if (res == Z_NEED_DICT) {
-	    return zlib_value2(3, d->s.adler, rbuf, rlen);
+	    return zlib_value2(3, d->zs->s.adler, rbuf, rlen);
 	} else {
 	    return zlib_return(res, rbuf, rlen);
 	}
@@ -572,7 +763,7 @@ static ErlDrvSSizeT zlib_ctl(ErlDrvData drv_data, unsigned int command, char *bu
 	if (d->binsz_need != need) {
 	    d->binsz_need = need;
 	    if (d->bin != NULL) {
-		if (d->s.avail_out == d->binsz) {
+		if (d->zs->s.avail_out == d->binsz) {
 		    driver_free_binary(d->bin);
 		    d->bin = NULL;
 		    d->binsz = 0;
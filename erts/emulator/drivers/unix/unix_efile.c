@@ -41,9 +41,9 @@
 #define DARWIN 1
 #endif
 
-#ifdef DARWIN
+#if defined(DARWIN) || (defined(HAVE_FSTATAT) && defined(HAVE_FACCESSAT))
 #include <fcntl.h>
-#endif /* DARWIN */
+#endif
 
 #ifdef VXWORKS
 #include <ioLib.h>
@@ -582,6 +582,41 @@ efile_getdcwd(Efile_error* errInfo,	/* Where to return error codes. */
     return check_error(-1, errInfo);
 }
 
+/* Everything in Efile_info but the access field */
+static void
+stat_to_info(struct stat *statbuf, Efile_info *pInfo)
+{
+#if SIZEOF_OFF_T == 4
+    pInfo->size_high = 0;
+#else
+    pInfo->size_high = (Uint32)(statbuf->st_size >> 32);
+#endif
+    pInfo->size_low = (Uint32)statbuf->st_size;
+
+    if (ISDEV(*statbuf))
+	pInfo->type = FT_DEVICE;
+    else if (ISDIR(*statbuf))
+	pInfo->type = FT_DIRECTORY;
+    else if (ISREG(*statbuf))
+	pInfo->type = FT_REGULAR;
+    else if (ISLNK(*statbuf))
+	pInfo->type = FT_SYMLINK;
+    else
+	pInfo->type = FT_OTHER;
+
+    pInfo->accessTime   = statbuf->st_atime;
+    pInfo->modifyTime   = statbuf->st_mtime;
+    pInfo->cTime        = statbuf->st_ctime;
+
+    pInfo->mode         = statbuf->st_mode;
+    pInfo->links        = statbuf->st_nlink;
+    pInfo->major_device = statbuf->st_dev;
+    pInfo->minor_device = statbuf->st_rdev;
+    pInfo->inode        = statbuf->st_ino;
+    pInfo->uid          = statbuf->st_uid;
+    pInfo->gid          = statbuf->st_gid;
+}
+
 int
 efile_readdir(Efile_error* errInfo,	/* Where to return error codes. */
 	      char* name,		/* Name of directory to open. */
@@ -629,6 +664,69 @@ efile_readdir(Efile_error* errInfo,	/* Where to return error codes. */
     }
 }
 
+void
+efile_closedir(EFILE_DIR_HANDLE dir_handle)
+{
+    closedir((DIR *) dir_handle);
+}
+
+/*
+ * Like efile_readdir(), but also returns the file information of the
+ * entry as efile_fileinfo() with info_for_link set would. Entries that
+ * disappear or can not be looked at between the two are skipped.
+ */
+int
+efile_readdir_info(Efile_error* errInfo, char* name,
+		   EFILE_DIR_HANDLE* p_dir_handle,
+		   char* buffer, size_t *size, Efile_info* pInfo)
+{
+    size_t n;
+    int result;
+
+    for (;;) {
+	n = *size;
+	if (!efile_readdir(errInfo, name, p_dir_handle, buffer, &n))
+	    return 0;
+#if defined(HAVE_FSTATAT) && defined(HAVE_FACCESSAT)
+	{
+	    /* Relative to the open directory; no path to build or resolve */
+	    struct stat statbuf;
+	    int dfd = dirfd(*((DIR **)((void *)p_dir_handle)));
+	    result = fstatat(dfd, buffer, &statbuf, AT_SYMLINK_NOFOLLOW);
+	    if (result == 0) {
+		stat_to_info(&statbuf, pInfo);
+#ifdef NO_ACCESS
+		pInfo->access = ((statbuf.st_mode >> 6) & 07) >> 1;
+#else
+		pInfo->access = FA_NONE;
+		if (faccessat(dfd, buffer, R_OK, 0) == 0)
+		    pInfo->access |= FA_READ;
+		if (faccessat(dfd, buffer, W_OK, 0) == 0)
+		    pInfo->access |= FA_WRITE;
+#endif
+	    }
+	}
+#else
+	{
+	    char path[MAXPATHLEN];
+	    size_t len = strlen(name);
+
+	    if (len + 1 + n >= MAXPATHLEN)
+		continue;
+	    memcpy(path, name, len);
+	    path[len] = '/';
+	    memcpy(path + len + 1, buffer, n + 1);
+	    result = efile_fileinfo(errInfo, pInfo, path, 1) ? 0 : -1;
+	    errInfo->posix_errno = errInfo->os_errno = 0;
+	}
+#endif
+	if (result == 0) {
+	    *size = n;
+	    return 1;
+	}
+    }
+}
+
 int
 efile_openfile(Efile_error* errInfo,	/* Where to return error codes. */
 	       char* name,		/* Name of directory to open. */
@@ -840,12 +938,7 @@ efile_fileinfo(Efile_error* errInfo, Efile_info* pInfo,
 	return 0;
     }
 
-#if SIZEOF_OFF_T == 4
-    pInfo->size_high = 0;
-#else
-    pInfo->size_high = (Uint32)(statbuf.st_size >> 32);
-#endif
-    pInfo->size_low = (Uint32)statbuf.st_size;
+    stat_to_info(&statbuf, pInfo);
 
 #ifdef NO_ACCESS
     /* Just look at read/write access for owner. */
@@ -871,29 +964,6 @@ efile_fileinfo(Efile_error* errInfo, Efile_info* pInfo,
 
 #endif	
 
-    if (ISDEV(statbuf))
-	pInfo->type = FT_DEVICE;
-    else if (ISDIR(statbuf))
-	pInfo->type = FT_DIRECTORY;
-    else if (ISREG(statbuf))
-	pInfo->type = FT_REGULAR;
-    else if (ISLNK(statbuf))
-	pInfo->type = FT_SYMLINK;
-    else
-	pInfo->type = FT_OTHER;
-
-    pInfo->accessTime   = statbuf.st_atime;
-    pInfo->modifyTime   = statbuf.st_mtime;
-    pInfo->cTime        = statbuf.st_ctime;
-
-    pInfo->mode         = statbuf.st_mode;
-    pInfo->links        = statbuf.st_nlink;
-    pInfo->major_device = statbuf.st_dev;
-    pInfo->minor_device = statbuf.st_rdev;
-    pInfo->inode        = statbuf.st_ino;
-    pInfo->uid          = statbuf.st_uid;
-    pInfo->gid          = statbuf.st_gid;
-
     return 1;
 }
 
@@ -685,6 +685,45 @@ efile_readdir(Efile_error* errInfo, /* Where to return error codes. */
     }
 }
 
+void
+efile_closedir(EFILE_DIR_HANDLE dir_handle)
+{
+    FindClose((HANDLE) dir_handle);
+}
+
+/*
+ * Like efile_readdir(), but also returns the file information of the
+ * entry as efile_fileinfo() with info_for_link set would. Entries that
+ * disappear or can not be looked at between the two are skipped.
+ */
+int
+efile_readdir_info(Efile_error* errInfo, char* name,
+		   EFILE_DIR_HANDLE* dir_handle,
+		   char* buffer, size_t *size, Efile_info* pInfo)
+{
+    WCHAR path[MAX_PATH];
+    WCHAR *wname = (WCHAR *) name;
+    size_t n, length;
+
+    for (;;) {
+	n = *size;
+	if (!efile_readdir(errInfo, name, dir_handle, buffer, &n))
+	    return 0;
+	length = wcslen(wname);
+	if (length + 1 + n/2 >= MAX_PATH)
+	    continue;
+	wcscpy(path, wname);
+	if (length > 0 && path[length-1] != L'/' && path[length-1] != L'\\')
+	    path[length++] = L'\\';
+	wcscpy(path+length, (WCHAR *) buffer);
+	if (efile_fileinfo(errInfo, pInfo, (char *) path, 1)) {
+	    *size = n;
+	    return 1;
+	}
+	errInfo->posix_errno = errInfo->os_errno = 0;
+    }
+}
+
 int
 efile_openfile(Efile_error* errInfo,		/* Where to return error codes. */
 	       char* name,			/* Name of directory to open. */
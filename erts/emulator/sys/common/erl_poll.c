@@ -71,6 +71,9 @@
 #include "erl_thr_progress.h"
 #include "erl_driver.h"
 #include "erl_alloc.h"
+#if ERTS_POLL_USE_EPOLL
+#  include "erl_uring.h"
+#endif
 
 #if !defined(ERTS_POLL_USE_EPOLL) \
     && !defined(ERTS_POLL_USE_DEVPOLL)  \
@@ -105,6 +108,32 @@
 
 #define ERTS_POLL_COALESCE_KP_RES (ERTS_POLL_USE_KQUEUE || ERTS_POLL_USE_EPOLL)
 
+/*
+ * On Linux an io_uring, when the kernel has one, replaces the epoll set.
+ * Polls are armed one-shot and re-armed by the polling thread after
+ * each event, which keeps the level triggered behaviour of epoll. All
+ * updates are queued as submissions and handed to the kernel by the
+ * same io_uring_enter() call that waits, instead of one epoll_ctl()
+ * each.
+ */
+#if ERTS_POLL_USE_EPOLL && ERTS_HAVE_IO_URING
+#  define ERTS_POLL_USE_IO_URING 1
+#else
+#  define ERTS_POLL_USE_IO_URING 0
+#endif
+
+#if ERTS_POLL_USE_IO_URING
+#define ERTS_POLL_RING_ENTRIES 1024
+#define ERTS_POLL_RING_CQ_ENTRIES (4*ERTS_POLL_RING_ENTRIES)
+/* user_data of requests whose completions we do not care about */
+#define ERTS_POLL_RING_IGNORE (~((Uint64) 0))
+#define ERTS_POLL_RING_KEY(FD, GEN) \
+  ((((Uint64) (GEN)) << 32) | (Uint64) (Uint32) (FD))
+#define ERTS_POLL_USING_RING(PS) ((PS)->use_ring)
+#else
+#define ERTS_POLL_USING_RING(PS) 0
+#endif
+
 #define FDS_STATUS_EXTRA_FREE_SIZE 128
 #define POLL_FDS_EXTRA_FREE_SIZE 128
 
@@ -188,6 +217,9 @@ struct ErtsPollSetUpdateRequestsBlock_ {
 #if ERTS_POLL_USE_KERNEL_POLL || defined(ERTS_SMP)
 #  define ERTS_POLL_FD_FLG_RST		(((unsigned short) 1) << 3)
 #endif
+#if ERTS_POLL_USE_IO_URING
+#  define ERTS_POLL_FD_FLG_RARMED	(((unsigned short) 1) << 4)
+#endif
 typedef struct {
 #if ERTS_POLL_USE_POLL
     int pix;
@@ -200,6 +232,9 @@ typedef struct {
 #if ERTS_POLL_USE_UPDATE_REQUESTS_QUEUE || ERTS_POLL_USE_FALLBACK
     unsigned short flags;
 #endif
+#if ERTS_POLL_USE_IO_URING
+    unsigned short ring_gen;
+#endif
 
 } ErtsFdStatus;
 
@@ -232,6 +267,10 @@ struct ErtsPollSet_ {
     int res_events_len;
 #if ERTS_POLL_USE_EPOLL
     struct epoll_event *res_events;
+#if ERTS_POLL_USE_IO_URING
+    int use_ring;
+    ErtsURing ring;
+#endif
 #elif ERTS_POLL_USE_KQUEUE
     struct kevent *res_events;
 #elif ERTS_POLL_USE_DEVPOLL
@@ -632,6 +671,9 @@ grow_fds_status(ErtsPollSet ps, int min_fd)
 #endif
 #if ERTS_POLL_USE_UPDATE_REQUESTS_QUEUE || ERTS_POLL_USE_FALLBACK
 	ps->fds_status[i].flags = (unsigned short) 0;
+#endif
+#if ERTS_POLL_USE_IO_URING
+	ps->fds_status[i].ring_gen = (unsigned short) 0;
 #endif
     }
     ps->fds_status_len = new_len;
@@ -667,6 +709,14 @@ need_update(ErtsPollSet ps, int fd)
     if (ps->fds_status[fd].used_events != ps->fds_status[fd].events)
 	return 1;
 
+#if ERTS_POLL_USE_IO_URING
+    /* Fired and not yet re-armed */
+    if (ERTS_POLL_USING_RING(ps)
+	&& ps->fds_status[fd].events
+	&& !(ps->fds_status[fd].flags & ERTS_POLL_FD_FLG_RARMED))
+	return 1;
+#endif
+
 #if ERTS_POLL_USE_KERNEL_POLL
     return reset;
 #else
@@ -1008,6 +1058,68 @@ batch_update_pollset(ErtsPollSet ps, int fd, ErtsPollBatchBuf *bbp)
 
 #else /* !ERTS_POLL_USE_BATCH_UPDATE_POLLSET */
 
+#if ERTS_POLL_USE_IO_URING
+
+static ERTS_INLINE struct io_uring_sqe *
+get_ring_sqe(ErtsPollSet ps)
+{
+    struct io_uring_sqe *sqe = erts_uring_get_sqe(&ps->ring);
+    if (!sqe)
+	fatal_error("%s:%d:get_ring_sqe(): Failed to flush io_uring "
+		    "submission queue: %s (%d)\n",
+		    __FILE__, __LINE__, erl_errno_id(errno), errno);
+    return sqe;
+}
+
+/*
+ * Only called by the polling thread (or with the poll set otherwise not
+ * in use); concurrent updates are queued as update requests instead.
+ */
+static int
+update_ring_pollset(ErtsPollSet ps, int fd)
+{
+    ErtsFdStatus *fdsp = &ps->fds_status[fd];
+    ErtsPollEvents events = fdsp->events;
+    struct io_uring_sqe *sqe;
+
+    if ((fdsp->flags & ERTS_POLL_FD_FLG_RARMED)
+	&& (events != fdsp->used_events
+	    || (fdsp->flags & ERTS_POLL_FD_FLG_RST))) {
+	sqe = get_ring_sqe(ps);
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = ERTS_POLL_RING_KEY(fd, fdsp->ring_gen);
+	sqe->user_data = ERTS_POLL_RING_IGNORE;
+	fdsp->flags &= ~ERTS_POLL_FD_FLG_RARMED;
+    }
+
+    if (!events) {
+	if (fdsp->used_events)
+	    erts_smp_atomic_dec_nob(&ps->no_of_user_fds);
+    }
+    else {
+	if (!fdsp->used_events)
+	    erts_smp_atomic_inc_nob(&ps->no_of_user_fds);
+	if (!(fdsp->flags & ERTS_POLL_FD_FLG_RARMED)) {
+	    /* A new generation lets us tell completions of earlier
+	       polls on the same fd apart from this one */
+	    fdsp->ring_gen++;
+	    sqe = get_ring_sqe(ps);
+	    sqe->opcode = IORING_OP_POLL_ADD;
+	    sqe->fd = fd;
+	    sqe->poll32_events =
+		erts_uring_poll_mask((Uint32) ERTS_POLL_EV_E2N(events));
+	    sqe->user_data = ERTS_POLL_RING_KEY(fd, fdsp->ring_gen);
+	    fdsp->flags |= ERTS_POLL_FD_FLG_RARMED;
+	}
+    }
+    fdsp->used_events = events;
+    fdsp->flags &= ~ERTS_POLL_FD_FLG_RST;
+    return 0;
+}
+
+#endif /* ERTS_POLL_USE_IO_URING */
+
 #if ERTS_POLL_USE_EPOLL
 static int
 #if ERTS_POLL_USE_CONCURRENT_UPDATE
@@ -1023,6 +1135,14 @@ update_pollset(ErtsPollSet ps, int fd)
 
     ASSERT(fd < ps->fds_status_len);
 
+#if ERTS_POLL_USE_IO_URING && ERTS_POLL_USE_CONCURRENT_UPDATE
+    if (ERTS_POLL_USING_RING(ps) && !*update_fallback) {
+	/* The submission queue belongs to the polling thread */
+	*update_fallback = 1;
+	return 0;
+    }
+#endif
+
     if (!need_update(ps, fd))
 	return 0;
 
@@ -1050,6 +1170,11 @@ update_pollset(ErtsPollSet ps, int fd)
 	}
     }
 
+#if ERTS_POLL_USE_IO_URING
+    if (ERTS_POLL_USING_RING(ps))
+	return update_ring_pollset(ps, fd);
+#endif
+
     epe_templ.events = ERTS_POLL_EV_E2N(ps->fds_status[fd].events);
     epe_templ.data.fd = fd;
 
@@ -1464,6 +1589,17 @@ poll_control(ErtsPollSet ps, int fd, ErtsPollEvents events, int on, int *do_wake
     if ((new_events && (ps->fds_status[fd].flags & ERTS_POLL_FD_FLG_RST))
 	|| (~ps->fds_status[fd].used_events & new_events))
 	*do_wake = 1;
+#if ERTS_POLL_USE_IO_URING
+    /*
+     * An armed poll holds a reference to the file, which would keep
+     * e.g. a socket open after the driver has closed it; get the
+     * poller to cancel it right away instead of at its next wakeup.
+     */
+    if (ERTS_POLL_USING_RING(ps)
+	&& !new_events
+	&& (ps->fds_status[fd].flags & ERTS_POLL_FD_FLG_RARMED))
+	*do_wake = 1;
+#endif
 #endif /* ERTS_SMP */
 
 #endif /* ERTS_POLL_USE_UPDATE_REQUESTS_QUEUE */
@@ -1537,6 +1673,73 @@ ERTS_POLL_EXPORT(erts_poll_control)(ErtsPollSet ps,
 
 #if ERTS_POLL_USE_KERNEL_POLL
 
+#if ERTS_POLL_USE_IO_URING
+
+static int
+save_ring_result(ErtsPollSet ps, ErtsPollResFd pr[], int max_res)
+{
+    int res = 0;
+    struct io_uring_cqe *cqe;
+#if ERTS_POLL_USE_WAKEUP_PIPE
+    int wake_fd = ps->wake_fds[0];
+#endif
+
+    while (res < max_res && (cqe = erts_uring_peek_cqe(&ps->ring)) != NULL) {
+	Uint64 key = cqe->user_data;
+	int cres = cqe->res;
+	int fd, ix;
+	ErtsFdStatus *fdsp;
+	ErtsPollEvents revents;
+
+	erts_uring_cqe_seen(&ps->ring);
+
+	if (key == ERTS_POLL_RING_IGNORE)
+	    continue;
+	fd = (int) (Uint32) key;
+	if (fd >= ps->fds_status_len)
+	    continue;
+	fdsp = &ps->fds_status[fd];
+	if (!(fdsp->flags & ERTS_POLL_FD_FLG_RARMED)
+	    || fdsp->ring_gen != (unsigned short) (key >> 32))
+	    continue; /* Completion of a poll that has been replaced */
+
+	/* One-shot; arm it again before the next wait */
+	fdsp->flags &= ~ERTS_POLL_FD_FLG_RARMED;
+	if (fdsp->events)
+	    enqueue_update_request(ps, fd);
+
+#if ERTS_POLL_USE_WAKEUP_PIPE
+	if (fd == wake_fd) {
+	    cleanup_wakeup_pipe(ps);
+	    continue;
+	}
+#endif
+	if (cres == -ECANCELED)
+	    continue;
+	if (cres < 0)
+	    revents = ERTS_POLL_EV_NVAL;
+	else /* The events may have been changed since the poll was armed */
+	    revents = (ERTS_POLL_EV_N2E((Uint32) cres)
+		       & (fdsp->events | ERTS_POLL_EV_ERR));
+	if (!revents)
+	    continue;
+
+	ix = (int) fdsp->res_ev_ix;
+	if (ix >= res || pr[ix].fd != fd) {
+	    ix = res;
+	    pr[ix].fd = fd;
+	    pr[ix].events = (ErtsPollEvents) 0;
+	    fdsp->res_ev_ix = (unsigned short) ix;
+	    res++;
+	}
+	pr[ix].events |= revents;
+    }
+
+    return res;
+}
+
+#endif /* ERTS_POLL_USE_IO_URING */
+
 static ERTS_INLINE int
 save_kp_result(ErtsPollSet ps, ErtsPollResFd pr[], int max_res, int chk_fds_res)
 {
@@ -1547,6 +1750,11 @@ save_kp_result(ErtsPollSet ps, ErtsPollResFd pr[], int max_res, int chk_fds_res)
     int wake_fd = ps->wake_fds[0];
 #endif
 
+#if ERTS_POLL_USE_IO_URING
+    if (ERTS_POLL_USING_RING(ps))
+	return save_ring_result(ps, pr, max_res);
+#endif
+
     for (i = 0; i < n; i++) {
 
 #if ERTS_POLL_USE_EPOLL		/* --- epoll ------------------------------- */
@@ -1660,6 +1868,11 @@ get_kp_results(ErtsPollSet ps, ErtsPollResFd pr[], int max_res)
     struct timespec ts = {0, 0};
 #endif
 
+#if ERTS_POLL_USE_IO_URING
+    if (ERTS_POLL_USING_RING(ps))
+	return save_ring_result(ps, pr, max_res);
+#endif
+
     if (max_res > ps->res_events_len)
 	grow_res_events(ps, max_res);
 
@@ -1915,6 +2128,28 @@ check_fd_events(ErtsPollSet ps, SysTimeval *tv, int max_res)
 	if (!(ps->fallback_used = ERTS_POLL_NEED_FALLBACK(ps))) {
 
 #if ERTS_POLL_USE_EPOLL		/* --- epoll ------------------------------- */
+#if ERTS_POLL_USE_IO_URING
+	    if (ERTS_POLL_USING_RING(ps)) {
+		int err;
+		/* Only wait if nothing is left over from last time */
+		int wait = (timeout && !erts_uring_cq_ready(&ps->ring));
+#ifdef ERTS_SMP
+		if (wait)
+		    erts_thr_progress_prepare_wait(NULL);
+#endif
+		err = erts_uring_enter(&ps->ring, wait ? 1 : 0, timeout);
+#ifdef ERTS_SMP
+		if (wait)
+		    erts_thr_progress_finalize_wait(NULL);
+#endif
+		res = (int) erts_uring_cq_ready(&ps->ring);
+		if (!res && err && err != EBUSY) {
+		    errno = err;
+		    res = -1;
+		}
+		return res;
+	    }
+#endif
 	    if (timeout > INT_MAX)
 		timeout = INT_MAX;
 	    if (max_res > ps->res_events_len)
@@ -2251,7 +2486,14 @@ ERTS_POLL_EXPORT(erts_poll_create_pollset)(void)
 #if ERTS_POLL_USE_KERNEL_POLL
     ps->kp_fd = -1;
 #if ERTS_POLL_USE_EPOLL
+#if ERTS_POLL_USE_IO_URING
+    ps->use_ring = (erts_uring_init(&ps->ring,
+				    ERTS_POLL_RING_ENTRIES,
+				    ERTS_POLL_RING_CQ_ENTRIES) == 0);
+    kp_fd = ps->use_ring ? ps->ring.fd : epoll_create(256);
+#else
     kp_fd = epoll_create(256);
+#endif
     ps->res_events_len = 0;
     ps->res_events = NULL;
 #elif ERTS_POLL_USE_DEVPOLL
@@ -2358,6 +2600,11 @@ ERTS_POLL_EXPORT(erts_poll_destroy_pollset)(ErtsPollSet ps)
 	erts_free(ERTS_ALC_T_FD_STATUS, (void *) ps->fds_status);
 
 #if ERTS_POLL_USE_EPOLL
+#if ERTS_POLL_USE_IO_URING
+    if (ps->use_ring)
+	erts_uring_exit(&ps->ring);
+    else
+#endif
     if (ps->kp_fd >= 0)
 	close(ps->kp_fd);
     if (ps->res_events)
@@ -2451,6 +2698,8 @@ ERTS_POLL_EXPORT(erts_poll_info)(ErtsPollSet ps, ErtsPollInfo *pip)
     pip->primary = 
 #if ERTS_POLL_USE_KQUEUE
 	"kqueue"
+#elif ERTS_POLL_USE_IO_URING
+	(ps->use_ring ? "io_uring" : "epoll")
 #elif ERTS_POLL_USE_EPOLL
 	"epoll"
 #elif ERTS_POLL_USE_DEVPOLL
@@ -2477,6 +2726,8 @@ ERTS_POLL_EXPORT(erts_poll_info)(ErtsPollSet ps, ErtsPollInfo *pip)
 	NULL
 #elif ERTS_POLL_USE_KQUEUE
 	"kqueue"
+#elif ERTS_POLL_USE_IO_URING
+	(ps->use_ring ? "io_uring" : "epoll")
 #elif ERTS_POLL_USE_EPOLL
 	"epoll"
 #elif ERTS_POLL_USE_DEVPOLL
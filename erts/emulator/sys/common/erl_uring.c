@@ -0,0 +1,194 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2013. All Rights Reserved.
+ *
+ * The contents of this file are subject to the Erlang Public License,
+ * Version 1.1, (the "License"); you may not use this file except in
+ * compliance with the License. You should have received a copy of the
+ * Erlang Public License along with this software. If not, it can be
+ * retrieved online at http://www.erlang.org/.
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * %CopyrightEnd%
+ */
+
+/*
+ * Description:	Setup, submission and teardown of io_uring rings. We
+ *              talk to the kernel directly instead of through liburing;
+ *              only the handful of operations ERTS needs are covered.
+ *              Rings are never set up with SQPOLL, so the kernel only
+ *              looks at the submission queue inside io_uring_enter().
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "erl_uring.h"
+
+#if ERTS_HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* Cleared by ERL_NO_IO_URING; read when rings are set up */
+int erts_use_io_uring = 1;
+
+#define ERTS_URING_FEATURES (IORING_FEAT_SINGLE_MMAP		\
+			     | IORING_FEAT_NODROP		\
+			     | IORING_FEAT_EXT_ARG		\
+			     | IORING_FEAT_RW_CUR_POS)
+
+int
+erts_uring_init(ErtsURing *r, unsigned entries, unsigned cq_entries)
+{
+    struct io_uring_params p;
+    size_t sq_size, cq_size;
+    char *ptr;
+    void *sqes;
+    int fd, err;
+
+    r->fd = -1;
+    if (!erts_use_io_uring)
+	return ENOSYS;
+
+    memset(&p, 0, sizeof(p));
+    if (cq_entries) {
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = cq_entries;
+    }
+    fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0)
+	return errno;
+    if ((p.features & ERTS_URING_FEATURES) != ERTS_URING_FEATURES) {
+	/* Kernel older than 5.11; the callers have fallbacks */
+	close(fd);
+	return ENOSYS;
+    }
+
+    sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    cq_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    r->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ptr = mmap(NULL, r->ring_size, PROT_READ|PROT_WRITE,
+	       MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED) {
+	err = errno;
+	close(fd);
+	return err;
+    }
+    r->sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+    sqes = mmap(NULL, r->sqes_size, PROT_READ|PROT_WRITE,
+		MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+	err = errno;
+	munmap(ptr, r->ring_size);
+	close(fd);
+	return err;
+    }
+
+    r->ring_ptr = (void *) ptr;
+    r->sq_head = (unsigned *) (ptr + p.sq_off.head);
+    r->sq_tail = (unsigned *) (ptr + p.sq_off.tail);
+    r->sq_mask = (unsigned *) (ptr + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *) (ptr + p.sq_off.array);
+    r->sqes = (struct io_uring_sqe *) sqes;
+    r->cq_head = (unsigned *) (ptr + p.cq_off.head);
+    r->cq_tail = (unsigned *) (ptr + p.cq_off.tail);
+    r->cq_mask = (unsigned *) (ptr + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *) (ptr + p.cq_off.cqes);
+    r->entries = p.sq_entries;
+    r->pending = 0;
+    r->fd = fd;
+    return 0;
+}
+
+void
+erts_uring_exit(ErtsURing *r)
+{
+    if (r->fd < 0)
+	return;
+    munmap((void *) r->sqes, r->sqes_size);
+    munmap(r->ring_ptr, r->ring_size);
+    close(r->fd);
+    r->fd = -1;
+}
+
+/*
+ * Submit what is queued and, if min_complete > 0, wait until that many
+ * completions are available or timeout milliseconds (< 0 for no limit)
+ * have passed. Returns 0 or an errno value; a timeout is not an error,
+ * callers look at the completion queue to find out what happened.
+ */
+int
+erts_uring_enter(ErtsURing *r, unsigned min_complete, long timeout)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = 0;
+    int res;
+
+    if (!r->pending && !min_complete)
+	return 0;
+
+    memset(&arg, 0, sizeof(arg));
+    if (min_complete) {
+	flags = IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG;
+	if (timeout >= 0) {
+	    ts.tv_sec = timeout / 1000;
+	    ts.tv_nsec = (timeout % 1000) * 1000000;
+	    arg.ts = (__u64) (UWord) &ts;
+	}
+    }
+    res = (int) syscall(__NR_io_uring_enter, r->fd, r->pending, min_complete,
+			flags, flags ? &arg : NULL, flags ? sizeof(arg) : 0);
+    if (res < 0)
+	return errno == ETIME ? 0 : errno;
+    ASSERT(res <= r->pending);
+    r->pending -= res;
+    return 0;
+}
+
+/*
+ * The entry is handed out with the tail already moved past it; this is
+ * fine since the kernel does not read it until the next
+ * erts_uring_enter() made by the same thread. Returns NULL if the queue
+ * is full and could not be flushed.
+ */
+struct io_uring_sqe *
+erts_uring_get_sqe(ErtsURing *r)
+{
+    unsigned tail = *r->sq_tail;
+    unsigned ix;
+    struct io_uring_sqe *sqe;
+
+    if (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->entries) {
+	if (erts_uring_enter(r, 0, -1) != 0
+	    || (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE)
+		>= r->entries))
+	    return NULL;
+    }
+    ix = tail & *r->sq_mask;
+    sqe = &r->sqes[ix];
+    memset((void *) sqe, 0, sizeof(*sqe));
+    r->sq_array[ix] = ix;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->pending++;
+    return sqe;
+}
+
+/* Take back what was queued since the last successful submit */
+void
+erts_uring_discard(ErtsURing *r)
+{
+    __atomic_store_n(r->sq_tail, *r->sq_tail - r->pending, __ATOMIC_RELEASE);
+    r->pending = 0;
+}
+
+#endif /* ERTS_HAVE_IO_URING */
@@ -0,0 +1,107 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2013. All Rights Reserved.
+ *
+ * The contents of this file are subject to the Erlang Public License,
+ * Version 1.1, (the "License"); you may not use this file except in
+ * compliance with the License. You should have received a copy of the
+ * Erlang Public License along with this software. If not, it can be
+ * retrieved online at http://www.erlang.org/.
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * %CopyrightEnd%
+ */
+
+/*
+ * Description:	Minimal io_uring support (Linux) shared by the poll
+ *              implementation and the file driver. A ring is owned by
+ *              one thread at a time; nothing here is thread safe.
+ */
+
+#ifndef ERL_URING_H__
+#define ERL_URING_H__
+
+#include "sys.h"
+
+#undef ERTS_HAVE_IO_URING
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__GNUC__)
+#  include <linux/io_uring.h>
+#  if defined(IORING_FEAT_EXT_ARG) && defined(IORING_FEAT_RW_CUR_POS)
+#    define ERTS_HAVE_IO_URING 1
+#  endif
+#endif
+#ifndef ERTS_HAVE_IO_URING
+#  define ERTS_HAVE_IO_URING 0
+#endif
+
+#if ERTS_HAVE_IO_URING
+
+#include <string.h>
+
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned pending;		/* Queued on the sq but not yet submitted */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *ring_ptr;
+    size_t ring_size;
+    size_t sqes_size;
+} ErtsURing;
+
+extern int erts_use_io_uring;
+
+int erts_uring_init(ErtsURing *, unsigned entries, unsigned cq_entries);
+void erts_uring_exit(ErtsURing *);
+int erts_uring_enter(ErtsURing *, unsigned min_complete, long timeout);
+struct io_uring_sqe *erts_uring_get_sqe(ErtsURing *);
+void erts_uring_discard(ErtsURing *);
+
+/* Completions are reaped one at a time: peek, use, then mark as seen */
+static ERTS_INLINE struct io_uring_cqe *
+erts_uring_peek_cqe(ErtsURing *r)
+{
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+	return NULL;
+    return &r->cqes[head & *r->cq_mask];
+}
+
+static ERTS_INLINE void
+erts_uring_cqe_seen(ErtsURing *r)
+{
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+static ERTS_INLINE unsigned
+erts_uring_cq_ready(ErtsURing *r)
+{
+    return __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE) - *r->cq_head;
+}
+
+/* The kernel reads poll32_events as two swapped halves on big endian */
+static ERTS_INLINE Uint32
+erts_uring_poll_mask(Uint32 events)
+{
+#ifdef WORDS_BIGENDIAN
+    return (events << 16) | (events >> 16);
+#else
+    return events;
+#endif
+}
+
+#endif /* ERTS_HAVE_IO_URING */
+
+#endif /* #ifndef ERL_URING_H__ */
@@ -21,6 +21,11 @@
  * After a vfork() (or fork()) the child exec()s to this program which
  * sets up the child and exec()s to the user program (see spawn_start()
  * in sys.c and ticket OTP-4389).
+ *
+ * The same program is also used as the forkserver which the emulator
+ * starts once and then lets fork all spawned port programs. It is
+ * small, so fork() is cheap in it, whereas a fork() or even a vfork()
+ * of a large emulator stalls the scheduler doing it.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -31,6 +36,18 @@
 #include "sys.h"
 #include "erl_misc_utils.h"
 
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#if defined(SOCK_SEQPACKET) && defined(SCM_RIGHTS)
+#  define FORKSERVER 1
+#else
+#  define FORKSERVER 0
+#endif
+
 #ifdef SIG_SIGSET		/* Old SysV */
 void sys_sigrelease(int sig)
 {
@@ -54,12 +71,312 @@ void sys_sigrelease(int sig)
 #endif /* !SIG_SIGNAL */
 #endif /* !SIG_SIGSET */
 
+#if FORKSERVER
+
+/* Exit status reported for children that could not be started */
+#define FS_FAILED_STATUS (1 << 8)
+
+typedef struct {
+    pid_t pid;
+    int seq;
+} FsChild;
+
+static FsChild *fs_children;
+static int fs_no_children;
+static int fs_children_sz;
+static int fs_sigchld_pipe[2];
+
+static void
+fs_onchld(int signum)
+{
+    int saved_errno = errno;
+    (void) write(fs_sigchld_pipe[1], "C", 1);
+    errno = saved_errno;
+}
+
+static void
+fs_send_exit(int sock, int seq, int status)
+{
+    ErtsForkserverExit ex;
+    ex.seq = seq;
+    ex.status = status;
+    while (send(sock, (void *) &ex, sizeof(ex), 0) < 0 && errno == EINTR)
+	;
+}
+
+static void
+fs_add_child(pid_t pid, int seq)
+{
+    if (fs_no_children == fs_children_sz) {
+	fs_children_sz = fs_children_sz ? 2*fs_children_sz : 64;
+	fs_children = realloc(fs_children, fs_children_sz*sizeof(FsChild));
+	if (!fs_children)
+	    _exit(1);
+    }
+    fs_children[fs_no_children].pid = pid;
+    fs_children[fs_no_children].seq = seq;
+    fs_no_children++;
+}
+
+static void
+fs_reap_children(int sock)
+{
+    pid_t pid;
+    int i, status;
+    char buf[64];
+
+    while (read(fs_sigchld_pipe[0], buf, sizeof(buf)) > 0)
+	;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+	for (i = 0; i < fs_no_children; i++) {
+	    if (fs_children[i].pid == pid) {
+		fs_send_exit(sock, fs_children[i].seq, status);
+		fs_children[i] = fs_children[--fs_no_children];
+		break;
+	    }
+	}
+    }
+}
+
+/* The child; same setup as after fork() in spawn_start() */
+static void
+fs_exec_child(ErtsForkserverReq *req, int wfd, int rfd, int max_files,
+	      char *cmd, char *wd, char **args, char **env)
+{
+    int i, use_stdio = req->flags & CS_FS_USE_STDIO;
+    char *sh_argv[4];
+
+    (void) signal(SIGCHLD, SIG_DFL);
+
+    /* Get the pipe ends out of the way of the dup2() targets */
+    if (wfd >= 0 && wfd < 5 && (wfd = fcntl(wfd, F_DUPFD, 5)) < 0)
+	_exit(1);
+    if (rfd >= 0 && rfd < 5 && (rfd = fcntl(rfd, F_DUPFD, 5)) < 0)
+	_exit(1);
+
+    if (use_stdio) {
+	if (req->flags & CS_FS_DO_READ) {
+	    if (dup2(wfd, 1) < 0)
+		_exit(1);
+	    if ((req->flags & CS_FS_REDIR_STDERR) && dup2(wfd, 2) < 0)
+		_exit(1);
+	}
+	if ((req->flags & CS_FS_DO_WRITE) && dup2(rfd, 0) < 0)
+	    _exit(1);
+    }
+    else {
+	if ((req->flags & CS_FS_DO_READ) && dup2(wfd, 4) < 0)
+	    _exit(1);
+	if ((req->flags & CS_FS_DO_WRITE) && dup2(rfd, 3) < 0)
+	    _exit(1);
+    }
+
+    for (i = use_stdio ? 3 : 5; i < max_files; i++)
+	(void) close(i);
+
+    if (*wd && chdir(wd) < 0)
+	_exit(1);
+
+#if defined(USE_SETPGRP_NOARGS)		/* SysV */
+    (void) setpgrp();
+#elif defined(USE_SETPGRP)		/* BSD */
+    (void) setpgrp(0, getpid());
+#else					/* POSIX */
+    (void) setsid();
+#endif
+
+    sys_sigrelease(SIGCHLD);
+    sys_sigrelease(SIGINT);
+    sys_sigrelease(SIGUSR1);
+
+    if (req->flags & CS_FS_EXECUTABLE) {
+	if (!args[0]) {
+	    args[0] = cmd;
+	    args[1] = NULL;
+	}
+	execve(cmd, args, env);
+    }
+    else {
+	sh_argv[0] = "sh";
+	sh_argv[1] = "-c";
+	sh_argv[2] = cmd;
+	sh_argv[3] = NULL;
+	execve("/bin/sh", sh_argv, env);
+    }
+    _exit(1);
+}
+
+/* Returns 0 when the emulator has gone away */
+static int
+fs_handle_request(int sock, int max_files)
+{
+    ErtsForkserverReq req;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+	struct cmsghdr align;
+	char buf[CMSG_SPACE(2*sizeof(int))];
+    } cbuf;
+    int fds[2] = {-1, -1}, wfd, rfd;
+    char *buf, *p, *end, *cmd, *wd, **args;
+    size_t argv_offs;
+    ssize_t n;
+    pid_t pid;
+    int i;
+
+    n = recv(sock, (void *) &req, sizeof(req), MSG_PEEK);
+    if (n == 0)
+	return 0;
+    if (n < 0)
+	return errno == EINTR || errno == EAGAIN;
+    if (n < (ssize_t) sizeof(req) || req.size < (int) sizeof(req)
+	|| req.nargs < 0 || req.nenv < 0) {
+	(void) recv(sock, (void *) &req, sizeof(req), 0);
+	return 1;
+    }
+
+    /* The strings, then the (aligned) argument and environment vectors */
+    argv_offs = ((req.size + sizeof(char *) - 1)
+		 / sizeof(char *)) * sizeof(char *);
+    buf = malloc(argv_offs + (req.nargs + req.nenv + 2)*sizeof(char *));
+    if (!buf) {
+	(void) recv(sock, (void *) &req, sizeof(req), 0);
+	fs_send_exit(sock, req.seq, FS_FAILED_STATUS);
+	return 1;
+    }
+    args = (char **) (buf + argv_offs);
+
+    iov.iov_base = buf;
+    iov.iov_len = req.size;
+    memset((void *) &msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = sizeof(cbuf.buf);
+    do {
+	n = recvmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+	free(buf);
+	return 0;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+	    int nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+	    memcpy((void *) fds, (void *) CMSG_DATA(cmsg),
+		   (nfds > 2 ? 2 : nfds)*sizeof(int));
+	}
+    }
+    wfd = (req.flags & CS_FS_DO_READ) ? fds[0] : -1;
+    rfd = (req.flags & CS_FS_DO_READ) ? fds[1] : fds[0];
+    if (!(req.flags & CS_FS_DO_WRITE))
+	rfd = -1;
+
+    /* Unpack the strings */
+    p = buf + sizeof(req);
+    end = buf + n;
+    cmd = wd = NULL;
+    for (i = -2; i < req.nargs + req.nenv && p < end; i++) {
+	char *str = p;
+	while (p < end && *p)
+	    p++;
+	if (p == end)
+	    break;
+	p++;
+	if (i == -2)
+	    cmd = str;
+	else if (i == -1)
+	    wd = str;
+	else if (i < req.nargs)
+	    args[i] = str;
+	else
+	    args[i + 1] = str;
+    }
+
+    if (n != req.size || i != req.nargs + req.nenv
+	|| ((req.flags & CS_FS_DO_READ) && wfd < 0)
+	|| ((req.flags & CS_FS_DO_WRITE) && rfd < 0))
+	pid = -1;
+    else {
+	args[req.nargs] = NULL;
+	args[req.nargs + 1 + req.nenv] = NULL;
+	pid = fork();
+	if (pid == 0)
+	    fs_exec_child(&req, wfd, rfd, max_files, cmd, wd,
+			  args, &args[req.nargs + 1]);
+    }
+
+    if (fds[0] >= 0)
+	(void) close(fds[0]);
+    if (fds[1] >= 0)
+	(void) close(fds[1]);
+    free(buf);
+
+    if (pid < 0)
+	fs_send_exit(sock, req.seq, FS_FAILED_STATUS);
+    else
+	fs_add_child(pid, req.seq);
+    return 1;
+}
+
+static int
+forkserver(int sock, int max_files)
+{
+    struct pollfd pfds[2];
+    struct sigaction sa;
+    int i;
+
+    (void) setsid();
+
+    if (pipe(fs_sigchld_pipe) < 0)
+	return 1;
+    (void) fcntl(sock, F_SETFD, FD_CLOEXEC);
+    for (i = 0; i < 2; i++) {
+	(void) fcntl(fs_sigchld_pipe[i], F_SETFD, FD_CLOEXEC);
+	(void) fcntl(fs_sigchld_pipe[i], F_SETFL,
+		     fcntl(fs_sigchld_pipe[i], F_GETFL) | O_NONBLOCK);
+    }
+    memset((void *) &sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sa.sa_handler = fs_onchld;
+    if (sigaction(SIGCHLD, &sa, NULL) < 0)
+	return 1;
+    sys_sigrelease(SIGCHLD);
+
+    pfds[0].fd = sock;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = fs_sigchld_pipe[0];
+    pfds[1].events = POLLIN;
+
+    while (1) {
+	if (poll(pfds, 2, -1) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return 1;
+	}
+	if (pfds[1].revents)
+	    fs_reap_children(sock);
+	if (pfds[0].revents && !fs_handle_request(sock, max_files))
+	    return 0;
+    }
+}
+
+#endif /* FORKSERVER */
+
 int
 main(int argc, char *argv[])
 {
     int i, from, to;
     int erts_spawn_executable = 0;
 
+#if FORKSERVER
+    if (argc == 4 && strcmp(argv[1], CS_FORKSERVER_ARG) == 0)
+	return forkserver(atoi(argv[2]), atoi(argv[3]));
+#endif
+
     /* OBSERVE!
      * Keep child setup after fork() (implemented in sys.c) up to date
      * if changes are made here.
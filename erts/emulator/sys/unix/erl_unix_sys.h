@@ -72,6 +72,10 @@
 
 #if HAVE_MMAP
 #   include <sys/mman.h>
+/* Mapped files are guarded by a read lease, see sys.c */
+#   if defined(MAP_ANON) && defined(MREMAP_FIXED) && defined(F_SETLEASE)
+#       define ERTS_HAVE_MMAP_BINARY 1
+#   endif
 #endif
 
 #if TIME_WITH_SYS_TIME
@@ -129,6 +133,10 @@
 #define HAVE_ERTS_CHECK_IO_DEBUG
 int erts_check_io_debug(void);
 
+#ifdef ERTS_HAVE_MMAP_BINARY
+struct erl_drv_binary *erts_sys_mmap_drv_binary(int fd, size_t size);
+#endif
+
 #ifndef ERTS_SMP
 #  undef ERTS_POLL_NEED_ASYNC_INTERRUPT_SUPPORT
 #  define ERTS_POLL_NEED_ASYNC_INTERRUPT_SUPPORT
@@ -322,6 +330,37 @@ void erts_sys_unblock_fpe(int);
 
 #define CS_ARGV_NO_OF_DUP2_OPS	3		/* Number of dup2 ops	*/
 #define CS_ARGV_NO_OF_ARGS	8		/* Number of arguments	*/
+
+/*
+ * The child setup program can instead be started as a forkserver:
+ * "child_setup -forkserver <socket fd> <max files>". Spawn requests
+ * are then sent to it as packets on the socket (a SOCK_SEQPACKET
+ * socket pair), each an ErtsForkserverReq followed by its strings
+ * (the command, the working directory, the nargs arguments and the
+ * nenv environment entries, all NUL terminated) and with the pipe
+ * ends of the child passed as SCM_RIGHTS, write end first. No reply
+ * is sent; when a child exits an ErtsForkserverExit is sent back.
+ */
+#define CS_FORKSERVER_ARG	"-forkserver"
+
+#define CS_FS_USE_STDIO		(1 << 0)
+#define CS_FS_REDIR_STDERR	(1 << 1)
+#define CS_FS_DO_READ		(1 << 2)	/* We read, child writes */
+#define CS_FS_DO_WRITE		(1 << 3)	/* We write, child reads */
+#define CS_FS_EXECUTABLE	(1 << 4)	/* No /bin/sh -c	*/
+
+typedef struct {
+    int seq;
+    int flags;
+    int nargs;
+    int nenv;
+    int size;					/* Of the whole packet	*/
+} ErtsForkserverReq;
+
+typedef struct {
+    int seq;
+    int status;					/* As from waitpid()	*/
+} ErtsForkserverExit;
 #endif /* #ifdef NEED_CHILD_SETUP_DEFINES */
 
 /* Threads */
@@ -31,6 +31,7 @@
 #include <signal.h>
 #include <sys/wait.h>
 #include <sys/uio.h>
+#include <sys/socket.h>
 #include <termios.h>
 #include <ctype.h>
 #include <sys/utsname.h>
@@ -82,6 +83,9 @@ static erts_smp_rwmtx_t environ_rwmtx;
 #include "erl_sys_driver.h"
 #include "erl_check_io.h"
 #include "erl_cpu_topology.h"
+#include "erl_uring.h"
+#include "erl_binary.h"
+#include "erl_async.h"
 
 #ifndef DISABLE_VFORK
 #define DISABLE_VFORK 0
@@ -115,7 +119,7 @@ typedef struct ErtsSysReportExit_ ErtsSysReportExit;
 struct ErtsSysReportExit_ {
     ErtsSysReportExit *next;
     Eterm port;
-    int pid;
+    int pid;			/* Or forkserver id, see below */
     int ifd;
     int ofd;
 #if CHLDWTHR && !defined(ERTS_SMP)
@@ -191,6 +195,14 @@ static int sig_notify_fds[2] = {-1, -1};
 static int async_fd[2];
 #endif
 
+#ifdef ERTS_HAVE_MMAP_BINARY
+static void init_mmap_binaries(void);
+static void mmap_lease_break(void);
+#ifndef ERTS_SMP
+static volatile int mmap_leases_broken;
+#endif
+#endif
+
 #if CHLDWTHR || defined(ERTS_SMP)
 erts_mtx_t chld_stat_mtx;
 #endif
@@ -214,6 +226,28 @@ static long children_alive;
 static volatile int children_died;
 #endif
 
+/*
+ * Unless ERL_NO_FORKSERVER is set, port programs are forked by a
+ * forkserver (the child setup program, see erl_child_setup.c) that we
+ * start at boot. A spawn request is just a packet on a socket, so the
+ * scheduler opening the port neither forks a possibly huge emulator
+ * nor waits for the child. The forkserver reports exit statuses back
+ * on the same socket; children started this way are identified by
+ * negative sequence numbers instead of pids in report_exit_list.
+ * If the forkserver cannot be used we fall back on forking ourselves.
+ */
+#if CHLDWTHR && !DISABLE_VFORK && !defined(QNX) \
+    && defined(SOCK_SEQPACKET) && defined(SCM_RIGHTS)
+#  define ERTS_USE_FORKSERVER 1
+#  define ERTS_FORKSERVER_LOST_STATUS (255 << 8)
+static erts_tid_t forkserver_tid;
+static int forkserver_fd = -1;	/* Protected by chld_stat_mtx */
+static int forkserver_seq;
+static void start_forkserver(void);
+#else
+#  define ERTS_USE_FORKSERVER 0
+#endif
+
 
 static struct fd_data {
     char  pbuf[4];   /* hold partial packet bytes */
@@ -385,11 +419,17 @@ erts_sys_misc_mem_sz(void)
     return res;
 }
 
+static void flush_std_out_buffers(void);
+
 /*
  * reset the terminal to the original settings on exit
  */
 void sys_tty_reset(int exit_code)
 {
+  if (exit_code <= 0 && exit_code != ERTS_INTR_EXIT
+      && exit_code != ERTS_ABORT_EXIT) {
+    flush_std_out_buffers();
+  }
   if (using_oldshell && !replace_intr) {
     SET_BLOCKING(0);
   }
@@ -504,6 +544,9 @@ erts_sys_pre_init(void)
     sigaddset(&thr_create_sigmask, SIGINT);   /* block interrupt */
     sigaddset(&thr_create_sigmask, SIGCHLD);  /* block child signals */
     sigaddset(&thr_create_sigmask, SIGUSR1);  /* block user defined signal */
+#ifdef ERTS_HAVE_MMAP_BINARY
+    sigaddset(&thr_create_sigmask, SIGIO);    /* block lease breaks */
+#endif
 #endif
 
     erts_thr_init(&eid);
@@ -1028,8 +1071,23 @@ static struct driver_data {
     int pid;
     int alive;
     int status;
+    int out_buffer;		/* Output gathered before writing, 0 if none */
+    int out_blocked;		/* Selected for write since write would block */
 } *driver_data;			/* indexed by fd */
 
+/*
+ * With the output_buffer option, output is put in the driver queue
+ * and written with one writev() when out_buffer bytes have gathered,
+ * ERTS_OUT_BUFFER_TIMEOUT ms after the first of them, or when the
+ * port is closed.
+ */
+#define ERTS_OUT_BUFFER_TIMEOUT 10
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#  define MAX_OUT_BUFFER_VSIZE IOV_MAX
+#else
+#  define MAX_OUT_BUFFER_VSIZE 1024
+#endif
+
 /* Driver interfaces */
 static ErlDrvData spawn_start(ErlDrvPort, char*, SysDriverOpts*);
 static ErlDrvData fd_start(ErlDrvPort, char*, SysDriverOpts*);
@@ -1043,6 +1101,8 @@ static void ready_input(ErlDrvData, ErlDrvEvent);
 static void ready_output(ErlDrvData, ErlDrvEvent);
 static void output(ErlDrvData, char*, ErlDrvSizeT);
 static void outputv(ErlDrvData, ErlIOVec*);
+static void out_buffer_timeout(ErlDrvData);
+static void out_buffer_flush(ErlDrvData);
 static void stop_select(ErlDrvEvent, void*);
 
 struct erl_drv_entry spawn_driver_entry = {
@@ -1056,10 +1116,10 @@ struct erl_drv_entry spawn_driver_entry = {
     NULL,
     NULL,
     NULL,
+    out_buffer_timeout,
     NULL,
     NULL,
-    NULL,
-    NULL,
+    out_buffer_flush,
     NULL,
     NULL,
     ERL_DRV_EXTENDED_MARKER,
@@ -1080,10 +1140,10 @@ struct erl_drv_entry fd_driver_entry = {
     NULL,
     NULL,
     fd_control,
-    NULL,
+    out_buffer_timeout,
     outputv,
     NULL, /* ready_async */
-    NULL, /* flush */
+    out_buffer_flush,
     NULL, /* call */
     NULL, /* event */
     ERL_DRV_EXTENDED_MARKER,
@@ -1170,6 +1230,8 @@ static int set_driver_data(int port_num,
 	driver_data[ifd].pid = pid;
 	driver_data[ifd].alive = 1;
 	driver_data[ifd].status = 0;
+	driver_data[ifd].out_buffer = 0;
+	driver_data[ifd].out_blocked = 0;
 	if (read_write & DO_WRITE) {
 	    driver_data[ifd].ofd = ofd;
 	    if (ifd != ofd)
@@ -1187,6 +1249,8 @@ static int set_driver_data(int port_num,
 	driver_data[ofd].pid = pid;
 	driver_data[ofd].alive = 1;
 	driver_data[ofd].status = 0;
+	driver_data[ofd].out_buffer = 0;
+	driver_data[ofd].out_blocked = 0;
 	return(ofd);
     }
 }
@@ -1219,6 +1283,10 @@ static int spawn_init()
    erts_thr_create(&child_waiter_tid, child_waiter, NULL, &thr_opts);
 #endif
 
+#if ERTS_USE_FORKSERVER
+   start_forkserver();
+#endif
+
    return 1;
 }
 
@@ -1320,6 +1388,209 @@ static char **build_unix_environment(char *block)
     return cpp;
 }
 
+#if ERTS_USE_FORKSERVER
+
+static void *
+forkserver_reader(void *vfd)
+{
+    int fd = (int) (SWord) vfd;
+    ErtsForkserverExit ex;
+    ErtsSysReportExit *rep;
+    ssize_t n;
+
+#ifdef ERTS_ENABLE_LOCK_CHECK
+    erts_lc_set_thread_name("forkserver reader");
+#endif
+
+    while (1) {
+	n = recv(fd, (void *) &ex, sizeof(ex), 0);
+	if (n == sizeof(ex)) {
+	    CHLD_STAT_LOCK;
+	    note_child_death(-ex.seq, ex.status);
+	    CHLD_STAT_UNLOCK;
+	}
+	else if (n < 0 && errno == EINTR)
+	    continue;
+	else
+	    break;
+    }
+
+    /*
+     * The forkserver is gone. From now on we fork ourselves, and we
+     * will never know how the children it started exit.
+     */
+    CHLD_STAT_LOCK;
+    forkserver_fd = -1;
+    do {
+	for (rep = report_exit_list; rep && rep->pid >= 0; rep = rep->next)
+	    ;
+	if (rep)
+	    note_child_death(rep->pid, ERTS_FORKSERVER_LOST_STATUS);
+    } while (rep);
+    CHLD_STAT_UNLOCK;
+    (void) close(fd);
+    return NULL;
+}
+
+static void
+start_forkserver(void)
+{
+    erts_thr_opts_t thr_opts = ERTS_THR_OPTS_DEFAULT_INITER;
+    char fd_str[22], max_files_str[22];
+    char *fs_argv[5];
+    char buf[2];
+    size_t bufsz = sizeof(buf);
+    int fds[2];
+    int pid;
+
+    if (erts_sys_getenv("ERL_NO_FORKSERVER", buf, &bufsz) >= 0)
+	return;
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0)
+	return;
+    (void) fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+    sprintf(fd_str, "%d", fds[1]);
+    sprintf(max_files_str, "%d", max_files);
+    fs_argv[0] = child_setup_prog;
+    fs_argv[1] = CS_FORKSERVER_ARG;
+    fs_argv[2] = fd_str;
+    fs_argv[3] = max_files_str;
+    fs_argv[4] = NULL;
+
+    block_signals();
+    erts_smp_rwmtx_rlock(&environ_rwmtx);
+    pid = vfork();
+    if (pid == 0) {
+	execve(child_setup_prog, fs_argv, environ);
+	_exit(1);
+    }
+    erts_smp_rwmtx_runlock(&environ_rwmtx);
+    unblock_signals();
+    (void) close(fds[1]);
+
+    if (pid < 0) {
+	(void) close(fds[0]);
+	return;
+    }
+
+    CHLD_STAT_LOCK;
+    forkserver_fd = fds[0];
+    forkserver_seq = 0;
+    if (!(children_alive++))
+	CHLD_STAT_SIGNAL; /* Let the child waiter reap the forkserver */
+    CHLD_STAT_UNLOCK;
+
+    thr_opts.detached = 1;
+    thr_opts.suggested_stack_size = 0; /* Smallest possible */
+    erts_thr_create(&forkserver_tid, forkserver_reader,
+		    (void *) (SWord) fds[0], &thr_opts);
+}
+
+/*
+ * Hand a spawn over to the forkserver; called with chld_stat_mtx
+ * locked. Returns the (negative) id of the child, or -1 if we have
+ * to fork ourselves. We never wait for the forkserver here; if its
+ * socket is full, we also fork ourselves.
+ */
+static int
+forkserver_spawn(char *cmd_line, char **new_environ, SysDriverOpts *opts,
+		 int ifd[2], int ofd[2])
+{
+    ErtsForkserverReq *req;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+	struct cmsghdr align;
+	char buf[CMSG_SPACE(2*sizeof(int))];
+    } cbuf;
+    char *wd = opts->wd ? opts->wd : "";
+    char *p;
+    int fds[2], nfds, nargs, nenv, i, seq;
+    size_t size, len;
+    ssize_t res;
+
+#define FS_STR_ARG(S) ((S) == erts_default_arg0 ? cmd_line : (S))
+
+    nargs = 0;
+    if (opts->spawn_type == ERTS_SPAWN_EXECUTABLE && opts->argv)
+	while (opts->argv[nargs])
+	    nargs++;
+    size = sizeof(ErtsForkserverReq) + strlen(cmd_line) + 1 + strlen(wd) + 1;
+    for (i = 0; i < nargs; i++)
+	size += strlen(FS_STR_ARG(opts->argv[i])) + 1;
+    for (nenv = 0; new_environ[nenv]; nenv++)
+	size += strlen(new_environ[nenv]) + 1;
+    if (size > INT_MAX)
+	return -1;
+
+    req = erts_alloc_fnf(ERTS_ALC_T_TMP, size);
+    if (!req)
+	return -1;
+
+    seq = forkserver_seq < INT_MAX ? forkserver_seq + 1 : 1;
+    req->seq = seq;
+    req->flags = 0;
+    if (opts->use_stdio)
+	req->flags |= CS_FS_USE_STDIO;
+    if (opts->redir_stderr)
+	req->flags |= CS_FS_REDIR_STDERR;
+    if (opts->spawn_type == ERTS_SPAWN_EXECUTABLE)
+	req->flags |= CS_FS_EXECUTABLE;
+    req->nargs = nargs;
+    req->nenv = nenv;
+    req->size = (int) size;
+
+    p = (char *) (req + 1);
+#define FS_PUT_STR(S) \
+    do { len = strlen((S)) + 1; memcpy(p, (S), len); p += len; } while (0)
+    FS_PUT_STR(cmd_line);
+    FS_PUT_STR(wd);
+    for (i = 0; i < nargs; i++)
+	FS_PUT_STR(FS_STR_ARG(opts->argv[i]));
+    for (i = 0; i < nenv; i++)
+	FS_PUT_STR(new_environ[i]);
+#undef FS_PUT_STR
+#undef FS_STR_ARG
+    ASSERT(p == ((char *) req) + size);
+
+    nfds = 0;
+    if (opts->read_write & DO_READ) {
+	req->flags |= CS_FS_DO_READ;
+	fds[nfds++] = ifd[1];
+    }
+    if (opts->read_write & DO_WRITE) {
+	req->flags |= CS_FS_DO_WRITE;
+	fds[nfds++] = ofd[0];
+    }
+
+    iov.iov_base = (void *) req;
+    iov.iov_len = size;
+    sys_memzero((void *) &msg, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = CMSG_SPACE(nfds*sizeof(int));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(nfds*sizeof(int));
+    memcpy((void *) CMSG_DATA(cmsg), (void *) fds, nfds*sizeof(int));
+
+    do {
+	res = sendmsg(forkserver_fd, &msg, MSG_DONTWAIT);
+    } while (res < 0 && errno == EINTR);
+
+    erts_free(ERTS_ALC_T_TMP, (void *) req);
+
+    if (res != (ssize_t) size)
+	return -1;
+    forkserver_seq = seq;
+    return -seq;
+}
+
+#endif /* ERTS_USE_FORKSERVER */
+
 /*
   [arndt] In most Unix systems, including Solaris 2.5, 'fork' allocates memory
   in swap space for the child of a 'fork', whereas 'vfork' does not do this.
@@ -1449,6 +1720,14 @@ static ErlDrvData spawn_start(ErlDrvPort port_num, char* name, SysDriverOpts* op
 
     CHLD_STAT_LOCK;
 
+#if ERTS_USE_FORKSERVER
+    if (forkserver_fd >= 0) {
+	pid = forkserver_spawn(cmd_line, new_environ, opts, ifd, ofd);
+	if (pid != -1)
+	    goto spawned;
+    }
+#endif
+
     unbind = erts_sched_bind_atfork_prepare();
 
 #if !DISABLE_VFORK
@@ -1653,6 +1932,9 @@ static ErlDrvData spawn_start(ErlDrvPort port_num, char* name, SysDriverOpts* op
     reset_qnx_spawn();
 #endif /* QNX */
 
+#if ERTS_USE_FORKSERVER
+ spawned:
+#endif
     erts_free(ERTS_ALC_T_TMP, (void *) cmd_line);
 
     if (new_environ != environ)
@@ -1674,6 +1956,8 @@ static ErlDrvData spawn_start(ErlDrvPort port_num, char* name, SysDriverOpts* op
 
     res = set_driver_data(port_num, ifd[0], ofd[1], opts->packet_bytes,
 			  opts->read_write, opts->exit_status, pid);
+    if (opts->read_write & DO_WRITE)
+	driver_data[res].out_buffer = opts->out_buffer;
     /* Don't unblock SIGCHLD until now, since the call above must
        first complete putting away the info about our new subprocess. */
     unblock_signals();
@@ -1681,7 +1965,7 @@ static ErlDrvData spawn_start(ErlDrvPort port_num, char* name, SysDriverOpts* op
 #if CHLDWTHR
     ASSERT(children_alive >= 0);
 
-    if (!(children_alive++))
+    if (pid > 0 && !(children_alive++))
 	CHLD_STAT_SIGNAL; /* Wake up child waiter thread if no children
 			     was alive before we fork()ed ... */
 #endif
@@ -1904,6 +2188,8 @@ static ErlDrvData fd_start(ErlDrvPort port_num, char* name,
     res = (ErlDrvData)(long)set_driver_data(port_num, opts->ifd, opts->ofd,
 				      opts->packet_bytes,
 				      opts->read_write, 0, -1);
+    if (opts->read_write & DO_WRITE)
+	driver_data[(int)(long)res].out_buffer = opts->out_buffer;
     CHLD_STAT_UNLOCK;
     return res;
 }
@@ -1933,6 +2219,7 @@ static void fd_stop(ErlDrvData fd)  /* Does not close the fds */
 {
     int ofd;
     
+    driver_data[(int)(long)fd].out_buffer = 0;
     nbio_stop_fd(driver_data[(int)(long)fd].port_num, (int)(long)fd);
     ofd = driver_data[(int)(long)fd].ofd;
     if (ofd != (int)(long)fd && ofd != -1) 
@@ -1996,6 +2283,121 @@ static void stop(ErlDrvData fd)
     }
 }
 
+/* Write as much of the queue as we can; wait for the fd if it blocks */
+static void out_buffer_write(int fd)
+{
+    int ix = driver_data[fd].port_num;
+    int ofd = driver_data[fd].ofd;
+    struct iovec* iv;
+    ssize_t n;
+    int vsize;
+
+    while ((iv = (struct iovec*) driver_peekq(ix, &vsize)) != NULL) {
+	vsize = vsize > MAX_OUT_BUFFER_VSIZE ? MAX_OUT_BUFFER_VSIZE : vsize;
+	n = writev(ofd, iv, vsize);
+	if (n > 0) {
+	    if (driver_deq(ix, n) == 0)
+		set_busy_port(ix, 0);
+	}
+	else if (n < 0 && errno == EINTR)
+	    continue;
+	else if (n < 0 && errno != ERRNO_BLOCK) {
+	    driver_failure_posix(ix, errno);
+	    return;
+	}
+	else {
+	    driver_data[fd].out_blocked = 1;
+	    driver_select(ix, ofd, ERL_DRV_WRITE|ERL_DRV_USE, 1);
+	    return;
+	}
+    }
+}
+
+/* Called when output has been queued on a port with an output buffer */
+static void out_buffer_output(int fd)
+{
+    int ix = driver_data[fd].port_num;
+    ErlDrvSizeT sz = driver_sizeq(ix);
+
+    if (driver_data[fd].out_blocked) {
+	if (sz >= driver_data[fd].out_buffer + (1 << 13))
+	    set_busy_port(ix, 1);
+    }
+    else if (sz >= driver_data[fd].out_buffer) {
+	driver_cancel_timer(ix);
+	out_buffer_write(fd);
+    }
+    else {
+	unsigned long time_left;
+	if (driver_read_timer(ix, &time_left) != 0 || time_left == 0)
+	    driver_set_timer(ix, ERTS_OUT_BUFFER_TIMEOUT);
+    }
+}
+
+static void out_buffer_timeout(ErlDrvData e)
+{
+    int fd = (int)(long)e;
+    if (!driver_data[fd].out_blocked)
+	out_buffer_write(fd);
+}
+
+/* The port is being closed with output still queued */
+static void out_buffer_flush(ErlDrvData e)
+{
+    int fd = (int)(long)e;
+    if (driver_data[fd].out_buffer) {
+	driver_cancel_timer(driver_data[fd].port_num);
+	if (!driver_data[fd].out_blocked)
+	    out_buffer_write(fd);
+    }
+}
+
+/*
+ * halt() does not close the ports, so what fd ports have gathered for
+ * standard output or error would be lost. Write it out on the way out,
+ * waiting for the fd if need be. No port lock may be held.
+ */
+static void flush_std_out_buffers(void)
+{
+    int fd;
+
+    if (!driver_data)
+	return;
+    for (fd = 0; fd < 3 && fd < max_files; fd++) {
+	int ix = driver_data[fd].port_num;
+	int ofd = driver_data[fd].ofd;
+	struct iovec* iv;
+	int vsize;
+	ssize_t n;
+	Port *pp;
+
+	if (!driver_data[fd].out_buffer || (ofd != 1 && ofd != 2))
+	    continue;
+	pp = erts_id2port_sflgs(erts_port[ix].id,
+				NULL,
+				0,
+				ERTS_PORT_SFLGS_INVALID_DRIVER_LOOKUP);
+	if (!pp)
+	    continue;
+	if (pp->drv_data == (UWord) fd && driver_data[fd].out_buffer) {
+	    while ((iv = (struct iovec*) driver_peekq(ix, &vsize)) != NULL) {
+		if (vsize > MAX_OUT_BUFFER_VSIZE)
+		    vsize = MAX_OUT_BUFFER_VSIZE;
+		n = writev(ofd, iv, vsize);
+		if (n > 0)
+		    driver_deq(ix, n);
+		else if (n < 0 && errno == EINTR)
+		    continue;
+		else if (n < 0 && errno == ERRNO_BLOCK)
+		    SET_BLOCKING(ofd);
+		else
+		    break;
+	    }
+	}
+	erts_port_release(pp);
+    }
+}
+
 static void outputv(ErlDrvData e, ErlIOVec* ev)
 {
     int fd = (int)(long)e;
@@ -2021,7 +2423,11 @@ static void outputv(ErlDrvData e, ErlIOVec* ev)
     ev->iov[0].iov_base = lbp;
     ev->iov[0].iov_len = pb;
     ev->size += pb;
-    if ((sz = driver_sizeq(ix)) > 0) {
+    if (driver_data[fd].out_buffer) {
+	driver_enqv(ix, ev, 0);
+	out_buffer_output(fd);
+    }
+    else if ((sz = driver_sizeq(ix)) > 0) {
 	driver_enqv(ix, ev, 0);
 	if (sz + ev->size >= (1 << 13))
 	    set_busy_port(ix, 1);
@@ -2066,7 +2472,12 @@ static void output(ErlDrvData e, char* buf, ErlDrvSizeT len)
     put_int32(len, lb);
     lbp = lb + (4-pb);
 
-    if ((sz = driver_sizeq(ix)) > 0) {
+    if (driver_data[fd].out_buffer) {
+	driver_enq(ix, lbp, pb);
+	driver_enq(ix, buf, len);
+	out_buffer_output(fd);
+    }
+    else if ((sz = driver_sizeq(ix)) > 0) {
 	driver_enq(ix, lbp, pb);
 	driver_enq(ix, buf, len);
 	if (sz + len + pb >= (1 << 13))
@@ -2281,9 +2692,13 @@ static void ready_output(ErlDrvData e, ErlDrvEvent ready_fd)
 
     if ((iv = (struct iovec*) driver_peekq(ix, &vsize)) == NULL) {
 	driver_select(ix, ready_fd, ERL_DRV_WRITE, 0);
+	driver_data[fd].out_blocked = 0;
 	return; /* 0; */
     }
-    vsize = vsize > MAX_VSIZE ? MAX_VSIZE : vsize;
+    if (driver_data[fd].out_buffer)
+	vsize = vsize > MAX_OUT_BUFFER_VSIZE ? MAX_OUT_BUFFER_VSIZE : vsize;
+    else
+	vsize = vsize > MAX_VSIZE ? MAX_VSIZE : vsize;
     if ((n = writev(ready_fd, iv, vsize)) > 0) {
 	if (driver_deq(ix, n) == 0)
 	    set_busy_port(ix, 0);
@@ -2474,6 +2889,199 @@ void erts_sys_free(ErtsAlcType_t t, void *x, void *p)
     free(p);
 }
 
+#ifdef ERTS_HAVE_MMAP_BINARY
+
+/*
+ * A file can be handed out as a refc binary without copying it: the
+ * Binary header is put last on an anonymous page and the file is
+ * mapped right after it, so that orig_bytes is the file contents.
+ *
+ * A mapping shows later writes to the file, and touching a page that
+ * a truncate has cut off raises SIGBUS. So a file is only mapped if we
+ * get a read lease on it, which nobody can while the file is open for
+ * writing. Whoever opens it for writing or truncates it later blocks
+ * until we let go of the lease, and we are told by SIGIO. Before
+ * letting go, the mapping is replaced by a private copy of the pages
+ * at the same address. The lease is held through a descriptor of our
+ * own, kept in an ErtsMmapLease at the start of the header page.
+ */
+
+typedef struct ErtsMmapLease_ ErtsMmapLease;
+struct ErtsMmapLease_ {
+    ErtsMmapLease *next;
+    ErtsMmapLease *prev;
+    int fd;			/* Holds the lease; -1 once copied */
+};
+
+static ErtsMmapLease *mmap_leases;
+#ifdef USE_THREADS
+static erts_mtx_t mmap_mtx;
+#define MMAP_LOCK erts_mtx_lock(&mmap_mtx)
+#define MMAP_UNLOCK erts_mtx_unlock(&mmap_mtx)
+#else
+#define MMAP_LOCK
+#define MMAP_UNLOCK
+#endif
+
+#define MMAP_LEASE_BINARY(L, Page) \
+    ((Binary *) ((char *) (L) + (Page) - offsetof(Binary, orig_bytes)))
+
+#if (defined(SIG_SIGSET) || defined(SIG_SIGNAL))
+static RETSIGTYPE mmap_lease_broken(void)
+#else
+static RETSIGTYPE mmap_lease_broken(int signum)
+#endif
+{
+#ifdef ERTS_SMP
+    smp_sig_notify('L');
+#else
+    mmap_leases_broken = 1;
+    ERTS_CHK_IO_AS_INTR(); /* Make sure we don't sleep in poll */
+#endif
+}
+
+static void
+init_mmap_binaries(void)
+{
+    mmap_leases = NULL;
+#ifdef USE_THREADS
+    erts_mtx_init(&mmap_mtx, "mmap_binaries");
+#endif
+    sys_sigset(SIGIO, mmap_lease_broken);
+}
+
+static void
+mmap_lease_release(ErtsMmapLease *l)
+{
+    if (l->prev)
+	l->prev->next = l->next;
+    else
+	mmap_leases = l->next;
+    if (l->next)
+	l->next->prev = l->prev;
+    close(l->fd);		/* Gives up the lease */
+    l->fd = -1;
+}
+
+/* Let go of the files somebody wants to change */
+static void
+mmap_lease_break(void)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    ErtsMmapLease *l, *next;
+
+    MMAP_LOCK;
+    for (l = mmap_leases; l; l = next) {
+	Binary *bin = MMAP_LEASE_BINARY(l, page);
+	size_t size = (size_t) bin->orig_size;
+	void *copy;
+
+	next = l->next;
+	/* While a break is pending this gives the lease type asked for */
+	if (fcntl(l->fd, F_GETLEASE) == F_RDLCK)
+	    continue;
+	copy = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON,
+		    -1, 0);
+	if (copy == MAP_FAILED)
+	    erl_exit(ERTS_ABORT_EXIT,
+		     "Failed to copy a mapped file of %beu bytes: %s (%d)\n",
+		     (Uint) size, erl_errno_id(errno), errno);
+	memcpy(copy, bin->orig_bytes, size);
+	/* Moving the copy over the file pages is atomic to readers */
+	if (mprotect(copy, size, PROT_READ) != 0
+	    || mremap(copy, size, size, MREMAP_MAYMOVE|MREMAP_FIXED,
+		      bin->orig_bytes) == MAP_FAILED)
+	    erl_exit(ERTS_ABORT_EXIT,
+		     "Failed to replace a mapped file: %s (%d)\n",
+		     erl_errno_id(errno), errno);
+	mmap_lease_release(l);
+    }
+    MMAP_UNLOCK;
+}
+
+/* Returns NULL if the file was not mapped; the caller then reads it */
+ErlDrvBinary *
+erts_sys_mmap_drv_binary(int fd, size_t size)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    struct stat st;
+    ErtsMmapLease *l;
+    char *base;
+    Binary *bin;
+    int lfd;
+
+#ifndef ERTS_SMP
+    /*
+     * The lease is given up by the scheduler, which must not be the
+     * one waiting in open() for it.
+     */
+    if (erts_async_max_threads == 0)
+	return NULL;
+#endif
+    if (fstat(fd, &st) != 0
+	|| !S_ISREG(st.st_mode)
+	|| st.st_size != (off_t) size)
+	return NULL;
+    /* Not inherited by port programs, which would keep the lease */
+    if ((lfd = fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0)
+	return NULL;
+
+    /* Held until the lease is in the list, where a break looks for it */
+    MMAP_LOCK;
+    if (fcntl(lfd, F_SETLEASE, F_RDLCK) != 0
+	|| fstat(lfd, &st) != 0
+	|| st.st_size != (off_t) size)
+	goto fail;
+
+    /* Reserve room for both, then replace the tail with the file */
+    base = mmap(NULL, page + size, PROT_NONE, MAP_PRIVATE|MAP_ANON, -1, 0);
+    if (base == MAP_FAILED)
+	goto fail;
+    if (mprotect(base, page, PROT_READ|PROT_WRITE) != 0
+	|| mmap(base + page, size, PROT_READ, MAP_PRIVATE|MAP_FIXED,
+		lfd, 0) == MAP_FAILED) {
+	munmap(base, page + size);
+	goto fail;
+    }
+
+    l = (ErtsMmapLease *) base;
+    bin = MMAP_LEASE_BINARY(l, page);
+    ASSERT(bin->orig_bytes == base + page);
+    ASSERT((char *) (l + 1) <= (char *) bin);
+    bin->flags = BIN_FLAG_MMAP;
+    erts_refc_init(&bin->refc, 1);
+    bin->orig_size = (SWord) size;
+    l->fd = lfd;
+    l->prev = NULL;
+    l->next = mmap_leases;
+    if (mmap_leases)
+	mmap_leases->prev = l;
+    mmap_leases = l;
+    MMAP_UNLOCK;
+    return Binary2ErlDrvBinary(bin);
+
+ fail:
+    MMAP_UNLOCK;
+    close(lfd);
+    return NULL;
+}
+
+void
+erts_sys_munmap_binary(Binary *bin)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    ErtsMmapLease *l = (ErtsMmapLease *) (bin->orig_bytes - page);
+
+    ASSERT(bin->flags & BIN_FLAG_MMAP);
+    MMAP_LOCK;
+    if (l->fd >= 0)
+	mmap_lease_release(l);
+    MMAP_UNLOCK;
+    munmap(bin->orig_bytes - page, page + (size_t) bin->orig_size);
+}
+
+#endif /* ERTS_HAVE_MMAP_BINARY */
+
 /* Return a pointer to a vector of names of preloaded modules */
 
 Preload*
@@ -2735,6 +3343,12 @@ erl_sys_schedule(int runnable)
 #endif
     ERTS_SMP_LC_ASSERT(!erts_thr_progress_is_blocking());
     (void) check_children();
+#if defined(ERTS_HAVE_MMAP_BINARY) && !defined(ERTS_SMP)
+    if (mmap_leases_broken) {
+	mmap_leases_broken = 0;
+	mmap_lease_break();
+    }
+#endif
 }
 
 
@@ -2822,6 +3436,11 @@ signal_dispatcher_thread_func(void *unused)
 	    case 'Q': /* SIGQUIT */
 		quit_requested();
 		break;
+#ifdef ERTS_HAVE_MMAP_BINARY
+	    case 'L': /* SIGIO, a mapped file is wanted */
+		mmap_lease_break();
+		break;
+#endif
 	    case '1': /* SIGUSR1 */
 		sigusr1_exit();
 		break;
@@ -3009,11 +3628,28 @@ erl_sys_args(int* argc, char** argv)
     }
 #endif
 
+#if ERTS_HAVE_IO_URING
+    {
+	char no_uring[10];
+	size_t no_uring_sz = sizeof(no_uring);
+	int res = erts_sys_getenv("ERL_NO_IO_URING", no_uring, &no_uring_sz);
+	if (res > 0
+	    || (res == 0
+		&& sys_strcmp("false", no_uring) != 0
+		&& sys_strcmp("FALSE", no_uring) != 0)) {
+	    erts_use_io_uring = 0;
+	}
+    }
+#endif
+
     init_check_io();
 
 #ifdef ERTS_SMP
     init_smp_sig_notify();
 #endif
+#ifdef ERTS_HAVE_MMAP_BINARY
+    init_mmap_binaries();
+#endif
 
     /* Handled arguments have been marked with NULL. Slide arguments
        not handled towards the beginning of argv. */
@@ -27,13 +27,13 @@
 	 init_per_group/2,end_per_group/2,
 	 init_per_testcase/2,end_per_testcase/2,
 	 basic/1, packet_size/1, neg/1, http/1, line/1, ssl/1, otp_8536/1,
-         otp_9389/1, otp_9389_line/1]).
+         otp_9389/1, otp_9389_line/1, varint/1]).
 
 suite() -> [{ct_hooks,[ts_install_cth]}].
 
 all() -> 
     [basic, packet_size, neg, http, line, ssl, otp_8536,
-     otp_9389, otp_9389_line].
+     otp_9389, otp_9389_line, varint].
 
 groups() -> 
     [].
@@ -73,12 +73,16 @@ basic(Config) when is_list(Config) ->
     ?line {more, 5+1} = decode_pkt(1,<<5,1,2,3,4>>),
     ?line {more, 5+2} = decode_pkt(2,<<0,5,1,2,3,4>>),
     ?line {more, 5+4} = decode_pkt(4,<<0,0,0,5,1,2,3,4>>),
+    ?line {more, 5+2} = decode_pkt({2,little},<<5,0,1,2,3,4>>),
+    ?line {more, 5+4} = decode_pkt({4,little},<<5,0,0,0,1,2,3,4>>),
+    ?line {more, 5+1} = decode_pkt(varint,<<5,1,2,3,4>>),
 
     ?line {more, undefined} = decode_pkt(1,<<>>),
     ?line {more, undefined} = decode_pkt(2,<<0>>),
     ?line {more, undefined} = decode_pkt(4,<<0,0,0>>),
 
-    Types = [1,2,4,asn1,sunrm,cdr,fcgi,tpkt,ssl_tls],
+    Types = [1,2,4,{2,little},{4,little},varint,
+	     asn1,sunrm,cdr,fcgi,tpkt,ssl_tls],
 
     %% Run tests for different header types and bit offsets.
 
@@ -147,6 +151,15 @@ pack(2,Bin) ->
 pack(4,Bin) ->
     Psz = byte_size(Bin),
     {<<Psz:32,Bin/binary>>, Bin};
+pack({2,little},Bin) ->
+    Psz = byte_size(Bin),
+    {<<Psz:16/little,Bin/binary>>, Bin};
+pack({4,little},Bin) ->
+    Psz = byte_size(Bin),
+    {<<Psz:32/little,Bin/binary>>, Bin};
+pack(varint,Bin) ->
+    Psz = enc_varint(byte_size(Bin)),
+    {<<Psz/binary,Bin/binary>>, Bin};
 pack(asn1,Bin) ->
     Ident = case random:uniform(3) of
 		1 -> <<17>>;
@@ -288,7 +301,8 @@ neg(Config) when is_list(Config) ->
 
     %% Invalid Type args
     lists:foreach(fun(T)-> BadargF(T,Bin,[]) end, 
-		  [3,-1,5,2.0,{2},unknown,[],"line",Bin,Fun,self()]),
+		  [3,-1,5,2.0,{2},unknown,[],"line",Bin,Fun,self(),
+		   {1,little},{4,big},{little,4},{4,little,1}]),
 
     %% Invalid Bin args
     lists:foreach(fun(B)-> BadargF(0,B,[]) end, 
@@ -573,6 +587,38 @@ otp_8536_do(N) ->
     %% Now check that we got the expected binaries
     {Hdr, Data} = {Hdr2, Data2}.
 
+varint(doc) -> ["Varint headers of all lengths"];
+varint(suite) -> [];
+varint(Config) when is_list(Config) ->
+    Body = <<"abc">>,
+    Rest = <<1,2,3>>,
+    lists:foreach(fun(Len) ->
+			  Hdr = enc_varint(Len),
+			  Bin = <<Hdr/binary,Body/binary,Rest/binary>>,
+			  Total = byte_size(Hdr) + Len,
+			  {more, Total} = decode_pkt(varint, Bin),
+			  {more, undefined} =
+			      decode_pkt(varint, binary:part(Hdr, 0,
+							     byte_size(Hdr)-1))
+		  end,
+		  [16#80, 16#3fff, 16#4000, 16#1fffff, 16#200000,
+		   16#fffffff, 16#10000000, 16#7ffffff0]),
+    ?line {ok, <<"abc">>, Rest} = decode_pkt(varint, <<3,"abc",Rest/binary>>),
+    ?line {ok, <<"abc">>, <<>>} = decode_pkt(varint, <<16#83,0,"abc">>),
+    ?line {ok, <<>>, <<"abc">>} = decode_pkt(varint, <<0,"abc">>),
+    %% More than 32 bits
+    ?line {error, _} = decode_pkt(varint, <<255,255,255,255,16#10,0>>),
+    ?line {error, _} = decode_pkt(varint, <<128,128,128,128,128,0>>),
+    ?line {error, _} = decode_pkt(varint, <<16#80,1,"abc">>,
+				  [{packet_size,100}]),
+    ok.
+
+enc_varint(N) when N < 16#80 ->
+    <<N>>;
+enc_varint(N) ->
+    Tail = enc_varint(N bsr 7),
+    <<1:1,(N band 16#7f):7,Tail/binary>>.
+
 decode_pkt(Type,Bin) ->
     decode_pkt(Type,Bin,[]).		       
 decode_pkt(Type,Bin,Opts) ->
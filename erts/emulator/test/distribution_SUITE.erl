@@ -36,6 +36,9 @@
 	 stop_dist/1, 
 	 dist_auto_connect_never/1, dist_auto_connect_once/1,
 	 dist_parallel_send/1,
+	 dist_stats/1,
+	 dist_compress/1, dist_compress_busy/1,
+	 send_multi/1,
 	 atom_roundtrip/1,
 	 atom_roundtrip_r13b/1,
 	 contended_atom_cache_entry/1,
@@ -51,6 +54,7 @@
 -export([sender/3, receiver2/2, dummy_waiter/0, dead_process/0,
 	 roundtrip/1, bounce/1, do_dist_auto_connect/1, inet_rpc_server/1,
 	 dist_parallel_sender/3, dist_parallel_receiver/0,
+	 dist_compress_echo/0, send_multi_receiver/1,
 	 dist_evil_parallel_receiver/0,
          sendersender/4, sendersender2/4]).
 
@@ -62,7 +66,8 @@ all() ->
      link_to_dead_new_node, applied_monitor_node,
      ref_port_roundtrip, nil_roundtrip, stop_dist,
      {group, trap_bif}, {group, dist_auto_connect},
-     dist_parallel_send, atom_roundtrip, atom_roundtrip_r13b,
+     dist_parallel_send, dist_stats, dist_compress, dist_compress_busy, send_multi,
+     atom_roundtrip, atom_roundtrip_r13b,
      contended_atom_cache_entry, bad_dist_structure, {group, bad_dist_ext}].
 
 groups() -> 
@@ -1092,6 +1097,129 @@ dist_evil_parallel_receiver() ->
     net_kernel:disconnect(node(Sender)),
     dist_evil_parallel_receiver().
 
+dist_stats(doc) ->
+    "Test the per connection statistics in system_info({dist_stats, Node}).";
+dist_stats(Config) when is_list(Config) ->
+    ?line undefined = erlang:system_info({dist_stats, '__no_such_node__@host'}),
+    ?line {'EXIT', {badarg, _}} = (catch erlang:system_info({dist_stats, "x"})),
+    ?line {ok, Node} = start_node(Config),
+    ?line Pid = spawn(Node, ?MODULE, bounce, [self()]),
+    ?line Msg = lists:seq(1, 100),
+    ?line Pid ! Msg,
+    ?line receive Msg -> ok end,
+    ?line [{send, Send}, {recv, Recv}, {out_queue_max, QMax},
+	   {busy_dist_port, Busy}] = erlang:system_info({dist_stats, Node}),
+    ?line {send, SMsgs, SOct, SUsecs} = lists:keyfind(send, 1, Send),
+    ?line true = SMsgs >= 1,
+    ?line true = SOct > length(Msg),
+    ?line true = is_integer(SUsecs),
+    ?line {send, RMsgs, ROct, _} = lists:keyfind(send, 1, Recv),
+    ?line true = RMsgs >= 1,
+    ?line true = ROct > length(Msg),
+    ?line true = QMax > 0,
+    ?line true = is_integer(Busy),
+    ?line stop_node(Node),
+    ?line undefined = erlang:system_info({dist_stats, Node}),
+    ?line ok.
+
+dist_compress(doc) ->
+    "Test that messages are passed intact over a compressed connection.";
+dist_compress(Config) when is_list(Config) ->
+    ?line Args = "-kernel dist_compress true +zdct 100",
+    ?line {ok, Node1} = start_node(dist_compress_1, Args),
+    ?line {ok, Node2} = start_node(dist_compress_2, Args),
+    ?line Echo = spawn(Node2, ?MODULE, dist_compress_echo, []),
+    ?line Msgs = [lists:duplicate(N, {N, abc}) || N <- lists:seq(1, 500)]
+	++ [list_to_binary(lists:duplicate(100000, $x)), [], small],
+    ?line Size = erlang:external_size(Msgs),
+    ?line Self = self(),
+    ?line spawn(Node1,
+		fun () ->
+			[Echo ! {self(), M} || M <- Msgs],
+			Got = [receive M -> M end || _ <- Msgs],
+			{_, Port} = lists:keyfind(Node2, 1,
+						 erlang:system_info(dist_ctrl)),
+			{ok, [{send_oct, Oct}]} = inet:getstat(Port, [send_oct]),
+			Self ! {self(), Got, Oct}
+		end),
+    ?line receive
+	      {_, Got, Oct} ->
+		  ?line Msgs = Got,
+		  ?line true = Oct < Size div 10
+	  end,
+    ?line stop_node(Node1),
+    ?line stop_node(Node2),
+    ?line ok.
+
+dist_compress_busy(doc) ->
+    "Test that output queued up while the dist port is busy is "
+	"compressed too.";
+dist_compress_busy(Config) when is_list(Config) ->
+    ?line Args = "-kernel dist_compress true",
+    ?line {ok, Node1} = start_node(dist_compress_busy_1, Args),
+    ?line {ok, Node2} = start_node(dist_compress_busy_2, Args),
+    ?line Echo = spawn(Node2, ?MODULE, dist_compress_echo, []),
+    %% Something that doesn't compress, to get the port busy
+    ?line Noise = << <<(erlang:md5(<<I:32>>))/binary>> ||
+		       I <- lists:seq(1, 1 bsl 20) >>,
+    ?line Msgs = [list_to_binary(lists:duplicate(50000, N rem 256)) ||
+		     N <- lists:seq(1, 200)],
+    ?line Size = erlang:external_size(Msgs),
+    ?line Self = self(),
+    ?line spawn(Node1,
+		fun () ->
+			Echo ! {self(), Noise},
+			[Echo ! {self(), M} || M <- Msgs],
+			[receive _ -> ok end || _ <- [Noise|Msgs]],
+			{_, Port} = lists:keyfind(Node2, 1,
+						 erlang:system_info(dist_ctrl)),
+			{ok, [{send_oct, Oct}]} = inet:getstat(Port, [send_oct]),
+			Self ! {self(), Oct}
+		end),
+    ?line receive
+	      {_, Oct} ->
+		  ?line true = Oct < byte_size(Noise) + Size div 10
+	  end,
+    ?line stop_node(Node1),
+    ?line stop_node(Node2),
+    ?line ok.
+
+dist_compress_echo() ->
+    receive {From, Msg} -> From ! Msg end,
+    dist_compress_echo().
+
+send_multi(doc) ->
+    "Test erlang:send_multi/2,3 to local and remote processes.";
+send_multi(Config) when is_list(Config) ->
+    ?line ok = erlang:send_multi([], msg),
+    ?line [] = erlang:send_multi([], msg, [noconnect]),
+    ?line {'EXIT', {badarg, _}} = (catch erlang:send_multi([self()|x], msg)),
+    ?line {'EXIT', {badarg, _}} = (catch erlang:send_multi([x], msg)),
+    ?line {'EXIT', {badarg, _}} = (catch erlang:send_multi([self()], msg,
+							     [bad])),
+    ?line {ok, Node} = start_node(Config),
+    ?line Self = self(),
+    ?line Remote = [spawn(Node, ?MODULE, send_multi_receiver, [Self])
+		    || _ <- lists:seq(1, 100)],
+    ?line Local = [spawn(?MODULE, send_multi_receiver, [Self])
+		   || _ <- lists:seq(1, 10)],
+    ?line Pids = Local ++ Remote,
+    ?line Msg = {hello, lists:seq(1, 100)},
+    ?line ok = erlang:send_multi(Pids, Msg),
+    ?line [receive {P, Msg} -> ok end || P <- Pids],
+    ?line [] = erlang:send_multi(Pids, Msg, [noconnect, nosuspend]),
+    ?line [receive {P, Msg} -> ok end || P <- Pids],
+    ?line {send, Send} = lists:keyfind(send, 1,
+				       erlang:system_info({dist_stats, Node})),
+    ?line {send_multi, 2, _, _} = lists:keyfind(send_multi, 1, Send),
+    ?line stop_node(Node),
+    ?line Remote = erlang:send_multi(Remote, Msg, [noconnect]),
+    ?line ok.
+
+send_multi_receiver(Parent) ->
+    receive Msg -> Parent ! {self(), Msg} end,
+    send_multi_receiver(Parent).
+
 atom_roundtrip(Config) when is_list(Config) ->
     ?line AtomData = atom_data(),
     ?line verify_atom_data(AtomData),
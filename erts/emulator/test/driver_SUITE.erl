@@ -77,9 +77,10 @@
 	 thread_mseg_alloc_cache_clean/1,
 	 otp_9302/1,
 	 thr_free_drv/1,
-	 async_blast/1]).
+	 async_blast/1,
+	 async_steal_halt/1]).
 
--export([bin_prefix/2]).
+-export([bin_prefix/2, async_steal_child/1]).
 
 -include_lib("test_server/include/test_server.hrl").
 
@@ -147,7 +148,8 @@ all() ->
      thread_mseg_alloc_cache_clean,
      otp_9302,
      thr_free_drv,
-     async_blast].
+     async_blast,
+     async_steal_halt].
 
 groups() -> 
     [{timer, [],
@@ -2010,6 +2012,67 @@ async_blast(Config) when is_list(Config) ->
     ?line erlang:display({async_blast_time, AsyncBlastTime}),
     ?line ok.
 
+async_steal_halt(doc) ->
+    ["A job taken by another async thread holds up the next job of its "
+     "port in the queue; check that the queue's thread is woken when "
+     "the job is done, and that the emulator can halt meanwhile."];
+async_steal_halt(Config) when is_list(Config) ->
+    ?line Path = ?config(data_dir, Config),
+    ?line Dir = filename:dirname(code:which(?MODULE)),
+    ?line Cmd = atom_to_list(lib:progname()) ++ " +A 2 -noshell -pa " ++ Dir
+	++ " -run " ++ ?MODULE_STRING ++ " async_steal_child " ++ Path,
+    ?line io:format("~s~n", [Cmd]),
+    ?line Port = open_port({spawn, Cmd}, [exit_status, stderr_to_stdout]),
+    ?line {Out, Status} = async_steal_wait(Port, []),
+    ?line io:format("~s~n", [Out]),
+    ?line {match, _} = re:run(Out, "async_steal: ok"),
+    ?line 0 = Status,
+    ?line ok.
+
+async_steal_wait(Port, Acc) ->
+    receive
+	{Port, {data, Data}} ->
+	    async_steal_wait(Port, [Acc|Data]);
+	{Port, {exit_status, Status}} ->
+	    {lists:flatten(Acc), Status}
+    after 10000 ->
+	    Out = lists:flatten(Acc),
+	    case re:run(Out, "async_steal: pid ([0-9]+)",
+			[{capture, [1], list}]) of
+		{match, [Pid]} -> os:cmd("kill -9 " ++ Pid);
+		nomatch -> ok
+	    end,
+	    ?line test_server:fail({hanging, Out})
+    end.
+
+%% Run in an emulator with two async threads. The driver puts all jobs
+%% in the first queue.
+async_steal_child([Path]) ->
+    io:format("async_steal: pid ~s~n", [os:getpid()]),
+    ok = load_driver(Path, async_steal_drv),
+    A = open_port({spawn, async_steal_drv}, []),
+    B = open_port({spawn, async_steal_drv}, []),
+    async_steal_jobs(A, B),
+    receive {B, done, 600} -> ok end,
+    receive {B, done, 0} -> ok after 1000 -> exit(held_back) end,
+    [Q|_] = erlang:system_info(async_queues),
+    {stolen, Stolen} = lists:keyfind(stolen, 1, Q),
+    true = Stolen > 0,
+    io:format("async_steal: ok~n", []),
+    %% The queue's thread must run the held up job before it can end
+    async_steal_jobs(A, B),
+    halt().
+
+%% The queue's thread runs a job of A, so the other thread takes a long
+%% job of B, which holds up the next job of B. Returns when the queue's
+%% thread has run out of jobs it may take.
+async_steal_jobs(A, B) ->
+    port_command(A, <<200:32>>),
+    receive after 50 -> ok end,
+    port_command(B, <<600:32>>),
+    port_command(B, <<0:32>>),
+    receive {A, done, 200} -> ok end.
+
 
 
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
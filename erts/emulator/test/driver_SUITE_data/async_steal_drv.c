@@ -0,0 +1,130 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2013. All Rights Reserved.
+ *
+ * The contents of this file are subject to the Erlang Public License,
+ * Version 1.1, (the "License"); you may not use this file except in
+ * compliance with the License. You should have received a copy of the
+ * Erlang Public License along with this software. If not, it can be
+ * retrieved online at http://www.erlang.org/.
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * %CopyrightEnd%
+ */
+
+/*
+ * Each command is a 32-bit big-endian number of milliseconds. An async
+ * job sleeping that long is put in the first async queue, whatever the
+ * port, and {Port, done, Ms} is sent to the caller when it is ready.
+ */
+
+#ifdef __WIN32__
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "erl_driver.h"
+
+static ErlDrvData start(ErlDrvPort port,
+			char *command);
+static void output(ErlDrvData drv_data,
+		   char *buf, ErlDrvSizeT len);
+static void ready_async(ErlDrvData drv_data,
+			ErlDrvThreadData thread_data);
+
+static ErlDrvEntry async_steal_drv_entry = {
+    NULL /* init */,
+    start,
+    NULL /* stop */,
+    output,
+    NULL /* ready_input */,
+    NULL /* ready_output */,
+    "async_steal_drv",
+    NULL /* finish */,
+    NULL /* handle */,
+    NULL /* control */,
+    NULL /* timeout */,
+    NULL /* outputv */,
+    ready_async,
+    NULL /* flush */,
+    NULL /* call */,
+    NULL /* event */,
+    ERL_DRV_EXTENDED_MARKER,
+    ERL_DRV_EXTENDED_MAJOR_VERSION,
+    ERL_DRV_EXTENDED_MINOR_VERSION,
+    ERL_DRV_FLAG_USE_PORT_LOCKING,
+    NULL /* handle2 */,
+    NULL /* handle_monitor */
+};
+
+typedef struct {
+    ErlDrvTermData caller;
+    unsigned ms;
+} async_steal_job_t;
+
+DRIVER_INIT(async_steal_drv)
+{
+    return &async_steal_drv_entry;
+}
+
+static ErlDrvData start(ErlDrvPort port,
+			char *command)
+{
+    return (ErlDrvData) port;
+}
+
+static void async_invoke(void *data)
+{
+    async_steal_job_t *job = (async_steal_job_t *) data;
+#ifdef __WIN32__
+    Sleep((DWORD) job->ms);
+#else
+    usleep(job->ms * 1000);
+#endif
+}
+
+static void async_free(void *data)
+{
+    driver_free(data);
+}
+
+static void ready_async(ErlDrvData drv_data,
+			ErlDrvThreadData thread_data)
+{
+    ErlDrvPort port = (ErlDrvPort) drv_data;
+    async_steal_job_t *job = (async_steal_job_t *) thread_data;
+    ErlDrvTermData spec[] = {
+	ERL_DRV_PORT, driver_mk_port(port),
+	ERL_DRV_ATOM, driver_mk_atom("done"),
+	ERL_DRV_UINT, (ErlDrvTermData) job->ms,
+	ERL_DRV_TUPLE, 3
+    };
+    driver_send_term(port, job->caller, spec, sizeof(spec)/sizeof(spec[0]));
+    driver_free(job);
+}
+
+static void output(ErlDrvData drv_data,
+		   char *buf, ErlDrvSizeT len)
+{
+    ErlDrvPort port = (ErlDrvPort) drv_data;
+    unsigned int key = 0;
+    async_steal_job_t *job;
+
+    if (len != 4) {
+	driver_failure_atom(port, "badarg");
+	return;
+    }
+    job = driver_alloc(sizeof(async_steal_job_t));
+    job->caller = driver_caller(port);
+    job->ms = ((((unsigned) (unsigned char) buf[0]) << 24)
+	       | (((unsigned) (unsigned char) buf[1]) << 16)
+	       | (((unsigned) (unsigned char) buf[2]) << 8)
+	       | ((unsigned) (unsigned char) buf[3]));
+    if (0 > driver_async(port, &key, async_invoke, job, async_free))
+	driver_failure_atom(port, "driver_async_failed");
+}
@@ -19,14 +19,15 @@
 -module(efile_SUITE).
 -export([all/0, suite/0,groups/0,init_per_suite/1, end_per_suite/1, 
 	 init_per_group/2,end_per_group/2]).
--export([iter_max_files/1]).
+-export([iter_max_files/1, ring_on/1, ring_off/1, ring_setup_fails/1]).
+-export([ring_check/1]).
 
 -include_lib("test_server/include/test_server.hrl").
 
 suite() -> [{ct_hooks,[ts_install_cth]}].
 
 all() -> 
-    [iter_max_files].
+    [iter_max_files, ring_on, ring_off, ring_setup_fails].
 
 groups() -> 
     [].
@@ -94,3 +95,133 @@ open_files(Name) ->
 		  io:format("Error reason: ~p", [Reason]),
 		  []
 	  end.
+
+%%
+%% The io_uring paths of the poller and the file driver. Each case runs
+%% file and socket work in a fresh emulator, so that how the rings are
+%% set up at start can be chosen.
+%%
+
+ring_on(suite) -> [];
+ring_on(Config) when is_list(Config) ->
+    case ring_node(Config, "", "") of
+	{io_uring, 2, 2} ->
+	    ok;
+	{epoll, 0, 0} ->
+	    {skip, "No io_uring in this kernel"};
+	Other ->
+	    ?line test_server:fail({unexpected, Other})
+    end.
+
+ring_off(suite) -> [];
+ring_off(Config) when is_list(Config) ->
+    ?line {epoll, 0, 0} = ring_node(Config, "", " -env ERL_NO_IO_URING true"),
+    ok.
+
+ring_setup_fails(suite) -> [];
+ring_setup_fails(Config) when is_list(Config) ->
+    Wrapper = filename:join(?config(data_dir, Config), "no_uring"),
+    case os:cmd(Wrapper ++ " true; echo $?") of
+	"0\n" ->
+	    ?line {epoll, 0, 0} = ring_node(Config, Wrapper ++ " ", ""),
+	    ok;
+	_ ->
+	    {skip, "Cannot make io_uring_setup() fail here"}
+    end.
+
+%% Returns {KernelPoll, Rings, RingsAfterEmfile}, the io_uring fds open
+%% with a file being read before and after running out of fds
+ring_node(Config, Wrapper, Env) ->
+    case os:type() of
+	{unix, linux} ->
+	    Dir = filename:dirname(code:which(?MODULE)),
+	    Priv = ?config(priv_dir, Config),
+	    Cmd = "ulimit -n 256; " ++ Wrapper ++
+		atom_to_list(lib:progname()) ++
+		" +K true +A 4 -noshell -pa " ++ Dir ++ Env ++
+		" -run " ++ ?MODULE_STRING ++ " ring_check " ++ Priv,
+	    io:format("~s~n", [Cmd]),
+	    Out = os:cmd(Cmd),
+	    io:format("~s~n", [Out]),
+	    case re:run(Out, "ring_check: (.*)\\.", [{capture, [1], list}]) of
+		{match, [Res]} ->
+		    {ok, Tokens, _} = erl_scan:string(Res ++ "."),
+		    {ok, Term} = erl_parse:parse_term(Tokens),
+		    Term;
+		nomatch ->
+		    ?line test_server:fail({ring_check, Out})
+	    end;
+	_ ->
+	    {skip, "Linux only"}
+    end.
+
+ring_check([Dir]) ->
+    {kernel_poll, Poll} = lists:keyfind(kernel_poll, 1,
+					erlang:system_info(check_io)),
+    Name = filename:join(Dir, "ring_" ++ os:getpid()),
+    Data = list_to_binary(lists:seq(0, 249)),
+    Content = iolist_to_binary([Data, Data, Data, Data]),
+    ring_write(Name, Content),
+    {ok, F} = file:open(Name, [read, raw, binary]),
+    %% Short reads at the end of the file
+    {ok, Content} = file:read(F, 4096),
+    eof = file:read(F, 1),
+    {ok, [<<240,241,242,243,244,245,246,247,248,249>>, eof, <<0,1,2>>]} =
+	file:pread(F, [{990, 20}, {2000, 5}, {0, 3}]),
+    Rings = ring_fds(),
+    ok = file:close(F),
+    %% No fd left for the ring of the file; the read goes to a thread
+    Fds = ring_fill(Name, []),
+    ok = file:close(hd(Fds)),
+    {ok, F2} = file:open(Name, [read, raw, binary]),
+    {ok, Data} = file:read(F2, 250),
+    [ok = file:close(Fd) || Fd <- [F2|tl(Fds)]],
+    {ok, F3} = file:open(Name, [read, raw, binary]),
+    {ok, Data} = file:read(F3, 250),
+    Rings2 = ring_fds(),
+    ok = file:close(F3),
+    ok = file:delete(Name),
+    ring_sockets(),
+    io:format("ring_check: ~w.~n", [{Poll, Rings, Rings2}]),
+    halt().
+
+ring_write(Name, Content) ->
+    {ok, F} = file:open(Name, [write, raw, binary]),
+    <<A:100/binary,B/binary>> = Content,
+    ok = file:write(F, A),
+    ok = file:write(F, B),
+    ok = file:datasync(F),
+    ok = file:sync(F),
+    ok = file:close(F).
+
+ring_fill(Name, Acc) ->
+    case file:open(Name, [read, raw, binary]) of
+	{ok, F} -> ring_fill(Name, [F|Acc]);
+	{error, emfile} -> Acc
+    end.
+
+ring_sockets() ->
+    {ok, L} = gen_tcp:listen(0, [binary, {active, false}]),
+    {ok, Port} = inet:port(L),
+    {ok, C} = gen_tcp:connect("localhost", Port, [binary, {active, true}]),
+    {ok, S} = gen_tcp:accept(L),
+    ok = inet:setopts(S, [{active, true}]),
+    ring_echo(C, S, 100),
+    ok = gen_tcp:close(C),
+    receive {tcp_closed, S} -> ok end,
+    ok = gen_tcp:close(L).
+
+ring_echo(_C, _S, 0) ->
+    ok;
+ring_echo(C, S, N) ->
+    ok = gen_tcp:send(C, <<N:32>>),
+    receive {tcp, S, <<N:32>>} -> ok end,
+    ok = gen_tcp:send(S, <<N:32>>),
+    receive {tcp, C, <<N:32>>} -> ok end,
+    ring_echo(C, S, N-1).
+
+ring_fds() ->
+    {ok, Fds} = file:list_dir("/proc/self/fd"),
+    length([Fd || Fd <- Fds,
+		  file:read_link("/proc/self/fd/" ++ Fd)
+		      =:= {ok, "anon_inode:[io_uring]"}]).
@@ -0,0 +1,60 @@
+/*
+ * Run a program with io_uring_setup() failing with EPERM, the way it
+ * does where io_uring is disabled by policy.
+ *
+ *     no_uring Program Args...
+ *
+ * Exits with status 2 without running anything if that cannot be
+ * arranged on this system.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <stddef.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#endif
+
+#if defined(__NR_io_uring_setup) && defined(SECCOMP_MODE_FILTER) \
+    && defined(SECCOMP_RET_ERRNO) && defined(PR_SET_NO_NEW_PRIVS)
+
+int main(int argc, char **argv)
+{
+    struct sock_filter filter[] = {
+	BPF_STMT(BPF_LD|BPF_W|BPF_ABS, offsetof(struct seccomp_data, nr)),
+	BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, __NR_io_uring_setup, 0, 1),
+	BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ERRNO|EPERM),
+	BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW)
+    };
+    struct sock_fprog prog;
+
+    if (argc < 2) {
+	fprintf(stderr, "usage: no_uring Program Args...\n");
+	return 2;
+    }
+    prog.len = sizeof(filter)/sizeof(filter[0]);
+    prog.filter = filter;
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0
+	|| prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) != 0) {
+	perror("no_uring");
+	return 2;
+    }
+    execvp(argv[1], argv+1);
+    perror("no_uring");
+    return 2;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+    fprintf(stderr, "no_uring: not supported here\n");
+    return 2;
+}
+
+#endif
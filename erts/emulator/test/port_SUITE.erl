@@ -90,7 +90,9 @@
 	 mix_up_ports/1, otp_5112/1, otp_5119/1, otp_6224/1,
 	 exit_status_multi_scheduling_block/1, ports/1,
 	 spawn_driver/1, spawn_executable/1, close_deaf_port/1,
-	 unregister_name/1]).
+	 unregister_name/1, output_buffer/1, parallelism/1,
+	 forkserver_spawn/1, forkserver_cd_env/1, forkserver_failure/1,
+	 forkserver_fallback/1, forkserver_lost/1]).
 
 -export([]).
 
@@ -98,6 +100,8 @@
 -export([tps/3]).
 -export([otp_3906_forker/5, otp_3906_start_forker_starter/4]).
 -export([env_slave_main/1]).
+-export([forkserver_os_pid/0, forkserver_fallback_client/1,
+	 forkserver_lost_client/0]).
 
 -include_lib("test_server/include/test_server.hrl").
 -include_lib("kernel/include/file.hrl").
@@ -114,13 +118,17 @@ all() ->
      stderr_to_stdout, otp_3906, otp_4389, win_massive,
      mix_up_ports, otp_5112, otp_5119,
      exit_status_multi_scheduling_block, ports, spawn_driver,
-     spawn_executable, close_deaf_port, unregister_name].
+     spawn_executable, close_deaf_port, unregister_name, output_buffer,
+     parallelism, {group, forkserver}].
 
 groups() -> 
     [{stream, [], [stream_small, stream_big]},
      {options, [], [t_binary, eof, input_only, output_only]},
      {multiple_packets, [], [mul_basic, mul_slow_writes]},
-     {tps, [], [tps_16_bytes, tps_1K]}].
+     {tps, [], [tps_16_bytes, tps_1K]},
+     {forkserver, [], [forkserver_spawn, forkserver_cd_env,
+		       forkserver_failure, forkserver_fallback,
+		       forkserver_lost]}].
 
 init_per_group(_GroupName, Config) ->
     Config.
@@ -484,6 +492,64 @@ parallell(Config) when is_list(Config) ->
     ?line test_server:timetrap_cancel(Dog),
     ok.
 
+parallelism(doc) ->
+    ["Test that commands given by several processes to a port opened "
+     "with {parallelism, true} reach it in the order each process gave "
+     "them, also when the port is locked or more is given than may be "
+     "queued."];
+parallelism(Config) when is_list(Config) ->
+    ?line Dog = test_server:timetrap(test_server:seconds(120)),
+    ?line Path = ?config(data_dir, Config),
+    ?line ok = load_driver(Path, "parallelism_drv"),
+    ?line {'EXIT', {badarg, _}} =
+	(catch open_port({spawn_driver, "parallelism_drv"},
+			 [{parallelism, yes}])),
+    ?line Port = open_port({spawn_driver, "parallelism_drv"},
+			   [binary, {parallelism, true}]),
+    ?line Senders = 8,
+    ?line Packets = 200,
+    ?line Self = self(),
+    ?line SchedOnln = erlang:system_info(schedulers_online),
+    ?line Pids = [spawn_opt(fun() -> parallelism_send(Port, Id, Packets),
+				     Self ! {self(), sent}
+			    end, [link, {scheduler, (Id rem SchedOnln)+1}])
+		  || Id <- lists:seq(1, Senders)],
+    ?line [receive {Pid, sent} -> ok end || Pid <- Pids],
+    ?line ok = parallelism_receive(Port,
+				   erlang:make_tuple(Senders, Packets+1),
+				   Senders*Packets),
+    ?line true = port_close(Port),
+    ?line ok = erl_ddll:unload_driver("parallelism_drv"),
+    ?line test_server:timetrap_cancel(Dog),
+    ok.
+
+%% Every 10th command keeps the port locked for a while, and every 20th
+%% is larger than what may be queued
+parallelism_send(_Port, _Id, 0) ->
+    ok;
+parallelism_send(Port, Id, Seq) ->
+    {Cmd, Size} = case {Seq rem 10, Seq rem 20} of
+		      {_, 0} -> {$e, 100000};
+		      {0, _} -> {$s, Seq};
+		      _ -> {$e, Seq}
+		  end,
+    true = port_command(Port, [Cmd, Id, <<Seq:16>> |
+			       lists:duplicate(Size, Id)]),
+    parallelism_send(Port, Id, Seq-1).
+
+parallelism_receive(_Port, _Last, 0) ->
+    ok;
+parallelism_receive(Port, Last, N) ->
+    receive
+	{Port, {data, <<_, Id, Seq:16, _/binary>>}} ->
+	    case element(Id, Last) of
+		Prev when Prev =:= Seq+1 ->
+		    parallelism_receive(Port, setelement(Id, Last, Seq), N-1);
+		Prev ->
+		    ?line test_server:fail({out_of_order, Id, Prev, Seq})
+	    end
+    end.
+
 wait_for([]) ->
     ok;
 wait_for(Pids) ->
@@ -1327,6 +1393,178 @@ exit_status(Config)  when is_list(Config) ->
     ?line test_server:timetrap_cancel(Dog),
     ok.
 
+%% Port programs are started through the forkserver (sys.c) when it is
+%% running; these tests make sure what a port program sees and reports
+%% is the same as with a plain fork.
+
+forkserver_spawn(suite) ->
+    [];
+forkserver_spawn(doc) ->
+    ["Test that many spawns pipelined to the forkserver each get "
+     "their own exit status"];
+forkserver_spawn(Config) when is_list(Config) ->
+    case os:type() of
+	{unix,_} ->
+	    ?line Dog = test_server:timetrap(test_server:seconds(60)),
+	    ?line Ports = [{forkserver_sh("exit " ++ integer_to_list(N), []), N}
+			   || N <- lists:seq(0, 99)],
+	    ?line [{N, []} = forkserver_wait(Port) || {Port, N} <- Ports],
+	    ?line test_server:timetrap_cancel(Dog),
+	    forkserver_comment();
+	_ ->
+	    {skip,"Only on Unix."}
+    end.
+
+forkserver_cd_env(suite) ->
+    [];
+forkserver_cd_env(doc) ->
+    ["Test that cd and env are passed through the forkserver"];
+forkserver_cd_env(Config) when is_list(Config) ->
+    case os:type() of
+	{unix,_} ->
+	    ?line Dog = test_server:timetrap(test_server:seconds(60)),
+	    ?line Dir = filename:absname(?config(priv_dir, Config)),
+	    ?line {0, ["unset", "set"]} =
+		forkserver_wait(forkserver_sh("echo \"${HOME-unset}\"; "
+					      "echo \"$FS_SET\"",
+					      [{env, [{"HOME", false},
+						      {"FS_SET", "set"}]}])),
+	    ?line {0, [PwdDir]} =
+		forkserver_wait(forkserver_sh("pwd -P", [{cd, Dir}])),
+	    ?line {ok, #file_info{inode = Ino}} = file:read_file_info(Dir),
+	    ?line {ok, #file_info{inode = Ino}} = file:read_file_info(PwdDir),
+	    ?line test_server:timetrap_cancel(Dog),
+	    forkserver_comment();
+	_ ->
+	    {skip,"Only on Unix."}
+    end.
+
+forkserver_failure(suite) ->
+    [];
+forkserver_failure(doc) ->
+    ["Test that a failing chdir or exec in the child is reported "
+     "as exit status 1"];
+forkserver_failure(Config) when is_list(Config) ->
+    case os:type() of
+	{unix,_} ->
+	    ?line Dog = test_server:timetrap(test_server:seconds(60)),
+	    ?line forkserver_failure_1(?config(priv_dir, Config)),
+	    ?line test_server:timetrap_cancel(Dog),
+	    forkserver_comment();
+	_ ->
+	    {skip,"Only on Unix."}
+    end.
+
+forkserver_failure_1(PrivDir) ->
+    BadExe = filename:join(PrivDir, "forkserver_bad_exe"),
+    ok = file:write_file(BadExe, <<127,"ELF",0,0,0,0>>),
+    ok = file:change_mode(BadExe, 8#755),
+    {1, []} = forkserver_wait(open_port({spawn_executable, BadExe},
+					[exit_status, {line, 256}])),
+    NoDir = filename:join(PrivDir, "forkserver_no_such_dir"),
+    {1, []} = forkserver_wait(forkserver_sh("exit 0", [{cd, NoDir}])),
+    %% The failures must not have disturbed later spawns.
+    {3, []} = forkserver_wait(forkserver_sh("exit 3", [])),
+    ok.
+
+forkserver_fallback(suite) ->
+    [];
+forkserver_fallback(doc) ->
+    ["Test that ERL_NO_FORKSERVER makes the emulator fork port "
+     "programs itself"];
+forkserver_fallback(Config) when is_list(Config) ->
+    case os:type() of
+	{unix,_} ->
+	    ?line Dog = test_server:timetrap(test_server:seconds(120)),
+	    ?line SuiteDir = filename:dirname(code:which(?MODULE)),
+	    ?line {ok, Node} =
+		test_server:start_node(forkserver_fallback, slave,
+				       [{args, " -pa " ++ SuiteDir ++
+					 " -env ERL_NO_FORKSERVER true"}]),
+	    ?line [] = rpc:call(Node, ?MODULE, forkserver_os_pid, []),
+	    ?line ok = rpc:call(Node, ?MODULE, forkserver_fallback_client,
+				[?config(priv_dir, Config)]),
+	    ?line test_server:stop_node(Node),
+	    ?line test_server:timetrap_cancel(Dog),
+	    ok;
+	_ ->
+	    {skip,"Only on Unix."}
+    end.
+
+forkserver_fallback_client(PrivDir) ->
+    Ports = [{forkserver_sh("exit " ++ integer_to_list(N), []), N}
+	     || N <- lists:seq(0, 9)],
+    [{N, []} = forkserver_wait(Port) || {Port, N} <- Ports],
+    forkserver_failure_1(PrivDir).
+
+forkserver_lost(suite) ->
+    [];
+forkserver_lost(doc) ->
+    ["Test that children pending in a forkserver that dies get "
+     "exit status 255 and that later spawns still work"];
+forkserver_lost(Config) when is_list(Config) ->
+    case os:type() of
+	{unix,_} ->
+	    ?line Dog = test_server:timetrap(test_server:seconds(120)),
+	    ?line SuiteDir = filename:dirname(code:which(?MODULE)),
+	    ?line {ok, Node} =
+		test_server:start_node(forkserver_lost, slave,
+				       [{args, " -pa " ++ SuiteDir}]),
+	    ?line Res = rpc:call(Node, ?MODULE, forkserver_lost_client, []),
+	    ?line test_server:stop_node(Node),
+	    ?line test_server:timetrap_cancel(Dog),
+	    Res;
+	_ ->
+	    {skip,"Only on Unix."}
+    end.
+
+forkserver_lost_client() ->
+    case forkserver_os_pid() of
+	[] ->
+	    {skip,"No forkserver running."};
+	[Fs] ->
+	    Ports = [forkserver_sh("sleep 2", []) || _ <- lists:seq(1, 5)],
+	    receive after 500 -> ok end,
+	    os:cmd("kill -9 " ++ Fs),
+	    [{255, []} = forkserver_wait(Port) || Port <- Ports],
+	    [] = forkserver_os_pid(),
+	    {7, []} = forkserver_wait(forkserver_sh("exit 7", [])),
+	    ok
+    end.
+
+%% Returns the OS pid of the forkserver started by this emulator, if any.
+forkserver_os_pid() ->
+    OsPid = os:getpid(),
+    [Pid || Line <- string:tokens(os:cmd("ps -e -o pid= -o ppid= -o args="),
+				  "\n"),
+	    [Pid, PPid | Args] <- [string:tokens(Line, " ")],
+	    PPid =:= OsPid,
+	    lists:member("-forkserver", Args)].
+
+forkserver_comment() ->
+    case forkserver_os_pid() of
+	[] -> {comment, "No forkserver running; tested plain fork."};
+	_ -> ok
+    end.
+
+%% Not {spawn,"exit N"}: that is exec'ed by sh, which turns it into 127.
+forkserver_sh(Cmd, Opts) ->
+    open_port({spawn_executable, "/bin/sh"},
+	      [exit_status, {line, 256}, {args, ["-c", Cmd]} | Opts]).
+
+forkserver_wait(Port) ->
+    forkserver_wait(Port, []).
+
+forkserver_wait(Port, Lines) ->
+    receive
+	{Port, {data, {eol, Line}}} ->
+	    forkserver_wait(Port, [Line|Lines]);
+	{Port, {exit_status, Status}} ->
+	    {Status, lists:reverse(Lines)}
+    after 10000 ->
+	    test_server:fail({no_exit_status, Port})
+    end.
+
 spawn_driver(suite) ->
     [];
 spawn_driver(doc) ->
@@ -1460,6 +1698,62 @@ unregister_name(Config) when is_list(Config) ->
     ?line true = register(crash, open_port({spawn, "sleep 100"}, [])),
     ?line true = unregister(crash).
 
+output_buffer(doc) -> ["Test the output_buffer option of spawn and fd ports."];
+output_buffer(suite) -> [];
+output_buffer(Config) when is_list(Config) ->
+    case os:type() of
+	{unix, _} ->
+	    output_buffer_1(Config);
+	_ ->
+	    {skipped, "Only run on Unix systems"}
+    end.
+
+output_buffer_1(Config) ->
+    ?line Dog = test_server:timetrap(test_server:seconds(60)),
+    ?line {'EXIT',{badarg,_}} =
+	(catch open_port({spawn,"cat"}, [{output_buffer,-1}])),
+    ?line {'EXIT',{badarg,_}} =
+	(catch open_port({spawn,"cat"}, [{output_buffer,x}])),
+    ?line Dir = ?config(priv_dir, Config),
+    ?line Filename = filename:join(Dir, "output_buffer"),
+    Lines = [[integer_to_list(I), $\n] || I <- lists:seq(1, 100000)],
+    %% Written on close, with the reader blocking us at first
+    ?line Port1 = open_port({spawn, "sh -c 'sleep 1; cat >" ++ Filename ++ "'"},
+			    [out, {output_buffer, 4096}]),
+    ?line [port_command(Port1, L) || L <- Lines],
+    ?line port_close(Port1),
+    ?line ok = output_buffer_wait(Filename, iolist_to_binary(Lines), 50),
+    %% Written when the timer fires
+    ?line Port2 = open_port({spawn, "cat >" ++ Filename},
+			    [out, binary, {packet, 2},
+			     {output_buffer, 65536}]),
+    ?line port_command(Port2, <<"hello">>),
+    ?line ok = output_buffer_wait(Filename, <<0,5,"hello">>, 50),
+    ?line port_close(Port2),
+    %% Standard output of an emulator that halts without closing it
+    ?line Erl = atom_to_list(lib:progname()) ++
+	" -noshell -kernel user_output_buffer 65536 -eval "
+	"'[io:format(\"~w~n\", [I]) || I <- lists:seq(1, 10000)], ",
+    ?line Numbers = lists:flatten([[integer_to_list(I), $\n] ||
+				      I <- lists:seq(1, 10000)]),
+    ?line Halted = Numbers ++ "status 0\n",
+    ?line Halted = os:cmd(Erl ++ "halt().'; echo status $?"),
+    ?line Halted1 = Numbers ++ "status 1\n",
+    ?line Halted1 = os:cmd(Erl ++ "halt(1).'; echo status $?"),
+    ?line test_server:timetrap_cancel(Dog),
+    ok.
+
+output_buffer_wait(Filename, Expected, N) ->
+    case file:read_file(Filename) of
+	{ok, Expected} ->
+	    ok;
+	Other when N =:= 0 ->
+	    Other;
+	_ ->
+	    receive after 100 -> ok end,
+	    output_buffer_wait(Filename, Expected, N-1)
+    end.
+
 test_bat_file(Dir) ->
     FN = "tf.bat",
     Full = filename:join([Dir,FN]),
@@ -0,0 +1,85 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2013. All Rights Reserved.
+ *
+ * The contents of this file are subject to the Erlang Public License,
+ * Version 1.1, (the "License"); you may not use this file except in
+ * compliance with the License. You should have received a copy of the
+ * Erlang Public License along with this software. If not, it can be
+ * retrieved online at http://www.erlang.org/.
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * %CopyrightEnd%
+ */
+
+/*
+ * Echoes every command. A command starting with 's' is echoed after
+ * sleeping 10 ms, so that the port stays locked while others give it
+ * commands.
+ */
+
+#ifdef __WIN32__
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "erl_driver.h"
+
+static ErlDrvData parallelism_drv_start(ErlDrvPort port, char *command);
+static void parallelism_drv_output(ErlDrvData drv_data, char *buf,
+				   ErlDrvSizeT len);
+
+static ErlDrvEntry parallelism_drv_entry = {
+    NULL, /* init */
+    parallelism_drv_start,
+    NULL, /* stop */
+    parallelism_drv_output,
+    NULL, /* ready_input */
+    NULL, /* ready_output */
+    "parallelism_drv",
+    NULL, /* finish */
+    NULL, /* handle */
+    NULL, /* control */
+    NULL, /* timeout */
+    NULL, /* outputv */
+    NULL, /* ready_async */
+    NULL, /* flush */
+    NULL, /* call */
+    NULL, /* event */
+    ERL_DRV_EXTENDED_MARKER,
+    ERL_DRV_EXTENDED_MAJOR_VERSION,
+    ERL_DRV_EXTENDED_MINOR_VERSION,
+    ERL_DRV_FLAG_USE_PORT_LOCKING,
+    NULL, /* handle2 */
+    NULL  /* process_exit */
+};
+
+DRIVER_INIT(parallelism_drv)
+{
+    return &parallelism_drv_entry;
+}
+
+static ErlDrvData parallelism_drv_start(ErlDrvPort port, char *command)
+{
+    return (ErlDrvData) port;
+}
+
+static void parallelism_drv_output(ErlDrvData drv_data, char *buf,
+				   ErlDrvSizeT len)
+{
+    ErlDrvPort port = (ErlDrvPort) drv_data;
+
+    if (len > 0 && buf[0] == 's') {
+#ifdef __WIN32__
+	Sleep((DWORD) 10);
+#else
+	usleep(10000);
+#endif
+    }
+    driver_output(port, buf, len);
+}
@@ -172,8 +172,13 @@ int main(int argc, char** argv)
     g->delay_write    = 0;
     g->progname       = argv[0];
     g->conn           = NULL;
+    g->conn_free      = NULL;
     g->nodes.reg = g->nodes.unreg = g->nodes.unreg_tail = NULL;
     g->nodes.unreg_count = 0;
+    g->nodes.htab     = NULL;
+#ifdef EPMD_USE_EPOLL
+    g->epoll_fd       = -1;
+#endif
     g->active_conn    = 0;
 
     for (i = 0; i < MAX_LISTEN_SOCKETS; i++)
@@ -259,6 +264,11 @@ int main(int argc, char** argv)
 #endif
       g->max_conn = MAX_FILES;
   
+#ifdef EPMD_USE_EPOLL
+    if (g->max_conn > MAX_EPOLL_FILES) {
+      g->max_conn = MAX_EPOLL_FILES;
+    }
+#else
     /*
      * max_conn must not be greater than FD_SETSIZE.
      * (at least QNX crashes)
@@ -267,6 +277,7 @@ int main(int argc, char** argv)
     if (g->max_conn > FD_SETSIZE) {
       g->max_conn = FD_SETSIZE;
     }
+#endif
 
     if (g->is_daemon)  {
 	run_daemon(g);
@@ -558,6 +569,10 @@ static void free_all_nodes(EpmdVars *g)
 	g->nodes.unreg = tmp->next;
 	free(tmp);
     }
+    if (g->nodes.htab) {
+	free(g->nodes.htab);
+	g->nodes.htab = NULL;
+    }
 }
 void epmd_cleanup_exit(EpmdVars *g, int exitval)
 {
@@ -569,6 +584,12 @@ void epmd_cleanup_exit(EpmdVars *g, int exitval)
 	      epmd_conn_close(g,&g->conn[i]);
       free(g->conn);
   }
+  if(g->conn_free)
+      free(g->conn_free);
+#ifdef EPMD_USE_EPOLL
+  if(g->epoll_fd >= 0)
+      close(g->epoll_fd);
+#endif
   for(i=0; i < MAX_LISTEN_SOCKETS; i++)
       if(g->listenfd[i] >= 0)
           close(g->listenfd[i]);
@@ -110,6 +110,11 @@
 #  include <unistd.h>
 #endif
 
+#if defined(HAVE_SYS_EPOLL_H) && !defined(__WIN32__) && !defined(VXWORKS)
+#  include <sys/epoll.h>
+#  define EPMD_USE_EPOLL
+#endif
+
 #include <stdarg.h>
 
 /* ************************************************************************ */
@@ -162,6 +167,17 @@
 
 #define MAX_FILES 2048		/* if sysconf() isn't available, or fails */
 
+/*
+ * With epoll we are not limited by FD_SETSIZE, but there is still one
+ * Connection slot allocated per file descriptor we may use, so don't
+ * let a huge RLIMIT_NOFILE decide the size of that table.
+ */
+
+#define MAX_EPOLL_FILES 65536
+
+/* Max number of events fetched by each call to epoll_wait() */
+#define EPOLL_EVENTS 256
+
 /* ************************************************************************ */
 /* Macros that let us use IPv6                                              */
 
@@ -226,6 +242,12 @@
 #define MAX_UNREG_COUNT 1000
 #define DEBUG_MAX_UNREG_COUNT 5
 
+/* Both registered and unregistered nodes are kept in a hash table
+   keyed by name. It starts out at this size (a power of two) and is
+   doubled when there are more nodes than buckets. */
+
+#define NODE_HASH_INIT_SIZE 256
+
 /* Maximum length of a node name == atom name */
 #define MAXSYMLEN 255
 
@@ -252,6 +274,8 @@
 
 /* Stuctures used by server */
 
+struct enode;
+
 typedef struct {
   int fd;			/* File descriptor */
   unsigned char open;		/* TRUE if open */
@@ -261,12 +285,17 @@ typedef struct {
   unsigned got;			/* # of bytes we have got */
   unsigned want;		/* Number of bytes we want */
   char *buf;			/* The remaining buffer */
+  struct enode *node;		/* Node registered on this connection */
 
   time_t mod_time;		/* Last activity on this socket */
 } Connection;
 
 struct enode {
   struct enode *next;
+  struct enode *prev;		/* Previous node in "reg" or "unreg" list */
+  struct enode *hnext;		/* Next node in same hash bucket */
+  unsigned int hval;		/* Hash value of symname */
+  unsigned char registered;	/* TRUE if in "reg" list */
   int fd;			/* The socket in use */
   unsigned short port;		/* Port number of Erlang node */
   char symname[MAXSYMLEN+1];	/* Name of the Erlang node */
@@ -286,6 +315,9 @@ typedef struct {
   Node *unreg;
   Node *unreg_tail;
   int unreg_count;
+  Node **htab;			/* All nodes in "reg" and "unreg", by name */
+  unsigned int hsize;		/* Number of buckets, a power of two */
+  unsigned int hcount;		/* Number of nodes in htab */
 } Nodes;
 
 
@@ -306,8 +338,13 @@ typedef struct {
   int select_fd_top;
   char *progname;
   Connection *conn;
+  int *conn_free;		/* Stack of free slots in conn */
+  int conn_free_top;
   Nodes nodes;
   fd_set orig_read_mask;
+#ifdef EPMD_USE_EPOLL
+  int epoll_fd;
+#endif
   int listenfd[MAX_LISTEN_SOCKETS];
   char *addresses;
   char **argv;
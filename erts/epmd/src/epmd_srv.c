@@ -72,22 +72,135 @@ static int conn_open(EpmdVars*,int);
 static int conn_close_fd(EpmdVars*,int);
 
 static void node_init(EpmdVars*);
+static Node *node_lookup(EpmdVars*,char*);
 static Node *node_reg2(EpmdVars*,char*, int, int, unsigned char, unsigned char, int, int, int, char*);
 static int node_unreg(EpmdVars*,char*);
-static int node_unreg_sock(EpmdVars*,int);
+static int node_unreg_sock(EpmdVars*,Connection*);
 
 static int reply(EpmdVars*,int,char *,int);
 static void dbg_print_buf(EpmdVars*,char *,int);
 static void print_names(EpmdVars*);
 
-static EPMD_INLINE void select_fd_set(EpmdVars* g, int fd)
+/* Start watching fd for input. When using epoll the tag is what we get
+   back in the event: a slot in g->conn, or g->max_conn + i for the
+   listen socket g->listenfd[i]. */
+
+static EPMD_INLINE void select_fd_set(EpmdVars* g, int fd, unsigned tag)
 {
+#ifdef EPMD_USE_EPOLL
+    struct epoll_event ev;
+
+    memzero(&ev, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = tag;
+    if (epoll_ctl(g->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+	dbg_perror(g,"failed to add file descriptor %d to epoll set", fd);
+    }
+#else
     FD_SET(fd, &g->orig_read_mask);
     if (fd >= g->select_fd_top) {
 	g->select_fd_top = fd + 1;
     }
+#endif
+}
+
+#ifdef EPMD_USE_EPOLL
+
+static void check_timeouts(EpmdVars *g)
+{
+  time_t now = current_time(g);
+  int i;
+
+  for (i = 0; i < g->max_conn; i++) {
+    if ((g->conn[i].open == EPMD_TRUE) &&
+	(g->conn[i].keep == EPMD_FALSE) &&
+	((g->conn[i].mod_time + g->packet_timeout) < now)) {
+      dbg_tty_printf(g,1,"closing because timed out on receive");
+      epmd_conn_close(g,&g->conn[i]);
+    }
+  }
+}
+
+/*
+ * Only the sockets that actually have data are visited, so the cost
+ * of a wakeup does not grow with the number of registered nodes.
+ * Connections not yet answered are checked for timeouts at most once
+ * a second. While all connection slots are taken the listen sockets
+ * are taken out of the (level triggered) epoll set, or epoll_wait()
+ * would return at once for them on every pass.
+ */
+
+static void epoll_loop(EpmdVars *g, int num_sockets)
+{
+  struct epoll_event events[EPOLL_EVENTS];
+  time_t last_check = current_time(g);
+  int timeout = ((g->packet_timeout < IDLE_TIMEOUT) ? 1 : IDLE_TIMEOUT) * 1000;
+  int listening = EPMD_TRUE;
+
+  dbg_tty_printf(g,2,"entering the main epoll() loop");
+
+  while(1)
+    {
+      int ret, i;
+      time_t now;
+
+      if (!listening && g->active_conn < g->max_conn) {
+	dbg_tty_printf(g,2,"accepting connections again");
+	for (i = 0; i < num_sockets; i++)
+	  select_fd_set(g, g->listenfd[i], g->max_conn + i);
+	listening = EPMD_TRUE;
+      }
+
+      if ((ret = epoll_wait(g->epoll_fd, events, EPOLL_EVENTS, timeout)) < 0) {
+	dbg_perror(g,"error in epoll_wait ");
+        switch (errno) {
+          case EAGAIN:
+          case EINTR:
+            continue;
+          default:
+            epmd_cleanup_exit(g,1);
+        }
+      }
+
+      if (ret > 0 && g->delay_accept) {	/* Test of busy server */
+	sleep(g->delay_accept);
+      }
+
+      /* Read before accepting so that a slot closed and reused
+	 within this batch never gets an event meant for the old
+	 connection. */
+
+      for (i = 0; i < ret; i++) {
+	unsigned tag = events[i].data.u32;
+	if (tag < (unsigned) g->max_conn && g->conn[tag].open == EPMD_TRUE)
+	  do_read(g,&g->conn[tag]);
+      }
+
+      for (i = 0; i < ret; i++) {
+	unsigned tag = events[i].data.u32;
+	if (tag >= (unsigned) g->max_conn &&
+	    tag - g->max_conn < (unsigned) num_sockets &&
+	    g->active_conn < g->max_conn)
+	  do_accept(g, g->listenfd[tag - g->max_conn]);
+      }
+
+      if (listening && g->active_conn >= g->max_conn) {
+	dbg_tty_printf(g,1,"all connections in use, not accepting any more");
+	for (i = 0; i < num_sockets; i++)
+	  epoll_ctl(g->epoll_fd, EPOLL_CTL_DEL, g->listenfd[i], NULL);
+	listening = EPMD_FALSE;
+      }
+
+      now = current_time(g);
+      if (now != last_check) {
+	last_check = now;
+	check_timeouts(g);
+      }
+    }
 }
 
+#endif /* EPMD_USE_EPOLL */
+
 void run(EpmdVars *g)
 {
   struct EPMD_SOCKADDR_IN iserv_addr[MAX_LISTEN_SOCKETS];
@@ -181,6 +294,14 @@ void run(EpmdVars *g)
   FD_ZERO(&g->orig_read_mask);
   g->select_fd_top = 0;
 
+#ifdef EPMD_USE_EPOLL
+  if ((g->epoll_fd = epoll_create(g->max_conn)) < 0)
+    {
+      dbg_perror(g,"error creating epoll set");
+      epmd_cleanup_exit(g,1);
+    }
+#endif
+
   for (i = 0; i < num_sockets; i++)
     {
       if ((listensock[i] = socket(FAMILY,SOCK_STREAM,0)) < 0)
@@ -241,9 +362,12 @@ void run(EpmdVars *g)
           dbg_perror(g,"failed to listen on socket");
           epmd_cleanup_exit(g,1);
       }
-      select_fd_set(g, listensock[i]);
+      select_fd_set(g, listensock[i], g->max_conn + i);
     }
 
+#ifdef EPMD_USE_EPOLL
+  epoll_loop(g, num_sockets);
+#else
   dbg_tty_printf(g,2,"entering the main select() loop");
 
  select_again:
@@ -311,6 +435,7 @@ void run(EpmdVars *g)
 	}
       }
     }
+#endif /* !EPMD_USE_EPOLL */
 }
 
 /*
@@ -339,14 +464,14 @@ static void do_read(EpmdVars *g,Connection *s)
 
       if (val == 0)
 	{
-	  node_unreg_sock(g,s->fd);
+	  node_unreg_sock(g,s);
 	  epmd_conn_close(g,s);
 	}
       else if (val < 0)
 	{
 	    dbg_tty_printf(g,1,"error on ALIVE socket %d (%d; errno=0x%x)",
 			   s->fd, val, errno);
-	  node_unreg_sock(g,s->fd);
+	  node_unreg_sock(g,s);
 	  epmd_conn_close(g,s);
 	}
       else
@@ -355,7 +480,7 @@ static void do_read(EpmdVars *g,Connection *s)
 		 s->fd,val);
 	  dbg_print_buf(g,s->buf,val);
 
-	  node_unreg_sock(g,s->fd);
+	  node_unreg_sock(g,s);
 	  epmd_conn_close(g,s);
 	}
       return;
@@ -534,6 +659,7 @@ static void do_request(g, fd, s, buf, bsize)
 	} else {
 	    wbuf[1] = 0; /* ok */
 	    put_int16(node->creation, wbuf+2);
+	    s->node = node;
 	}
   
 	if (g->delay_write)		/* Test of busy server */
@@ -575,31 +701,29 @@ static void do_request(g, fd, s, buf, bsize)
 	Node *node;
 	
 	wbuf[0] = EPMD_PORT2_RESP;
-	for (node = g->nodes.reg; node; node = node->next) {
+	if ((node = node_lookup(g, name)) != NULL && node->registered) {
 	    int offset;
-	    if (strcmp(node->symname, name) == 0) {
-		wbuf[1] = 0; /* ok */
-		put_int16(node->port,wbuf+2);
-		wbuf[4] = node->nodetype;
-		wbuf[5] = node->protocol;
-		put_int16(node->highvsn,wbuf+6);
-		put_int16(node->lowvsn,wbuf+8);
-		put_int16(strlen(node->symname),wbuf+10);
-		offset = 12;
-		strcpy(wbuf + offset,node->symname);
-		offset += strlen(node->symname);
-		put_int16(node->extralen,wbuf + offset);
-		offset += 2;
-		memcpy(wbuf + offset,node->extra,node->extralen);
-		offset += node->extralen;
-		if (reply(g, fd, wbuf, offset) != offset)
-		  {
-		    dbg_tty_printf(g,1,"** failed to send PORT2_RESP (ok) for \"%s\"",name);
-		    return;
-		  }
-		dbg_tty_printf(g,1,"** sent PORT2_RESP (ok) for \"%s\"",name);
+	    wbuf[1] = 0; /* ok */
+	    put_int16(node->port,wbuf+2);
+	    wbuf[4] = node->nodetype;
+	    wbuf[5] = node->protocol;
+	    put_int16(node->highvsn,wbuf+6);
+	    put_int16(node->lowvsn,wbuf+8);
+	    put_int16(strlen(node->symname),wbuf+10);
+	    offset = 12;
+	    strcpy(wbuf + offset,node->symname);
+	    offset += strlen(node->symname);
+	    put_int16(node->extralen,wbuf + offset);
+	    offset += 2;
+	    memcpy(wbuf + offset,node->extra,node->extralen);
+	    offset += node->extralen;
+	    if (reply(g, fd, wbuf, offset) != offset)
+	      {
+		dbg_tty_printf(g,1,"** failed to send PORT2_RESP (ok) for \"%s\"",name);
 		return;
-	    }
+	      }
+	    dbg_tty_printf(g,1,"** sent PORT2_RESP (ok) for \"%s\"",name);
+	    return;
 	}
 	wbuf[1] = 1; /* error */
 	if (reply(g, fd, wbuf, 2) != 2)
@@ -779,8 +903,11 @@ static Connection *conn_init(EpmdVars *g)
 {
   int nbytes = g->max_conn * sizeof(Connection);
   Connection *connections = (Connection *)malloc(nbytes);
+  int i;
+
+  g->conn_free = (int *)malloc(g->max_conn * sizeof(int));
 
-  if (connections == NULL)
+  if (connections == NULL || g->conn_free == NULL)
     {
       dbg_printf(g,0,"epmd: Insufficient memory");
 #ifdef DONT_USE_MAIN
@@ -791,6 +918,11 @@ static Connection *conn_init(EpmdVars *g)
 
   memzero(connections, nbytes);
 
+  /* Lowest slot on top, same order as the linear search we used to do */
+  for (i = 0; i < g->max_conn; i++)
+    g->conn_free[i] = g->max_conn - 1 - i;
+  g->conn_free_top = g->max_conn;
+
   return connections;
 }
 
@@ -816,8 +948,7 @@ static int conn_open(EpmdVars *g,int fd)
   }
 #endif
 
-  for (i = 0; i < g->max_conn; i++) {
-    if (g->conn[i].open == EPMD_FALSE) {
+  if (g->conn_free_top > 0) {
       struct sockaddr_in si;
       struct sockaddr_in di;
 #ifdef HAVE_SOCKLEN_T
@@ -827,15 +958,17 @@ static int conn_open(EpmdVars *g,int fd)
 #endif
       st = sizeof(si);
 
+      i = g->conn_free[--g->conn_free_top];
       g->active_conn++;
       s = &g->conn[i];
      
       /* From now on we want to know if there are data to be read */
-      select_fd_set(g, fd);
+      select_fd_set(g, fd, i);
 
       s->fd   = fd;
       s->open = EPMD_TRUE;
       s->keep = EPMD_FALSE;
+      s->node = NULL;
 
       /* Determine if connection is from localhost */
       if (getpeername(s->fd,(struct sockaddr*) &si,&st) ||
@@ -862,13 +995,12 @@ static int conn_open(EpmdVars *g,int fd)
 
       if (s->buf == NULL) {
 	dbg_printf(g,0,"epmd: Insufficient memory");
-	close(fd);
+	epmd_conn_close(g,s);
 	return EPMD_FALSE;
       }
 
       dbg_tty_printf(g,2,"opening connection on file descriptor %d",fd);
       return EPMD_TRUE;
-    }
   }
 
   dbg_tty_printf(g,0,"failed opening connection on file descriptor %d",fd);
@@ -881,7 +1013,7 @@ static int conn_close_fd(EpmdVars *g,int fd)
   int i;
 
   for (i = 0; i < g->max_conn; i++)
-    if (g->conn[i].fd == fd)
+    if (g->conn[i].open == EPMD_TRUE && g->conn[i].fd == fd)
       {
 	epmd_conn_close(g,&g->conn[i]);
 	return EPMD_TRUE;
@@ -895,13 +1027,19 @@ int epmd_conn_close(EpmdVars *g,Connection *s)
 {
   dbg_tty_printf(g,2,"closing connection on file descriptor %d",s->fd);
 
+#ifndef EPMD_USE_EPOLL
   FD_CLR(s->fd,&g->orig_read_mask);
   /* we don't bother lowering g->select_fd_top */
+#endif
+  /* With epoll the close also removes the fd from the epoll set */
   close(s->fd);			/* Sometimes already closed but close anyway */
   s->open = EPMD_FALSE;
+  s->node = NULL;
   if (s->buf != NULL) {		/* Should never be NULL but test anyway */
     free(s->buf);
+    s->buf = NULL;
   }
+  g->conn_free[g->conn_free_top++] = s - g->conn;
   g->active_conn--;
   return EPMD_TRUE;
 }
@@ -913,87 +1051,196 @@ int epmd_conn_close(EpmdVars *g,Connection *s)
  ****************************************************************************/
 
 
+/*
+ *  The nodes are kept in two lists, "reg" for the registered ones and
+ *  "unreg" for the ones we remember to be able to change "creation".
+ *  A name is never in both lists, so all of them are also kept in one
+ *  hash table keyed by name, making registration and lookup O(1) even
+ *  with many thousands of nodes.
+ */
+
 static void node_init(EpmdVars *g)
 {
   g->nodes.reg         = NULL;
   g->nodes.unreg       = NULL;
   g->nodes.unreg_tail  = NULL;
   g->nodes.unreg_count = 0;
+  g->nodes.hsize       = NODE_HASH_INIT_SIZE;
+  g->nodes.hcount      = 0;
+  g->nodes.htab = (Node **)malloc(g->nodes.hsize * sizeof(Node *));
+
+  if (g->nodes.htab == NULL)
+    {
+      dbg_printf(g,0,"epmd: Insufficient memory");
+      exit(1);
+    }
+
+  memzero(g->nodes.htab, g->nodes.hsize * sizeof(Node *));
 }
 
+/* FNV-1a */
+static unsigned int node_hash(char *name)
+{
+  unsigned int h = 2166136261U;
 
-/* We have got a close on a connection and it may be a
-   EPMD_ALIVE_CLOSE_REQ. Note that this call should be called
-   *before* calling conn_close() */
+  while (*name)
+    {
+      h ^= (unsigned char) *name++;
+      h *= 16777619U;
+    }
+  return h;
+}
 
-static int node_unreg(EpmdVars *g,char *name)
+static Node *node_lookup(EpmdVars *g, char *name)
 {
-  Node **prev = &g->nodes.reg;	/* Point to cell pointing to... */
-  Node *node  = g->nodes.reg;	/* Point to first node */
+  unsigned int hval = node_hash(name);
+  Node *node = g->nodes.htab[hval & (g->nodes.hsize - 1)];
 
-  for (; node; prev = &node->next, node = node->next)
-    if (strcmp(node->symname, name) == 0)
-      {
-	dbg_tty_printf(g,1,"unregistering '%s:%d', port %d",
-		       node->symname, node->creation, node->port);
+  for (; node; node = node->hnext)
+    if (node->hval == hval && strcmp(node->symname, name) == 0)
+      return node;
 
-	*prev = node->next;	/* Link out from "reg" list */
+  return NULL;
+}
 
-	if (g->nodes.unreg == NULL) /* Link into "unreg" list */
-	  g->nodes.unreg = g->nodes.unreg_tail = node;
-	else
-	  {
-	    g->nodes.unreg_tail->next = node;
-	    g->nodes.unreg_tail = node;
-	  }
+static void node_hash_grow(EpmdVars *g)
+{
+  unsigned int size = g->nodes.hsize * 2;
+  Node **htab = (Node **)malloc(size * sizeof(Node *));
+  unsigned int i;
 
-	g->nodes.unreg_count++;
+  if (htab == NULL)
+    return;			/* Keep the old table; slower but correct */
 
-	node->next = NULL;	/* Last in list == first in FIFO queue */
+  memzero(htab, size * sizeof(Node *));
 
-	print_names(g);
+  for (i = 0; i < g->nodes.hsize; i++)
+    {
+      Node *node = g->nodes.htab[i];
 
-	return node->fd;
-      }
+      while (node)
+	{
+	  Node *next = node->hnext;
+	  Node **bucket = &htab[node->hval & (size - 1)];
 
-  dbg_tty_printf(g,1,"trying to unregister node with unknown name %s", name);
-  return -1;
+	  node->hnext = *bucket;
+	  *bucket = node;
+	  node = next;
+	}
+    }
+
+  free(g->nodes.htab);
+  g->nodes.htab  = htab;
+  g->nodes.hsize = size;
 }
 
+static void node_hash_insert(EpmdVars *g, Node *node)
+{
+  Node **bucket;
+
+  if (g->nodes.hcount >= g->nodes.hsize)
+    node_hash_grow(g);
+
+  node->hval  = node_hash(node->symname);
+  bucket      = &g->nodes.htab[node->hval & (g->nodes.hsize - 1)];
+  node->hnext = *bucket;
+  *bucket     = node;
+  g->nodes.hcount++;
+}
 
-static int node_unreg_sock(EpmdVars *g,int fd)
+static void node_hash_remove(EpmdVars *g, Node *node)
 {
-  Node **prev = &g->nodes.reg;	/* Point to cell pointing to... */
-  Node *node  = g->nodes.reg;	/* Point to first node */
+  Node **prev = &g->nodes.htab[node->hval & (g->nodes.hsize - 1)];
 
-  for (; node; prev = &node->next, node = node->next)
-    if (node->fd == fd)
+  for (; *prev; prev = &(*prev)->hnext)
+    if (*prev == node)
       {
-	dbg_tty_printf(g,1,"unregistering '%s:%d', port %d",
-		       node->symname, node->creation, node->port);
+	*prev = node->hnext;
+	g->nodes.hcount--;
+	return;
+      }
+}
 
-	*prev = node->next;	/* Link out from "reg" list */
+/* Link out from the "unreg" FIFO queue */
 
-	if (g->nodes.unreg == NULL) /* Link into "unreg" list */
-	  g->nodes.unreg = g->nodes.unreg_tail = node;
-	else
-	  {
-	    g->nodes.unreg_tail->next = node;
-	    g->nodes.unreg_tail = node;
-	  }
+static void node_unreg_unlink(EpmdVars *g, Node *node)
+{
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    g->nodes.unreg = node->next;
+
+  if (node->next)
+    node->next->prev = node->prev;
+  else
+    g->nodes.unreg_tail = node->prev;
 
-	g->nodes.unreg_count++;
+  g->nodes.unreg_count--;
+}
 
-	node->next = NULL;	/* Last in list == first in FIFO queue */
+/* Move a registered node to the end of the "unreg" FIFO queue.
+   Returns the socket the node was registered on. */
 
-	print_names(g);
+static int node_unreg_node(EpmdVars *g, Node *node)
+{
+  dbg_tty_printf(g,1,"unregistering '%s:%d', port %d",
+		 node->symname, node->creation, node->port);
 
-	return node->fd;
-      }
+  if (node->prev)		/* Link out from "reg" list */
+    node->prev->next = node->next;
+  else
+    g->nodes.reg = node->next;
+  if (node->next)
+    node->next->prev = node->prev;
+
+  node->registered = EPMD_FALSE;
+  node->next = NULL;		/* Last in list == first in FIFO queue */
+  node->prev = g->nodes.unreg_tail;
+
+  if (g->nodes.unreg == NULL) /* Link into "unreg" list */
+    g->nodes.unreg = g->nodes.unreg_tail = node;
+  else
+    {
+      g->nodes.unreg_tail->next = node;
+      g->nodes.unreg_tail = node;
+    }
+
+  g->nodes.unreg_count++;
+
+  print_names(g);
+
+  return node->fd;
+}
+
+/* We have got a close on a connection and it may be a
+   EPMD_ALIVE_CLOSE_REQ. Note that this call should be called
+   *before* calling conn_close() */
+
+static int node_unreg(EpmdVars *g,char *name)
+{
+  Node *node = node_lookup(g, name);
+
+  if (node != NULL && node->registered)
+    return node_unreg_node(g, node);
+
+  dbg_tty_printf(g,1,"trying to unregister node with unknown name %s", name);
+  return -1;
+}
+
+
+static int node_unreg_sock(EpmdVars *g,Connection *s)
+{
+  Node *node = s->node;
+
+  if (node != NULL && node->registered && node->fd == s->fd)
+    {
+      s->node = NULL;
+      return node_unreg_node(g, node);
+    }
 
   dbg_tty_printf(g,1,
 		 "trying to unregister node with unknown file descriptor %d",
-		 fd);
+		 s->fd);
   return -1;
 }
 
@@ -1022,8 +1269,7 @@ static Node *node_reg2(EpmdVars *g,
 		       int extralen,
 		       char* extra)
 {
-  Node *prev;			/* Point to previous node or NULL */
-  Node *node;			/* Point to first node */
+  Node *node;
 
   /* Can be NULL; means old style */
   if (extra == NULL)
@@ -1042,53 +1288,30 @@ static Node *node_reg2(EpmdVars *g,
       return NULL;
     }
 
-  /* Fail if it is already registered */
+  node = node_lookup(g, name);
 
-  for (node = g->nodes.reg; node; node = node->next)
-    if (strcmp(node->symname, name) == 0)
-      {
-	dbg_printf(g,0,"node name already occupied %s", name);
-	return NULL;
-      }
-
-  /* Try to find the name in the used queue so that we
-     can change "creation" number 1..3 */
-
-  prev = NULL;
-
-  for (node = g->nodes.unreg; node; prev = node, node = node->next)
-    if (strcmp(node->symname, name) == 0)
-      {
-	dbg_tty_printf(g,1,"reusing slot with same name '%s'", node->symname);
+  /* Fail if it is already registered */
 
-	if (prev == NULL)	/* First in list matched */
-	  {
-	    if (node->next == NULL) /* Only one element */
-	      g->nodes.unreg = g->nodes.unreg_tail = NULL;
-	    else
-	      g->nodes.unreg = node->next;
-	  }
-	else
-	  {
-	    if (node->next == NULL) /* Last in list */
-	      {
-		g->nodes.unreg_tail = prev; /* Point to new last */
-		prev->next = NULL; /* New last has no next */
-	      }
-	    else
-	      prev->next = node->next; /* Simple link out from list */
-	  }
+  if (node != NULL && node->registered)
+    {
+      dbg_printf(g,0,"node name already occupied %s", name);
+      return NULL;
+    }
 
-	g->nodes.unreg_count--;
+  if (node != NULL)
+    {
+      /* The name is in the used queue so that we can change
+	 "creation" number 1..3 */
 
-	/* When reusing we change the "creation" number 1..3 */
+      dbg_tty_printf(g,1,"reusing slot with same name '%s'", node->symname);
 
-	node->creation = node->creation % 3 + 1;
+      node_unreg_unlink(g, node);
 
-	break;
-      }
+      /* When reusing we change the "creation" number 1..3 */
 
-  if (node == NULL)
+      node->creation = node->creation % 3 + 1;
+    }
+  else
     {
       /* A new name. If the "unreg" list is too long we steal the
 	 oldest node structure and use it for the new node, else
@@ -1099,8 +1322,8 @@ static Node *node_reg2(EpmdVars *g,
 	{
 	  /* MAX_UNREG_COUNT > 1 so no need to check unreg_tail */
 	  node = g->nodes.unreg;	/* Take first == oldest */
-	  g->nodes.unreg = node->next; /* Link out */
-	  g->nodes.unreg_count--;
+	  node_unreg_unlink(g, node);
+	  node_hash_remove(g, node);
 	}
       else
 	{
@@ -1112,10 +1335,17 @@ static Node *node_reg2(EpmdVars *g,
 
 	  node->creation = (current_time(g) % 3) + 1; /* "random" 1-3 */
 	}
+
+      strcpy(node->symname,name);
+      node_hash_insert(g, node);
     }
 
-  node->next = g->nodes.reg; /* Link into "reg" queue */
+  node->prev = NULL;		/* Link into "reg" queue */
+  node->next = g->nodes.reg;
+  if (g->nodes.reg)
+    g->nodes.reg->prev = node;
   g->nodes.reg  = node;
+  node->registered = EPMD_TRUE;
 
   node->fd       = fd;
   node->port     = port;
@@ -1125,8 +1355,6 @@ static Node *node_reg2(EpmdVars *g,
   node->lowvsn   = lowvsn;
   node->extralen = extralen;
   memcpy(node->extra,extra,extralen);
-  strcpy(node->symname,name);
-  select_fd_set(g, fd);
 
   if (highvsn == 0) {
     dbg_tty_printf(g,1,"registering '%s:%d', port %d",
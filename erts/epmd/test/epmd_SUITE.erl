@@ -49,7 +49,8 @@
     slow_get_port_nr/1,
     unregister_others_name_1/1,
     unregister_others_name_2/1,
-    register_overflow/1,
+    register_overflow/1, full_no_spin/1,
+    register_lookup_many/1,
     name_with_null_inside/1,
     name_null_terminated/1,
     stupid_names_req/1,
@@ -88,6 +89,7 @@
 -define(CONN_TIMEOUT, 100).
 -define(RECV_TIMEOUT, 2000).
 -define(REG_REPEAT_LIM,1000).
+-define(MANY_NAMES,10000).
 
 % Message codes in epmd protocol
 -define(EPMD_ALIVE2_REQ,	$x).
@@ -109,8 +111,8 @@ all() ->
     [register_name, register_names_1, register_names_2,
      register_duplicate_name, get_port_nr, slow_get_port_nr,
      unregister_others_name_1, unregister_others_name_2,
-     register_overflow, name_with_null_inside,
-     name_null_terminated, stupid_names_req, no_data,
+     register_overflow, full_no_spin, register_lookup_many,
+     name_with_null_inside, name_null_terminated, stupid_names_req, no_data,
      one_byte, two_bytes, partial_packet, zero_length,
      too_large, alive_req_too_small_1, alive_req_too_small_2,
      alive_req_too_large, returns_valid_empty_extra,
@@ -491,6 +493,48 @@ register_overflow(Config) when is_list(Config) ->
     test_server:timetrap_cancel(LongDog),
     ok.
 
+full_no_spin(doc) ->
+    ["Check that epmd doesn't spin while all connections are in use, "
+     "and that it accepts again once one is closed"];
+full_no_spin(suite) ->
+    [];
+full_no_spin(Config) when is_list(Config) ->
+    case {os:type(), os:find_executable(epmd)} of
+	{{unix,linux}, Epmd} when is_list(Epmd) ->
+	    Args = Epmd ++ " " ?EPMDARGS " -port " ++ integer_to_list(?PORT),
+	    ?line ok = osrun("sh -c 'ulimit -n 24; exec " ++ Args ++ "'"),
+	    ?line Conn = register_many(1, ?REG_REPEAT_LIM, "foo"),
+	    ?line Pid = string:strip(os:cmd("pgrep -f -x '" ++ Args ++ "'"),
+				     right, $\n),
+	    ?line T0 = cpu_ticks(Pid),
+	    sleep(2000),
+	    ?line T1 = cpu_ticks(Pid),
+	    test_server:format("~w names, ~w ticks in 2 s~n",
+			       [length(Conn), T1 - T0]),
+	    ?line true = T1 - T0 < 50,
+	    %% The last, timed out, attempt is first in the backlog
+	    %% and gets the first slot that frees up
+	    [{_,_,Sock1},{_,_,Sock2}|Conn1] = Conn,
+	    ?line ok = close(Sock1),
+	    ?line ok = close(Sock2),
+	    sleep(?MEDIUM_PAUSE),
+	    ?line {ok,Sock} = register_node("again"),
+	    ?line ok = unregister_many([{"again",?DUMMY_PORT,Sock}|Conn1]),
+	    ok;
+	_ ->
+	    {skipped, "Needs Linux and epmd in path"}
+    end.
+
+cpu_ticks(Pid) ->
+    %% Size of /proc files is 0, so file:read_file/1 won't do
+    {ok, F} = file:open("/proc/" ++ Pid ++ "/stat", [read]),
+    {ok, Stat} = file:read(F, 1024),
+    ok = file:close(F),
+    [_, Rest] = string:tokens(Stat, ")"),
+    Fields = string:tokens(Rest, " "),
+    list_to_integer(lists:nth(12, Fields)) +
+	list_to_integer(lists:nth(13, Fields)).
+
 register_repeat(Count) ->
     Conn = register_many(1, ?REG_REPEAT_LIM, "foo"),
     ok = unregister_many(Conn),
@@ -511,6 +555,40 @@ rregister_repeat(Count) ->
 	    error
     end.
 
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+
+register_lookup_many(doc) ->
+    ["Register up to 10000 names, look each one up and report the time"];
+register_lookup_many(suite) ->
+    [];
+register_lookup_many(Config) when is_list(Config) ->
+    Dog = ?config(watchdog, Config),
+    test_server:timetrap_cancel(Dog),
+    LongDog = test_server:timetrap(?LONG_TEST_TIMEOUT),
+    ?line ok = epmdrun(),
+    ?line {RegTime,Conn} =
+	timer:tc(fun() -> register_many(1, ?MANY_NAMES, "bench") end),
+    Count = length(Conn),
+    ?line true = Count > 0,
+    ?line {LookupTime,ok} = timer:tc(fun() -> lookup_many(Conn) end),
+    ?line ok = unregister_many(Conn),
+    test_server:timetrap_cancel(LongDog),
+    Comment = io_lib:format("~w names; register ~w us/name, lookup ~w us/name",
+			    [Count, RegTime div Count, LookupTime div Count]),
+    test_server:format("~s~n", [Comment]),
+    {comment, lists:flatten(Comment)}.
+
+lookup_many([]) ->
+    ok;
+lookup_many([{Name,Port,_Sock} | Conn]) ->
+    case port_please_v2(Name) of
+	{ok,#node_info{port=Port,node_name=Name}} ->
+	    lookup_many(Conn);
+	Any ->
+	    test_server:format("Lookup of ~s failed: ~p~n", [Name,Any]),
+	    error
+    end.
+
 % Return count of successful registrations
 
 register_many(I, N, _Prefix) when I > N ->
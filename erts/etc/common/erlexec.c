@@ -125,6 +125,7 @@ static char *pluss_val_switches[] = {
     "ct",
     "wt",
     "ss",
+    "pp",
     NULL
 };
 /* +h arguments with values */
@@ -144,6 +145,7 @@ static char *plusr_val_switches[] = {
 /* +z arguments with values */
 static char *plusz_val_switches[] = {
     "dbbl",
+    "dct",
     NULL
 };
 
@@ -31,7 +31,8 @@
 -export([suspend_process/1]).
 -export([min/2, max/2]).
 -export([dlink/1, dunlink/1, dsend/2, dsend/3, dgroup_leader/2,
-	 dexit/2, dmonitor_node/3, dmonitor_p/2]).
+	 dexit/2, dmonitor_node/3, dmonitor_p/2,
+	 dsend_multi/2, dsend_multi/3]).
 -export([delay_trap/2]).
 -export([set_cookie/2, get_cookie/0]).
 -export([nodes/0]).
@@ -487,6 +488,30 @@ dsend({Name, Node}, Msg, Opts) ->
 	ignored -> ok				% Not distributed.
     end.
 
+%% erlang:send_multi/2,3 traps here with the destinations on nodes
+%% that are not connected. They are grouped by node.
+dsend_multi(Pids, Msg) ->
+    {Up, _Down} = dconnect_multi(Pids, [], [], []),
+    erlang:send_multi(Up, Msg).
+
+dsend_multi(Pids, Msg, Opts) ->
+    {Up, Down} = dconnect_multi(Pids, [], [], []),
+    Down ++ erlang:send_multi(Up, Msg, Opts).
+
+dconnect_multi([Pid|Pids], Known, Up, Down) ->
+    Node = node(Pid),
+    case Known of
+	{Node, true} ->
+	    dconnect_multi(Pids, Known, [Pid|Up], Down);
+	{Node, false} ->
+	    dconnect_multi(Pids, Known, Up, [Pid|Down]);
+	_ ->
+	    Res = net_kernel:connect(Node) =:= true,
+	    dconnect_multi([Pid|Pids], {Node, Res}, Up, Down)
+    end;
+dconnect_multi([], _Known, Up, Down) ->
+    {Up, Down}.
+
 -spec dmonitor_p('process', pid() | {atom(),atom()}) -> reference().
 dmonitor_p(process, ProcSpec) ->
     %% ProcSpec = pid() | {atom(),atom()}
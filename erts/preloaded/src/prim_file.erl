@@ -27,11 +27,11 @@
 %% Generic file contents operations
 -export([open/2, close/1, datasync/1, sync/1, advise/4, position/2, truncate/1,
 	 write/2, pwrite/2, pwrite/3, read/2, read_line/1, pread/2, pread/3,
-	 copy/3, sendfile/10]).
+	 pread_batch/2, copy/3, sendfile/10]).
 
 %% Specialized file operations
 -export([open/1, open/3]).
--export([read_file/1, read_file/2, write_file/2]).
+-export([read_file/1, read_file/2, read_file/3, write_file/2]).
 -export([ipread_s32bu_p32bu/3]).
 
 
@@ -52,7 +52,8 @@
 	 make_symlink/2, make_symlink/3,
 	 read_link/1, read_link/2,
 	 read_link_info/1, read_link_info/2, read_link_info/3,
-	 list_dir/1, list_dir/2]).
+	 list_dir/1, list_dir/2,
+	 list_dir_info/1, list_dir_info/2, list_dir_info/3]).
 %% How to start and stop the ?DRV port.
 -export([start/0, stop/1]).
 
@@ -100,6 +101,8 @@
 -define(FILE_FDATASYNC,        30).
 -define(FILE_ADVISE,           31).
 -define(FILE_SENDFILE,         32).
+-define(FILE_READ_FILE_MMAP,   33).
+-define(FILE_READDIR_INFO,     34).
 
 %% Driver responses
 -define(FILE_RESP_OK,          0).
@@ -114,6 +117,7 @@
 -define(FILE_RESP_FNAME,       9).
 -define(FILE_RESP_ALL_DATA,   10).
 -define(FILE_RESP_LFNAME,     11).
+-define(FILE_RESP_LFINFO,     12).
 
 %% Open modes for the driver's open function.
 -define(EFILE_MODE_READ,       1).
@@ -138,6 +142,9 @@
 %% IPREAD variants
 -define(IPREAD_S32BU_P32BU, 0).
 
+%% PREADV flags
+-define(FILE_PREADV_BATCH, 1).
+
 %% POSIX file advises
 -define(POSIX_FADV_NORMAL,     0).
 -define(POSIX_FADV_RANDOM,     1).
@@ -397,22 +404,29 @@ read(#file_descriptor{module = ?MODULE, data = {Port, _}}, Size)
 %% Returns {ok, [Data|eof, ...]} | {error, Reason}
 pread(#file_descriptor{module = ?MODULE, data = {Port, _}}, L)
   when is_list(L) ->
-    pread_int(Port, L, 0, []).
+    pread_int(Port, L, 0, 0, []).
+
+%% As pread/2, but the driver reads overlapping and adjacent ranges
+%% together, and all Data are parts of one binary.
+pread_batch(#file_descriptor{module = ?MODULE, data = {Port, _}}, L)
+  when is_list(L) ->
+    pread_int(Port, L, ?FILE_PREADV_BATCH, 0, []).
 
-pread_int(_, [], 0, []) ->
+pread_int(_, [], _Flags, 0, []) ->
     {ok, []};
-pread_int(Port, [], N, Spec) ->
-    drv_command(Port, [<<?FILE_PREADV, 0:32, N:32>> | reverse(Spec)]);
-pread_int(Port, [{Offs, Size} | T], N, Spec)
+pread_int(Port, [], Flags, N, Spec) ->
+    drv_command(Port, [<<?FILE_PREADV, Flags:32, N:32>> | reverse(Spec)]);
+pread_int(Port, [{Offs, Size} | T], Flags, N, Spec)
   when is_integer(Offs), is_integer(Size), 0 =< Size ->
     if
 	-(?LARGEFILESIZE) =< Offs, Offs < ?LARGEFILESIZE,
 	Size < ?LARGEFILESIZE ->
-	    pread_int(Port, T, N+1, [<<Offs:64/signed, Size:64>> | Spec]);
+	    pread_int(Port, T, Flags, N+1,
+		      [<<Offs:64/signed, Size:64>> | Spec]);
 	true ->
 	    {error, einval}
     end;
-pread_int(_, [_|_], _N, _Spec) ->
+pread_int(_, [_|_], _Flags, _N, _Spec) ->
     {error, badarg}.
 
 
@@ -510,7 +524,42 @@ read_file(_) ->
 %% Takes a Port opened with open/1.
 read_file(Port, File) when is_port(Port),
 			   (is_list(File) orelse is_binary(File)) ->
-    Cmd = [?FILE_READ_FILE | pathname(File)],
+    read_file_int(Port, ?FILE_READ_FILE, File);
+read_file(File, Opts) when (is_list(File) orelse is_binary(File)),
+			   is_list(Opts) ->
+    case drv_open(?FD_DRV, [binary]) of
+	{ok, Port} ->
+	    Result = read_file(Port, File, Opts),
+	    close(Port),
+	    Result;
+	{error, _} = Error ->
+	    Error
+    end;
+read_file(_,_) ->
+    {error, badarg}.
+
+%% Takes a Port opened with open/1 and a list of options.
+read_file(Port, File, Opts) when is_port(Port),
+				 (is_list(File) orelse is_binary(File)),
+				 is_list(Opts) ->
+    case read_file_opts(Opts, ?FILE_READ_FILE) of
+	{ok, Command} ->
+	    read_file_int(Port, Command, File);
+	Error ->
+	    Error
+    end;
+read_file(_,_,_) ->
+    {error, badarg}.
+
+read_file_opts([], Command) ->
+    {ok, Command};
+read_file_opts([mmap | Opts], _) ->
+    read_file_opts(Opts, ?FILE_READ_FILE_MMAP);
+read_file_opts(_, _) ->
+    {error, badarg}.
+
+read_file_int(Port, Command, File) ->
+    Cmd = [Command | pathname(File)],
     case drv_command(Port, Cmd) of
 	{error, enomem} ->
 	    %% It could possibly help to do a 
@@ -521,9 +570,7 @@ read_file(Port, File) when is_port(Port),
 	    drv_command(Port, Cmd);
 	Result ->
 	    Result
-    end;
-read_file(_,_) ->
-    {error, badarg}.
+    end.
 
     
 
@@ -899,6 +946,41 @@ list_dir(Port, Dir) when is_port(Port) ->
 list_dir_int(Port, Dir) ->
     drv_command(Port, [?FILE_READDIR, pathname(Dir)], []).
 
+%% list_dir_info/{1,2,3}
+
+list_dir_info(Dir) ->
+    list_dir_info_int({?DRV, [binary]}, Dir, []).
+
+list_dir_info(Port, Dir) when is_port(Port) ->
+    list_dir_info_int(Port, Dir, []);
+list_dir_info(Dir, Opts) ->
+    list_dir_info_int({?DRV, [binary]}, Dir, Opts).
+
+list_dir_info(Port, Dir, Opts) when is_port(Port) ->
+    list_dir_info_int(Port, Dir, Opts).
+
+list_dir_info_int(Port, Dir, Opts) ->
+    try
+	TimeType = plgv(time, Opts, local),
+	Depth = case plgv(depth, Opts, 0) of
+		    infinity -> -1;
+		    D when is_integer(D), D >= 0, D < (1 bsl 31) -> D
+		end,
+	case drv_command(Port, [?FILE_READDIR_INFO, <<Depth:32>>,
+				pathname(Dir)], []) of
+	    {ok, Entries} ->
+		{ok, [{Name, FI#file_info{
+			       ctime = from_seconds(FI#file_info.ctime, TimeType),
+			       mtime = from_seconds(FI#file_info.mtime, TimeType),
+			       atime = from_seconds(FI#file_info.atime, TimeType)
+			      }} || {Name, FI} <- Entries]};
+	    Error ->
+		Error
+	end
+    catch
+	error:_ -> {error, badarg}
+    end.
+
 
 
 %%%-----------------------------------------------------------------
@@ -1182,9 +1264,34 @@ translate_response(?FILE_RESP_LFNAME, Data) ->
     {append, transform_lfname(Data)};
 translate_response(?FILE_RESP_ALL_DATA, Data) ->
     {ok, Data};
+translate_response(?FILE_RESP_LFINFO, []) ->
+    ok;
+translate_response(?FILE_RESP_LFINFO, Data) when is_binary(Data) ->
+    {append, transform_lfinfo(Data)};
+translate_response(?FILE_RESP_LFINFO, Data) ->
+    {append, transform_lfinfo(list_to_binary(Data))};
 translate_response(X, Data) ->
     {error, {bad_response_from_port, [X | Data]}}.
 
+transform_info(<<Size:64, Type:32,
+		 Atime:64/signed, Mtime:64/signed, Ctime:64/signed,
+		 Mode:32, Links:32, Major:32, Minor:32,
+		 Inode:32, Uid:32, Gid:32, Access:32>>) ->
+    #file_info {
+		size   = Size,
+		type   = file_type(Type),
+		access = file_access(Access),
+		atime  = Atime,
+		mtime  = Mtime,
+		ctime  = Ctime,
+		mode   = Mode,
+		links  = Links,
+		major_device = Major,
+		minor_device = Minor,
+		inode = Inode,
+		uid   = Uid,
+		gid   = Gid
+	    };
 transform_info([
     Hsize1, Hsize2, Hsize3, Hsize4, 
     Lsize1, Lsize2, Lsize3, Lsize4,
@@ -1295,6 +1402,12 @@ transform_ldata(0, List, [Size | Sizes], R) ->
     {Front, Rear} = lists_split(List, Size),
     transform_ldata(0, Rear, Sizes, [Front | R]).
 
+%% Each entry is followed by 68 bytes of file information
+transform_lfinfo(<<>>) -> [];
+transform_lfinfo(<<L:16, Name:L/binary, Info:68/binary, Rest/binary>>) ->
+    [{prim_file:internal_native2name(Name), transform_info(Info)}
+     | transform_lfinfo(Rest)].
+
 transform_lfname(<<>>) -> [];
 transform_lfname(<<L:16, Name:L/binary, Names/binary>>) -> 
     [ prim_file:internal_native2name(Name) | transform_lfname(Names)];
@@ -30,9 +30,10 @@
 -export([connect/3, connect/4, async_connect/4]).
 -export([accept/1, accept/2, async_accept/2]).
 -export([shutdown/2]).
--export([send/2, send/3, sendto/4, sendmsg/3]).
+-export([send/2, send/3, sendto/4, sendto_multi/2, sendmsg/3]).
 -export([recv/2, recv/3, async_recv/3]).
 -export([unrecv/2]).
+-export([tls_offload/3, splice/3, take_input/2]).
 -export([recvfrom/2, recvfrom/3]).
 -export([setopt/3, setopts/2, getopt/2, getopts/2, is_sockopt_val/2]).
 -export([chgopt/3, chgopts/2]).
@@ -118,12 +119,15 @@ shutdown(S, read_write) when is_port(S) ->
     shutdown_1(S, 2).
 
 shutdown_1(S, How) ->
+    wait_empty_out_q(S),
+    shutdown_2(S, How).
+
+wait_empty_out_q(S) ->
     case subscribe(S, [subs_empty_out_q]) of
 	{ok,[{subs_empty_out_q,N}]} when N > 0 ->
 	    shutdown_pend_loop(S, N);   %% wait for pending output to be sent
 	_Other -> ok
-    end,
-    shutdown_2(S, How).
+    end.
 
 shutdown_2(S, How) ->
     case ctl_cmd(S, ?TCP_REQ_SHUTDOWN, [How]) of
@@ -296,7 +300,9 @@ accept0(L, Time) when is_port(L), is_integer(Time) ->
 
 %% setup options from listen socket on the connected socket
 accept_opts(L, S) ->
-    case getopts(L, [active, nodelay, keepalive, delay_send, priority, tos]) of
+    case getopts(L, [active, nodelay, keepalive, delay_send,
+		      delay_send_bytes, delay_send_time, adaptive_buffer,
+		      latency_stats, priority, tos]) of
 	{ok, Opts} ->
 	    case setopts(S, Opts) of
 		ok -> {ok, S};
@@ -407,6 +413,32 @@ sendto(S, IP, Port, Data) when is_port(S), Port >= 0, Port =< 65535 ->
 	     {error,einval}
     end.
 
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%%
+%% SENDTO_MULTI(insock(), [{IP, Port, Data}]) -> ok | {error, Reason}
+%%
+%% send a number of Datagrams with one request (UDP only)
+%%
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%% As for "sendto", IP and Port are ignored if the socket is connected.
+
+sendto_multi(S, Dgrams) when is_port(S) ->
+    ?DBG_FORMAT("prim_inet:sendto_multi(~p, ~p)~n", [S,Dgrams]),
+    try enc_dgrams(Dgrams) of
+	Buf ->
+	    case ctl_cmd(S, ?UDP_REQ_SENDMULTI, Buf) of
+		{ok, _} -> ok;
+		Error -> Error
+	    end
+    catch
+	error:_ -> {error,einval}
+    end.
+
+enc_dgrams([{IP,Port,Data}|Dgrams]) when Port >= 0, Port =< 65535 ->
+    [[?int32(iolist_size(Data)),?int16(Port),ip_to_bytes(IP),Data]
+     |enc_dgrams(Dgrams)];
+enc_dgrams([]) -> [].
+
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %%
 %% SENDMSG(insock(), IP, Port, InitMsg, Data)   or
@@ -845,12 +877,13 @@ getfd(S) when is_port(S) ->
 %%
 %% IGNOREFD(insock(),boolean()) -> {ok,integer()} | {error, Reason}
 %%
-%% steal internal file descriptor
+%% steal internal file descriptor; output already queued on the socket
+%% goes out first so that it is not overtaken by the new writer
 %%
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
 ignorefd(S,Bool) when is_port(S) ->
-    Val = if Bool -> 1; true -> 0 end,
+    Val = if Bool -> wait_empty_out_q(S), 1; true -> 0 end,
     case ctl_cmd(S, ?INET_REQ_IGNOREFD, [Val]) of
 	{ok, _} -> ok;
 	Error -> Error
@@ -1006,6 +1039,103 @@ unrecv(S, Data) ->
 	{error,_}=Error  -> Error
     end.
 
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%%
+%% SPLICE(insock(), Fd, Bytes) -> {ok, Sent} | {error, Reason}
+%%
+%%   Copy Bytes (0 = until end of stream) from the socket Fd, which
+%%   its own port must be ignoring, to insock() inside the kernel.
+%%
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+
+splice(S, Fd, Bytes) when is_port(S), is_integer(Fd), Fd >= 0,
+			  is_integer(Bytes), Bytes >= 0 ->
+    wait_empty_out_q(S),
+    case ctl_cmd(S, ?TCP_REQ_SPLICE, <<Fd:32,Bytes:64>>) of
+	{ok,[R1,R0]} ->
+	    Ref = ?u16(R1,R0),
+	    receive
+		{inet_async, S, Ref, Status} -> Status;
+		{'EXIT', S, _Reason} ->
+		    {error, closed}
+	    end;
+	{error, ebusy} -> %% someone sent after the queue drained
+	    splice(S, Fd, Bytes);
+	{error,_}=Error -> Error
+    end.
+
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%%
+%% TAKE_INPUT(insock(), Max) -> {ok, Bin} | {error, Reason}
+%%
+%%   Remove and return up to Max bytes (0 = all) that the port has
+%%   read from the socket but not delivered yet.
+%%
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+
+take_input(S, Max) when is_port(S), is_integer(Max), Max >= 0 ->
+    case ctl_cmd(S, ?TCP_REQ_TAKE_INPUT, <<Max:64>>) of
+	{ok, Data} -> {ok, list_to_binary(Data)};
+	{error,_}=Error -> Error
+    end.
+
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%%
+%% TLS_OFFLOAD(insock(), tx | rx, [Param]) -> ok | {error, Reason}
+%%
+%%   Hand the TLS record layer of an established connection to the
+%%   kernel. Param is one of {version,V}, {cipher,C}, {key,Bin},
+%%   {salt,Bin4}, {iv,Bin8} and {seq,Int}.
+%%
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+
+tls_offload(S, Dir, Params) when is_port(S), is_list(Params) ->
+    try enc_tls_offload(Dir, Params) of
+	Data ->
+	    case ctl_cmd(S, ?TCP_REQ_TLS_OFFLOAD, Data) of
+		{ok, _} -> ok;
+		{error,_}=Error -> Error
+	    end
+    catch
+	error:_ -> {error,einval}
+    end.
+
+enc_tls_offload(Dir, Params) ->
+    D = case Dir of
+	    tx -> ?TCP_TLS_TX;
+	    rx -> ?TCP_TLS_RX
+	end,
+    {V,C,Key,Salt,IV,Seq} =
+	tls_offload_params(Params, {16#0303,?TCP_TLS_AES_128_GCM,
+				    undefined,undefined,undefined,0}),
+    KeyLen = case C of
+		 ?TCP_TLS_AES_128_GCM -> 16;
+		 ?TCP_TLS_AES_256_GCM -> 32
+	     end,
+    KeyLen = byte_size(Key),
+    4 = byte_size(Salt),
+    8 = byte_size(IV),
+    [D,?int16(V),C,<<Seq:64>>,Salt,IV,Key].
+
+tls_offload_params([], Acc) -> Acc;
+tls_offload_params([{version,'tlsv1.2'}|Ps], Acc) ->
+    tls_offload_params(Ps, setelement(1, Acc, 16#0303));
+tls_offload_params([{version,'tlsv1.3'}|Ps], Acc) ->
+    tls_offload_params(Ps, setelement(1, Acc, 16#0304));
+tls_offload_params([{cipher,aes_128_gcm}|Ps], Acc) ->
+    tls_offload_params(Ps, setelement(2, Acc, ?TCP_TLS_AES_128_GCM));
+tls_offload_params([{cipher,aes_256_gcm}|Ps], Acc) ->
+    tls_offload_params(Ps, setelement(2, Acc, ?TCP_TLS_AES_256_GCM));
+tls_offload_params([{key,Key}|Ps], Acc) when is_binary(Key) ->
+    tls_offload_params(Ps, setelement(3, Acc, Key));
+tls_offload_params([{salt,Salt}|Ps], Acc) when is_binary(Salt) ->
+    tls_offload_params(Ps, setelement(4, Acc, Salt));
+tls_offload_params([{iv,IV}|Ps], Acc) when is_binary(IV) ->
+    tls_offload_params(Ps, setelement(5, Acc, IV));
+tls_offload_params([{seq,Seq}|Ps], Acc)
+  when is_integer(Seq), Seq >= 0, Seq < 16#10000000000000000 ->
+    tls_offload_params(Ps, setelement(6, Acc, Seq)).
+
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %%
 %% DETACH(insock()) -> ok
@@ -1046,6 +1176,7 @@ is_sockopt_val(Opt, Val) ->
 %% Socket options processing: Encoding option NAMES:
 %%
 enc_opt(reuseaddr)       -> ?INET_OPT_REUSEADDR;
+enc_opt(reuseport)       -> ?INET_OPT_REUSEPORT;
 enc_opt(keepalive)       -> ?INET_OPT_KEEPALIVE;
 enc_opt(dontroute)       -> ?INET_OPT_DONTROUTE;
 enc_opt(linger)          -> ?INET_OPT_LINGER;
@@ -1072,9 +1203,15 @@ enc_opt(low_watermark)   -> ?INET_LOPT_TCP_LOWTRMRK;
 enc_opt(bit8)            -> ?INET_LOPT_BIT8;
 enc_opt(send_timeout)    -> ?INET_LOPT_TCP_SEND_TIMEOUT;
 enc_opt(send_timeout_close) -> ?INET_LOPT_TCP_SEND_TIMEOUT_CLOSE;
+enc_opt(multi_accept)    -> ?INET_LOPT_TCP_MULTI_ACCEPT;
 enc_opt(delay_send)      -> ?INET_LOPT_TCP_DELAY_SEND;
+enc_opt(delay_send_bytes) -> ?INET_LOPT_TCP_DELAY_SEND_BYTES;
+enc_opt(delay_send_time) -> ?INET_LOPT_TCP_DELAY_SEND_TIME;
+enc_opt(adaptive_buffer) -> ?INET_LOPT_TCP_ADAPTIVE_BUFFER;
+enc_opt(latency_stats)   -> ?INET_LOPT_TCP_LATENCY_STATS;
 enc_opt(packet_size)     -> ?INET_LOPT_PACKET_SIZE;
 enc_opt(read_packets)    -> ?INET_LOPT_READ_PACKETS;
+enc_opt(recv_batch)      -> ?INET_LOPT_UDP_RECV_BATCH;
 enc_opt(raw)             -> ?INET_OPT_RAW;
 % Names of SCTP opts:
 enc_opt(sctp_rtoinfo)	 	   -> ?SCTP_OPT_RTOINFO;
@@ -1100,6 +1237,7 @@ enc_opt(sctp_get_peer_addr_info)   -> ?SCTP_OPT_GET_PEER_ADDR_INFO.
 %% Decoding option NAMES:
 %%
 dec_opt(?INET_OPT_REUSEADDR)      -> reuseaddr;
+dec_opt(?INET_OPT_REUSEPORT)      -> reuseport;
 dec_opt(?INET_OPT_KEEPALIVE)      -> keepalive;
 dec_opt(?INET_OPT_DONTROUTE)      -> dontroute;
 dec_opt(?INET_OPT_LINGER)         -> linger;
@@ -1126,9 +1264,15 @@ dec_opt(?INET_LOPT_TCP_LOWTRMRK)  -> low_watermark;
 dec_opt(?INET_LOPT_BIT8)          -> bit8;
 dec_opt(?INET_LOPT_TCP_SEND_TIMEOUT) -> send_timeout;
 dec_opt(?INET_LOPT_TCP_SEND_TIMEOUT_CLOSE) -> send_timeout_close;
+dec_opt(?INET_LOPT_TCP_MULTI_ACCEPT) -> multi_accept;
 dec_opt(?INET_LOPT_TCP_DELAY_SEND)   -> delay_send;
+dec_opt(?INET_LOPT_TCP_DELAY_SEND_BYTES) -> delay_send_bytes;
+dec_opt(?INET_LOPT_TCP_DELAY_SEND_TIME) -> delay_send_time;
+dec_opt(?INET_LOPT_TCP_ADAPTIVE_BUFFER) -> adaptive_buffer;
+dec_opt(?INET_LOPT_TCP_LATENCY_STATS)   -> latency_stats;
 dec_opt(?INET_LOPT_PACKET_SIZE)      -> packet_size;
 dec_opt(?INET_LOPT_READ_PACKETS)     -> read_packets;
+dec_opt(?INET_LOPT_UDP_RECV_BATCH)   -> recv_batch;
 dec_opt(?INET_OPT_RAW)              -> raw;
 dec_opt(I) when is_integer(I)     -> undefined.
 
@@ -1169,6 +1313,7 @@ type_opt(_,   Opt) ->
 %% Types of option values, by option name:
 %%
 type_opt_1(reuseaddr)       -> bool;
+type_opt_1(reuseport)       -> bool;
 type_opt_1(keepalive)       -> bool;
 type_opt_1(dontroute)       -> bool;
 type_opt_1(linger)          -> {bool,int};
@@ -1196,6 +1341,9 @@ type_opt_1(packet) ->
 	   {1, ?TCP_PB_1},
 	   {2, ?TCP_PB_2},
 	   {4, ?TCP_PB_4},
+	   {{2,little}, ?TCP_PB_2_LITTLE},
+	   {{4,little}, ?TCP_PB_4_LITTLE},
+	   {varint, ?TCP_PB_VARINT},
 	   {raw,?TCP_PB_RAW},
 	   {sunrm, ?TCP_PB_RM},
 	   {asn1, ?TCP_PB_ASN1},
@@ -1225,9 +1373,15 @@ type_opt_1(bit8) ->
 	   {off,   ?INET_BIT8_OFF}]};
 type_opt_1(send_timeout)    -> time;
 type_opt_1(send_timeout_close) -> bool;
+type_opt_1(multi_accept)    -> uint;
 type_opt_1(delay_send)      -> bool;
+type_opt_1(delay_send_bytes) -> uint;
+type_opt_1(delay_send_time) -> uint;
+type_opt_1(adaptive_buffer) -> bool;
+type_opt_1(latency_stats)   -> bool;
 type_opt_1(packet_size)     -> uint;
 type_opt_1(read_packets)    -> uint;
+type_opt_1(recv_batch)      -> uint;
 %% 
 %% SCTP options (to be set). If the type is a record type, the corresponding
 %% record signature is returned, otherwise, an "elementary" type tag 
@@ -1375,6 +1529,8 @@ type_value_1(Q, {record,Types}, undefined) ->
 type_value_1(Q, {record,Types}, Values)
   when tuple_size(Types) =:= tuple_size(Values) ->
     type_value_record(Q, Types, Values, 2);
+type_value_1(_, {enum,_}=Type, Value) ->    % Enum values may be tuples
+    type_value_2(Type, Value);
 type_value_1(Q, Types, Values)
   when tuple_size(Types) =:= tuple_size(Values) ->
     type_value_tuple(Q, Types, Values, 1);
@@ -1499,6 +1655,8 @@ enc_value_1(Q, {record,Types}, undefined) ->
 enc_value_1(Q, {record,Types}, Values)
   when tuple_size(Types) =:= tuple_size(Values) ->
     enc_value_tuple(Q, Types, Values, 2);
+enc_value_1(_, {enum,_}=Type, Value) ->     % Enum values may be tuples
+    enc_value_2(Type, Value);
 enc_value_1(Q, Types, Values) when tuple_size(Types) =:= tuple_size(Values) ->
     enc_value_tuple(Q, Types, Values, 1);
 enc_value_1(_, Type, Value) ->
@@ -1965,6 +2123,9 @@ enc_stats([H|T]) ->
 	send_pend -> [?INET_STAT_SEND_PEND|enc_stats(T)];
 	send_oct  -> [?INET_STAT_SEND_OCT |enc_stats(T)];
 	recv_oct  -> [?INET_STAT_RECV_OCT |enc_stats(T)];
+	send_dwell   -> [?INET_STAT_SEND_DWELL|enc_stats(T)];
+	recv_latency -> [?INET_STAT_RECV_LAT  |enc_stats(T)];
+	busy_time    -> [?INET_STAT_BUSY_TIME |enc_stats(T)];
 	_ -> throw(einval)
     end;
 enc_stats([]) -> [].
@@ -1984,6 +2145,16 @@ dec_stats([?INET_STAT_SEND_OCT,X7,X6,X5,X4,X3,X2,X1,X0|R]) ->
 dec_stats([?INET_STAT_RECV_OCT,X7,X6,X5,X4,X3,X2,X1,X0|R]) ->
     Val = ?u64(X7,X6,X5,X4,X3,X2,X1,X0),
     [{recv_oct, Val}|dec_stats(R)];
+dec_stats([X|R0]) when X =:= ?INET_STAT_SEND_DWELL;
+			X =:= ?INET_STAT_RECV_LAT;
+			X =:= ?INET_STAT_BUSY_TIME ->
+    {Hist,R} = dec_hist(?INET_LAT_BUCKETS, R0),
+    Name = case X of
+	       ?INET_STAT_SEND_DWELL -> send_dwell;
+	       ?INET_STAT_RECV_LAT   -> recv_latency;
+	       ?INET_STAT_BUSY_TIME  -> busy_time
+	   end,
+    [{Name,Hist}|dec_stats(R)];
 dec_stats([X,X3,X2,X1,X0|R]) ->
     Val = ?u32(X3,X2,X1,X0),
     case X of
@@ -1999,6 +2170,11 @@ dec_stats([X,X3,X2,X1,X0|R]) ->
     end;
 dec_stats([]) -> [].
 
+dec_hist(0, R) -> {[],R};
+dec_hist(N, [X3,X2,X1,X0|R0]) ->
+    {Hist,R} = dec_hist(N-1, R0),
+    {[?u32(X3,X2,X1,X0)|Hist],R}.
+
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %%
 %% handle status options
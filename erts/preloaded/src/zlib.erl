@@ -112,6 +112,9 @@
 -define(CRC32_COMBINE,   23).
 -define(ADLER32_COMBINE, 24).
 
+%% Reductions charged per chunk handed back by the driver
+-define(CHUNK_REDS, 1000).
+
 %%------------------------------------------------------------------------
 
 %% Main data types of the file
@@ -206,7 +209,7 @@ deflate(Z, Data) ->
 deflate(Z, Data, Flush) ->
     try port_command(Z, Data) of
 	true ->
-	    call(Z, ?DEFLATE, <<(arg_flush(Flush)):32>>),
+	    call_chunked(Z, ?DEFLATE, <<(arg_flush(Flush)):32>>),
 	    collect(Z)
     catch 
 	error:_Err ->
@@ -252,7 +255,7 @@ inflateReset(Z) ->
 inflate(Z, Data) ->
     try port_command(Z, Data) of
 	true -> 
-	    call(Z, ?INFLATE, <<?Z_NO_FLUSH:32>>),
+	    call_chunked(Z, ?INFLATE, <<?Z_NO_FLUSH:32>>),
 	    collect(Z)
     catch 
 	error:_Err ->
@@ -492,6 +495,19 @@ call(Z, Cmd, Arg) ->
 	    erlang:error(badarg)
     end.
 
+%% The driver deflates or inflates a bounded amount of the queued
+%% data per call and answers 'continue' until all of it is done;
+%% charge for each chunk so that a big body is spread over several
+%% time slices instead of holding up the scheduler.
+call_chunked(Z, Cmd, Arg) ->
+    case call(Z, Cmd, Arg) of
+	continue ->
+	    erlang:bump_reductions(?CHUNK_REDS),
+	    call_chunked(Z, Cmd, Arg);
+	Res ->
+	    Res
+    end.
+
 reverse(X) ->
     reverse(X, []).
 
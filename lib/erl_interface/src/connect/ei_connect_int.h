@@ -102,6 +102,8 @@ extern int h_errno;
 #define DFLAG_NEW_FUN_TAGS        0x80
 #define DFLAG_EXTENDED_PIDS_PORTS 0x100
 #define DFLAG_NEW_FLOATS          0x800
+#define DFLAG_DIST_COMPRESS       0x40000000 /* Never offered by ei */
+#define DFLAG_SEND_MULTI          0x80000000 /* Never offered by ei */
 
 ei_cnode   *ei_fd_to_cnode(int fd);
 int         ei_distversion(int fd);
@@ -5004,6 +5004,8 @@ t_inet_setoption() ->
 t_inet_setoption_packettype() ->
   t_sup([t_atom('raw'),
 	 t_integers([0,1,2,4]),
+	 t_tuple([t_integers([2,4]), t_atom('little')]),
+	 t_atom('varint'),
 	 t_atom('asn1'), t_atom('cdr'), t_atom('sunrm'),
 	 t_atom('fcgi'), t_atom('tpkt'), t_atom('line'),
 	 t_atom('http'),
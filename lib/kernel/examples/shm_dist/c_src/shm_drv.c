@@ -0,0 +1,1569 @@
+/* ``The contents of this file are subject to the Erlang Public License,
+ * Version 1.1, (the "License"); you may not use this file except in
+ * compliance with the License. You should have received a copy of the
+ * Erlang Public License along with this software. If not, it can be
+ * retrieved via the world wide web at http://www.erlang.org/.
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Initial Developer of the Original Code is Ericsson Utvecklings AB.
+ * Portions created by Ericsson are Copyright 1999, Ericsson Utvecklings
+ * AB. All Rights Reserved.''
+ *
+ *     $Id$
+ */
+
+/*
+ * Purpose: Shared memory distribution driver for nodes on the same host.
+ *
+ * Connection setup and the distribution handshake are done over a Unix
+ * domain socket, in the same way as in the uds_drv example. When the
+ * connection is made, the connecting side creates a shared memory
+ * segment holding one ring buffer per direction and two eventfds, and
+ * hands them to the accepting side over the socket (SCM_RIGHTS).
+ *
+ * Once the node is up, distribution data is copied straight into the
+ * peer's ring and the peer is woken up through its eventfd only when it
+ * is about to sleep. Received messages are passed to the emulator
+ * directly from the shared memory, so there are no socket system calls
+ * and no kernel copies on the data path. The socket is kept open only
+ * to notice when the peer goes away.
+ *
+ * Linux only (eventfd).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+
+#define HAVE_UIO_H
+#include "erl_driver.h"
+
+#define DEBUG
+/*#define HARDDEBUG 1*/
+/*
+** Some constants/macros
+*/
+
+#ifdef HARDDEBUG
+#define DEBUGF(P) debugf P
+#include <stdarg.h>
+static void debugf(char *str, ...)
+{
+    va_list ap;
+    va_start(ap,str);
+    fprintf(stderr,"Shm_drv debug: ");
+    vfprintf(stderr,str, ap);
+    fprintf(stderr,"\r\n");
+    va_end(ap);
+}
+#ifndef DEBUG
+#define DEBUG 1
+#endif
+#else
+#define DEBUGF(P)
+#endif
+
+
+#ifdef DEBUG
+#define ASSERT(X) 							\
+do {									\
+    if (!(X)) {								\
+	fprintf(stderr,"Assertion (%s) failed at line %d file %s\r\n", #X, \
+		__LINE__, __FILE__); 					\
+	exit(1);							\
+    } 									\
+} while(0)
+#define ASSERT_NONBLOCK(FD) ASSERT(fcntl((FD), F_GETFL, 0) & O_NONBLOCK)
+#else
+#define ASSERT(X)
+#define ASSERT_NONBLOCK(FD)
+#endif
+
+#define SET_NONBLOCKING(FD)			\
+     fcntl((FD), F_SETFL, 			\
+	   fcntl((FD), F_GETFL, 0) | O_NONBLOCK)
+
+#define ALLOC(X) my_malloc(X)
+#define REALLOC(P,X) my_realloc(P,X)
+#define FREE(X) driver_free(X)
+
+/* Full memory barrier, orders our ring updates against the peer's */
+#define SHM_MB() __sync_synchronize()
+
+#define CHUNK_SIZE 256
+
+#define IO_VECTOR_MAX 16
+
+#define SOCKET_PATH "/tmp/erlang_shm"
+
+#define NORMAL_READ_FAILURE -1
+#define SEVERE_READ_FAILURE -2
+#define EOF_READ_FAILURE    -3
+
+#define HEADER_LENGTH 4
+
+/*
+** Shared memory layout
+*/
+
+#define SHM_MAGIC 0x45534d31	/* "ESM1" */
+
+/* Size of each ring, must be a power of two */
+#define RING_SIZE (1 << 20)
+
+/* Messages larger than this are split into several records, so that
+   a record always fits even when the ring has to wrap */
+#define MAX_RECORD (RING_SIZE / 4)
+
+#define REC_HEADER 8
+#define REC_ALIGN(N) (((N) + 7) & ~7)
+#define REC_MORE 1		/* More fragments of this message follow */
+#define REC_WRAP 2		/* Skip to the start of the ring */
+
+/* Max records handled per ready_input, to let other ports run */
+#define MAX_RECORDS_PER_INPUT 256
+
+/* The port is busy when this much is queued waiting for ring space */
+#define HIGH_WATERMARK (8 * 1024 * 1024)
+#define LOW_WATERMARK (4 * 1024 * 1024)
+
+#define CACHE_LINE 64
+
+typedef unsigned char Byte;
+typedef unsigned int Word;
+
+/*
+** Each ring has one producer and one consumer. The positions are byte
+** counters that wrap around at 2^32. The fields written by the
+** producer and by the consumer are kept in separate cache lines.
+*/
+typedef struct {
+    volatile Word head;		/* Written by producer */
+    volatile Word want_space;	/* Producer waits for the consumer */
+    char pad1[CACHE_LINE - 2 * sizeof(Word)];
+    volatile Word tail;		/* Written by consumer */
+    volatile Word sleeping;	/* Consumer waits for the producer */
+    char pad2[CACHE_LINE - 2 * sizeof(Word)];
+} RingCtl;
+
+typedef struct {
+    Word magic;
+    Word ring_size;
+    char pad[CACHE_LINE - 2 * sizeof(Word)];
+    RingCtl ring[2];		/* 0: connector -> acceptor, 1: the reverse */
+} ShmHeader;
+
+#define SHM_SIZE (sizeof(ShmHeader) + 2 * RING_SIZE)
+
+/* Sent by the connecting side together with the file descriptors */
+typedef struct {
+    Word magic;
+    Word ring_size;
+} ShmHello;
+
+/*
+** Internal structures
+*/
+
+typedef enum {
+    portTypeUnknown,      /* An uninitialized port */
+    portTypeListener,     /* A listening port/socket */
+    portTypeAcceptor,     /* An intermediate stage when accepting
+			     on a listen port */
+    portTypeConnector,    /* An intermediate stage when connecting */
+    portTypeShmWait,      /* Accepted, waiting for the shared memory */
+    portTypeCommand,      /* A connected open port in command mode */
+    portTypeIntermediate, /* A connected open port in special half
+			     active mode */
+    portTypeData          /* A connectec open port in data mode */
+} PortType;
+
+typedef struct shm_data {
+    int fd;                   /* File descriptor of socket */
+    int listen_fd;            /* Acceptor's own copy of listen socket */
+    ErlDrvPort port;          /* The port identifier */
+    PortType type;            /* Type of port */
+    char *name;               /* Short name of socket for unlink */
+    Word sent;                /* Bytes sent */
+    Word received;            /* Bytes received */
+    struct shm_data *next;    /* Next structure in list */
+
+    /* The input buffer and it's data (command mode) */
+    int buffer_size;          /* The allocated size of the input buffer */
+    int buffer_pos;           /* Current position in input buffer */
+    int header_pos;           /* Where the current header is in the
+				 input buffer */
+    Byte *buffer;             /* The actual input buffer */
+
+    /* Shared memory (intermediate and data mode) */
+    int efd;                  /* Our eventfd, written by the peer */
+    int peer_efd;             /* The peer's eventfd */
+    ShmHeader *shm;
+    RingCtl *tx;
+    RingCtl *rx;
+    Byte *tx_buf;
+    Byte *rx_buf;
+    int busy;                 /* We have called set_busy_port() */
+    int tx_in_msg;            /* The queue starts in the middle of a
+				 message, i.e. without a header */
+    Word tx_msg_left;         /* Bytes left of that message */
+    Byte *frag;               /* Reassembly of fragmented message */
+    Word frag_size;
+    Word frag_len;
+} ShmData;
+
+/*
+** Interface routines
+*/
+static ErlDrvData shm_start(ErlDrvPort port, char *buff);
+static void shm_stop(ErlDrvData handle);
+static void shm_command(ErlDrvData handle, char *buff, ErlDrvSizeT bufflen);
+static void shm_commandv(ErlDrvData handle, ErlIOVec *ev);
+static void shm_input(ErlDrvData handle, ErlDrvEvent event);
+static void shm_output(ErlDrvData handle, ErlDrvEvent event);
+static void shm_finish(void);
+static ErlDrvSSizeT shm_control(ErlDrvData handle, unsigned int command,
+				char* buf, ErlDrvSizeT count, char** res,
+				ErlDrvSizeT res_size);
+static void shm_stop_select(ErlDrvEvent event, void*);
+
+/*
+** Local helpers forward declarations
+*/
+
+static void shm_command_listen(ShmData *ud, char *buff, int bufflen);
+static void shm_command_accept(ShmData *ud, char *buff, int bufflen);
+static void shm_command_connect(ShmData *ud, char *buff, int bufflen);
+
+static void do_stop(ShmData *ud);
+static void do_send(ShmData *ud, char *buff, int bufflen);
+static void do_recv(ShmData *ud);
+static void do_accept(ShmData *ud);
+static void check_eof(ShmData *ud);
+
+static int shm_create(ShmData *ud);
+static int shm_attach(ShmData *ud);
+static void shm_init_rings(ShmData *ud, int side);
+static void shm_send(ShmData *ud, SysIOVec *iov, int vlen, Word size);
+static void shm_flush_queue(ShmData *ud);
+static void shm_drain(ShmData *ud);
+static int ring_put(ShmData *ud, SysIOVec *iov, int vlen, Word len,
+		    Word flags);
+static void signal_efd(int efd);
+
+static int report_control_error(char **buffer, int buff_len,
+				char *error_message);
+static int  send_out_queue(ShmData *ud);
+static int buffered_read_package(ShmData *ud, char **result);
+static int read_at_least(ShmData *ud, int num);
+static Word get_packet_length(char *b);
+static void put_packet_length(char *b, Word len);
+static void *my_malloc(size_t size);
+static void *my_realloc(void *optr, size_t size);
+static int ensure_dir(char *path);
+static void do_unlink(char *name);
+
+/*
+** Global data
+*/
+
+/* The driver entry */
+ErlDrvEntry shm_driver_entry = {
+    NULL,		   /* init, N/A */
+    shm_start,             /* start, called when port is opened */
+    shm_stop,              /* stop, called when port is closed */
+    shm_command,           /* output, called when erlang has sent */
+    shm_input,             /* ready_input, called when input descriptor
+			      ready */
+    shm_output,            /* ready_output, called when output
+			      descriptor ready */
+    "shm_drv",             /* char *driver_name, the argument to open_port */
+    shm_finish,            /* finish, called when unloaded */
+    NULL,                  /* void * that is not used (BC) */
+    shm_control,           /* control, port_control callback */
+    NULL,                  /* timeout, called on timeouts */
+    shm_commandv,          /* outputv, vector output interface */
+    NULL,                  /* ready_async */
+    NULL,                  /* flush */
+    NULL,                  /* call */
+    NULL,                  /* event */
+    ERL_DRV_EXTENDED_MARKER,
+    ERL_DRV_EXTENDED_MAJOR_VERSION,
+    ERL_DRV_EXTENDED_MINOR_VERSION,
+    ERL_DRV_FLAG_USE_PORT_LOCKING|ERL_DRV_FLAG_SOFT_BUSY,
+    NULL,
+    NULL,                  /* process_exit */
+    shm_stop_select
+};
+
+/* Beginning of linked list of ports, protected by list_lock */
+static ShmData *first_data;
+static ErlDrvMutex *list_lock;
+
+/*
+**
+** Driver interface routines
+**
+*/
+
+/*
+** Driver initialization routine
+*/
+DRIVER_INIT(shm_drv)
+{
+    first_data = NULL;
+    list_lock = erl_drv_mutex_create("shm_drv_list");
+    return &shm_driver_entry;
+}
+
+/*
+** A port is opened, we need no information whatsoever about the socket
+** at this stage.
+*/
+static ErlDrvData shm_start(ErlDrvPort port, char *buff)
+{
+    ShmData *ud;
+
+    ud = ALLOC(sizeof(ShmData));
+    memset(ud, 0, sizeof(ShmData));
+    ud->fd = -1;
+    ud->listen_fd = -1;
+    ud->efd = -1;
+    ud->peer_efd = -1;
+    ud->port = port;
+    ud->type = portTypeUnknown;
+    erl_drv_mutex_lock(list_lock);
+    ud->next = first_data;
+    first_data = ud;
+    erl_drv_mutex_unlock(list_lock);
+
+    return((ErlDrvData) ud);
+}
+
+/*
+** Close the socket/port and free up
+*/
+static void shm_stop(ErlDrvData handle)
+{
+    do_stop((ShmData *) handle);
+}
+
+/*
+** Command interface, operates in two modes, Command mode and data mode.
+** Mode is shifted with the port_control function.
+** Command mode protocol:
+** 'L'<socketname>: Listen on socket.
+** 'A'<listennumber as 32 bit bigendian>: Accept from the port referenced by the
+**                                        "listennumber"
+** 'C'<socketname>: Connect to the socket named <socketname>
+** 'S'<data>: Send the data <data>
+** 'R': Receive one packet of data
+** Intermediate and data mode protocol:
+** Send anything that arrives through the shared memory.
+*/
+
+static void shm_command(ErlDrvData handle, char *buff, ErlDrvSizeT bufflen)
+{
+    ShmData *ud = (ShmData *) handle;
+
+    if (ud->type == portTypeData || ud->type == portTypeIntermediate) {
+	SysIOVec iov;
+	iov.iov_base = buff;
+	iov.iov_len = bufflen;
+	shm_send(ud, &iov, 1, bufflen);
+	return;
+    }
+    if (bufflen == 0) {
+	return;
+    }
+    switch (*buff) {
+    case 'L':
+	if (ud->type != portTypeUnknown) {
+	    driver_failure_posix(ud->port, ENOTSUP);
+	    return;
+	}
+	shm_command_listen(ud,buff,bufflen);
+	return;
+    case 'A':
+	if (ud->type != portTypeUnknown) {
+	    driver_failure_posix(ud->port, ENOTSUP);
+	    return;
+	}
+	shm_command_accept(ud,buff,bufflen);
+	return;
+    case 'C':
+	if (ud->type != portTypeUnknown) {
+	    driver_failure_posix(ud->port, ENOTSUP);
+	    return;
+	}
+	shm_command_connect(ud,buff,bufflen);
+	return;
+    case 'S':
+	if (ud->type != portTypeCommand) {
+	    driver_failure_posix(ud->port, ENOTSUP);
+	    return;
+	}
+	do_send(ud, buff + 1, bufflen - 1);
+	return;
+    case 'R':
+	if (ud->type != portTypeCommand) {
+	    driver_failure_posix(ud->port, ENOTSUP);
+	    return;
+	}
+	do_recv(ud);
+	return;
+    default:
+	ASSERT(0);
+	return;
+    }
+}
+
+/*
+** The distribution always sends through here. Data is copied from the
+** I/O vector directly into the ring.
+*/
+static void shm_commandv(ErlDrvData handle, ErlIOVec *ev)
+{
+    ShmData *ud = (ShmData *) handle;
+    char *buff;
+
+    if (ud->type == portTypeData || ud->type == portTypeIntermediate) {
+	shm_send(ud, ev->iov, ev->vsize, ev->size);
+	return;
+    }
+    buff = ALLOC(ev->size + 1);
+    driver_vec_to_buf(ev, buff, ev->size);
+    shm_command(handle, buff, ev->size);
+    FREE(buff);
+}
+
+static void shm_input(ErlDrvData handle, ErlDrvEvent event)
+{
+    ShmData *ud = (ShmData *) handle;
+    int fd = (int) (long) event;
+
+    DEBUGF(("In shm_input type = %d",ud->type));
+    if (fd == ud->efd) {
+	eventfd_t count;
+	/* Clear it before looking at the rings, so that a wakeup
+	   arriving after this is not lost */
+	(void) eventfd_read(ud->efd, &count);
+	if (ud->type == portTypeData) {
+	    shm_drain(ud);
+	}
+	if (ud->type >= portTypeIntermediate) {
+	    shm_flush_queue(ud);
+	}
+	return;
+    }
+    switch (ud->type) {
+    case portTypeAcceptor:
+	do_accept(ud);
+	return;
+    case portTypeShmWait:
+	if (shm_attach(ud) < 0) {
+	    if (errno != EAGAIN) {
+		driver_failure_posix(ud->port, errno);
+	    }
+	    return;
+	}
+	ud->type = portTypeCommand;
+	driver_select(ud->port, (ErlDrvEvent) (long) ud->fd, ERL_DRV_READ, 0);
+	driver_output(ud->port, "Aok",3);
+	return;
+    case portTypeIntermediate:
+    case portTypeData:
+	check_eof(ud);
+	return;
+    default:
+	/* OK, command port */
+	ASSERT(ud->type == portTypeCommand);
+	do_recv(ud);
+    }
+}
+
+static void shm_output(ErlDrvData handle, ErlDrvEvent event)
+{
+   ShmData *ud = (ShmData *) handle;
+   if (ud->type == portTypeConnector) {
+       ud->type = portTypeCommand;
+       driver_select(ud->port, (ErlDrvEvent) (long) ud->fd, ERL_DRV_WRITE, 0);
+       if (shm_create(ud) < 0) {
+	   driver_failure_posix(ud->port, errno);
+	   return;
+       }
+       driver_output(ud->port, "Cok",3);
+       return;
+   }
+   ASSERT(ud->type == portTypeCommand);
+   send_out_queue(ud);
+}
+
+static void shm_finish(void)
+{
+    while (first_data != NULL) {
+	do_stop(first_data);
+    }
+    erl_drv_mutex_destroy(list_lock);
+}
+
+/*
+** Protocol to control:
+** 'C': Set port in command mode.
+** 'I': Set port in intermediate mode
+** 'D': Set port in data mode
+** 'N': Get identification number for listen port
+** 'S': Get statistics
+** 'T': Send a tick message
+** Answer is one byte status (0 == ok, Other is followed by error as string)
+** followed by data if applicable
+*/
+static ErlDrvSSizeT shm_control(ErlDrvData handle, unsigned int command,
+				char* buf, ErlDrvSizeT count, char** res,
+				ErlDrvSizeT res_size)
+{
+/* Local macro to ensure large enough buffer. */
+#define ENSURE(N) 				\
+   do {						\
+       if (res_size < N) {			\
+	   *res = ALLOC(N);			\
+       }					\
+   } while(0)
+
+   ShmData *ud = (ShmData *) handle;
+
+   DEBUGF(("Control, type = %d, fd = %d, command = %c", ud->type, ud->fd,
+	   (char) command));
+   switch (command) {
+   case 'S':
+       {
+	   ENSURE(13);
+	   **res = 0;
+	   put_packet_length((*res) + 1, ud->received);
+	   put_packet_length((*res) + 5, ud->sent);
+	   put_packet_length((*res) + 9, driver_sizeq(ud->port));
+	   return 13;
+       }
+   case 'C':
+       if (ud->type < portTypeCommand) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       ud->type = portTypeCommand;
+       driver_select(ud->port, (ErlDrvEvent) (long) ud->fd, ERL_DRV_READ, 0);
+       ENSURE(1);
+       **res = 0;
+       return 1;
+   case 'I':
+       if (ud->type < portTypeCommand) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       ud->type = portTypeIntermediate;
+       driver_select(ud->port, (ErlDrvEvent) (long) ud->fd, ERL_DRV_READ, 0);
+       ENSURE(1);
+       **res = 0;
+       return 1;
+   case 'D':
+       if (ud->type < portTypeCommand) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       ud->type = portTypeData;
+       /* The socket is only watched for the peer closing it */
+       driver_select(ud->port, (ErlDrvEvent) (long) ud->fd,
+		     ERL_DRV_READ|ERL_DRV_USE, 1);
+       /* The peer may already have written to the ring */
+       shm_drain(ud);
+       ENSURE(1);
+       **res = 0;
+       return 1;
+   case 'N':
+       if (ud->type != portTypeListener) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       ENSURE(5);
+       (*res)[0] = 0;
+       put_packet_length((*res) + 1, ud->fd);
+       return 5;
+   case 'T': /* tick */
+       if (ud->type != portTypeData) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       shm_send(ud, NULL, 0, 0);
+       ENSURE(1);
+       **res = 0;
+       return 1;
+   default:
+       return report_control_error(res, res_size, "einval");
+   }
+#undef ENSURE
+}
+
+static void shm_stop_select(ErlDrvEvent event, void* _)
+{
+    close((int)(long)event);
+}
+
+/*
+**
+** Local helpers
+**
+*/
+
+/*
+** Command implementations
+*/
+static void shm_command_connect(ShmData *ud, char *buff, int bufflen)
+{
+    int fd;
+    struct sockaddr_un s_un;
+    int length;
+
+    if (bufflen - 1 + sizeof(SOCKET_PATH "/") > sizeof(s_un.sun_path)) {
+	driver_failure_posix(ud->port, ENAMETOOLONG);
+	return;
+    }
+    ud->type = portTypeCommand;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	DEBUGF(("socket call failed, errno = %d", errno));
+	driver_failure_posix(ud->port, errno);
+	return;
+    }
+    ud->fd = fd;
+    s_un.sun_family = AF_UNIX;
+    strcpy(s_un.sun_path, SOCKET_PATH "/");
+    length = strlen(s_un.sun_path);
+    memcpy(s_un.sun_path + length, buff + 1, bufflen - 1);
+    s_un.sun_path[length + bufflen - 1] = '\0';
+    length = sizeof(s_un.sun_family) + strlen(s_un.sun_path);
+    DEBUGF(("Connect peer filename: %s", s_un.sun_path));
+    SET_NONBLOCKING(fd);
+    if (connect(fd, (struct sockaddr *) &s_un, length) < 0) {
+	if (errno != EINPROGRESS) {
+	    driver_failure_posix(ud->port, errno);
+	} else {
+	    DEBUGF(("Connect pending"));
+	    ud->type = portTypeConnector;
+	    driver_select(ud->port, (ErlDrvEvent) (long) ud->fd,
+			  ERL_DRV_WRITE|ERL_DRV_USE, 1);
+	}
+    } else {
+	DEBUGF(("Connect done"));
+	driver_select(ud->port, (ErlDrvEvent) (long) ud->fd, ERL_DRV_USE, 1);
+	if (shm_create(ud) < 0) {
+	    driver_failure_posix(ud->port, errno);
+	    return;
+	}
+	driver_output(ud->port, "Cok", 3);
+    }
+}
+
+/*
+** The acceptor uses its own duplicate of the listen socket, so that
+** it never has to touch the data of the listen port.
+*/
+static void shm_command_accept(ShmData *ud, char *buff, int bufflen)
+{
+    int listen_no;
+    ShmData *lp;
+
+    if (bufflen < 5) {
+	driver_failure_posix(ud->port, EINVAL);
+	return;
+    }
+
+    listen_no = get_packet_length(buff + 1); /* Same format as
+						packet headers */
+    DEBUGF(("Accept listen_no = %d",listen_no));
+    erl_drv_mutex_lock(list_lock);
+    for (lp = first_data; lp != NULL; lp = lp->next) {
+	if (lp->type == portTypeListener && lp->fd == listen_no) {
+	    ud->listen_fd = dup(lp->fd);
+	    break;
+	}
+    }
+    erl_drv_mutex_unlock(list_lock);
+    if (lp == NULL) {
+	DEBUGF(("Could not find listen port"));
+	driver_failure_posix(ud->port, EINVAL);
+	return;
+    }
+    if (ud->listen_fd < 0) {
+	driver_failure_posix(ud->port, errno);
+	return;
+    }
+    ud->type = portTypeAcceptor;
+    driver_select(ud->port, (ErlDrvEvent) (long) ud->listen_fd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+    /* Silent, answer will be sent when the shared memory is attached */
+}
+
+static void shm_command_listen(ShmData *ud, char *buff, int bufflen)
+{
+    char *str;
+    int fd;
+    struct sockaddr_un s_un;
+    int length;
+    ShmData *tmp;
+
+    str = ALLOC(bufflen);
+    memcpy(str, buff + 1,bufflen - 1);
+    str[bufflen - 1] = '\0';
+
+    if (strlen(SOCKET_PATH "/") + strlen(str) >= sizeof(s_un.sun_path)) {
+	driver_failure_posix(ud->port, ENAMETOOLONG);
+	FREE(str);
+	return;
+    }
+
+    /*
+    ** Name clashes between nodes are prevented by epmd, which the
+    ** Erlang side registers with before listening here. Just make sure
+    ** we don't listen twice in this node.
+    */
+    erl_drv_mutex_lock(list_lock);
+    for(tmp = first_data; tmp != NULL; tmp = tmp->next) {
+	if (tmp->name != NULL && strcmp(str, tmp->name) == 0) {
+	    break;
+	}
+    }
+    erl_drv_mutex_unlock(list_lock);
+    if (tmp != NULL) {
+	driver_failure_posix(ud->port, EADDRINUSE);
+	FREE(str);
+	return;
+    }
+
+    if (ensure_dir(SOCKET_PATH) != 0) {
+	driver_failure_posix(ud->port, errno);
+	FREE(str);
+	return;
+    }
+    s_un.sun_family = AF_UNIX;
+    strcpy(s_un.sun_path, SOCKET_PATH "/");
+    strcat(s_un.sun_path, str);
+    length = sizeof(s_un.sun_family) + strlen(s_un.sun_path);
+    ud->name = str;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	DEBUGF(("socket call failed, errno = %d", errno));
+	driver_failure_posix(ud->port, errno);
+	return;
+    }
+    SET_NONBLOCKING(fd);
+    ud->fd = fd;
+    do_unlink(str);		/* Left behind by a dead node */
+    DEBUGF(("Listen filename: %s", s_un.sun_path));
+    if (bind(fd, (struct sockaddr *) &s_un, length) < 0) {
+	DEBUGF(("bind call failed, errno = %d",errno));
+	driver_failure_posix(ud->port, errno);
+	return;
+    }
+
+    if (listen(fd, 5) < 0) {
+	DEBUGF(("listen call failed, errno = %d", errno));
+	driver_failure_posix(ud->port, errno);
+	return;
+    }
+    driver_select(ud->port, (ErlDrvEvent) (long) ud->fd, ERL_DRV_USE, 1);
+    erl_drv_mutex_lock(list_lock);
+    ud->type = portTypeListener;
+    erl_drv_mutex_unlock(list_lock);
+    driver_output(ud->port, "Lok", 3);
+}
+
+/*
+** Input/output/stop helpers
+*/
+static void do_stop(ShmData *ud)
+{
+    ShmData **tmp;
+
+    DEBUGF(("Cleaning up, type = %d, fd = %d", ud->type, ud->fd));
+    erl_drv_mutex_lock(list_lock);
+    for (tmp = &first_data; *tmp != NULL && *tmp != ud; tmp = &((*tmp)->next))
+	;
+    ASSERT(*tmp != NULL);
+    *tmp = (*tmp)->next;
+    erl_drv_mutex_unlock(list_lock);
+    if (ud->buffer != NULL) {
+	FREE(ud->buffer);
+    }
+    if (ud->frag != NULL) {
+	FREE(ud->frag);
+    }
+    if (ud->fd >= 0) {
+	driver_select(ud->port, (ErlDrvEvent) (long) ud->fd,
+		      ERL_DRV_READ|ERL_DRV_WRITE|ERL_DRV_USE, 0);
+    }
+    if (ud->listen_fd >= 0) {
+	driver_select(ud->port, (ErlDrvEvent) (long) ud->listen_fd,
+		      ERL_DRV_READ|ERL_DRV_USE, 0);
+    }
+    if (ud->efd >= 0) {
+	driver_select(ud->port, (ErlDrvEvent) (long) ud->efd,
+		      ERL_DRV_READ|ERL_DRV_USE, 0);
+    }
+    if (ud->peer_efd >= 0) {
+	close(ud->peer_efd);
+    }
+    if (ud->shm != NULL) {
+	munmap((void *) ud->shm, SHM_SIZE);
+    }
+    if (ud->name) {
+	do_unlink(ud->name);
+	FREE(ud->name);
+    }
+    FREE(ud);
+}
+
+static void do_accept(ShmData *ud)
+{
+    struct sockaddr_un peer;
+    socklen_t pl = sizeof(struct sockaddr_un);
+    int fd;
+
+    if ((fd = accept(ud->listen_fd, (struct sockaddr *) &peer, &pl)) < 0) {
+	if (errno != EWOULDBLOCK) {
+	    DEBUGF(("Accept failed."));
+	    driver_failure_posix(ud->port, errno);
+	    return;
+	}
+	DEBUGF(("Accept would block."));
+	return;
+    }
+    SET_NONBLOCKING(fd);
+    driver_select(ud->port, (ErlDrvEvent) (long) ud->listen_fd,
+		  ERL_DRV_READ|ERL_DRV_USE, 0);
+    ud->listen_fd = -1;
+    ud->fd = fd;
+    ud->type = portTypeShmWait;
+    DEBUGF(("Accept successful."));
+    driver_select(ud->port, (ErlDrvEvent) (long) ud->fd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+}
+
+/*
+** In intermediate and data mode nothing more is sent on the socket; it
+** becomes readable when the peer closes it.
+*/
+static void check_eof(ShmData *ud)
+{
+    char c;
+    int res = read(ud->fd, &c, 1);
+
+    if (res < 0 && errno == EAGAIN) {
+	return;
+    }
+    DEBUGF(("Socket closed or unexpected data (%d)", res));
+    driver_failure_eof(ud->port);
+}
+
+/*
+** Actually send the data (command mode, on the socket)
+*/
+static void do_send(ShmData *ud, char *buff, int bufflen)
+{
+    char header[4];
+    int written;
+    SysIOVec iov[2];
+    ErlIOVec eio;
+    ErlDrvBinary *binv[] = {NULL,NULL};
+
+    put_packet_length(header, bufflen);
+    iov[0].iov_base = (char *) header;
+    iov[0].iov_len = 4;
+    iov[1].iov_base = buff;
+    iov[1].iov_len = bufflen;
+    eio.iov = iov;
+    eio.binv = binv;
+    eio.vsize = 2;
+    eio.size = bufflen + 4;
+    written = 0;
+    if (driver_sizeq(ud->port) == 0) {
+	if ((written = writev(ud->fd, (struct iovec *) iov, 2)) == eio.size) {
+	    ud->sent += written;
+	    driver_output(ud->port, "Sok", 3);
+	    DEBUGF(("Wrote all %d bytes immediately.",written));
+	    return;
+	} else if (written < 0) {
+	    if (errno != EWOULDBLOCK) {
+		driver_failure_eof(ud->port);
+		return;
+	    } else {
+		written = 0;
+	    }
+	} else {
+	    ud->sent += written;
+	}
+	DEBUGF(("Wrote %d bytes immediately.",written));
+	/* Enqueue remaining */
+    }
+    driver_enqv(ud->port, &eio, written);
+    DEBUGF(("Sending output queue."));
+    send_out_queue(ud);
+}
+
+static void do_recv(ShmData *ud)
+{
+    int res;
+    char *ibuf;
+    ASSERT_NONBLOCK(ud->fd);
+    DEBUGF(("do_recv called, type = %d", ud->type));
+    if ((res = buffered_read_package(ud,&ibuf)) < 0) {
+	if (res == NORMAL_READ_FAILURE) {
+	    DEBUGF(("do_recv normal read failed"));
+	    driver_select(ud->port, (ErlDrvEvent) (long) ud->fd,
+			  ERL_DRV_READ|ERL_DRV_USE, 1);
+	} else {
+	    DEBUGF(("do_recv fatal read failed (%d) (%d)",errno, res));
+	    driver_failure_eof(ud->port);
+	}
+	return;
+    }
+    DEBUGF(("do_recv got package, port type = %d", ud->type));
+    ibuf[-1] = 'R'; /* There is always room for a single byte opcode
+		       before the actual buffer (where the packet
+		       header was) */
+    driver_output(ud->port,ibuf - 1, res + 1);
+    driver_select(ud->port, (ErlDrvEvent) (long) ud->fd, ERL_DRV_READ, 0);
+}
+
+/*
+** Shared memory setup
+*/
+
+/*
+** Connecting side: create the segment and the eventfds and pass them
+** to the peer. The descriptor of the segment is not needed once it is
+** mapped, and the name is removed at once.
+*/
+static int shm_create(ShmData *ud)
+{
+    static unsigned int counter = 0;
+    char name[64];
+    ShmHello hello;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    int fds[3];
+    int shm_fd;
+    void *p;
+
+    sprintf(name, "/erl_shm_%d_%u", (int) getpid(),
+	    __sync_fetch_and_add(&counter, 1));
+    if ((shm_fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600)) < 0) {
+	return -1;
+    }
+    shm_unlink(name);
+    if (ftruncate(shm_fd, SHM_SIZE) < 0 ||
+	(p = mmap(NULL, SHM_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED,
+		  shm_fd, 0)) == MAP_FAILED) {
+	int save_errno = errno;
+	close(shm_fd);
+	errno = save_errno;
+	return -1;
+    }
+    ud->shm = (ShmHeader *) p;
+    ud->shm->magic = SHM_MAGIC;
+    ud->shm->ring_size = RING_SIZE;
+    /* Nobody reads before data mode, so both consumers start asleep */
+    ud->shm->ring[0].sleeping = 1;
+    ud->shm->ring[1].sleeping = 1;
+
+    fds[0] = shm_fd;
+    fds[1] = eventfd(0, EFD_NONBLOCK);
+    fds[2] = eventfd(0, EFD_NONBLOCK);
+    if (fds[1] < 0 || fds[2] < 0) {
+	int save_errno = errno;
+	close(shm_fd);
+	if (fds[1] >= 0) close(fds[1]);
+	if (fds[2] >= 0) close(fds[2]);
+	errno = save_errno;
+	return -1;
+    }
+
+    hello.magic = SHM_MAGIC;
+    hello.ring_size = RING_SIZE;
+    iov.iov_base = (void *) &hello;
+    iov.iov_len = sizeof(hello);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(ud->fd, &msg, 0) != sizeof(hello)) {
+	int save_errno = errno;
+	close(shm_fd);
+	close(fds[1]);
+	close(fds[2]);
+	errno = save_errno;
+	return -1;
+    }
+    close(shm_fd);
+    ud->efd = fds[1];
+    ud->peer_efd = fds[2];
+    shm_init_rings(ud, 0);
+    return 0;
+}
+
+/*
+** Accepting side: receive what shm_create() sent. Returns -1 with errno
+** EAGAIN if it has not arrived yet.
+*/
+static int shm_attach(ShmData *ud)
+{
+    ShmHello hello;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    int fds[3];
+    struct stat st;
+    void *p;
+    int res;
+
+    iov.iov_base = (void *) &hello;
+    iov.iov_len = sizeof(hello);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    if ((res = recvmsg(ud->fd, &msg, 0)) < 0) {
+	return -1;
+    }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (res != sizeof(hello) || cmsg == NULL ||
+	cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+	cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+	errno = EPROTO;
+	return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    ud->efd = fds[2];
+    ud->peer_efd = fds[1];
+    if (hello.magic != SHM_MAGIC || hello.ring_size != RING_SIZE ||
+	fstat(fds[0], &st) < 0 || st.st_size != SHM_SIZE) {
+	close(fds[0]);
+	errno = EPROTO;
+	return -1;
+    }
+    p = mmap(NULL, SHM_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (p == MAP_FAILED) {
+	return -1;
+    }
+    ud->shm = (ShmHeader *) p;
+    shm_init_rings(ud, 1);
+    return 0;
+}
+
+static void shm_init_rings(ShmData *ud, int side)
+{
+    Byte *base = ((Byte *) ud->shm) + sizeof(ShmHeader);
+
+    ud->tx = &ud->shm->ring[side];
+    ud->tx_buf = base + side * RING_SIZE;
+    ud->rx = &ud->shm->ring[1 - side];
+    ud->rx_buf = base + (1 - side) * RING_SIZE;
+    SET_NONBLOCKING(ud->efd);
+    driver_select(ud->port, (ErlDrvEvent) (long) ud->efd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+}
+
+/*
+** Ring buffer I/O
+*/
+
+static void signal_efd(int efd)
+{
+    /* Can only fail if the counter would overflow, in which case the
+       peer has plenty of wakeups pending already */
+    (void) eventfd_write(efd, 1);
+}
+
+/*
+** Copy len bytes from the I/O vector into one record. Returns 0 if
+** there is no room, in which case we will be woken up when the peer
+** has consumed something.
+*/
+static int ring_put(ShmData *ud, SysIOVec *iov, int vlen, Word len,
+		    Word flags)
+{
+    RingCtl *ctl = ud->tx;
+    Word head = ctl->head;
+    Word pos = head & (RING_SIZE - 1);
+    Word rec = REC_HEADER + REC_ALIGN(len);
+    Word need = rec;
+    Word *hdr;
+    Byte *dst;
+
+    if (RING_SIZE - pos < rec) {
+	need += RING_SIZE - pos; /* Wasted at the end of the ring */
+    }
+    if (RING_SIZE - (head - ctl->tail) < need) {
+	ctl->want_space = 1;
+	SHM_MB();
+	if (RING_SIZE - (head - ctl->tail) < need) {
+	    return 0;
+	}
+    }
+    if (ctl->want_space) {
+	ctl->want_space = 0;
+    }
+
+    if (RING_SIZE - pos < rec) {
+	hdr = (Word *) (ud->tx_buf + pos);
+	hdr[0] = 0;
+	hdr[1] = REC_WRAP;
+	head += RING_SIZE - pos;
+	pos = 0;
+    }
+    hdr = (Word *) (ud->tx_buf + pos);
+    hdr[0] = len;
+    hdr[1] = flags;
+    dst = ud->tx_buf + pos + REC_HEADER;
+    while (len > 0) {
+	Word n = iov->iov_len < len ? iov->iov_len : len;
+	memcpy(dst, iov->iov_base, n);
+	dst += n;
+	len -= n;
+	iov++;
+    }
+
+    SHM_MB();			/* Data before head */
+    ctl->head = head + rec;
+    SHM_MB();			/* Head before sleeping */
+    if (ctl->sleeping) {
+	signal_efd(ud->peer_efd);
+    }
+    return 1;
+}
+
+/*
+** Queue a message for the shared memory. Queued messages are prefixed
+** with their length; a message that was partly written goes first
+** without one (tx_in_msg).
+*/
+static void shm_send(ShmData *ud, SysIOVec *iov, int vlen, Word size)
+{
+    ErlIOVec eio;
+    ErlDrvBinary *binv[IO_VECTOR_MAX];
+    char header[4];
+
+    if (vlen > IO_VECTOR_MAX) {
+	/* The emulator never does this, make it simple */
+	char *buff = ALLOC(size);
+	SysIOVec flat;
+	char *p = buff;
+	int i;
+	for (i = 0; i < vlen; i++) {
+	    memcpy(p, iov[i].iov_base, iov[i].iov_len);
+	    p += iov[i].iov_len;
+	}
+	flat.iov_base = buff;
+	flat.iov_len = size;
+	shm_send(ud, &flat, 1, size);
+	FREE(buff);
+	return;
+    }
+    memset(binv, 0, sizeof(binv));
+    eio.iov = iov;
+    eio.binv = binv;
+    eio.vsize = vlen;
+    eio.size = size;
+
+    if (!ud->tx_in_msg && driver_sizeq(ud->port) == 0) {
+	Word off = 0;
+	do {
+	    Word chunk = size - off > MAX_RECORD ? MAX_RECORD : size - off;
+	    SysIOVec tmp[IO_VECTOR_MAX];
+	    int i, n;
+	    Word skip = off;
+	    /* Make an iovec starting at off */
+	    for (i = 0; i < vlen && skip >= iov[i].iov_len; i++) {
+		skip -= iov[i].iov_len;
+	    }
+	    for (n = 0; i < vlen; i++, n++) {
+		tmp[n].iov_base = ((char *) iov[i].iov_base) + skip;
+		tmp[n].iov_len = iov[i].iov_len - skip;
+		skip = 0;
+	    }
+	    if (!ring_put(ud, tmp, n, chunk,
+			  off + chunk < size ? REC_MORE : 0)) {
+		ud->tx_in_msg = 1;
+		ud->tx_msg_left = size - off;
+		driver_enqv(ud->port, &eio, off);
+		goto check_busy;
+	    }
+	    ud->sent += REC_HEADER + chunk;
+	    off += chunk;
+	} while (off < size);
+	return;
+    }
+
+    put_packet_length(header, size);
+    driver_enq(ud->port, header, 4);
+    if (size > 0) {
+	driver_enqv(ud->port, &eio, 0);
+    }
+
+ check_busy:
+    if (!ud->busy && driver_sizeq(ud->port) > HIGH_WATERMARK) {
+	ud->busy = 1;
+	set_busy_port(ud->port, 1);
+    }
+}
+
+static void shm_flush_queue(ShmData *ud)
+{
+    for (;;) {
+	int vlen;
+	SysIOVec *iov = driver_peekq(ud->port, &vlen);
+	Word chunk;
+
+	if (!ud->tx_in_msg) {
+	    char header[4];
+	    char *p = header;
+	    int i, need = 4;
+	    if (iov == NULL) {
+		break;
+	    }
+	    for (i = 0; i < vlen && need > 0; i++) {
+		int n = iov[i].iov_len < need ? iov[i].iov_len : need;
+		memcpy(p, iov[i].iov_base, n);
+		p += n;
+		need -= n;
+	    }
+	    ASSERT(need == 0);
+	    driver_deq(ud->port, 4);
+	    ud->tx_in_msg = 1;
+	    ud->tx_msg_left = get_packet_length(header);
+	    continue;
+	}
+	chunk = ud->tx_msg_left > MAX_RECORD ? MAX_RECORD : ud->tx_msg_left;
+	if (!ring_put(ud, iov, vlen, chunk,
+		      chunk < ud->tx_msg_left ? REC_MORE : 0)) {
+	    break;
+	}
+	if (chunk > 0) {
+	    driver_deq(ud->port, chunk);
+	}
+	ud->sent += REC_HEADER + chunk;
+	ud->tx_msg_left -= chunk;
+	if (ud->tx_msg_left == 0) {
+	    ud->tx_in_msg = 0;
+	}
+    }
+    if (ud->busy && driver_sizeq(ud->port) < LOW_WATERMARK) {
+	ud->busy = 0;
+	set_busy_port(ud->port, 0);
+    }
+}
+
+/*
+** Pass everything in our receive ring to the emulator. Unfragmented
+** messages are delivered straight from the shared memory; the peer does
+** not reuse that space until we have moved the tail past it.
+*/
+static void shm_drain(ShmData *ud)
+{
+    RingCtl *ctl = ud->rx;
+    int n = 0;
+
+    /* We are awake; the peer need not signal us for every record it
+       puts in until we have seen the ring empty again */
+    ctl->sleeping = 0;
+    SHM_MB();			/* Awake before looking at head */
+
+    for (;;) {
+	Word tail = ctl->tail;
+	Word pos, len, flags, rec;
+	Word *hdr;
+	Byte *data;
+
+	if (tail == ctl->head) {
+	    ctl->sleeping = 1;
+	    SHM_MB();		/* Sleeping before head */
+	    if (tail == ctl->head) {
+		break;
+	    }
+	    ctl->sleeping = 0;
+	}
+	SHM_MB();		/* Head before data */
+	pos = tail & (RING_SIZE - 1);
+	hdr = (Word *) (ud->rx_buf + pos);
+	len = hdr[0];
+	flags = hdr[1];
+	if (flags & REC_WRAP) {
+	    rec = RING_SIZE - pos;
+	} else {
+	    rec = REC_HEADER + REC_ALIGN(len);
+	    if (len > MAX_RECORD || rec > ctl->head - tail) {
+		driver_failure_posix(ud->port, EPROTO);
+		return;
+	    }
+	    data = ud->rx_buf + pos + REC_HEADER;
+	    /* Count the header too, so that ticks show as traffic */
+	    ud->received += REC_HEADER + len;
+	    if ((flags & REC_MORE) || ud->frag_len > 0) {
+		if (ud->frag_len + len > ud->frag_size) {
+		    ud->frag_size = ud->frag_len + len + MAX_RECORD;
+		    ud->frag = ud->frag ? REALLOC(ud->frag, ud->frag_size)
+			: ALLOC(ud->frag_size);
+		}
+		memcpy(ud->frag + ud->frag_len, data, len);
+		ud->frag_len += len;
+		if (!(flags & REC_MORE)) {
+		    driver_output(ud->port, (char *) ud->frag, ud->frag_len);
+		    ud->frag_len = 0;
+		    if (ud->frag_size > 4 * MAX_RECORD) {
+			FREE(ud->frag);
+			ud->frag = NULL;
+			ud->frag_size = 0;
+		    }
+		}
+	    } else {
+		driver_output(ud->port, (char *) data, len);
+	    }
+	}
+	SHM_MB();		/* Done with data before tail */
+	ctl->tail = tail + rec;
+	SHM_MB();		/* Tail before want_space */
+	if (ctl->want_space) {
+	    signal_efd(ud->peer_efd);
+	}
+	if (++n >= MAX_RECORDS_PER_INPUT) {
+	    /* Come back later; we are not marked as sleeping so the
+	       peer won't wake us up */
+	    signal_efd(ud->efd);
+	    break;
+	}
+    }
+}
+
+/*
+** Report control error, helper for error messages from control
+*/
+static int report_control_error(char **buffer, int buff_len,
+				char *error_message)
+{
+    int elen = strlen(error_message);
+    if (elen + 1 > buff_len) {
+	*buffer = ALLOC(elen + 1);
+    }
+    **buffer = 1;
+    memcpy((*buffer) + 1, error_message, elen);
+    return elen + 1;
+}
+
+/*
+** Lower level I/O helpers
+*/
+static int send_out_queue(ShmData *ud)
+{
+    ASSERT_NONBLOCK(ud->fd);
+    for(;;) {
+	int vlen;
+	SysIOVec *tmp = driver_peekq(ud->port, &vlen);
+	int wrote;
+	if (tmp == NULL) {
+	    DEBUGF(("Write queue empty."));
+	    driver_select(ud->port, (ErlDrvEvent) (long) ud->fd,
+			  ERL_DRV_WRITE, 0);
+	    driver_output(ud->port, "Sok", 3);
+	    return 0;
+	}
+	if (vlen > IO_VECTOR_MAX) {
+	    vlen = IO_VECTOR_MAX;
+	}
+	DEBUGF(("Trying to writev %d vectors", vlen));
+	if ((wrote = writev(ud->fd, (struct iovec *) tmp, vlen)) < 0) {
+	    if (errno == EWOULDBLOCK) {
+		DEBUGF(("Write failed normal."));
+		driver_select(ud->port, (ErlDrvEvent) (long) ud->fd,
+			      ERL_DRV_WRITE|ERL_DRV_USE, 1);
+		return 0;
+	    } else {
+		DEBUGF(("Write failed fatal (%d).", errno));
+		driver_failure_eof(ud->port);
+		return -1;
+	    }
+	}
+	driver_deq(ud->port, wrote);
+	ud->sent += wrote;
+	DEBUGF(("Wrote %d bytes of data.",wrote));
+    }
+}
+
+static int buffered_read_package(ShmData *ud, char **result)
+{
+    int res;
+    int data_size;
+
+    if (ud->buffer_pos < ud->header_pos + HEADER_LENGTH) {
+	/* The header is not read yet */
+	DEBUGF(("Header not read yet"));
+	if ((res = read_at_least(ud, ud->header_pos + HEADER_LENGTH -
+				 ud->buffer_pos)) < 0) {
+	    DEBUGF(("Header read failed"));
+	    return res;
+	}
+    }
+    DEBUGF(("Header is read"));
+    /* We have at least the header read */
+    data_size = get_packet_length((char *) ud->buffer + ud->header_pos);
+    DEBUGF(("Input packet size = %d", data_size));
+    if (ud->buffer_pos < ud->header_pos + HEADER_LENGTH + data_size) {
+	/* We need to read more */
+	if ((res = read_at_least(ud,
+				 ud->header_pos + HEADER_LENGTH +
+				 data_size - ud->buffer_pos)) < 0) {
+	    DEBUGF(("Data read failed"));
+	    return res;
+	}
+    }
+    DEBUGF(("Data is completely read"));
+    *result = (char *) ud->buffer + ud->header_pos + HEADER_LENGTH;
+    ud->header_pos += HEADER_LENGTH + data_size;
+    return data_size;
+}
+
+static int read_at_least(ShmData *ud, int num)
+{
+    int got;
+    if (ud->buffer_pos + num > ud->buffer_size) {
+	/* No place in the buffer, try to pack it */
+	if (ud->header_pos > 0) {
+	    int offset = ud->header_pos;
+	    memmove(ud->buffer, ud->buffer + ud->header_pos,
+		    ud->buffer_pos - ud->header_pos);
+	    ud->buffer_pos -= offset;
+	    ud->header_pos -= offset;
+	}
+	/* The buffer is packed, look for space again and reallocate if
+	   needed */
+	if (ud->buffer_pos + num > ud->buffer_size) {
+	    /* Let's grow in chunks of 256 */
+	    ud->buffer_size = (((ud->buffer_pos + num) /
+				  CHUNK_SIZE) + 1) * CHUNK_SIZE;
+	    DEBUGF(("New buffer size %d.",ud->buffer_size));
+	    if (!ud->buffer) {
+		ud->buffer = ALLOC(ud->buffer_size);
+	    } else {
+		ud->buffer = REALLOC(ud->buffer, ud->buffer_size);
+	    }
+	}
+    }
+    /* OK, now we have a large enough buffer, try to read into it */
+    if ((got = read(ud->fd, ud->buffer + ud->buffer_pos,
+		    ud->buffer_size - ud->buffer_pos)) < 0) {
+	/* It failed, the question is why... */
+	if (errno == EAGAIN) {
+	    return NORMAL_READ_FAILURE;
+	}
+	return SEVERE_READ_FAILURE;
+    } else if (got == 0) {
+	return EOF_READ_FAILURE;
+    }
+    DEBUGF(("Got %d bytes.", got));
+    ud->received += got;
+    ud->buffer_pos += got;
+   /* So, we got some bytes, but enough ? */
+    if (got < num) {
+	return NORMAL_READ_FAILURE;
+    }
+    return 0;
+}
+
+static Word get_packet_length(char *b)
+{
+    Byte *u = (Byte *) b;
+    return (((Word) u[0]) << 24) | (((Word) u[1]) << 16) |
+	(((Word) u[2]) << 8) | ((Word) u[3]);
+}
+
+static void put_packet_length(char *b, Word len)
+{
+    Byte *p = (Byte *) b;
+    p[0] = (len >> 24) & 0xFF;
+    p[1] = (len >> 16) & 0xFF;
+    p[2] = (len >> 8) & 0xFF;
+    p[3] = len & 0xFF;
+}
+
+/*
+** Malloc wrappers
+*/
+static void *my_malloc(size_t size)
+{
+    void erl_exit(int, char *, ...);
+    void *ptr;
+
+    if ((ptr = driver_alloc(size)) == NULL) {
+	erl_exit(1,"Could not allocate %d bytes of memory",(int) size);
+    }
+    return ptr;
+}
+
+static void *my_realloc(void *ptr, size_t size)
+{
+    void erl_exit(int, char *, ...);
+    void *nptr;
+    if ((nptr = driver_realloc(ptr, size)) == NULL) {
+	erl_exit(1,"Could not reallocate %d bytes of memory",(int) size);
+    }
+    return nptr;
+}
+
+
+/*
+** Socket file handling helpers
+*/
+
+/*
+** Check that directory exists, create if not (only works for one level)
+*/
+static int ensure_dir(char *path)
+{
+    if (mkdir(path,0777) != 0 && errno != EEXIST) {
+	return -1;
+    }
+    return 0;
+}
+
+static void do_unlink(char *name)
+{
+    char buff[100];
+    char *str = buff;
+    int len = strlen(SOCKET_PATH) + 1 + strlen(name) + 1;
+
+    if (len > sizeof(buff) && (str = ALLOC(len)) == NULL) {
+	return;
+    }
+    snprintf(str,len,SOCKET_PATH "/%s",name);
+    unlink(str);
+    if (str != buff) {
+	FREE(str);
+    }
+}
@@ -0,0 +1,169 @@
+%% ``The contents of this file are subject to the Erlang Public License,
+%% Version 1.1, (the "License"); you may not use this file except in
+%% compliance with the License. You should have received a copy of the
+%% Erlang Public License along with this software. If not, it can be
+%% retrieved via the world wide web at http://www.erlang.org/.
+%% 
+%% Software distributed under the License is distributed on an "AS IS"
+%% basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+%% the License for the specific language governing rights and limitations
+%% under the License.
+%% 
+%% The Initial Developer of the Original Code is Ericsson Utvecklings AB.
+%% Portions created by Ericsson are Copyright 1999, Ericsson Utvecklings
+%% AB. All Rights Reserved.''
+%% 
+%%     $Id$
+%%
+-module(shm).
+
+%% Interface to the shm_drv driver.
+
+-export([listen/1, connect/1, accept/1, send/2, recv/1, close/1,
+	 get_port/1, get_status_counters/1, set_mode/2, controlling_process/2,
+	 tick/1]).
+
+-define(decode(A,B,C,D), (((A) bsl 24) bor 
+			  ((B) bsl 16) bor ((C) bsl 8) bor (D))).
+-define(check_server(), case whereis(shm_server) of 
+			    undefined ->
+				exit(shm_server_not_started);
+			    _ ->
+				ok
+			end).
+
+listen(Name) ->
+    ?check_server(),
+    command(port(),$L,Name).
+
+connect(Name) ->
+    ?check_server(),
+    command(port(),$C,Name).
+
+accept(Port) ->
+    ?check_server(),
+    case control(Port,$N) of
+	{ok, N} ->
+	    command(port(),$A,N);
+	Else ->
+	    Else
+    end.
+
+send(Port,Data) ->
+    ?check_server(),
+    command(Port, $S, Data).
+
+recv(Port) ->
+    ?check_server(),
+    command(Port, $R, []).
+
+close(Port) ->
+    ?check_server(),
+    (catch unlink(Port)), %% Avoids problem with trap exits.
+    case (catch erlang:port_close(Port)) of
+	{'EXIT', _Reason} ->
+	    {error, closed};
+	_ ->
+	    ok
+    end.
+
+get_port(Port) ->
+    ?check_server(),
+    {ok,Port}.
+
+get_status_counters(Port) ->
+    ?check_server(),
+    case control(Port, $S) of
+	{ok, {C0, C1, C2}} ->
+	    {ok, C0, C1, C2};
+	Other ->
+	    Other
+    end.
+
+set_mode(Port, command) -> 
+    ?check_server(),
+    control(Port,$C);
+set_mode(Port,intermediate) ->
+    ?check_server(),
+    control(Port,$I);
+set_mode(Port,data) ->
+    ?check_server(),
+    control(Port,$D).
+
+tick(Port) ->
+    ?check_server(),
+    control(Port,$T).
+
+controlling_process(Port, Pid) ->
+    ?check_server(),
+    case (catch erlang:port_connect(Port, Pid)) of
+	true ->
+	    (catch unlink(Port)),
+	    ok;
+	{'EXIT', {badarg, _}} ->
+	    {error, closed};
+	Else ->
+	    exit({unexpected_driver_response, Else})
+    end.
+    
+
+control(Port, Command) ->
+    case (catch erlang:port_control(Port, Command, [])) of
+	[0] ->
+	    ok;
+	[0,A,B,C,D] ->
+	    {ok, [A,B,C,D]};
+	[0,A1,B1,C1,D1,A2,B2,C2,D2,A3,B3,C3,D3] ->
+	    {ok, {?decode(A1,B1,C1,D1),?decode(A2,B2,C2,D2),
+		  ?decode(A3,B3,C3,D3)}};
+	[1|Error] ->
+	    exit({error, list_to_atom(Error)});
+	{'EXIT', {badarg, _}} ->
+	    {error, closed};
+	Else ->
+	    exit({unexpected_driver_response, Else})
+    end.
+	    
+
+command(Port, Command, Parameters) ->
+    SavedTrapExit = process_flag(trap_exit,true),
+    case (catch erlang:port_command(Port,[Command | Parameters])) of
+	true ->
+	    receive
+		{Port, {data, [Command, $o, $k]}} ->
+		    process_flag(trap_exit,SavedTrapExit),
+		    {ok, Port};
+		{Port, {data, [Command |T]}} ->
+		    process_flag(trap_exit,SavedTrapExit),
+		    {ok, T};
+		{Port, Else} ->
+		    process_flag(trap_exit,SavedTrapExit),
+		    exit({unexpected_driver_response, Else});
+		{'EXIT', Port, normal} ->
+		    process_flag(trap_exit,SavedTrapExit),
+		    {error, closed};
+		{'EXIT', Port, Error} -> 
+		    process_flag(trap_exit,SavedTrapExit),
+		    {error, Error}
+	    end;
+	{'EXIT', {badarg, _}} ->
+	    process_flag(trap_exit,SavedTrapExit),
+	    {error, closed};
+	Unexpected ->
+	    process_flag(trap_exit,SavedTrapExit),
+	    exit({unexpected_driver_response, Unexpected})
+    end.
+
+port() ->
+    SavedTrapExit = process_flag(trap_exit,true),
+    case open_port({spawn, "shm_drv"},[]) of
+	P when is_port(P) ->
+	    process_flag(trap_exit,SavedTrapExit),
+	    P;
+	{'EXIT',Error} ->
+	    process_flag(trap_exit,SavedTrapExit),
+	    exit(Error);
+	Else ->
+	    process_flag(trap_exit,SavedTrapExit),
+	    exit({unexpected_driver_response, Else})
+    end.
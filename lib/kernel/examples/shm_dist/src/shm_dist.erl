@@ -0,0 +1,280 @@
+%% ``The contents of this file are subject to the Erlang Public License,
+%% Version 1.1, (the "License"); you may not use this file except in
+%% compliance with the License. You should have received a copy of the
+%% Erlang Public License along with this software. If not, it can be
+%% retrieved via the world wide web at http://www.erlang.org/.
+%%
+%% Software distributed under the License is distributed on an "AS IS"
+%% basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+%% the License for the specific language governing rights and limitations
+%% under the License.
+%%
+%% The Initial Developer of the Original Code is Ericsson Utvecklings AB.
+%% Portions created by Ericsson are Copyright 1999, Ericsson Utvecklings
+%% AB. All Rights Reserved.''
+%%
+%%     $Id$
+%%
+-module(shm_dist).
+
+%% Handles the connection setup phase with other Erlang nodes.
+%%
+%% Nodes on the same host are connected through the shm_drv shared
+%% memory driver. The node also listens on TCP, and is registered in
+%% epmd as usual, so that nodes on other hosts (and nodes not using
+%% this module) can connect to it. Connections to other hosts are
+%% made with inet_tcp_dist.
+
+-export([childspecs/0, listen/1, accept/1, accept_connection/5,
+	 setup/5, close/1, select/1, is_node_name/1]).
+
+%% internal exports
+
+-export([accept_loop/3,do_accept/6,do_setup/6,getstat/1,tick/1]).
+
+-import(error_logger,[error_msg/2]).
+
+-include_lib("kernel/include/net_address.hrl").
+
+-include_lib("kernel/include/dist.hrl").
+-include_lib("kernel/include/dist_util.hrl").
+
+%% -------------------------------------------------------------
+%% This function should return a valid childspec, so that
+%% the primitive shm_server gets supervised
+%% -------------------------------------------------------------
+childspecs() ->
+    {ok, [{shm_server,{shm_server, start_link, []},
+	   permanent, 2000, worker, [shm_server]}]}.
+
+%% ------------------------------------------------------------
+%%  Select this protocol based on node name
+%%  select(Node) => Bool
+%% ------------------------------------------------------------
+
+select(Node) ->
+    inet_tcp_dist:select(Node).
+
+%% ------------------------------------------------------------
+%% Create the listen sockets, i.e. the ports that this erlang
+%% node is accessible through. The TCP listen socket is also what
+%% registers the node in epmd.
+%% ------------------------------------------------------------
+
+listen(Name) ->
+    case inet_tcp_dist:listen(Name) of
+	{ok, {TcpListen, Address, Creation}} ->
+	    case shm:listen(atom_to_list(Name)) of
+		{ok, ShmListen} ->
+		    {ok, {{TcpListen, ShmListen}, Address, Creation}};
+		Error ->
+		    inet_tcp_dist:close(TcpListen),
+		    Error
+	    end;
+	Error ->
+	    Error
+    end.
+
+%% ------------------------------------------------------------
+%% Accepts new connection attempts from other Erlang nodes.
+%%
+%% The TCP acceptor is the process known by net_kernel. The shared
+%% memory acceptor is linked to it, so that they are restarted
+%% together. Both report accepted connections as inet/tcp, which is
+%% what our listen address says.
+%% ------------------------------------------------------------
+
+accept({TcpListen, ShmListen}) ->
+    TcpAcceptor = inet_tcp_dist:accept(TcpListen),
+    spawn_opt(?MODULE, accept_loop, [self(), TcpAcceptor, ShmListen],
+	      [link, {priority, max}]),
+    TcpAcceptor.
+
+accept_loop(Kernel, TcpAcceptor, Listen) ->
+    link(TcpAcceptor),
+    accept_loop(Kernel, Listen).
+
+accept_loop(Kernel, Listen) ->
+    case shm:accept(Listen) of
+	{ok, Socket} ->
+	    Kernel ! {accept,self(),{shm,Socket},inet,tcp},
+	    controller(Kernel, Socket),
+	    accept_loop(Kernel, Listen);
+	Error ->
+	    exit(Error)
+    end.
+
+controller(Kernel, Socket) ->
+    receive
+	{Kernel, controller, Pid} ->
+	    shm:controlling_process(Socket, Pid),
+	    Pid ! {self(), controller};
+	{Kernel, unsupported_protocol} ->
+	    exit(unsupported_protocol)
+    end.
+
+%% ------------------------------------------------------------
+%% Accepts a new connection attempt from another Erlang node.
+%% Performs the handshake with the other side.
+%% ------------------------------------------------------------
+
+accept_connection(AcceptPid, {shm,Socket}, MyNode, Allowed, SetupTime) ->
+    spawn_opt(?MODULE, do_accept,
+	      [self(), AcceptPid, Socket, MyNode, Allowed, SetupTime],
+	      [link, {priority, max}]);
+accept_connection(AcceptPid, Socket, MyNode, Allowed, SetupTime) ->
+    inet_tcp_dist:accept_connection(AcceptPid, Socket, MyNode, Allowed,
+				    SetupTime).
+
+do_accept(Kernel, AcceptPid, Socket, MyNode, Allowed, SetupTime) ->
+    receive
+	{AcceptPid, controller} ->
+	    Timer = dist_util:start_timer(SetupTime),
+	    HSData = (hs_data(Socket))#hs_data{
+		       kernel_pid = Kernel,
+		       this_node = MyNode,
+		       timer = Timer,
+		       allowed = Allowed,
+		       f_address = fun get_remote_id/2
+		      },
+	    dist_util:handshake_other_started(HSData)
+    end.
+
+%% ------------------------------------------------------------
+%% Get remote information about a Socket.
+%% ------------------------------------------------------------
+
+get_remote_id(_Socket, Node) ->
+    case split_node(atom_to_list(Node), $@, []) of
+	[_, Host] ->
+	    #net_address{address = [],
+			 host = Host,
+			 protocol = shm,
+			 family = shm};
+	_ ->
+	    ?shutdown(no_node)
+    end.
+
+%% ------------------------------------------------------------
+%% Setup a new connection to another Erlang node.
+%% Performs the handshake with the other side.
+%% ------------------------------------------------------------
+
+setup(Node, Type, MyNode, LongOrShortNames,SetupTime) ->
+    spawn_opt(?MODULE, do_setup,
+	      [self(), Node, Type, MyNode, LongOrShortNames, SetupTime],
+	      [link, {priority, max}]).
+
+%% A node on our own host that does not use this module, or that has
+%% gone away, has no shared memory listener and is connected to over
+%% TCP instead.
+do_setup(Kernel, Node, Type, MyNode, LongOrShortNames,SetupTime) ->
+    ?trace("~p~n",[{shm_dist,self(),setup,Node}]),
+    [Name, Address] = splitnode(Node, LongOrShortNames),
+    case is_local_host(Address) andalso (catch shm:connect(Name)) of
+	{ok, Socket} ->
+	    Timer = dist_util:start_timer(SetupTime),
+	    HSData = (hs_data(Socket))#hs_data{
+		       kernel_pid = Kernel,
+		       other_node = Node,
+		       this_node = MyNode,
+		       timer = Timer,
+		       other_version = 5,
+		       f_address =
+		       fun(_,_) ->
+			       #net_address{
+				 address = [],
+				 host = Address,
+				 protocol = shm,
+				 family = shm}
+		       end,
+		       request_type = Type
+		      },
+	    dist_util:handshake_we_started(HSData);
+	_ ->
+	    ?trace("shm connect to ~p failed, trying tcp~n", [Node]),
+	    inet_tcp_dist:do_setup(Kernel, Node, Type, MyNode,
+				   LongOrShortNames, SetupTime)
+    end.
+
+hs_data(Socket) ->
+    #hs_data{
+       socket = Socket,
+       this_flags = 0,
+       f_send = fun(S,D) -> shm:send(S,D) end,
+       f_recv = fun(S,_N,_T) -> shm:recv(S) end,
+       f_setopts_pre_nodeup =
+       fun(S) ->
+	       shm:set_mode(S, intermediate)
+       end,
+       f_setopts_post_nodeup =
+       fun(S) ->
+	       shm:set_mode(S, data)
+       end,
+       f_getll = fun(S) ->
+			 shm:get_port(S)
+		 end,
+       mf_tick = fun ?MODULE:tick/1,
+       mf_getstat = fun ?MODULE:getstat/1
+      }.
+
+is_local_host(Host) ->
+    {ok, MyHost} = inet:gethostname(),
+    case split_node(Host, $., []) of
+	[MyHost|_] ->
+	    true;
+	_ ->
+	    Host =:= "localhost"
+    end.
+
+%%
+%% Close the listen sockets.
+%%
+close({TcpListen, ShmListen}) ->
+    shm:close(ShmListen),
+    inet_tcp_dist:close(TcpListen).
+
+
+%% If Node is illegal terminate the connection setup!!
+splitnode(Node, LongOrShortNames) ->
+    case split_node(atom_to_list(Node), $@, []) of
+	[Name|Tail] when Tail =/= [] ->
+	    Host = lists:append(Tail),
+	    case split_node(Host, $., []) of
+		[_] when LongOrShortNames =:= longnames ->
+		    error_msg("** System running to use "
+			      "fully qualified "
+			      "hostnames **~n"
+			      "** Hostname ~s is illegal **~n",
+			      [Host]),
+		    ?shutdown(Node);
+		L when length(L) > 1, LongOrShortNames =:= shortnames ->
+		    error_msg("** System NOT running to use fully qualified "
+			      "hostnames **~n"
+			      "** Hostname ~s is illegal **~n",
+			      [Host]),
+		    ?shutdown(Node);
+		_ ->
+		    [Name, Host]
+	    end;
+	[_] ->
+	    error_msg("** Nodename ~p illegal, no '@' character **~n",
+		      [Node]),
+	    ?shutdown(Node);
+	_ ->
+	    error_msg("** Nodename ~p illegal **~n", [Node]),
+	    ?shutdown(Node)
+    end.
+
+split_node([Chr|T], Chr, Ack) -> [lists:reverse(Ack)|split_node(T, Chr, [])];
+split_node([H|T], Chr, Ack)   -> split_node(T, Chr, [H|Ack]);
+split_node([], _, Ack)        -> [lists:reverse(Ack)].
+
+is_node_name(Node) ->
+    inet_tcp_dist:is_node_name(Node).
+
+tick(Socket) ->
+    shm:tick(Socket).
+
+getstat(Socket) ->
+    shm:get_status_counters(Socket).
@@ -81,11 +81,17 @@ remove_flag(Flag, Flags) ->
 	    Flags - Flag
     end.
 
-adjust_flags(ThisFlags, OtherFlags) ->
-    case (?DFLAG_PUBLISHED band ThisFlags) band OtherFlags of
+adjust_flags(ThisFlags0, OtherFlags0) ->
+    {ThisFlags, OtherFlags} = adjust_flag(?DFLAG_PUBLISHED,
+					  ThisFlags0, OtherFlags0),
+    adjust_flag(?DFLAG_DIST_COMPRESS, ThisFlags, OtherFlags).
+
+%% Keep Flag only if both sides have it.
+adjust_flag(Flag, ThisFlags, OtherFlags) ->
+    case (Flag band ThisFlags) band OtherFlags of
 	0 ->
-	    {remove_flag(?DFLAG_PUBLISHED, ThisFlags),
-	     remove_flag(?DFLAG_PUBLISHED, OtherFlags)};
+	    {remove_flag(Flag, ThisFlags),
+	     remove_flag(Flag, OtherFlags)};
 	_ ->
 	    {ThisFlags, OtherFlags}
     end.
@@ -100,8 +106,17 @@ publish_flag(_, OtherNode) ->
 	    0
     end.
 
+compress_flag() ->
+    case application:get_env(kernel, dist_compress) of
+	{ok, true} ->
+	    ?DFLAG_DIST_COMPRESS;
+	_ ->
+	    0
+    end.
+
 make_this_flags(RequestType, OtherNode) ->
     publish_flag(RequestType, OtherNode) bor
+	compress_flag() bor
 	%% The parenthesis below makes the compiler generate better code.
 	(?DFLAG_EXPORT_PTR_TAG bor
 	 ?DFLAG_EXTENDED_PIDS_PORTS bor
@@ -115,7 +130,8 @@ make_this_flags(RequestType, OtherNode) ->
 	 ?DFLAG_NEW_FLOATS bor
 	 ?DFLAG_UNICODE_IO bor
 	 ?DFLAG_DIST_HDR_ATOM_CACHE bor
-	 ?DFLAG_SMALL_ATOM_TAGS).
+	 ?DFLAG_SMALL_ATOM_TAGS bor
+	 ?DFLAG_SEND_MULTI).
 
 handshake_other_started(#hs_data{request_type=ReqType}=HSData0) ->
     {PreOtherFlags,Node,Version} = recv_name(HSData0),
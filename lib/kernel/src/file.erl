@@ -27,20 +27,20 @@
 -export([format_error/1]).
 %% File system and metadata.
 -export([get_cwd/0, get_cwd/1, set_cwd/1, delete/1, rename/2,
-	 make_dir/1, del_dir/1, list_dir/1,
+	 make_dir/1, del_dir/1, list_dir/1, list_dir_info/1, list_dir_info/2,
 	 read_file_info/1, read_file_info/2,
 	 write_file_info/2, write_file_info/3,
 	 altname/1,
 	 read_link_info/1, read_link_info/2,
 	 read_link/1,
 	 make_link/2, make_symlink/2,
-	 read_file/1, write_file/2, write_file/3]).
+	 read_file/1, read_file/2, write_file/2, write_file/3]).
 %% Specialized
 -export([ipread_s32bu_p32bu/3]).
 %% Generic file contents.
 -export([open/2, close/1, advise/4,
 	 read/2, write/2, 
-	 pread/2, pread/3, pwrite/2, pwrite/3,
+	 pread/2, pread/3, pread_batch/2, pwrite/2, pwrite/3,
 	 read_line/1,
 	 position/2, truncate/1, datasync/1, sync/1,
 	 copy/2, copy/3]).
@@ -111,6 +111,9 @@
 -type sendfile_option() :: {chunk_size, non_neg_integer()}.
 -type file_info_option() :: {'time', 'local'} | {'time', 'universal'} 
 			  | {'time', 'posix'}.
+-type read_file_option() :: 'mmap'.
+-type list_dir_info_option() :: {'depth', non_neg_integer() | 'infinity'}
+                              | file_info_option().
 
 
 %%%-----------------------------------------------------------------
@@ -285,6 +288,23 @@ write_file_info(Name, Info = #file_info{}, Opts) when is_list(Opts) ->
 list_dir(Name) ->
     check_and_call(list_dir, [file_name(Name)]).
 
+-spec list_dir_info(Dir) -> {ok, Entries} | {error, Reason} when
+      Dir :: name(),
+      Entries :: [{filename(), file_info()}],
+      Reason :: posix() | badarg.
+
+list_dir_info(Name) ->
+    check_and_call(list_dir_info, [file_name(Name), []]).
+
+-spec list_dir_info(Dir, Opts) -> {ok, Entries} | {error, Reason} when
+      Dir :: name(),
+      Opts :: [list_dir_info_option()],
+      Entries :: [{filename(), file_info()}],
+      Reason :: posix() | badarg.
+
+list_dir_info(Name, Opts) when is_list(Opts) ->
+    check_and_call(list_dir_info, [file_name(Name), Opts]).
+
 -spec read_file(Filename) -> {ok, Binary} | {error, Reason} when
       Filename :: name(),
       Binary :: binary(),
@@ -293,6 +313,15 @@ list_dir(Name) ->
 read_file(Name) ->
     check_and_call(read_file, [file_name(Name)]).
 
+-spec read_file(Filename, Opts) -> {ok, Binary} | {error, Reason} when
+      Filename :: name(),
+      Opts :: [read_file_option()],
+      Binary :: binary(),
+      Reason :: posix() | badarg | terminated | system_limit.
+
+read_file(Name, Opts) when is_list(Opts) ->
+    check_and_call(read_file, [file_name(Name), Opts]).
+
 -spec make_link(Existing, New) -> ok | {error, Reason} when
       Existing :: name(),
       New :: name(),
@@ -535,6 +564,18 @@ pread_int(File, [{At, Sz} | T], R) when is_integer(Sz), Sz >= 0 ->
 pread_int(_, _, _) ->
     {error, badarg}.
 
+-spec pread_batch(IoDevice, LocNums) -> {ok, DataL} | eof | {error, Reason} when
+      IoDevice :: io_device(),
+      LocNums :: [{Location :: location(), Number :: non_neg_integer()}],
+      DataL :: [Data],
+      Data :: string() | binary() | eof,
+      Reason :: posix() | badarg | terminated.
+
+pread_batch(#file_descriptor{module = prim_file} = Handle, L) when is_list(L) ->
+    prim_file:pread_batch(Handle, L);
+pread_batch(File, L) ->
+    pread(File, L).
+
 -spec pread(IoDevice, Location, Number) ->
              {ok, Data} | eof | {error, Reason} when
       IoDevice :: io_device(),
@@ -155,6 +155,10 @@ valid_enc(_Other) ->
 
 server_loop(#state{mref = Mref} = State) ->
     receive
+	{file_request, From, ReplyAs, Sync} when is_pid(From),
+						 (Sync =:= sync orelse
+						  Sync =:= datasync) ->
+	    group_sync(Sync, [{From, ReplyAs}], State);
 	{file_request, From, ReplyAs, Request} when is_pid(From) ->
 	    case file_request(Request, State) of
 		{reply, Reply, NewState} ->
@@ -189,6 +193,36 @@ server_loop(#state{mref = Mref} = State) ->
 	    server_loop(State)
     end.
 
+%% Group commit: the callers wait for their replies, so whatever they
+%% wrote before asking to sync is already written. All sync requests
+%% that queued up while the previous one was in progress can therefore
+%% be answered by one sync, which is a sync if any of them asked for it.
+group_sync(Sync, Waiters, State) ->
+    receive
+	{file_request, From, ReplyAs, S} when is_pid(From),
+					      (S =:= sync orelse
+					       S =:= datasync) ->
+	    group_sync(stronger_sync(Sync, S), [{From, ReplyAs} | Waiters],
+		       State)
+    after 0 ->
+	    case file_request(Sync, State) of
+		{reply, Reply, NewState} ->
+		    group_reply(lists:reverse(Waiters), Reply),
+		    server_loop(NewState);
+		{stop, Reason, Reply, _NewState} ->
+		    group_reply(lists:reverse(Waiters), Reply),
+		    exit(Reason)
+	    end
+    end.
+
+stronger_sync(datasync, datasync) -> datasync;
+stronger_sync(_, _) -> sync.
+
+group_reply(Waiters, Reply) ->
+    lists:foreach(fun({From, ReplyAs}) ->
+			  file_reply(From, ReplyAs, Reply)
+		  end, Waiters).
+
 file_reply(From, ReplyAs, Reply) ->
     From ! {file_reply, ReplyAs, Reply}.
 
@@ -116,6 +116,9 @@ handle_call({open, _Name, _Mode}, _From, Handle) ->
 handle_call({read_file, Name}, _From, Handle) ->
     {reply, ?PRIM_FILE:read_file(Name), Handle};
 
+handle_call({read_file, Name, Opts}, _From, Handle) ->
+    {reply, ?PRIM_FILE:read_file(Name, Opts), Handle};
+
 handle_call({write_file, Name, Bin}, _From, Handle) ->
     {reply, ?PRIM_FILE:write_file(Name, Bin), Handle};
 
@@ -137,6 +140,9 @@ handle_call({del_dir, Name}, _From, Handle) ->
 handle_call({list_dir, Name}, _From, Handle) ->
     {reply, ?PRIM_FILE:list_dir(Handle, Name), Handle};
 
+handle_call({list_dir_info, Name, Opts}, _From, Handle) ->
+    {reply, ?PRIM_FILE:list_dir_info(Handle, Name, Opts), Handle};
+
 handle_call(get_cwd, _From, Handle) ->
     {reply, ?PRIM_FILE:get_cwd(Handle), Handle};
 handle_call({get_cwd}, _From, Handle) ->
@@ -31,21 +31,26 @@
 
 -type option() ::
         {active,          true | false | once} |
+        {adaptive_buffer, boolean()} |
         {bit8,            clear | set | on | off} |
         {buffer,          non_neg_integer()} |
         {delay_send,      boolean()} |
+        {delay_send_bytes, non_neg_integer()} |
+        {delay_send_time, non_neg_integer()} |
         {deliver,         port | term} |
         {dontroute,       boolean()} |
         {exit_on_close,   boolean()} |
         {header,          non_neg_integer()} |
         {high_watermark,  non_neg_integer()} |
         {keepalive,       boolean()} |
+        {latency_stats,   boolean()} |
         {linger,          {boolean(), non_neg_integer()}} |
         {low_watermark,   non_neg_integer()} |
         {mode,            list | binary} | list | binary |
+        {multi_accept,    non_neg_integer()} |
         {nodelay,         boolean()} |
         {packet,
-         0 | 1 | 2 | 4 | raw | sunrm |  asn1 |
+         0 | 1 | 2 | 4 | {2 | 4, little} | varint | raw | sunrm |  asn1 |
          cdr | fcgi | line | tpkt | http | httph | http_bin | httph_bin } |
         {packet_size,     non_neg_integer()} |
         {priority,        non_neg_integer()} |
@@ -55,24 +60,30 @@
          ValueBin :: binary()} |
         {recbuf,          non_neg_integer()} |
         {reuseaddr,       boolean()} |
+        {reuseport,       boolean()} |
         {send_timeout,    non_neg_integer() | infinity} |
         {send_timeout_close, boolean()} |
         {sndbuf,          non_neg_integer()} |
         {tos,             non_neg_integer()}.
 -type option_name() ::
         active |
+        adaptive_buffer |
         bit8 |
         buffer |
         delay_send |
+        delay_send_bytes |
+        delay_send_time |
         deliver |
         dontroute |
         exit_on_close |
         header |
         high_watermark |
         keepalive |
+        latency_stats |
         linger |
         low_watermark |
         mode |
+        multi_accept |
         nodelay |
         packet |
         packet_size |
@@ -84,6 +95,7 @@
                       (ValueBin :: binary())} |
         recbuf |
         reuseaddr |
+        reuseport |
         send_timeout |
         send_timeout_close |
         sndbuf |
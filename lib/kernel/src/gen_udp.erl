@@ -19,7 +19,7 @@
 -module(gen_udp).
 
 -export([open/1, open/2, close/1]).
--export([send/2, send/4, recv/2, recv/3, connect/3]).
+-export([send/2, send/4, send_multi/2, recv/2, recv/3, connect/3]).
 -export([controlling_process/2]).
 -export([fdopen/2]).
 
@@ -45,7 +45,9 @@
          ValueBin :: binary()} |
         {read_packets,    non_neg_integer()} |
         {recbuf,          non_neg_integer()} |
+        {recv_batch,      non_neg_integer()} |
         {reuseaddr,       boolean()} |
+        {reuseport,       boolean()} |
         {sndbuf,          non_neg_integer()} |
         {tos,             non_neg_integer()}.
 -type option_name() ::
@@ -67,7 +69,9 @@
                       (ValueBin :: binary())} |
         read_packets |
         recbuf |
+        recv_batch |
         reuseaddr |
+        reuseport |
         sndbuf |
         tos.
 -type socket() :: port().
@@ -137,6 +141,42 @@ send(S, Packet) when is_port(S) ->
 	    Error
     end.
 
+-spec send_multi(Socket, Packets) -> ok | {error, Reason} when
+      Socket :: socket(),
+      Packets :: [{Address, Port, Packet}],
+      Address :: inet:ip_address() | inet:hostname(),
+      Port :: inet:port_number(),
+      Packet :: iodata(),
+      Reason :: not_owner | inet:posix().
+
+send_multi(S, Packets) when is_port(S) ->
+    case inet_db:lookup_socket(S) of
+	{ok, Mod} ->
+	    case send_multi_addrs(Mod, Packets, []) of
+		{ok, Dgrams} -> Mod:send_multi(S, Dgrams);
+		Error -> Error
+	    end;
+	Error ->
+	    Error
+    end.
+
+send_multi_addrs(Mod, [{Address, Port, Packet}|Packets], Acc) ->
+    case Mod:getaddr(Address) of
+	{ok,IP} ->
+	    case Mod:getserv(Port) of
+		{ok,UP} ->
+		    send_multi_addrs(Mod, Packets, [{IP,UP,Packet}|Acc]);
+		{error,einval} -> exit(badarg);
+		Error -> Error
+	    end;
+	{error,einval} -> exit(badarg);
+	Error -> Error
+    end;
+send_multi_addrs(_Mod, [], Acc) ->
+    {ok, lists:reverse(Acc)};
+send_multi_addrs(_Mod, _, _Acc) ->
+    exit(badarg).
+
 -spec recv(Socket, Length) ->
                   {ok, {Address, Port, Packet}} | {error, Reason} when
       Socket :: socket(),
@@ -28,7 +28,7 @@
 	 getifaddrs/0, getifaddrs/1,
 	 getif/1, getif/0, getiflist/0, getiflist/1,
 	 ifget/3, ifget/2, ifset/3, ifset/2,
-	 getstat/1, getstat/2,
+	 getstat/1, getstat/2, tls_offload/3, splice/3,
 	 ip/1, stats/0, options/0, 
 	 pushf/3, popf/1, close/1, gethostname/0, gethostname/1]).
 
@@ -123,7 +123,8 @@
 -type socket_type() :: 'stream' | 'dgram' | 'seqpacket'.
 -type stat_option() :: 
 	'recv_cnt' | 'recv_max' | 'recv_avg' | 'recv_oct' | 'recv_dvi' |
-	'send_cnt' | 'send_max' | 'send_avg' | 'send_oct' | 'send_pend'.
+	'send_cnt' | 'send_max' | 'send_avg' | 'send_oct' | 'send_pend' |
+	'send_dwell' | 'recv_latency' | 'busy_time'.
 
 %%% ---------------------------------
 
@@ -358,11 +359,72 @@ getstat(Socket) ->
 	{ok, OptionValues} | {error, posix()} when
       Socket :: socket(),
       Options :: [stat_option()],
-      OptionValues :: [{stat_option(), integer()}].
+      OptionValues :: [{stat_option(), integer() | [non_neg_integer()]}].
 
 getstat(Socket,What) ->
     prim_inet:getstat(Socket, What).
 
+-spec tls_offload(Socket, Direction, Params) -> 'ok' | {'error', posix()} when
+      Socket :: socket(),
+      Direction :: 'tx' | 'rx',
+      Params :: [{'version', 'tlsv1.2' | 'tlsv1.3'} |
+		 {'cipher', 'aes_128_gcm' | 'aes_256_gcm'} |
+		 {'key', binary()} | {'salt', binary()} | {'iv', binary()} |
+		 {'seq', non_neg_integer()}].
+
+tls_offload(Socket, Direction, Params) ->
+    prim_inet:tls_offload(Socket, Direction, Params).
+
+-spec splice(From, To, Bytes) ->
+	{'ok', non_neg_integer()} | {'error', posix() | 'closed' | 'not_owner'} when
+      From :: socket(),
+      To :: socket(),
+      Bytes :: non_neg_integer().
+
+splice(From, To, Bytes)
+  when is_port(From), is_port(To), is_integer(Bytes), Bytes >= 0 ->
+    case {erlang:port_get_data(From), erlang:port_get_data(To)} of
+	{F, T} when (F =:= inet_tcp orelse F =:= inet6_tcp),
+		    (T =:= inet_tcp orelse T =:= inet6_tcp) ->
+	    case lock_socket(From, true) of
+		ok ->
+		    {ok, Fd} = prim_inet:getfd(From),
+		    try splice_1(From, To, Fd, Bytes)
+		    after
+			%% From may have been closed meanwhile
+			_ = lock_socket(From, false)
+		    end;
+		Error ->
+		    Error
+	    end;
+	_ ->
+	    {error, badarg}
+    end.
+
+%% What the port of From has read ahead, e.g. past a line in
+%% {packet,line} mode, is sent before the kernel copies the rest
+splice_1(From, To, Fd, Bytes) ->
+    case prim_inet:take_input(From, Bytes) of
+	{ok, <<>>} ->
+	    prim_inet:splice(To, Fd, Bytes);
+	{ok, Buffered} ->
+	    N = byte_size(Buffered),
+	    case prim_inet:send(To, Buffered) of
+		ok when N =:= Bytes ->
+		    {ok, N};
+		ok ->
+		    Left = if Bytes =:= 0 -> 0; true -> Bytes - N end,
+		    case prim_inet:splice(To, Fd, Left) of
+			{ok, M} -> {ok, N + M};
+			Error -> Error
+		    end;
+		Error ->
+		    Error
+	    end;
+	Error ->
+	    Error
+    end.
+
 -spec gethostbyname(Hostname) -> {ok, Hostent} | {error, posix()} when
       Hostname :: hostname(),
       Hostent :: hostent().
@@ -530,12 +592,13 @@ getservbyname(Name, Protocol) when is_atom(Name) ->
 %% Return a list of available options
 options() ->
     [
-     tos, priority, reuseaddr, keepalive, dontroute, linger,
+     tos, priority, reuseaddr, reuseport, keepalive, dontroute, linger,
      broadcast, sndbuf, recbuf, nodelay,
      buffer, header, active, packet, deliver, mode,
      multicast_if, multicast_ttl, multicast_loop,
      exit_on_close, high_watermark, low_watermark,
-     bit8, send_timeout, send_timeout_close
+     bit8, send_timeout, send_timeout_close, multi_accept, adaptive_buffer,
+     latency_stats
     ].
 
 %% Return a list of statistics options
@@ -550,10 +613,11 @@ stats() ->
 %% Available options for tcp:connect
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 connect_options() ->
-    [tos, priority, reuseaddr, keepalive, linger, sndbuf, recbuf, nodelay,
+    [tos, priority, reuseaddr, reuseport, keepalive, linger, sndbuf, recbuf, nodelay,
      header, active, packet, packet_size, buffer, mode, deliver,
      exit_on_close, high_watermark, low_watermark, bit8, send_timeout,
-     send_timeout_close, delay_send,raw].
+     send_timeout_close, delay_send, delay_send_bytes, delay_send_time,
+     adaptive_buffer, latency_stats, raw].
     
 connect_options(Opts, Family) ->
     BaseOpts = 
@@ -606,10 +670,11 @@ con_add(Name, Val, R, Opts, AllOpts) ->
 %% Available options for tcp:listen
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 listen_options() ->
-    [tos, priority, reuseaddr, keepalive, linger, sndbuf, recbuf, nodelay,
-     header, active, packet, buffer, mode, deliver, backlog,
+    [tos, priority, reuseaddr, reuseport, keepalive, linger, sndbuf, recbuf,
+     nodelay, header, active, packet, buffer, mode, deliver, backlog,
      exit_on_close, high_watermark, low_watermark, bit8, send_timeout,
-     send_timeout_close, delay_send, packet_size,raw].
+     send_timeout_close, delay_send, delay_send_bytes, delay_send_time,
+     packet_size, multi_accept, adaptive_buffer, latency_stats, raw].
 
 listen_options(Opts, Family) ->
     BaseOpts = 
@@ -663,10 +728,10 @@ list_add(Name, Val, R, Opts, As) ->
 %% Available options for udp:open
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 udp_options() ->
-    [tos, priority, reuseaddr, sndbuf, recbuf, header, active, buffer, mode, 
+    [tos, priority, reuseaddr, reuseport, sndbuf, recbuf, header, active, buffer, mode, 
      deliver,
      broadcast, dontroute, multicast_if, multicast_ttl, multicast_loop,
-     add_membership, drop_membership, read_packets,raw].
+     add_membership, drop_membership, read_packets, recv_batch, raw].
 
 
 udp_options(Opts, Family) ->
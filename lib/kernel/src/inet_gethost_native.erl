@@ -51,12 +51,17 @@
 -define(UNIT_IPV6,16).
 
 -define(PORT_PROGRAM, "inet_gethost").
+-define(PORT_DRIVER, "inet_gethost_drv").
 -define(DEFAULT_POOLSIZE, 4).
 -define(REQUEST_TIMEOUT, (inet_db:res_option(timeout)*4)).
 
 -define(MAX_TIMEOUT, 16#7FFFFFF).
 -define(INVALID_SERIAL, 16#FFFFFFFF).
 
+%% Successful replies, read directly by the clients.
+-define(CACHE, inet_gethost_native_cache).
+-define(CACHE_LIMIT, 4096).
+
 %-define(DEBUG,1).
 -ifdef(DEBUG).
 -define(dbg(A,B), io:format(A,B)).
@@ -186,6 +191,7 @@ server_init(Starter, Ref) ->
     put(num_requests,0),
     RequestTab = ets:new(ign_requests,[{keypos,#request.rid},set,protected]),
     RequestIndex = ets:new(ign_req_index,[set,protected]),
+    ets:new(?CACHE,[named_table,set,protected,{read_concurrency,true}]),
     State = #state{port = Port, timeout = Timeout, requests = RequestTab,
 		   req_index = RequestIndex, 
 		   pool_size = Poolsize,
@@ -221,6 +227,7 @@ handle_message({{Pid,Ref}, {?OP_CONTROL, Ctl, Data}}, State)
 
 handle_message({{Pid,Ref}, restart_port}, State)
   when is_pid(Pid) ->
+    ets:delete_all_objects(?CACHE),
     NewPort=restart_port(State),
     Pid ! {Ref, ok},
     main_loop(State#state{port=NewPort});
@@ -236,6 +243,8 @@ handle_message({Port, {data, Data}}, State = #state{port = Port}) ->
 				   false ->
 				       State;
 				   Req ->
+				       Unit =/= ?UNIT_ERROR andalso
+					   cache_insert(Req, BinReply),
 				       lists:foreach(fun({P,R,TR}) ->
 							     ?CANCEL_TIMER(TR),
 							     P ! {R,
@@ -354,6 +363,40 @@ pick_client(State,RID,Clid) ->
 	    end
     end.
 
+cache_insert(#request{op = Op, proto = Proto, rdata = Data}, BinReply) ->
+    case get_cache_ttl() of
+	0 ->
+	    ok;
+	TTL ->
+	    Now = now_seconds(),
+	    case ets:info(?CACHE, size) >= ?CACHE_LIMIT of
+		true ->
+		    ets:select_delete(?CACHE, [{{'_','$1','_'},
+						[{'=<','$1',Now}],
+						[true]}]),
+		    ets:info(?CACHE, size) >= ?CACHE_LIMIT andalso
+			ets:delete_all_objects(?CACHE);
+		false ->
+		    ok
+	    end,
+	    ets:insert(?CACHE, {{Op,Proto,Data}, Now + TTL, BinReply})
+    end.
+
+cache_lookup(R) ->
+    case catch ets:lookup(?CACHE, R) of
+	[{R, Expires, BinReply}] ->
+	    case now_seconds() < Expires of
+		true -> {ok, BinReply};
+		false -> false
+	    end;
+	_ ->
+	    false
+    end.
+
+now_seconds() ->
+    {MS,S,_} = os:timestamp(),
+    MS*1000000 + S.
+
 get_rid () ->
     New = (get(rid) + 1) rem 16#7FFFFFF,
     put(rid,New),
@@ -390,6 +433,22 @@ restart_port(#state{port = Port, requests = Requests}) ->
 
 
 do_open_port(Poolsize, ExtraArgs) ->
+    case application:get_env(kernel, gethost_driver) of
+	{ok, false} ->
+	    do_open_program(Poolsize, ExtraArgs);
+	_ ->
+	    try
+		open_port({spawn_driver,
+			   ?PORT_DRIVER++" "++integer_to_list(Poolsize)},
+			  [binary])
+	    catch
+		error:_ ->
+		    %% No threads or no getaddrinfo() in this emulator
+		    do_open_program(Poolsize, ExtraArgs)
+	    end
+    end.
+
+do_open_program(Poolsize, ExtraArgs) ->
     try 
 	open_port({spawn, 
 		   ?PORT_PROGRAM++" "++integer_to_list(Poolsize)++" "++
@@ -417,6 +476,14 @@ get_extra_args() ->
 	    FirstPart++""
     end.
 
+get_cache_ttl() ->
+    case application:get_env(kernel, gethost_cache_ttl) of
+	{ok,I} when is_integer(I), I >= 0 ->
+	    I;
+	_ ->
+	    0
+    end.
+
 get_poolsize() ->
     case application:get_env(kernel, gethost_poolsize) of
 	{ok,I} when is_integer(I) ->
@@ -483,7 +550,18 @@ control(_) -> {error, formerr}.
 getit(Op, Proto, Data, DefaultName) ->
     getit({Op, Proto, Data}, DefaultName).
 
+getit({Op, _, _} = Req, DefaultName)
+  when Op =:= ?OP_GETHOSTBYNAME; Op =:= ?OP_GETHOSTBYADDR ->
+    case cache_lookup(Req) of
+	{ok, BinHostent} ->
+	    parse_address(BinHostent, DefaultName);
+	false ->
+	    call(Req, DefaultName)
+    end;
 getit(Req, DefaultName) ->
+    call(Req, DefaultName).
+
+call(Req, DefaultName) ->
     Pid = ensure_started(),
     Ref = make_ref(),
     Pid ! {{self(),Ref}, Req},
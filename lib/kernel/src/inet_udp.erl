@@ -19,7 +19,7 @@
 -module(inet_udp).
 
 -export([open/1, open/2, close/1]).
--export([send/2, send/4, recv/2, recv/3, connect/3]).
+-export([send/2, send/4, send_multi/2, recv/2, recv/3, connect/3]).
 -export([controlling_process/2]).
 -export([fdopen/2]).
 
@@ -61,6 +61,9 @@ send(S,{A,B,C,D},P,Data) when ?ip(A,B,C,D), ?port(P) ->
 
 send(S, Data) ->
     prim_inet:sendto(S, {0,0,0,0}, 0, Data).
+
+send_multi(S, Dgrams) ->
+    prim_inet:sendto_multi(S, Dgrams).
     
 connect(S, {A,B,C,D}, P) when ?ip(A,B,C,D), ?port(P) ->
     prim_inet:connect(S, {A,B,C,D}, P).
@@ -49,10 +49,20 @@ start_out() ->
     start_port([out,binary]).
 
 start_port(PortSettings) ->
-    Id = spawn(fun() -> server({fd,0,1}, PortSettings) end),
+    Id = spawn(fun() -> server({fd,0,1}, PortSettings++output_buffer()) end),
     register(?NAME, Id),
     Id.
 
+%% Batch tools writing a lot to standard_io can have the output
+%% gathered into fewer writes, see kernel(6).
+output_buffer() ->
+    case application:get_env(kernel, user_output_buffer) of
+	{ok, Size} when is_integer(Size), Size > 0 ->
+	    [{output_buffer,Size}];
+	_ ->
+	    []
+    end.
+
 %% Return the pid of the shell process.
 %% Note: We can't ask the user process for this info since it
 %% may be busy waiting for data from the port.
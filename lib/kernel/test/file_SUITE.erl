@@ -43,8 +43,8 @@
 -export([all/0, suite/0,groups/0,init_per_suite/1, end_per_suite/1, 
 	 init_per_group/2,end_per_group/2,
 	 init_per_testcase/2, end_per_testcase/2,
-	 read_write_file/1, names/1]).
--export([cur_dir_0/1, cur_dir_1/1, make_del_dir/1,
+	 read_write_file/1, read_file_mmap/1, names/1]).
+-export([cur_dir_0/1, cur_dir_1/1, make_del_dir/1, list_dir_info/1,
 	 pos1/1, pos2/1]).
 -export([close/1, consult1/1, path_consult/1, delete/1]).
 -export([ eval1/1, path_eval/1, script1/1, path_script/1,
@@ -53,7 +53,8 @@
 -export([ file_info_basic_file/1, file_info_basic_directory/1,
 	 file_info_bad/1, file_info_times/1, file_write_file_info/1]).
 -export([rename/1, access/1, truncate/1, datasync/1, sync/1,
-	 read_write/1, pread_write/1, append/1, exclusive/1]).
+	 sync_group/1,
+	 read_write/1, pread_write/1, pread_batch/1, append/1, exclusive/1]).
 -export([ e_delete/1, e_rename/1, e_make_dir/1, e_del_dir/1]).
 -export([otp_5814/1]).
 
@@ -103,7 +104,7 @@
 suite() -> [{ct_hooks,[ts_install_cth]}].
 
 all() -> 
-    [altname, read_write_file, {group, dirs},
+    [altname, read_write_file, read_file_mmap, {group, dirs},
      {group, files}, delete, rename, names, {group, errors},
      {group, compression}, {group, links}, copy,
      delayed_write, read_ahead, segment_read, segment_write,
@@ -112,14 +113,14 @@ all() ->
      read_line_4, standard_io].
 
 groups() -> 
-    [{dirs, [], [make_del_dir, cur_dir_0, cur_dir_1]},
+    [{dirs, [], [make_del_dir, cur_dir_0, cur_dir_1, list_dir_info]},
      {files, [],
       [{group, open}, {group, pos}, {group, file_info},
        {group, consult}, {group, eval}, {group, script},
-       truncate, sync, datasync, advise]},
+       truncate, sync, datasync, sync_group, advise]},
      {open, [],
       [open1, old_modes, new_modes, path_open, close, access,
-       read_write, pread_write, append, open_errors,
+       read_write, pread_write, pread_batch, append, open_errors,
        exclusive]},
      {pos, [], [pos1, pos2]},
      {file_info, [],
@@ -347,9 +348,146 @@ read_write_file(Config) when is_list(Config) ->
     ?line test_server:timetrap_cancel(Dog),
     ok.
 
+read_file_mmap(suite) -> [];
+read_file_mmap(doc) -> ["Test the mmap option of read_file/2."];
+read_file_mmap(Config) when is_list(Config) ->
+    ?line Dog = test_server:timetrap(test_server:seconds(10)),
+    ?line RootDir = ?config(priv_dir,Config),
+    ?line Name = filename:join(RootDir, 
+			       atom_to_list(?MODULE)
+			       ++"_read_file_mmap"),
+    ?line Small = filename:join(RootDir, 
+				atom_to_list(?MODULE)
+				++"_read_file_mmap_small"),
+    ?line Data = list_to_binary([lists:seq(0, 255) || _ <- lists:seq(1, 1024)]),
+    ?line ok = ?FILE_MODULE:write_file(Name, Data),
+    ?line ok = ?FILE_MODULE:write_file(Small, <<"small">>),
+
+    ?line {ok,<<"small">>} = ?FILE_MODULE:read_file(Small, [mmap]),
+    ?line {ok,Data} = ?FILE_MODULE:read_file(Name, []),
+
+    %% A file open for writing is read as usual
+    ?line {ok,Fd} = ?FILE_MODULE:open(Name, [read,write,raw]),
+    ?line {ok,Data} = ?FILE_MODULE:read_file(Name, [mmap]),
+    ?line true = is_mapped(Name) =/= true,
+    ?line ok = ?FILE_MODULE:close(Fd),
+
+    %% Otherwise it may be mapped
+    ?line {ok,Bin} = ?FILE_MODULE:read_file(Name, [mmap]),
+    ?line Data = Bin,
+    ?line Part = binary:part(Bin, 1000, 3000),
+    ?line Part = binary:part(Data, 1000, 3000),
+    case is_mapped(Name) of
+	true ->
+	    %% Changing the file makes the binary a private copy
+	    ?line ok = ?FILE_MODULE:write_file(Name, <<"changed">>),
+	    ?line false = is_mapped(Name),
+	    ?line Data = Bin,
+	    ?line {ok,<<"changed">>} = ?FILE_MODULE:read_file(Name, [mmap]);
+	_ ->
+	    ok
+    end,
+    ?line ok = ?FILE_MODULE:write_file(Name, Data),
+    ?line {ok,Bin3} = ?FILE_MODULE:read_file(Name, [mmap]),
+    ?line Data = Bin3,
+    case is_mapped(Name) of
+	true ->
+	    %% ... also when someone else truncates it
+	    ?line os:cmd("dd if=/dev/null of=" ++ Name),
+	    ?line {ok,#file_info{size=0}} = ?FILE_MODULE:read_file_info(Name),
+	    ?line false = is_mapped(Name),
+	    ?line Data = Bin3,
+	    ?line ok = ?FILE_MODULE:write_file(Name, Data);
+	_ ->
+	    ok
+    end,
+
+    %% The binary outlives the file and can be passed around
+    ?line ok = ?FILE_MODULE:delete(Name),
+    ?line ok = ?FILE_MODULE:delete(Small),
+    ?line Self = self(),
+    ?line Pid = spawn(fun() -> receive {B, P} -> P ! {self(), B} end end),
+    ?line Pid ! {Bin, Self},
+    ?line Bin2 = receive {Pid, B} -> B end,
+    ?line Data = Bin2,
+    ?line Data = binary_to_term(term_to_binary(Bin)),
+    ?line Size = byte_size(Data),
+    ?line <<Data:Size/binary, "more">> = <<Bin/binary, "more">>,
+    ?line erlang:garbage_collect(),
+
+    ?line {error, enoent} = ?FILE_MODULE:read_file(Name, [mmap]),
+    ?line {error, badarg} = ?FILE_MODULE:read_file(Name, [bad_option]),
+    ?line [] = flush(),
+    ?line test_server:timetrap_cancel(Dog),
+    ok.
+
+%% Whether the file is mapped by the emulator, or unknown.
+is_mapped(Name) ->
+    case ?FILE_MODULE:open("/proc/self/maps", [read,raw]) of
+	{ok,Fd} ->
+	    Maps = read_all(Fd, []),
+	    ok = ?FILE_MODULE:close(Fd),
+	    binary:match(Maps, list_to_binary(" " ++ Name ++ "\n")) =/= nomatch;
+	{error,_} ->
+	    unknown
+    end.
+
+read_all(Fd, Acc) ->
+    case ?FILE_MODULE:read(Fd, 65536) of
+	{ok,Data} -> read_all(Fd, [Data|Acc]);
+	eof -> list_to_binary(lists:reverse(Acc))
+    end.
+
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
 
+list_dir_info(suite) -> [];
+list_dir_info(doc) -> ["Test list_dir_info/1,2 with and without depth."];
+list_dir_info(Config) when is_list(Config) ->
+    ?line Dog = test_server:timetrap(test_server:seconds(30)),
+    ?line RootDir = ?config(priv_dir,Config),
+    ?line Top = filename:join(RootDir, 
+			      atom_to_list(?MODULE)
+			      ++"_list_dir_info"),
+    ?line ok = ?FILE_MODULE:make_dir(Top),
+    ?line ok = ?FILE_MODULE:make_dir(filename:join(Top, "a")),
+    ?line ok = ?FILE_MODULE:make_dir(filename:join([Top, "a", "b"])),
+    ?line ok = ?FILE_MODULE:write_file(filename:join(Top, "f"), <<"abc">>),
+    ?line ok = ?FILE_MODULE:write_file(filename:join([Top, "a", "b", "g"]),
+				       <<"defg">>),
+    %% Enough files to need several replies from the driver
+    ?line Many = ["m"++integer_to_list(I) || I <- lists:seq(1, 2000)],
+    ?line [ok = ?FILE_MODULE:write_file(filename:join([Top, "a", M]), <<>>)
+	   || M <- Many],
+
+    ?line {ok,L0} = ?FILE_MODULE:list_dir_info(Top),
+    ?line ["a","f"] = lists:sort([N || {N,_} <- L0]),
+    ?line {ok,L1} = ?FILE_MODULE:list_dir_info(Top, [{depth,1}]),
+    ?line Names1 = lists:sort(["a","f","a/b"|["a/"++M || M <- Many]]),
+    ?line Names1 = lists:sort([N || {N,_} <- L1]),
+    ?line {ok,L2} = ?FILE_MODULE:list_dir_info(Top, [{depth,infinity}]),
+    ?line Names2 = lists:sort(["a/b/g"|Names1]),
+    ?line Names2 = lists:sort([N || {N,_} <- L2]),
+
+    %% The information is what read_link_info/2 returns
+    ?line [begin
+	       {ok,FI} = ?FILE_MODULE:read_link_info(filename:join(Top, N)),
+	       FI = FI0#file_info{atime=FI#file_info.atime}
+	   end || {N,FI0} <- L2],
+    ?line {_,#file_info{type=regular,size=4}} = lists:keyfind("a/b/g", 1, L2),
+    ?line {_,#file_info{type=directory}} = lists:keyfind("a/b", 1, L2),
+    ?line {ok,L3} = ?FILE_MODULE:list_dir_info(Top, [{time,posix}]),
+    ?line [true = is_integer(FI#file_info.mtime) || {_,FI} <- L3],
+
+    ?line {error, enoent} =
+	?FILE_MODULE:list_dir_info(filename:join(Top, "nonexisting")),
+    ?line {error, enotdir} =
+	?FILE_MODULE:list_dir_info(filename:join(Top, "f")),
+    ?line {error, badarg} = ?FILE_MODULE:list_dir_info(Top, [{depth,-1}]),
+    ?line [] = flush(),
+    ?line test_server:timetrap_cancel(Dog),
+    ok.
+
 make_del_dir(suite) -> [];
 make_del_dir(doc) -> [];
 make_del_dir(Config) when is_list(Config) ->
@@ -827,6 +965,47 @@ pread_write_test(File, Data) ->
     ?line [] = flush(),
     ok.
 
+pread_batch(doc) -> "Test ?FILE_MODULE:pread_batch/2.";
+pread_batch(suite) -> [];
+pread_batch(Config) when is_list(Config) ->
+    ?line Dog = test_server:timetrap(test_server:seconds(30)),
+    ?line RootDir = ?config(priv_dir, Config),
+    ?line Name = filename:join(RootDir,
+			       atom_to_list(?MODULE)++"_pread_batch.fil"),
+    ?line Size = 100000,
+    ?line Bin = << <<(X rem 251)>> || X <- lists:seq(1, Size) >>,
+    ?line ok = ?FILE_MODULE:write_file(Name, Bin),
+    %% Overlapping, adjacent, repeated, empty and past end of file
+    ?line Fixed = [{10, 10}, {20, 5}, {15, 10}, {10, 10}, {0, 0},
+		   {Size-3, 10}, {Size, 1}, {Size+100, 10}, {500, 0},
+		   {500, 1}, {2*Size, 0}, {0, Size+1}],
+    random:seed(17, 4711, 42),
+    ?line Random = [{random:uniform(Size+10)-1, random:uniform(300)-1}
+		    || _ <- lists:seq(1, 500)],
+    ?line Big = [{random:uniform(Size)-1, 300000} || _ <- lists:seq(1, 3)],
+    Modes = [[raw, binary], [raw], [binary], []],
+    lists:foreach(
+      fun(Mode) ->
+	      ?line {ok, Fd} = ?FILE_MODULE:open(Name, [read | Mode]),
+	      lists:foreach(
+		fun(L) ->
+			?line {ok, Expected} = ?FILE_MODULE:pread(Fd, L),
+			?line {ok, Expected} = ?FILE_MODULE:pread_batch(Fd, L)
+		end, [[], [{3, 4}], Fixed, Random, Big, Fixed++Random]),
+	      ?line ok = ?FILE_MODULE:close(Fd)
+      end, Modes),
+    %% All results share one binary
+    ?line {ok, Fd1} = ?FILE_MODULE:open(Name, [read, raw, binary]),
+    ?line {ok, [B1, B2]} = ?FILE_MODULE:pread_batch(Fd1, [{0, 10}, {10, 10}]),
+    ?line 20 = binary:referenced_byte_size(B1),
+    ?line 20 = binary:referenced_byte_size(B2),
+    ?line {error, einval} = ?FILE_MODULE:pread_batch(Fd1, [{-1, 1}, {0, 1}]),
+    ?line {error, badarg} = ?FILE_MODULE:pread_batch(Fd1, [{0, 1}, foo]),
+    ?line ok = ?FILE_MODULE:close(Fd1),
+    ?line [] = flush(),
+    ?line test_server:timetrap_cancel(Dog),
+    ok.
+
 append(doc) -> "Test appending to a file.";
 append(suite) -> [];
 append(Config) when is_list(Config) ->
@@ -1537,6 +1716,49 @@ sync(Config) when is_list(Config) ->
     ?line test_server:timetrap_cancel(Dog),
     ok.
 
+sync_group(suite) -> [];
+sync_group(doc) -> "Tests that queued up syncs are answered by one sync.";
+sync_group(Config) when is_list(Config) ->
+    ?line Dog = test_server:timetrap(test_server:seconds(10)),
+    ?line PrivDir = ?config(priv_dir, Config),
+    ?line Sync = filename:join(PrivDir,
+			       atom_to_list(?MODULE)
+			       ++"_sync_group.fil"),
+    ?line {ok, Fd} = ?FILE_MODULE:open(Sync, [write]),
+    ?line ok = ?FILE_MODULE:write(Fd, "data"),
+    ?line {1, 0} = sync_group(Fd, [sync, datasync, sync, datasync]),
+    ?line {0, 1} = sync_group(Fd, [datasync, datasync, datasync]),
+    ?line {1, 0} = sync_group(Fd, [sync]),
+    ?line ok = ?FILE_MODULE:close(Fd),
+    ?line [] = flush(),
+    ?line test_server:timetrap_cancel(Dog),
+    ok.
+
+%% Queue up the syncs while the server is suspended
+sync_group(Fd, Syncs) ->
+    MFAs = [{prim_file, sync, 1}, {prim_file, datasync, 1}],
+    [1 = erlang:trace_pattern(MFA, true, [call_count]) || MFA <- MFAs],
+    erlang:suspend_process(Fd),
+    Self = self(),
+    Pids = [spawn_link(fun() ->
+			       Self ! {self(), ?FILE_MODULE:Sync(Fd)}
+		       end) || Sync <- Syncs],
+    wait_for_queue(Fd, length(Syncs)),
+    erlang:resume_process(Fd),
+    [receive {Pid, ok} -> ok end || Pid <- Pids],
+    [{call_count, S}, {call_count, D}] =
+	[erlang:trace_info(MFA, call_count) || MFA <- MFAs],
+    [erlang:trace_pattern(MFA, false, [call_count]) || MFA <- MFAs],
+    {S, D}.
+
+wait_for_queue(Pid, N) ->
+    case process_info(Pid, message_queue_len) of
+	{message_queue_len, Len} when Len >= N ->
+	    ok;
+	_ ->
+	    receive after 10 -> wait_for_queue(Pid, N) end
+    end.
+
 advise(suite) -> [];
 advise(doc) -> "Tests that ?FILE_MODULE:advise/4 at least doesn't crash.";
 advise(Config) when is_list(Config) ->
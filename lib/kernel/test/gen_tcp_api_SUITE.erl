@@ -28,9 +28,10 @@
 -export([all/0, suite/0,groups/0,init_per_suite/1, end_per_suite/1, 
 	 init_per_group/2,end_per_group/2, 
 	 init_per_testcase/2, end_per_testcase/2,
-	 t_connect_timeout/1, t_accept_timeout/1,
+	 t_connect_timeout/1, t_accept_timeout/1, t_accept_multi/1,
+	 t_accept_ahead/1, t_reuseport/1,
 	 t_connect_bad/1,
-	 t_recv_timeout/1, t_recv_eof/1,
+	 t_recv_timeout/1, t_recv_eof/1, t_recv_adaptive/1,
 	 t_shutdown_write/1, t_shutdown_both/1, t_shutdown_error/1,
 	 t_fdopen/1, t_implicit_inet6/1]).
 
@@ -42,9 +43,10 @@ all() ->
      t_fdopen, t_implicit_inet6].
 
 groups() -> 
-    [{t_accept, [], [t_accept_timeout]},
+    [{t_accept, [], [t_accept_timeout, t_accept_multi, t_accept_ahead,
+		     t_reuseport]},
      {t_connect, [], [t_connect_timeout, t_connect_bad]},
-     {t_recv, [], [t_recv_timeout, t_recv_eof]}].
+     {t_recv, [], [t_recv_timeout, t_recv_eof, t_recv_adaptive]}].
 
 
 
@@ -76,6 +78,100 @@ t_accept_timeout(Config) when is_list(Config) ->
     ?line {ok, L} = gen_tcp:listen(0, []),
     ?line timeout({gen_tcp, accept, [L, 200]}, 0.2, 1.0).
 
+t_accept_multi(doc) -> "Test accepting with the multi_accept option.";
+t_accept_multi(suite) -> [];
+t_accept_multi(Config) when is_list(Config) ->
+    ?line {ok, L} = gen_tcp:listen(0, [{multi_accept, 8}, {backlog, 64},
+				       {active, false}]),
+    ?line {ok, [{multi_accept, 8}]} = inet:getopts(L, [multi_accept]),
+    ?line {ok, Port} = inet:port(L),
+    ?line Self = self(),
+    ?line spawn_link(fun() -> Self ! {accepted, gen_tcp:accept(L)} end),
+    ?line receive after 100 -> ok end,
+    ?line Cs = [begin
+		    {ok, C} = gen_tcp:connect(localhost, Port, [{active, false}]),
+		    C
+		end || _ <- lists:seq(1, 20)],
+    ?line receive {accepted, {ok, _}} -> ok end,
+    ?line As = [begin {ok, A} = gen_tcp:accept(L, 1000), A end
+		|| _ <- lists:seq(1, 19)],
+    ?line {error, timeout} = gen_tcp:accept(L, 0),
+    ?line Names = [begin {ok, N} = inet:sockname(C), N end || C <- Cs],
+    ?line [] = [A || A <- As, not lists:member(element(2, inet:peername(A)),
+					      Names)],
+    ?line ok = gen_tcp:send(lists:last(Cs), "x"),
+    ?line [{ok, "x"}] = [R || {ok, _} = R <- [gen_tcp:recv(A, 0, 0) || A <- As]],
+    ?line ok = gen_tcp:close(L),
+    ?line {error, einval} = inet:setopts(element(2, gen_tcp:listen(0, [])),
+					 [{multi_accept, -1}]),
+    ok.
+
+t_accept_ahead(doc) ->
+    "Test that multi_accept takes pending connections from the backlog "
+	"in the readiness event that serves the last acceptor.";
+t_accept_ahead(suite) -> [];
+t_accept_ahead(Config) when is_list(Config) ->
+    case os:type() of
+	{unix, linux} ->
+	    ?line {ok, L} = gen_tcp:listen(0, [{ip, {127,0,0,1}},
+					       {multi_accept, 8},
+					       {backlog, 64}, {active, false}]),
+	    ?line {ok, Port} = inet:port(L),
+	    ?line Self = self(),
+	    ?line spawn_link(fun() -> Self ! {accepted, gen_tcp:accept(L)} end),
+	    ?line receive after 100 -> ok end,
+	    %% With a single scheduler all twelve connections are in the
+	    %% backlog before the listen socket is polled again.
+	    ?line true = lists:member(erlang:system_flag(multi_scheduling,
+							 block),
+				      [blocked, disabled]),
+	    ?line Ps = [spawn_link(fun() -> accept_ahead_connect(Self, Port) end)
+			|| _ <- lists:seq(1, 12)],
+	    ?line Cs = [receive {P, C} -> C end || P <- Ps],
+	    ?line {ok, A} = receive {accepted, Res} -> Res end,
+	    ?line erlang:system_flag(multi_scheduling, unblock),
+	    %% One went to the acceptor and eight were taken ahead
+	    ?line 3 = listen_queue(Port),
+	    ?line As = [begin {ok, S} = gen_tcp:accept(L, 1000), S end
+			|| _ <- lists:seq(1, 11)],
+	    ?line {error, timeout} = gen_tcp:accept(L, 0),
+	    ?line [ok = gen_tcp:close(S) || S <- [L, A | As ++ Cs]],
+	    ok;
+	_ ->
+	    {skipped, "Needs /proc/net/tcp"}
+    end.
+
+accept_ahead_connect(Parent, Port) ->
+    {ok, C} = gen_tcp:connect({127,0,0,1}, Port, [{active, false}]),
+    ok = gen_tcp:controlling_process(C, Parent),
+    Parent ! {self(), C}.
+
+%% Connections waiting in the kernel backlog of a loopback listen socket
+listen_queue(Port) ->
+    Local = [lists:flatten(io_lib:format("~s:~4.16.0B", [Ip, Port]))
+	     || Ip <- ["0100007F", "7F000001"]],
+    [Queue] = [list_to_integer(Rx, 16)
+	       || Line <- tl(string:tokens(os:cmd("cat /proc/net/tcp"), "\n")),
+		  [_, Loc, _, "0A", Queues | _] <- [string:tokens(Line, " ")],
+		  lists:member(Loc, Local),
+		  [_, Rx] <- [string:tokens(Queues, ":")]],
+    Queue.
+
+t_reuseport(doc) -> "Test that listen sockets can share a port with reuseport.";
+t_reuseport(suite) -> [];
+t_reuseport(Config) when is_list(Config) ->
+    case gen_tcp:listen(0, [{reuseport, true}]) of
+	{ok, L1} ->
+	    ?line {ok, Port} = inet:port(L1),
+	    ?line {ok, L2} = gen_tcp:listen(Port, [{reuseport, true}]),
+	    ?line {ok, [{reuseport, true}]} = inet:getopts(L2, [reuseport]),
+	    ?line {error, eaddrinuse} = gen_tcp:listen(Port, []),
+	    ?line ok = gen_tcp:close(L1),
+	    ?line ok = gen_tcp:close(L2);
+	{error, einval} ->
+	    {skipped, "SO_REUSEPORT not supported"}
+    end.
+
 %%% gen_tcp:connect/X
 
 
@@ -127,6 +223,44 @@ t_recv_eof(Config) when is_list(Config) ->
     ?line {error, closed} = gen_tcp:recv(Client, 0),
     ok.
 
+t_recv_adaptive(doc) -> "Test receiving with the adaptive_buffer option.";
+t_recv_adaptive(suite) -> [];
+t_recv_adaptive(Config) when is_list(Config) ->
+    ?line {ok, L} = gen_tcp:listen(0, [binary, {packet, 4}, {active, false},
+				       {adaptive_buffer, true}]),
+    ?line {ok, Port} = inet:port(L),
+    ?line {ok, Client} = gen_tcp:connect(localhost, Port, [binary, {packet, 4}]),
+    ?line {ok, A} = gen_tcp:accept(L),
+    ?line {ok, [{adaptive_buffer, true}]} = inet:getopts(A, [adaptive_buffer]),
+    ?line Pkts = [list_to_binary(lists:duplicate(I rem 300, I rem 256))
+		  || I <- lists:seq(1, 2000)],
+    ?line [ok = gen_tcp:send(Client, P) || P <- Pkts],
+    ?line receive after 200 -> ok end,
+    %% Several packets in one read are delivered as sub-binaries
+    ?line ok = inet:setopts(A, [{active, true}]),
+    ?line Got = [receive {tcp, A, P} -> P after 5000 -> timeout end
+		 || _ <- Pkts],
+    ?line Pkts = Got,
+    ?line ok = inet:setopts(A, [{active, false}]),
+    ?line [_|_] = [P || P <- Got, binary:referenced_byte_size(P) > 1000],
+    %% Packets larger than the learned buffer size
+    ?line Big = [binary:copy(<<I>>, I * 1000) || I <- lists:seq(1, 100)],
+    ?line [ok = gen_tcp:send(Client, P) || P <- Big],
+    ?line Big = [element(2, gen_tcp:recv(A, 0, 5000)) || _ <- Big],
+    %% Raw mode, reading given lengths
+    ?line ok = inet:setopts(A, [{packet, raw}]),
+    ?line ok = inet:setopts(Client, [{packet, raw}]),
+    ?line Raw = iolist_to_binary(Pkts),
+    ?line 0 = byte_size(Raw) rem 100,
+    ?line ok = gen_tcp:send(Client, Raw),
+    ?line Raw = iolist_to_binary(
+		  [element(2, gen_tcp:recv(A, 100, 5000))
+		   || _ <- lists:seq(1, byte_size(Raw) div 100)]),
+    ?line ok = gen_tcp:close(Client),
+    ?line {error, closed} = gen_tcp:recv(A, 0),
+    ?line ok = gen_tcp:close(L),
+    ok.
+
 %%% gen_tcp:shutdown/2
 
 t_shutdown_write(Config) when is_list(Config) ->
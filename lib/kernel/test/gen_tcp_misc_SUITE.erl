@@ -41,7 +41,10 @@
 	 killing_acceptor/1,killing_multi_acceptors/1,killing_multi_acceptors2/1,
 	 several_accepts_in_one_go/1,active_once_closed/1, send_timeout/1, send_timeout_active/1, 
 	 otp_7731/1, zombie_sockets/1, otp_7816/1, otp_8102/1,
-         otp_9389/1]).
+         otp_9389/1, length_prefix_packets/1, tls_offload/1,
+	 tls_offload_records/1,
+	 splice/1, splice_read_ahead/1, splice_source/1, latency_stats/1,
+	 delay_send_limits/1]).
 
 %% Internal exports.
 -export([sender/3, not_owner/1, passive_sockets_server/2, priority_server/1, 
@@ -73,7 +76,10 @@ all() ->
      killing_acceptor, killing_multi_acceptors,
      killing_multi_acceptors2, several_accepts_in_one_go,
      active_once_closed, send_timeout, send_timeout_active, otp_7731,
-     zombie_sockets, otp_7816, otp_8102, otp_9389].
+     zombie_sockets, otp_7816, otp_8102, otp_9389,
+     length_prefix_packets, tls_offload, tls_offload_records,
+     splice, splice_read_ahead, splice_source, latency_stats,
+     delay_send_limits].
 
 groups() -> 
     [].
@@ -2543,3 +2549,409 @@ otp_9389_loop(S, OrigLinkHdr, State) ->
         3000 ->
             ?line error({timeout,header})
     end.
+
+length_prefix_packets(doc) ->
+    ["Send and receive with little-endian and varint length headers"];
+length_prefix_packets(suite) -> [];
+length_prefix_packets(Config) when is_list(Config) ->
+    ?line {ok, L} = gen_tcp:listen(0, [binary, {active, false}]),
+    ?line {ok, Port} = inet:port(L),
+    ?line {ok, C} = gen_tcp:connect(localhost, Port, [binary, {active, false}]),
+    ?line {ok, S} = gen_tcp:accept(L),
+    ?line Sizes = [0, 1, 127, 128, 300, 16383, 16384, 65535, 100000],
+    ?line Pkts = [binary:copy(<<(N rem 256)>>, N) || N <- Sizes],
+    Types = [{{2,little}, fun(N) -> <<N:16/little>> end},
+	     {{4,little}, fun(N) -> <<N:32/little>> end},
+	     {varint, fun length_prefix_varint/1}],
+    lists:foreach(
+      fun({Type, Hdr}) ->
+	      io:format("Packet type ~p\n", [Type]),
+	      ?line ok = inet:setopts(C, [{packet, Type}]),
+	      ?line ok = inet:setopts(S, [{packet, raw}]),
+	      ?line {ok, [{packet, Type}]} = inet:getopts(C, [packet]),
+	      Ps = [P || P <- Pkts, Type =/= {2,little} orelse
+				      byte_size(P) < 65536],
+	      %% The driver writes the header
+	      ?line [ok = gen_tcp:send(C, P) || P <- Ps],
+	      ?line Framed = iolist_to_binary([[Hdr(byte_size(P)), P]
+					       || P <- Ps]),
+	      ?line {ok, Framed} = gen_tcp:recv(S, byte_size(Framed), 5000),
+	      %% and strips it, a frame at a time
+	      ?line ok = gen_tcp:send(S, Framed),
+	      ?line ok = inet:setopts(S, [{packet, Type}, {active, once}]),
+	      ?line Whole = iolist_to_binary(lists:sublist(Ps, 6)),
+	      ?line ok = gen_tcp:send(C, lists:sublist(Ps, 6)),
+	      ?line Ps = [begin
+			      {ok, P} = gen_tcp:recv(C, 0, 5000),
+			      P
+			  end || _ <- Ps],
+	      ?line receive {tcp, S, Whole} -> ok
+		    after 5000 -> ?t:fail({no_frame, Type})
+		    end,
+	      ?line ok = inet:setopts(S, [{active, false}])
+      end, Types),
+    %% A varint header of more than 32 bits is an error
+    ?line ok = inet:setopts(C, [{packet, raw}]),
+    ?line ok = inet:setopts(S, [{packet, varint}]),
+    ?line ok = gen_tcp:send(C, <<255,255,255,255,255,1>>),
+    ?line {error, emsgsize} = gen_tcp:recv(S, 0, 5000),
+    ?line ok = gen_tcp:close(C),
+    ?line ok = gen_tcp:close(S),
+    ?line ok = gen_tcp:close(L),
+    ok.
+
+length_prefix_varint(N) when N < 16#80 ->
+    <<N>>;
+length_prefix_varint(N) ->
+    Tail = length_prefix_varint(N bsr 7),
+    <<1:1,(N band 16#7f):7,Tail/binary>>.
+
+tls_offload(doc) ->
+    ["Hand the TLS record layer to the kernel in both directions"];
+tls_offload(suite) -> [];
+tls_offload(Config) when is_list(Config) ->
+    ?line {ok, L} = gen_tcp:listen(0, [binary, {active, false}]),
+    ?line {ok, Port} = inet:port(L),
+    ?line {ok, C} = gen_tcp:connect(localhost, Port, [binary, {active, false}]),
+    ?line {ok, S} = gen_tcp:accept(L),
+    Params = [{version, 'tlsv1.2'}, {cipher, aes_128_gcm},
+	      {key, <<1:128>>}, {salt, <<2:32>>}, {iv, <<3:64>>}, {seq, 0}],
+    ?line {error, einval} = inet:tls_offload(C, tx, [{key, <<1:64>>}]),
+    ?line {error, einval} = inet:tls_offload(C, sideways, Params),
+    ?line {error, enotconn} = inet:tls_offload(L, tx, Params),
+    case inet:tls_offload(C, tx, Params) of
+	{error, enotsup} ->
+	    [gen_tcp:close(X) || X <- [C, S, L]],
+	    {skip, "No kernel TLS"};
+	ok ->
+	    ?line {error, ealready} = inet:tls_offload(C, tx, Params),
+	    %% One application data record: header, explicit nonce,
+	    %% ciphertext and a 16 byte tag
+	    ?line ok = gen_tcp:send(C, <<"hello">>),
+	    ?line {ok, <<23,3,3,(8+5+16):16>>} = gen_tcp:recv(S, 5, 5000),
+	    ?line {ok, _} = gen_tcp:recv(S, 8+5+16, 5000),
+	    ?line Data = binary:copy(<<"0123456789">>, 10000),
+	    ?line ok = gen_tcp:send(C, Data),
+	    ?line ok = inet:tls_offload(S, rx, lists:keystore(seq, 1, Params,
+							      {seq, 1})),
+	    ?line {ok, Data} = gen_tcp:recv(S, byte_size(Data), 5000),
+	    ?line ok = gen_tcp:close(C),
+	    ?line ok = gen_tcp:close(S),
+	    ?line ok = gen_tcp:close(L),
+	    ok
+    end.
+
+tls_offload_records(doc) ->
+    ["Records other than application data are delivered as ssl_tls "
+     "messages after rx offload"];
+tls_offload_records(suite) -> [];
+tls_offload_records(Config) when is_list(Config) ->
+    case catch crypto:start() of
+	ok -> tls_offload_records_1();
+	_ -> {skip, "Crypto not started"}
+    end.
+
+tls_offload_records_1() ->
+    ?line {ok, L} = gen_tcp:listen(0, [binary, {active, false}]),
+    ?line {ok, Port} = inet:port(L),
+    ?line {ok, C} = gen_tcp:connect(localhost, Port, [binary, {active, false}]),
+    ?line {ok, S} = gen_tcp:accept(L),
+    Key = <<1:128>>,
+    Salt = <<2:32>>,
+    Params = [{version, 'tlsv1.2'}, {cipher, aes_128_gcm},
+	      {key, Key}, {salt, Salt}, {iv, <<3:64>>}, {seq, 0}],
+    case inet:tls_offload(S, rx, Params) of
+	{error, enotsup} ->
+	    [gen_tcp:close(X) || X <- [C, S, L]],
+	    {skip, "No kernel TLS"};
+	ok ->
+	    %% A HelloRequest handshake record in the middle of data
+	    ?line ok = gen_tcp:send(C, [tls_record(Key, Salt, 0, 23, <<"ab">>),
+					tls_record(Key, Salt, 1, 22, <<0:32>>),
+					tls_record(Key, Salt, 2, 23, <<"cd">>)]),
+	    ?line {ok, <<"ab">>} = gen_tcp:recv(S, 2, 5000),
+	    ?line {ok, {ssl_tls, S, 22, {3,3}, <<0:32>>}} =
+		gen_tcp:recv(S, 0, 5000),
+	    ?line {ok, <<"cd">>} = gen_tcp:recv(S, 2, 5000),
+	    %% Half a packet is kept while a record passes by
+	    ?line ok = inet:setopts(S, [{packet, 2}]),
+	    ?line ok = gen_tcp:send(C, [tls_record(Key, Salt, 3, 23, <<5:16,"ef">>),
+					tls_record(Key, Salt, 4, 21, <<1,0>>),
+					tls_record(Key, Salt, 5, 23, <<"ghi">>)]),
+	    ?line ok = inet:setopts(S, [{active, once}]),
+	    ?line receive {ssl_tls, S, 21, {3,3}, <<1,0>>} -> ok
+		  after 5000 -> test_server:fail(no_alert)
+		  end,
+	    ?line ok = inet:setopts(S, [{active, once}]),
+	    ?line receive {tcp, S, <<"efghi">>} -> ok
+		  after 5000 -> test_server:fail(no_data)
+		  end,
+	    ?line ok = gen_tcp:close(C),
+	    ?line ok = gen_tcp:close(S),
+	    ?line ok = gen_tcp:close(L),
+	    ok
+    end.
+
+%% A TLS 1.2 AES-128-GCM record as the kernel expects it, with the
+%% sequence number as explicit nonce
+tls_record(Key, Salt, Seq, Type, Plain) ->
+    AAD = <<Seq:64,Type,3,3,(byte_size(Plain)):16>>,
+    {Cipher, Tag} = gcm_seal(Key, <<Salt/binary,Seq:64>>, AAD, Plain),
+    [<<Type,3,3,(8 + byte_size(Cipher) + 16):16,Seq:64>>, Cipher, Tag].
+
+%% AES-GCM from AES-CTR: E(K,0) is the hash key, the counter block
+%% ending in 1 masks the tag and the data starts at 2
+gcm_seal(Key, Nonce, AAD, Plain) ->
+    <<H:128>> = crypto:aes_ctr_encrypt(Key, <<0:128>>, <<0:128>>),
+    Cipher = crypto:aes_ctr_encrypt(Key, <<Nonce/binary,2:32>>, Plain),
+    S = ghash(H, [AAD, Cipher,
+		  <<(byte_size(AAD)*8):64,(byte_size(Cipher)*8):64>>], 0),
+    {Cipher, crypto:aes_ctr_encrypt(Key, <<Nonce/binary,1:32>>, <<S:128>>)}.
+
+ghash(_H, [], Y) -> Y;
+ghash(H, [<<X:128,Rest/binary>>|Bs], Y) ->
+    ghash(H, [Rest|Bs], gf_mult(Y bxor X, H));
+ghash(H, [<<>>|Bs], Y) ->
+    ghash(H, Bs, Y);
+ghash(H, [Part|Bs], Y) ->
+    Pad = 8*(16 - byte_size(Part)),
+    ghash(H, [<<Part/binary,0:Pad>>|Bs], Y).
+
+%% Multiplication in GF(2^128), bit 0 being the most significant
+gf_mult(X, Y) -> gf_mult(X, Y, 127, 0).
+
+gf_mult(_X, _V, -1, Z) -> Z;
+gf_mult(X, V, I, Z0) ->
+    Z = case (X bsr I) band 1 of
+	    1 -> Z0 bxor V;
+	    0 -> Z0
+	end,
+    gf_mult(X, (V bsr 1) bxor ((V band 1) * (16#e1 bsl 120)), I-1, Z).
+
+splice(doc) ->
+    ["Copy data from one socket to another without it passing "
+     "through a process"];
+splice(suite) -> [];
+splice(Config) when is_list(Config) ->
+    ?line {Src, In} = splice_pair(),
+    ?line {Out, Dst} = splice_pair(),
+    ?line ok = gen_tcp:send(Src, <<"x">>),
+    case inet:splice(In, Out, 1) of
+	{error, enotsup} ->
+	    [gen_tcp:close(X) || X <- [Src, In, Out, Dst]],
+	    {skip, "No splice"};
+	{ok, 1} ->
+	    ?line {ok, <<"x">>} = gen_tcp:recv(Dst, 1, 5000),
+	    ?line {ok, U} = gen_udp:open(0),
+	    ?line {error, badarg} = inet:splice(In, U, 0),
+	    ?line ok = gen_udp:close(U),
+	    %% A bounded copy leaves the rest for the owner of From,
+	    %% and regular sends on To line up behind it
+	    ?line ok = gen_tcp:send(Src, <<"0123456789">>),
+	    ?line {ok, 5} = inet:splice(In, Out, 5),
+	    ?line ok = gen_tcp:send(Out, <<"|">>),
+	    ?line {ok, <<"01234|">>} = gen_tcp:recv(Dst, 6, 5000),
+	    ?line {ok, <<"56789">>} = gen_tcp:recv(In, 5, 5000),
+	    %% Copy until end of stream
+	    ?line Data = binary:copy(<<"0123456789abcdef">>, 1 bsl 18),
+	    ?line Self = self(),
+	    ?line spawn_link(fun() ->
+				     ok = gen_tcp:send(Src, Data),
+				     ok = gen_tcp:close(Src)
+			     end),
+	    ?line spawn_link(fun() ->
+				     Self ! {splice_data, splice_recv(Dst, [])}
+			     end),
+	    ?line Size = byte_size(Data),
+	    ?line {ok, Size} = inet:splice(In, Out, 0),
+	    ?line ok = gen_tcp:close(Out),
+	    ?line receive {splice_data, Data} -> ok
+		  after 10000 -> ?t:fail(no_data)
+		  end,
+	    ?line {error, closed} = gen_tcp:recv(In, 0, 5000),
+	    ?line ok = gen_tcp:close(In),
+	    ok
+    end.
+
+splice_read_ahead(doc) ->
+    ["Data read ahead by a packet mode recv is spliced first"];
+splice_read_ahead(suite) -> [];
+splice_read_ahead(Config) when is_list(Config) ->
+    ?line {Src, In} = splice_pair(),
+    ?line {Out, Dst} = splice_pair(),
+    ?line ok = inet:setopts(In, [{packet, line}]),
+    ?line ok = gen_tcp:send(Src, <<"GET /\nbody-0123456789">>),
+    ?line {ok, <<"GET /\n">>} = gen_tcp:recv(In, 0, 5000),
+    ?line ok = gen_tcp:send(Src, <<"abcdef">>),
+    case inet:splice(In, Out, 12) of
+	{error, enotsup} ->
+	    [gen_tcp:close(X) || X <- [Src, In, Out, Dst]],
+	    {skip, "No splice"};
+	{ok, 12} ->
+	    %% Only part of the buffered data was asked for
+	    ?line {ok, <<"body-0123456">>} = gen_tcp:recv(Dst, 12, 5000),
+	    ?line {ok, 7} = inet:splice(In, Out, 7),
+	    ?line {ok, <<"789abcd">>} = gen_tcp:recv(Dst, 7, 5000),
+	    ?line ok = gen_tcp:close(Src),
+	    ?line {ok, 2} = inet:splice(In, Out, 0),
+	    ?line ok = gen_tcp:close(Out),
+	    ?line {ok, <<"ef">>} = gen_tcp:recv(Dst, 0, 5000),
+	    ?line ok = gen_tcp:close(In),
+	    ?line ok = gen_tcp:close(Dst),
+	    ok
+    end.
+
+splice_source(doc) ->
+    ["Only a socket that its port has lent out can be spliced from, "
+     "and closing that port ends the splice"];
+splice_source(suite) -> [];
+splice_source(Config) when is_list(Config) ->
+    ?line {Src, In} = splice_pair(),
+    ?line {Out, Dst} = splice_pair(),
+    ?line {ok, Fd} = prim_inet:getfd(In),
+    case prim_inet:splice(Out, Fd, 0) of
+	{error, enotsup} ->
+	    [gen_tcp:close(X) || X <- [Src, In, Out, Dst]],
+	    {skip, "No splice"};
+	{error, ebadf} ->
+	    ?line {error, ebadf} = prim_inet:splice(Out, 0, 0),
+	    ?line Self = self(),
+	    ?line Pid = spawn_link(fun() ->
+					   receive go -> ok end,
+					   Self ! {splice_res,
+						   inet:splice(In, Out, 0)}
+				   end),
+	    ?line ok = gen_tcp:controlling_process(In, Pid),
+	    ?line Pid ! go,
+	    ?line ok = gen_tcp:send(Src, <<"abc">>),
+	    ?line {ok, <<"abc">>} = gen_tcp:recv(Dst, 3, 5000),
+	    ?line ok = gen_tcp:close(In),
+	    ?line receive {splice_res, {error, closed}} -> ok
+		  after 5000 -> ?t:fail(splice_not_ended)
+		  end,
+	    %% The splice let go of the socket, so the connection is gone
+	    ?line {error, closed} = gen_tcp:recv(Src, 0, 5000),
+	    ?line ok = gen_tcp:send(Out, <<"d">>),
+	    ?line {ok, <<"d">>} = gen_tcp:recv(Dst, 1, 5000),
+	    [gen_tcp:close(X) || X <- [Src, Out, Dst]],
+	    ok
+    end.
+
+splice_pair() ->
+    {ok, L} = gen_tcp:listen(0, [binary, {active, false}]),
+    {ok, Port} = inet:port(L),
+    {ok, C} = gen_tcp:connect(localhost, Port, [binary, {active, false}]),
+    {ok, S} = gen_tcp:accept(L),
+    ok = gen_tcp:close(L),
+    {C, S}.
+
+splice_recv(S, Acc) ->
+    case gen_tcp:recv(S, 0) of
+	{ok, B} -> splice_recv(S, [B|Acc]);
+	{error, closed} -> iolist_to_binary(lists:reverse(Acc))
+    end.
+
+latency_stats(doc) ->
+    ["Test the send dwell, receive latency and busy time histograms"];
+latency_stats(suite) -> [];
+latency_stats(Config) when is_list(Config) ->
+    ?line {C, S} = splice_pair(),
+    ?line Hists = [send_dwell, recv_latency, busy_time],
+    ?line {ok, [{latency_stats, false}]} = inet:getopts(C, [latency_stats]),
+    ?line {ok, Zero} = inet:getstat(C, Hists),
+    ?line Zero = [{H, lists:duplicate(24, 0)} || H <- Hists],
+    ?line ok = inet:setopts(C, [{latency_stats, true},
+				{sndbuf, 16384},
+				{high_watermark, 4096},
+				{low_watermark, 2048}]),
+    ?line ok = inet:setopts(S, [{latency_stats, true}]),
+    ?line {ok, [{latency_stats, true}]} = inet:getopts(C, [latency_stats]),
+    %% Nobody reads S for a while, so the sends queue up and C goes busy
+    ?line Chunk = binary:copy(<<"0123456789abcdef">>, 1024),
+    ?line N = 200,
+    ?line Self = self(),
+    ?line Pid = spawn_link(fun() ->
+				   [ok = gen_tcp:send(C, Chunk) ||
+				       _ <- lists:seq(1, N)],
+				   Self ! {self(), sent}
+			   end),
+    ?line test_server:sleep(500),
+    ?line Total = N * byte_size(Chunk),
+    ?line {ok, _} = gen_tcp:recv(S, Total, 10000),
+    ?line receive {Pid, sent} -> ok end,
+    ?line {ok, [{send_cnt, SendCnt}, {send_dwell, Dwell},
+		{busy_time, Busy}]} =
+	inet:getstat(C, [send_cnt, send_dwell, busy_time]),
+    ?line 24 = length(Dwell),
+    ?line SendCnt = lists:sum(Dwell),
+    ?line true = lists:sum(Busy) > 0,
+    ?line {ok, [{recv_cnt, RecvCnt}, {recv_latency, RecvLat}]} =
+	inet:getstat(S, [recv_cnt, recv_latency]),
+    ?line true = lists:sum(RecvLat) > 0,
+    ?line true = lists:sum(RecvLat) =< RecvCnt,
+    %% Switching off drops what was gathered
+    ?line ok = inet:setopts(C, [{latency_stats, false}]),
+    ?line {ok, Zero} = inet:getstat(C, Hists),
+    ?line ok = gen_tcp:close(C),
+    ?line ok = gen_tcp:close(S),
+    ok.
+
+delay_send_limits(doc) ->
+    ["Test the size threshold and hold time of delayed TCP output"];
+delay_send_limits(suite) -> [];
+delay_send_limits(Config) when is_list(Config) ->
+    ?line {C, S} = splice_pair(),
+    ?line {ok, [{delay_send_bytes, 0}, {delay_send_time, 0}]} =
+	inet:getopts(C, [delay_send_bytes, delay_send_time]),
+    ?line ok = inet:setopts(C, [{delay_send, true},
+				{delay_send_bytes, 1000},
+				{delay_send_time, 200}]),
+    ?line {ok, [{delay_send, true}, {delay_send_bytes, 1000},
+		{delay_send_time, 200}]} =
+	inet:getopts(C, [delay_send, delay_send_bytes, delay_send_time]),
+    %% Small sends are held back until the hold time runs out
+    ?line T0 = now(),
+    ?line [ok = gen_tcp:send(C, <<"0123456789">>) || _ <- lists:seq(1, 10)],
+    ?line {ok, [{send_pend, 100}]} = inet:getstat(C, [send_pend]),
+    ?line {ok, <<_:100/binary>>} = gen_tcp:recv(S, 100, 5000),
+    ?line true = timer:now_diff(now(), T0) >= 150000,
+    %% Reaching the size threshold writes at once
+    ?line Chunk = binary:copy(<<"x">>, 100),
+    ?line [ok = gen_tcp:send(C, Chunk) || _ <- lists:seq(1, 10)],
+    ?line {ok, [{send_pend, 0}]} = inet:getstat(C, [send_pend]),
+    ?line {ok, <<_:1000/binary>>} = gen_tcp:recv(S, 1000, 5000),
+    %% A receive with a timeout flushes what is held
+    ?line ok = gen_tcp:send(C, <<"ping">>),
+    ?line Pid = spawn_link(fun() ->
+				   {ok, <<"ping">>} = gen_tcp:recv(S, 4, 5000),
+				   ok = gen_tcp:send(S, <<"pong">>)
+			   end),
+    ?line {ok, <<"pong">>} = gen_tcp:recv(C, 4, 100),
+    ?line unlink(Pid),
+    %% So does closing the socket
+    ?line ok = gen_tcp:send(C, <<"bye">>),
+    ?line ok = gen_tcp:close(C),
+    ?line {ok, <<"bye">>} = gen_tcp:recv(S, 3, 5000),
+    ?line {error, closed} = gen_tcp:recv(S, 0, 5000),
+    ?line ok = gen_tcp:close(S),
+    %% And the peer closing its side, passive or active
+    ?line delay_send_half_closed(passive),
+    ?line delay_send_half_closed(active),
+    ok.
+
+delay_send_half_closed(Mode) ->
+    {C, S} = splice_pair(),
+    ok = inet:setopts(C, [{exit_on_close, false}, {delay_send, true},
+			  {delay_send_time, 3000}]),
+    ok = gen_tcp:send(C, <<"held">>),
+    ok = gen_tcp:shutdown(S, write),
+    case Mode of
+	passive ->
+	    {error, closed} = gen_tcp:recv(C, 0);
+	active ->
+	    ok = inet:setopts(C, [{active, true}]),
+	    receive {tcp_closed, C} -> ok end
+    end,
+    {ok, <<"held">>} = gen_tcp:recv(S, 4, 1000),
+    ok = gen_tcp:close(C),
+    ok = gen_tcp:close(S).
@@ -35,14 +35,15 @@
 
 -export([send_to_closed/1, 
 	 buffer_size/1, binary_passive_recv/1, bad_address/1,
-	 read_packets/1, open_fd/1, connect/1, implicit_inet6/1]).
+	 read_packets/1, open_fd/1, connect/1, implicit_inet6/1,
+	 recv_batch/1]).
 
 suite() -> [{ct_hooks,[ts_install_cth]}].
 
 all() -> 
     [send_to_closed, buffer_size, binary_passive_recv,
      bad_address, read_packets, open_fd, connect,
-     implicit_inet6].
+     implicit_inet6, recv_batch].
 
 groups() -> 
     [].
@@ -497,6 +498,70 @@ connect(Config) when is_list(Config) ->
     end,
     ok.
 
+recv_batch(suite) ->
+    [];
+recv_batch(doc) ->
+    ["Test the recv_batch option and gen_udp:send_multi/2"];
+recv_batch(Config) when is_list(Config) ->
+    ?line Addr = {127,0,0,1},
+    ?line {ok,R} = gen_udp:open(0, [binary,{recv_batch,16},{recbuf,1000000},
+				    {active,false}]),
+    ?line {ok,[{recv_batch,16}]} = inet:getopts(R, [recv_batch]),
+    ?line {ok,RP} = inet:port(R),
+    ?line {ok,S} = gen_udp:open(0),
+    ?line {ok,SP} = inet:port(S),
+    ?line Msgs = [list_to_binary(integer_to_list(I)) || I <- lists:seq(1, 40)],
+    ?line ok = gen_udp:send_multi(S, [{Addr,RP,M} || M <- Msgs]),
+    ?line ok = gen_udp:send_multi(S, []),
+    %% All queued datagrams arrive, in batches of at most 16
+    ?line ok = inet:setopts(R, [{active,true}]),
+    ?line Msgs = recv_batch_loop(R, Addr, SP, length(Msgs), []),
+    %% Active once is reset after a single batch
+    ?line ok = inet:setopts(R, [{active,false}]),
+    ?line ok = gen_udp:send_multi(S, [{"localhost",RP,"a"},{Addr,RP,"b"}]),
+    ?line ?t:sleep(100),
+    ?line ok = inet:setopts(R, [{active,once}]),
+    ?line receive
+	      {udp_batch,R,[{Addr,SP,<<"a">>},{Addr,SP,<<"b">>}]} -> ok
+	  after 5000 -> ?t:fail(no_batch)
+	  end,
+    ?line {ok,[{active,false}]} = inet:getopts(R, [active]),
+    %% With 64 kilobyte buffers a batch is at most 256 kilobytes
+    ?line ok = inet:setopts(R, [{buffer,65536}]),
+    ?line ok = gen_udp:send_multi(S, [{Addr,RP,M} || M <- Msgs]),
+    ?line ?t:sleep(100),
+    ?line ok = inet:setopts(R, [{active,once}]),
+    ?line receive
+	      {udp_batch,R,Big} when length(Big) =:= 4 -> ok
+	  after 5000 -> ?t:fail(no_batch)
+	  end,
+    ?line ok = inet:setopts(R, [{active,true}]),
+    ?line [_|_] = recv_batch_loop(R, Addr, SP, length(Msgs) - 4, []),
+    %% Batching off gives ordinary udp messages
+    ?line ok = inet:setopts(R, [{recv_batch,0},{active,true}]),
+    ?line ok = gen_udp:send_multi(S, [{Addr,RP,"c"}]),
+    ?line receive
+	      {udp,R,Addr,SP,<<"c">>} -> ok
+	  after 5000 -> ?t:fail(no_udp)
+	  end,
+    ?line {'EXIT',badarg} = (catch gen_udp:send_multi(S, [{Addr,RP}])),
+    ?line {error,einval} = gen_udp:send_multi(S, [{Addr,-1,"x"}]),
+    ?line {error,einval} = inet:setopts(R, [{recv_batch,100000}]),
+    ?line ok = gen_udp:close(S),
+    ?line ok = gen_udp:close(R),
+    ok.
+
+recv_batch_loop(_R, _Addr, _SP, 0, Acc) ->
+    Acc;
+recv_batch_loop(R, Addr, SP, N, Acc) ->
+    receive
+	{udp_batch,R,Batch} when length(Batch) =< 16 ->
+	    Data = [D || {A,P,D} <- Batch, A =:= Addr, P =:= SP],
+	    recv_batch_loop(R, Addr, SP, N - length(Data), Acc ++ Data)
+    after 5000 ->
+	    ?t:fail({missing,N})
+    end.
+
 implicit_inet6(Config) when is_list(Config) ->
     ?line Host = ok(inet:gethostname()),
     ?line
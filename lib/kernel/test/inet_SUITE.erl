@@ -36,6 +36,7 @@
 	 gethostnative_parallell/1, cname_loop/1, 
          gethostnative_soft_restart/0, gethostnative_soft_restart/1,
 	 gethostnative_debug_level/0, gethostnative_debug_level/1,
+	 gethostnative_driver/1, gethostnative_cache/1,
 	 getif/1,
 	 getif_ifr_name_overflow/1,getservbyname_overflow/1, getifaddrs/1]).
 
@@ -51,6 +52,7 @@ all() ->
      ipv4_to_ipv6, host_and_addr, {group, parse},
      t_gethostnative, gethostnative_parallell, cname_loop,
      gethostnative_debug_level, gethostnative_soft_restart,
+     gethostnative_driver, gethostnative_cache,
      getif, getif_ifr_name_overflow, getservbyname_overflow,
      getifaddrs].
 
@@ -705,6 +707,85 @@ collect_gethosters(N) ->
 	    {failed, {missing, N}}
     end.
 
+gethostnative_driver(suite) ->
+    [];
+gethostnative_driver(doc) ->
+    ["Check lookups through the in-VM resolver driver"];
+gethostnative_driver(Config) when is_list(Config) ->
+    ?line {ok,_} = inet_gethost_native:gethostbyname("localhost"),
+    case gethost_driver_port() of
+	false ->
+	    ?line {skipped, "inet_gethost_drv not available"};
+	Port ->
+	    ?line {ok,#hostent{h_addr_list=Addrs}} =
+		inet_gethost_native:gethostbyname("localhost"),
+	    ?line true = lists:member({127,0,0,1}, Addrs),
+	    ?line {ok,#hostent{h_addr_list=[{127,0,0,1}]}} =
+		inet_gethost_native:gethostbyaddr({127,0,0,1}),
+	    ?line {error,formerr} = inet_gethost_native:gethostbyname(17),
+	    ?line ok = inet_gethost_native:control({debug_level,1}),
+	    ?line ok = inet_gethost_native:control({debug_level,0}),
+	    %% Identical requests in flight at the same time are
+	    %% coalesced, all callers get the answer
+	    ?line Self = self(),
+	    ?line Pids = [spawn_link(
+			    fun() ->
+				    Self ! {self(),
+					    inet_gethost_native:gethostbyname(
+					      "localhost")}
+			    end) || _ <- lists:seq(1, 50)],
+	    ?line [receive {P,{ok,#hostent{}}} -> ok end || P <- Pids],
+	    %% A soft restart opens a new driver instance
+	    ?line ok = inet_gethost_native:control(soft_restart),
+	    ?line false = (gethost_driver_port() =:= Port),
+	    ?line {ok,_} = inet_gethost_native:gethostbyname("localhost"),
+	    ok
+    end.
+
+gethostnative_cache(suite) ->
+    [];
+gethostnative_cache(doc) ->
+    ["Check the gethost_cache_ttl answer cache of inet_gethost_native"];
+gethostnative_cache(Config) when is_list(Config) ->
+    ?line Key = {1,1,"localhost"},
+    ?line Old = application:get_env(kernel, gethost_cache_ttl),
+    try
+	?line application:unset_env(kernel, gethost_cache_ttl),
+	?line {ok,_} = inet_gethost_native:gethostbyname("localhost"),
+	?line [] = ets:lookup(inet_gethost_native_cache, Key),
+	?line application:set_env(kernel, gethost_cache_ttl, 60),
+	?line {ok,Hostent} = inet_gethost_native:gethostbyname("localhost"),
+	?line [{Key,_,_}] = ets:lookup(inet_gethost_native_cache, Key),
+	?line {ok,Hostent} = inet_gethost_native:gethostbyname("localhost"),
+	%% Errors are never cached
+	?line {error,_} = inet_gethost_native:gethostbyname(
+			    "a23456789012345678901234"),
+	?line [] = ets:lookup(inet_gethost_native_cache,
+			      {1,1,"a23456789012345678901234"}),
+	%% A soft restart (e.g. after a resolver configuration
+	%% change) drops everything
+	?line ok = inet_gethost_native:control(soft_restart),
+	?line [] = ets:lookup(inet_gethost_native_cache, Key),
+	ok
+    after
+	case Old of
+	    {ok,TTL} -> application:set_env(kernel, gethost_cache_ttl, TTL);
+	    undefined -> application:unset_env(kernel, gethost_cache_ttl)
+	end
+    end.
+
+gethost_driver_port() ->
+    Pid = whereis(inet_gethost_native),
+    case [P || P <- erlang:ports(),
+	       erlang:port_info(P, connected) =:= {connected,Pid},
+	       case erlang:port_info(P, name) of
+		   {name,"inet_gethost_drv"++_} -> true;
+		   _ -> false
+	       end] of
+	[Port] -> Port;
+	[] -> false
+    end.
+
 kill_gethost() ->
     kill_gethost(20).
 
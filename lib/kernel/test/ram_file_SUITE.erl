@@ -24,8 +24,8 @@
 	 %% init/1, fini/1,
 	 init_per_testcase/2, end_per_testcase/2]).
 -export([open_modes/1, open_old_modes/1, pread_pwrite/1, position/1,
-	 truncate/1, sync/1, get_set_file/1, compress/1, uuencode/1,
-	 large_file_errors/1, large_file_light/1, large_file_heavy/1]).
+	 truncate/1, sync/1, get_set_file/1, compress/1, compress_big/1,
+	 uuencode/1, large_file_errors/1, large_file_light/1, large_file_heavy/1]).
 
 -include_lib("test_server/include/test_server.hrl").
 -include_lib("kernel/include/file.hrl").
@@ -39,7 +39,7 @@ suite() -> [{ct_hooks,[ts_install_cth]}].
 
 all() -> 
     [open_modes, open_old_modes, pread_pwrite, position,
-     truncate, sync, get_set_file, compress, uuencode,
+     truncate, sync, get_set_file, compress, compress_big, uuencode,
      large_file_errors, large_file_light, large_file_heavy].
 
 groups() -> 
@@ -462,6 +462,44 @@ compress(Config) when is_list(Config) ->
 
     ok.
 
+compress_big(suite) ->
+    [];
+compress_big(doc) ->
+    ["Test compress/1 and uncompress/1 on a file of many segments, "
+     "large enough not to be done in one go."];
+compress_big(Config) when is_list(Config) ->
+    ?line Chunk = iolist_to_binary([integer_to_list(I) ||
+				       I <- lists:seq(1, 1000)]),
+    ?line ChunkSz = byte_size(Chunk),
+    ?line N = 4000,
+    ?line Size = N*ChunkSz,
+    ?line {ok,Fd} = ?FILE_MODULE:open([], [ram,read,write,binary]),
+    ?line [ok = ?FILE_MODULE:write(Fd, Chunk) || _ <- lists:seq(1, N)],
+    ?line {ok,Size} = ?RAM_FILE_MODULE:get_size(Fd),
+    ?line {ok,Chunk} = ?FILE_MODULE:pread(Fd, (N div 3)*ChunkSz, ChunkSz),
+    ?line {ok,GzSize} = ?RAM_FILE_MODULE:compress(Fd),
+    ?line {ok,Gz} = ?RAM_FILE_MODULE:get_file(Fd),
+    ?line GzSize = byte_size(Gz),
+    ?line Bin = zlib:gunzip(Gz),
+    ?line Bin = binary:copy(Chunk, N),
+    ?line {ok,Size} = ?RAM_FILE_MODULE:uncompress(Fd),
+    ?line {ok,0} = ?FILE_MODULE:position(Fd, cur),
+    ?line {ok,Bin} = ?RAM_FILE_MODULE:get_file(Fd),
+    %% A truncated file fails and is left as it was
+    ?line GzSize_100 = GzSize-100,
+    ?line {ok,_} = ?RAM_FILE_MODULE:set_file(Fd, binary:part(Gz, 0, GzSize_100)),
+    ?line {error,einval} = ?RAM_FILE_MODULE:uncompress(Fd),
+    ?line {ok,GzSize_100} = ?RAM_FILE_MODULE:get_size(Fd),
+    %% Truncating and growing again gives zeroes
+    ?line {ok,_} = ?RAM_FILE_MODULE:set_file(Fd, Bin),
+    ?line {ok,_} = ?FILE_MODULE:position(Fd, {bof,1000}),
+    ?line ok = ?FILE_MODULE:truncate(Fd),
+    ?line ok = ?FILE_MODULE:pwrite(Fd, Size, <<"x">>),
+    ?line {ok,<<0,0,0,0>>} = ?FILE_MODULE:pread(Fd, 1000, 4),
+    ?line {ok,<<0,"x">>} = ?FILE_MODULE:pread(Fd, Size-1, 4),
+    ?line ok = ?FILE_MODULE:close(Fd),
+    ok.
+
 mk_42(0) ->
     [42];
 mk_42(N) ->
@@ -88,7 +88,7 @@ groups() ->
      {examples, [], [intro]},
      {func, [],
       [zip_usage, gz_usage, gz_usage2, compress_usage,
-       dictionary_usage, large_deflate, crc, adler]}].
+       dictionary_usage, large_deflate, chunked_streams, crc, adler]}].
 
 init_per_suite(Config) ->
     Config.
@@ -574,6 +574,50 @@ large_deflate() ->
     ?m(ok, zlib:close(Z)),
     ?m(Plain, zlib:unzip(list_to_binary([Deflated, 3, 0]))).
 
+chunked_streams(doc) -> "Deflate/inflate bodies spanning many driver chunks, "
+			  "and reuse of pooled deflate streams";
+chunked_streams(suite) -> [];
+chunked_streams(Config) when is_list(Config) ->
+    %% Incompressible and very compressible data, the latter making
+    %% inflate stop on output rather than on input
+    ?line random:seed(1, 2, 3),
+    ?line Rand = list_to_binary([random:uniform(256)-1 ||
+				    _ <- lists:seq(1, 1 bsl 20)]),
+    ?line Zeros = <<0:(8 bsl 20)/unit:8>>,
+    ?line Zip = zlib:compress(Rand),
+    ?m(Rand, zlib:uncompress(Zip)),
+    ?m(Zeros, zlib:gunzip(zlib:gzip(Zeros))),
+    ?m(Zeros, zlib:unzip(zlib:zip(Zeros))),
+
+    %% Fed in pieces with sync flushes in between
+    ?line Z1 = zlib:open(),
+    ?line ok = zlib:deflateInit(Z1),
+    ?line Parts = [zlib:deflate(Z1, B, sync) ||
+		      <<B:(1 bsl 18)/binary>> <= Rand],
+    ?line Last = zlib:deflate(Z1, [], finish),
+    ?line ok = zlib:deflateEnd(Z1),
+    ?line zlib:close(Z1),
+    ?m(Rand, zlib:uncompress([Parts|Last])),
+
+    %% Streams handed back to the pool give the same output as fresh
+    %% ones, also after deflateParams/2 and a stream left unfinished
+    ?line Z2 = zlib:open(),
+    ?line ok = zlib:deflateInit(Z2, best_speed),
+    ?line ok = zlib:deflateParams(Z2, default, default),
+    ?line _ = zlib:deflate(Z2, Rand, finish),
+    ?line ok = zlib:deflateEnd(Z2),
+    ?line ok = zlib:deflateInit(Z2, best_speed),
+    ?line _ = zlib:deflate(Z2, Rand),
+    ?line ?DATA_ERROR = (catch zlib:deflateEnd(Z2)),
+    ?line zlib:close(Z2),
+    ?m(Zip, zlib:compress(Rand)),
+    ?line Fast = zlib:open(),
+    ?line ok = zlib:deflateInit(Fast, best_speed),
+    ?line FastZip = zlib:deflate(Fast, Zeros, finish),
+    ?line zlib:close(Fast),
+    ?m(Zeros, zlib:uncompress(FastZip)),
+    ok.
+
 rand_bytes(Sz) ->
     L = <<8,2,3,6,1,2,3,2,3,4,8,7,3,7,2,3,4,7,5,8,9,3>>,
     rand_bytes(erlang:md5(L),Sz).